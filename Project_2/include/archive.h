@@ -0,0 +1,63 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "events.h"
+#include <stdio.h>
+
+/** @brief Most distinct levels the archive tracks */
+#define ARCHIVE_MAX_LEVELS 4096
+
+/**
+ * @brief Opens the archive directory and loads the level aggregates.
+ *
+ * PACMANIST_ARCHIVE_DIR  Directory of the hourly .pca files and the
+ *                        level_<id>.agg aggregates (default "archive");
+ *                        "0" keeps aggregates in memory only.
+ *
+ * @return 0 on success, -1 if the directory cannot be created.
+ */
+int archive_start(void);
+
+/**
+ * @brief Returns the stable id of a level, registering it if new.
+ *
+ * Ids are keyed by file name and size and survive restarts through the
+ * .agg files. Called once per level start, off the tick path.
+ * @param level_name Level file path (only the file name is used).
+ * @param width Board width.
+ * @param height Board height.
+ * @return Level id, or 0 once ARCHIVE_MAX_LEVELS levels are known.
+ */
+int archive_level_id(const char *level_name, int width, int height);
+
+/**
+ * @brief Appends an event and updates its level's aggregates.
+ *
+ * Only called by the analytics thread.
+ * @param event Event drained from the bus.
+ */
+void archive_record(const game_event_t *event);
+
+/**
+ * @brief Writes a partial row group and dirty aggregates once they are due.
+ *
+ * Only called by the analytics thread, when the bus is empty.
+ */
+void archive_idle(void);
+
+/**
+ * @brief Writes the partial row group and dirty aggregates and closes the
+ * hour's file (called at shutdown).
+ *
+ * Only called once the analytics thread stopped feeding the archive (see
+ * events_stop()).
+ */
+void archive_stop(void);
+
+/**
+ * @brief Writes archive volume and per-level balance figures.
+ * @param f Open stream to write to.
+ */
+void archive_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef ARCHIVE_FORMAT_H
+#define ARCHIVE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * On-disk layout of the event archive.
+ *
+ * events_YYYYMMDD_HH.pca holds the events of one UTC hour: a file header
+ * followed by row groups. A row group stores up to ARCHIVE_GROUP_ROWS
+ * events column by column; each column is delta coded, zigzagged and
+ * written as LEB128 varints, so a reader can skip the columns it does not
+ * need using the byte lengths in the group header.
+ *
+ * level_<id>.agg holds the running aggregates of one level: a header and
+ * two width * height heatmaps of uint32 counts (deaths, then dots eaten).
+ */
+
+/** @brief "PCA1" */
+#define ARCHIVE_FILE_MAGIC 0x31414350u
+/** @brief "PCRG" */
+#define ARCHIVE_GROUP_MAGIC 0x47524350u
+/** @brief "PAGG" */
+#define ARCHIVE_LEVEL_MAGIC 0x47474150u
+
+/** @brief Events per row group */
+#define ARCHIVE_GROUP_ROWS 65536
+
+/**
+ * @brief Columns of a row group, in file order.
+ */
+typedef enum {
+  ARCHIVE_COL_TIME = 0,    /**< Milliseconds since the start of the hour */
+  ARCHIVE_COL_SESSION = 1, /**< Client id */
+  ARCHIVE_COL_LEVEL = 2,   /**< Level id (see level_<id>.agg) */
+  ARCHIVE_COL_TYPE = 3,    /**< game_event_type_t */
+  ARCHIVE_COL_X = 4,       /**< Board column, -1 when not applicable */
+  ARCHIVE_COL_Y = 5,       /**< Board row, -1 when not applicable */
+  ARCHIVE_COL_POINTS = 6,  /**< Player's points */
+  ARCHIVE_COL_DETAIL = 7,  /**< Type specific detail */
+} archive_column_t;
+
+/** @brief Number of columns */
+#define ARCHIVE_COLUMNS 8
+
+/**
+ * @brief Header at the start of a .pca file.
+ */
+typedef struct {
+  uint32_t magic;      /**< ARCHIVE_FILE_MAGIC */
+  uint32_t columns;    /**< ARCHIVE_COLUMNS when written */
+  uint64_t hour_start; /**< Unix time of the start of the hour */
+} archive_file_header_t;
+
+/**
+ * @brief Header of a row group; column data follows in column order.
+ */
+typedef struct {
+  uint32_t magic;                       /**< ARCHIVE_GROUP_MAGIC */
+  uint32_t rows;                        /**< Events in the group */
+  uint32_t column_bytes[ARCHIVE_COLUMNS]; /**< Encoded size of each column */
+} archive_group_header_t;
+
+/**
+ * @brief Header of a level_<id>.agg file.
+ */
+typedef struct {
+  uint32_t magic;       /**< ARCHIVE_LEVEL_MAGIC */
+  uint32_t width;       /**< Heatmap columns */
+  uint32_t height;      /**< Heatmap rows */
+  uint32_t reserved;
+  uint64_t starts;      /**< Times the level was started */
+  uint64_t portals;     /**< Times its portal was reached */
+  uint64_t quits;       /**< Times the player left it */
+  uint64_t deaths;      /**< Deaths on it */
+  uint64_t dots;        /**< Dots eaten on it */
+  uint64_t portal_ms;   /**< Total time from start to portal */
+  char name[256];       /**< Level file name */
+} archive_level_header_t;
+
+/**
+ * @brief Upper bound of the encoded size of a column.
+ */
+static inline size_t archive_column_bound(uint32_t rows) {
+  return (size_t)rows * 5;
+}
+
+/**
+ * @brief Encodes a column (delta, zigzag, LEB128).
+ * @param values Column values.
+ * @param rows Number of values.
+ * @param out Destination, at least archive_column_bound(rows) bytes.
+ * @return Encoded size in bytes.
+ */
+size_t archive_encode_column(const int32_t *values, uint32_t rows,
+                             uint8_t *out);
+
+/**
+ * @brief Decodes a column written by archive_encode_column().
+ * @param in Encoded bytes.
+ * @param size Number of encoded bytes.
+ * @param values Destination for rows values.
+ * @param rows Number of values expected.
+ * @return 0 on success, -1 if the data is truncated or malformed.
+ */
+int archive_decode_column(const uint8_t *in, size_t size, int32_t *values,
+                          uint32_t rows);
+
+#endif
@@ -2,6 +2,9 @@
 #define BOARD_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** @brief Maximum number of moves in a command sequence */
 #define MAX_MOVES 20
@@ -11,6 +14,8 @@
 #define MAX_FILENAME 256
 /** @brief Maximum number of ghosts allowed on a board */
 #define MAX_GHOSTS 25
+/** @brief Longest precomputed ghost path, in moves */
+#define GHOST_PATH_MAX 4096
 
 /** @brief Game Control Codes */
 #define CONTINUE_PLAY 0
@@ -18,6 +23,8 @@
 #define QUIT_GAME 2
 #define LOAD_BACKUP 3
 #define CREATE_BACKUP 4
+#define MIGRATE_SESSION 5 /**< Level paused to move the session elsewhere */
+#define PAUSE_SESSION 6   /**< Level paused because the player is idle */
 
 /**
  * @brief Return codes for movement functions.
@@ -53,6 +60,17 @@ typedef struct {
   char next_user_move; /**< The next move buffered from client input */
 } pacman_t;
 
+/**
+ * @brief State of a scripted ghost after some number of moves.
+ */
+typedef struct {
+  int pos_x, pos_y;
+  int move;       /**< current_move, modulo n_moves */
+  int waiting;    /**< Passo countdown */
+  int turns_left; /**< turns_left of the current command */
+  int blocked;    /**< The move out of this step hits a wall */
+} ghost_path_t;
+
 /**
  * @brief State and attributes of a Ghost character.
  */
@@ -64,6 +82,10 @@ typedef struct {
   int current_move;           /**< Current index in the movement pattern */
   int waiting;                /**< Flag if ghost is currently in a wait state */
   int charged; /**< Potentially for power-ups (e.g. vulnerable ghosts) */
+  int path_start; /**< First step of its path in board->ghost_paths */
+  int path_len;   /**< Steps in the path, 0 if it runs its script */
+  int path_loop;  /**< Step the path goes back to after the last one */
+  int path_step;  /**< Step the ghost is at */
 } ghost_t;
 
 /**
@@ -75,6 +97,56 @@ typedef struct {
   int has_portal; /**< 1 if cell is the level exit portal */
 } board_pos_t;
 
+/**
+ * @brief Gameplay events a board reports through its on_event hook.
+ */
+typedef enum {
+  BOARD_EVENT_DOT = 1,    /**< Pacman ate a dot at (x, y) */
+  BOARD_EVENT_DEATH = 2,  /**< Pacman died at (x, y); detail is the cause */
+  BOARD_EVENT_PORTAL = 3, /**< Pacman reached the portal at (x, y) */
+} board_event_t;
+
+/** @brief Death causes passed as the detail of BOARD_EVENT_DEATH */
+#define DEATH_WALKED_INTO_GHOST 1
+#define DEATH_CAUGHT_BY_GHOST 2
+
+/**
+ * @brief Event hook, called with the state lock held for writing.
+ *
+ * In BOARD_LOCK_STRIPED mode it is called with only the stripes of the move
+ * held, so several entities may call it at once. Must not block or take the
+ * board's lock.
+ * @param ctx The board's event_ctx.
+ * @param event Event kind.
+ * @param x Column of the cell where it happened.
+ * @param y Row of the cell where it happened.
+ * @param points Pacman's points after the event.
+ * @param detail Event specific (death cause), 0 otherwise.
+ */
+typedef void (*board_event_fn)(void *ctx, board_event_t event, int x, int y,
+                               int points, int detail);
+
+/**
+ * @brief Step hook, called after every move with the state lock held for
+ * writing and board->hash already updated.
+ *
+ * Replaying the same steps in the same order on a copy of the board gives
+ * the same board: random moves draw from the board's own rng_seed. Must not
+ * block or take the board's lock.
+ * @param ctx The board's step_ctx.
+ * @param entity 0 for Pacman, 1 + index for a ghost.
+ * @param key Command played, '\0' if it was the entity's own script command.
+ * @param hash Board hash after the move.
+ */
+typedef void (*board_step_fn)(void *ctx, int entity, char key, uint64_t hash);
+
+/** @brief Moves hold state_lock for writing (board_t.lock_mode) */
+#define BOARD_LOCK_GLOBAL 0
+/** @brief Moves share state_lock and lock the row stripes they touch */
+#define BOARD_LOCK_STRIPED 1
+/** @brief Row stripes of a board in BOARD_LOCK_STRIPED mode (row % n) */
+#define BOARD_LOCK_STRIPES 16
+
 /**
  * @brief Global state of a level.
  */
@@ -94,6 +166,20 @@ typedef struct {
   pthread_rwlock_t
       state_lock;       /**< Synchronization for multi-threaded board access */
   int lock_initialized; /**< Safety flag to track if lock is ready */
+  int lock_mode;        /**< BOARD_LOCK_GLOBAL or BOARD_LOCK_STRIPED */
+  pthread_mutex_t row_locks[BOARD_LOCK_STRIPES]; /**< Striped mode only */
+  atomic_llong lock_wait_ns; /**< Time threads spent blocked on board locks */
+  unsigned int rng_seed; /**< rand_r() state for random ('R') moves */
+  board_event_fn on_event; /**< Gameplay event hook (NULL for none) */
+  void *event_ctx;         /**< Argument passed to on_event */
+  board_step_fn on_step;   /**< Move hook (NULL for none) */
+  void *step_ctx;          /**< Argument passed to on_step */
+  uint64_t hash; /**< Zobrist hash of the playing state (board_hash()) */
+  ghost_path_t *ghost_paths; /**< Paths of the scripted ghosts, one block */
+  int n_ghost_paths;         /**< Steps in ghost_paths */
+  unsigned long allocs;      /**< Heap blocks board_clone()/board_restore()
+                                  allocated for this copy */
+  unsigned long long alloc_bytes; /**< Bytes of those blocks */
 } board_t;
 
 /**
@@ -102,6 +188,39 @@ typedef struct {
  */
 void sleep_ms(int milliseconds);
 
+/**
+ * @brief Acquires the board's state_lock for writing.
+ *
+ * Only contended acquisitions are timed; the wait is added to lock_wait_ns.
+ * @param board Board to lock.
+ */
+void board_wrlock(board_t *board);
+
+/**
+ * @brief Acquires the board's state_lock for reading (see board_wrlock()).
+ *
+ * In BOARD_LOCK_STRIPED mode moves hold state_lock for reading, so readers
+ * take it for writing to see no move half done.
+ * @param board Board to lock.
+ */
+void board_rdlock(board_t *board);
+
+/**
+ * @brief Switches a board's moves to BOARD_LOCK_STRIPED mode.
+ *
+ * A move then holds state_lock for reading and the stripes of the rows it
+ * may touch (its row and the rows next to it, every row for a charged
+ * ghost), so entities in different parts of the map move in parallel. The
+ * hash is updated with atomic XORs and random moves draw from rng_seed with
+ * a compare-and-swap. Boards with an on_step hook still apply moves one at
+ * a time, as the hook needs their order. Call it before any thread uses
+ * the board; unload_level() releases the stripes. Copies made by
+ * board_clone() and board_restore() start in BOARD_LOCK_GLOBAL mode.
+ * @param board Board to switch.
+ * @return 0 on success, -1 if the locks cannot be created.
+ */
+int board_use_striped_locks(board_t *board);
+
 /**
  * @brief Processes a single movement step for Pacman.
  * @param board Pointer to the game board.
@@ -120,6 +239,21 @@ int move_pacman(board_t *board, int pacman_index, command_t *command);
  */
 int move_ghost(board_t *board, int ghost_index, command_t *command);
 
+/**
+ * @brief Tells where a ghost will be after more moves, in constant time.
+ *
+ * Only ghosts with a precomputed path (see load_level()) can be asked. Hold
+ * the board's lock for an answer consistent with the board.
+ * @param board Pointer to the board.
+ * @param ghost_index Index of the ghost.
+ * @param moves Moves from now, 0 for its current position.
+ * @param x Receives the column.
+ * @param y Receives the row.
+ * @return 0 on success, -1 if the ghost runs its script.
+ */
+int ghost_path_position(const board_t *board, int ghost_index, long moves,
+                        int *x, int *y);
+
 /**
  * @brief Logic for when Pacman dies (collision/traps).
  * @param board Pointer to the board.
@@ -127,6 +261,20 @@ int move_ghost(board_t *board, int ghost_index, command_t *command);
  */
 void kill_pacman(board_t *board, int pacman_index);
 
+/**
+ * @brief Computes the Zobrist hash of a board from scratch.
+ *
+ * Covers every cell's content, dot and portal, the entities' positions, the
+ * cursor of their scripts (current command, passo countdown, turns left of
+ * a wait), dead Pacmans and charged ghosts; not points, tempo or the random
+ * state. Keys are derived from a fixed seed, so equal states hash equal on
+ * every build and platform. The movement functions keep board->hash equal
+ * to this value at O(1) cost per change.
+ * @param board Board to hash.
+ * @return 64-bit hash.
+ */
+uint64_t board_hash(const board_t *board);
+
 /**
  * @brief Dynamically allocates and adds a pacman to the board.
  * @param board Board pointer.
@@ -142,6 +290,10 @@ int load_ghost(board_t *board);
 
 /**
  * @brief Parses a level file and initializes the board_t state.
+ *
+ * Ghosts whose script has no random ('R') or charge ('C') command, and
+ * whose cells no other ghost can ever reach, always take the same path: it
+ * is run once here, until it loops, and move_ghost() then replays it.
  * @param board Pointer to populate.
  * @param filename Path to the .txt level file.
  * @param accumulated_points Points carried over from previous levels.
@@ -149,6 +301,44 @@ int load_ghost(board_t *board);
  */
 int load_level(board_t *board, const char *filename, int accumulated_points);
 
+/**
+ * @brief Makes a playable copy of a loaded level without touching the disk.
+ * @param dst Board to populate (its previous contents are not freed).
+ * @param src Loaded level, only read.
+ * @param accumulated_points Points carried over from previous levels.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int board_clone(board_t *dst, const board_t *src, int accumulated_points);
+
+/**
+ * @brief Bytes board_save() needs for a board.
+ */
+size_t board_save_size(const board_t *board);
+
+/**
+ * @brief Serializes the playing state of a board (cells, entities, tempo,
+ * random state), e.g. to move a paused session to another process.
+ *
+ * The format is the in-memory layout: only builds of the same source can
+ * read it back. Scripts file names, the lock and the event hook are not
+ * saved. The board's hash is, and board_restore() checks it.
+ * @param board Board to save (not being modified).
+ * @param buf Destination.
+ * @param size Bytes available at buf.
+ * @return Bytes written, or -1 if buf is too small.
+ */
+long board_save(const board_t *board, void *buf, size_t size);
+
+/**
+ * @brief Rebuilds a board saved by board_save().
+ * @param dst Board to populate (its previous contents are not freed).
+ * @param buf Saved board.
+ * @param size Bytes at buf.
+ * @return 0 on success, -1 if the data is invalid (including a state that
+ * does not match its saved hash) or allocation fails.
+ */
+int board_restore(board_t *dst, const void *buf, size_t size);
+
 /**
  * @brief Frees memory and cleans up resources for the level.
  */
@@ -0,0 +1,66 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "board.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+
+/**
+ * @brief One parsed level of a catalog.
+ */
+typedef struct {
+  board_t board;         /**< Loaded level, only ever read once published */
+  char path[512];        /**< Path of the level file */
+  ino_t ino;             /**< Inode of the file when it was loaded */
+  off_t size;            /**< File size when it was loaded */
+  struct timespec mtime; /**< Modification time, to the nanosecond */
+  struct timespec ctime; /**< Status change time, to the nanosecond */
+} catalog_level_t;
+
+/**
+ * @brief Immutable, reference-counted snapshot of the levels directory.
+ */
+typedef struct {
+  atomic_int refs;         /**< Sessions using it, plus 1 while current */
+  unsigned long version;   /**< Increases with every rebuild */
+  int count;               /**< Number of levels */
+  catalog_level_t *levels; /**< Levels sorted by file name */
+} level_catalog_t;
+
+/**
+ * @brief Loads every level of a directory and starts watching it.
+ *
+ * A background thread waits for inotify events on the directory. Files are
+ * only picked up once closed after writing or moved in, so a copy in
+ * progress is never read. After a short quiet period it builds a new
+ * catalog, re-parsing only the levels that changed (all of them if a .p/.m
+ * script changed), and makes it current.
+ *
+ * @param dir Levels directory.
+ * @return 0 on success, -1 if the directory cannot be read.
+ */
+int catalog_start(const char *dir);
+
+/**
+ * @brief Takes a reference to the current catalog.
+ *
+ * The catalog stays valid, and unchanged, until catalog_release().
+ * @return The current catalog.
+ */
+level_catalog_t *catalog_acquire(void);
+
+/**
+ * @brief Drops a reference; the last one frees a replaced catalog.
+ * @param catalog Catalog returned by catalog_acquire().
+ */
+void catalog_release(level_catalog_t *catalog);
+
+/**
+ * @brief Writes the current version, reload counts and live catalogs.
+ * @param f Open stream to write to.
+ */
+void catalog_dump_stats(FILE *f);
+
+#endif
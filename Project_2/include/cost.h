@@ -0,0 +1,77 @@
+#ifndef COST_H
+#define COST_H
+
+#include "session.h"
+#include <stdio.h>
+
+/**
+ * @brief Counters summed over every session this process has run.
+ */
+typedef struct {
+  int sessions;                      /**< Sessions running right now */
+  unsigned long long ticks;          /**< Frames ticked */
+  unsigned long long frames_written; /**< OP_UPDATE frames written */
+  unsigned long long bytes_written;  /**< Bytes written to clients */
+  unsigned long long lock_wait_ns;   /**< Time blocked on board state locks */
+} cost_totals_t;
+
+/**
+ * @brief Returns the CPU time consumed so far by the calling thread.
+ * @return Thread CPU time in nanoseconds.
+ */
+unsigned long long cost_thread_cpu_ns(void);
+
+/**
+ * @brief Adds the calling thread's whole CPU time to a session.
+ *
+ * Called by game threads right before they exit.
+ * @param session Session the thread worked for.
+ */
+void cost_add_thread_cpu(session_t *session);
+
+/**
+ * @brief Accounts allocations made on behalf of a session.
+ * @param session Session to charge.
+ * @param count Number of allocations.
+ * @param bytes Total bytes allocated.
+ */
+void cost_add_alloc(session_t *session, unsigned long count,
+                    unsigned long long bytes);
+
+/**
+ * @brief Makes a session visible in the "top sessions by cost" report.
+ * @param session Session starting on a worker.
+ */
+void cost_session_begin(session_t *session);
+
+/**
+ * @brief Removes a session from the live set, keeping its final costs.
+ * @param session Session ending on a worker.
+ */
+void cost_session_end(session_t *session);
+
+/**
+ * @brief Accounts one play of a level for the per-level cost report.
+ * @param level_name Level file name.
+ * @param cpu_ns CPU time spent by the session while playing the level.
+ * @param ticks Frames ticked while playing the level.
+ */
+void cost_level_played(const char *level_name, unsigned long long cpu_ns,
+                       unsigned long ticks);
+
+/**
+ * @brief Sums the counters of live and finished sessions.
+ *
+ * Every counter only grows, so the difference between two calls is the
+ * activity in between.
+ * @param out Destination.
+ */
+void cost_totals(cost_totals_t *out);
+
+/**
+ * @brief Writes the top sessions and levels by CPU cost.
+ * @param f Open stream to write to.
+ */
+void cost_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "board.h"
+#include "session.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Kinds of game events.
+ */
+typedef enum {
+  EVENT_SESSION_START = 1, /**< detail: FEAT_* bits agreed in the handshake */
+  EVENT_SESSION_END = 2,   /**< points: final score */
+  EVENT_LEVEL_START = 3,   /**< points: carried over from previous levels */
+  EVENT_LEVEL_END = 4,     /**< detail: NEXT_LEVEL, LOAD_BACKUP or QUIT_GAME */
+  EVENT_DOT = 5,           /**< (x, y): cell of the dot eaten */
+  EVENT_DEATH = 6,         /**< (x, y): collision cell; detail: DEATH_* */
+  EVENT_PORTAL = 7,        /**< (x, y): cell of the portal */
+  EVENT_INPUT = 8,         /**< (x, y): Pacman; detail: key of the move */
+} game_event_type_t;
+
+/** @brief Number of event kinds, plus one (kinds start at 1) */
+#define EVENT_TYPES 9
+
+/**
+ * @brief One game event (32 bytes).
+ */
+typedef struct {
+  uint64_t seq;      /**< Position in the stream, from 1 (0 while written) */
+  uint64_t time_ns;  /**< CLOCK_MONOTONIC time of the event */
+  int32_t client_id; /**< Session the event belongs to */
+  int32_t points;    /**< Player's points at the time of the event */
+  uint8_t type;      /**< game_event_type_t */
+  uint8_t detail;    /**< Type specific, see game_event_type_t */
+  uint16_t level;    /**< Level id (see archive_level_id()) */
+  int16_t x, y;      /**< Board cell, -1 when not applicable */
+} game_event_t;
+
+/** @brief Marks an initialized events segment ("PEVT") */
+#define EVENTS_SHM_MAGIC 0x54564550u
+/** @brief Default shared memory name of the event stream */
+#define EVENTS_SHM_DEFAULT "/pacmanist_events"
+
+/**
+ * @brief Shared memory event stream, written only by the server.
+ *
+ * Event seq s lives in events[(s - 1) % capacity]. Its seq field is zeroed
+ * while the slot is rewritten, so a reader copies a slot, re-reads seq and
+ * keeps the copy only if seq is still the one it expected. Readers never
+ * block the server; one that falls more than capacity events behind loses
+ * the overwritten ones.
+ */
+typedef struct {
+  uint32_t magic;      /**< EVENTS_SHM_MAGIC once initialized */
+  uint32_t capacity;   /**< Number of slots in events */
+  uint64_t write_seq;  /**< Seq of the last event published (atomic) */
+  int32_t owner_pid;   /**< Server writing the stream */
+  uint32_t reserved;
+  game_event_t events[]; /**< Ring of the most recent events */
+} events_shm_t;
+
+/**
+ * @brief Starts the event bus and its analytics thread.
+ *
+ * PACMANIST_EVENTS_SHM  Shared memory name of the event stream (default
+ *                       "/pacmanist_events"); "0" keeps events in-process.
+ *
+ * A stream another running server still writes is left alone, and this
+ * server keeps its events in-process; one left by a dead server is replaced.
+ *
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int events_start(void);
+
+/**
+ * @brief Lets the analytics thread drain the ring and exit, then removes the
+ * shared memory stream (called at shutdown).
+ * @return 0 once the thread exited, -1 if it was still busy after a second.
+ */
+int events_stop(void);
+
+/**
+ * @brief Queues an event of a session. Never blocks; drops it if full.
+ * @param session Session the event belongs to.
+ * @param type Event kind.
+ * @param x Board column, or -1.
+ * @param y Board row, or -1.
+ * @param points Player's points.
+ * @param detail Type specific value.
+ */
+void events_emit(const session_t *session, game_event_type_t type, int x,
+                 int y, int points, int detail);
+
+/**
+ * @brief board_event_fn forwarding board events; ctx is the session_t.
+ */
+void events_board_hook(void *ctx, board_event_t event, int x, int y,
+                       int points, int detail);
+
+/**
+ * @brief Name of an event kind, for logs and consumers.
+ */
+static inline const char *events_type_name(int type) {
+  static const char *const names[EVENT_TYPES] = {
+      "?",   "SESSION_START", "SESSION_END", "LEVEL_START", "LEVEL_END",
+      "DOT", "DEATH",         "PORTAL",      "INPUT"};
+  return type > 0 && type < EVENT_TYPES ? names[type] : names[0];
+}
+
+/**
+ * @brief Writes event counts, drops and the analytics aggregates.
+ * @param f Open stream to write to.
+ */
+void events_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef FEATURE_PLANES_H
+#define FEATURE_PLANES_H
+
+#include "board.h"
+#include <stdint.h>
+
+/**
+ * @file feature_planes.h
+ * @brief Converts boards and recorded frames into one-hot feature planes.
+ *
+ * Input is a frame in the OP_UPDATE board_data format: one character per
+ * cell, row-major ('#' wall, '.' dot, '@' portal, 'C' pacman, 'M' ghost,
+ * ' ' empty). Output is FEATURE_PLANES planes of width * height cells, in
+ * the order below, optionally followed by a distance-to-pacman byte plane.
+ */
+
+/** @brief Plane indices */
+#define FEATURE_WALL 0
+#define FEATURE_DOT 1
+#define FEATURE_PORTAL 2
+#define FEATURE_PACMAN 3
+#define FEATURE_GHOST 4
+#define FEATURE_PLANES 5
+
+/** @brief Pack planes 8 cells per byte (LSB first) instead of 1 per byte */
+#define FEATURES_BITS 0x01
+/** @brief Append a byte plane of Manhattan distance to pacman (255 = far) */
+#define FEATURES_DISTANCE 0x02
+
+/**
+ * @brief Bytes written per frame by the encoders.
+ * @param cells width * height.
+ * @param flags FEATURES_* flags.
+ * @return Output size of one frame.
+ */
+size_t features_size(int cells, int flags);
+
+/**
+ * @brief Renders a board as an OP_UPDATE frame.
+ * @param board Board to render.
+ * @param board_data Output, width * height characters.
+ */
+void features_frame_from_board(const board_t *board, char *board_data);
+
+/**
+ * @brief Encodes one frame (SIMD where available).
+ * @param board_data Frame characters.
+ * @param width Board width.
+ * @param height Board height.
+ * @param flags FEATURES_* flags.
+ * @param out Output, features_size() bytes.
+ */
+void features_encode(const char *board_data, int width, int height, int flags,
+                     uint8_t *out);
+
+/**
+ * @brief Encodes n frames of the same size stored back to back.
+ * @param frames n * width * height characters.
+ * @param n Number of frames.
+ * @param width Board width.
+ * @param height Board height.
+ * @param flags FEATURES_* flags.
+ * @param out Output, n * features_size() bytes.
+ */
+void features_encode_batch(const char *frames, int n, int width, int height,
+                           int flags, uint8_t *out);
+
+/**
+ * @brief Per-cell reference encoder, same output as features_encode().
+ */
+void features_encode_scalar(const char *board_data, int width, int height,
+                            int flags, uint8_t *out);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FLOOD_H
+#define FLOOD_H
+
+#include "session.h"
+#include <stdio.h>
+
+/**
+ * @brief Reads the request-path limits from the environment.
+ *
+ * PACMANIST_INPUT_RATE   Sustained OP_MOVE requests per second (default 30).
+ * PACMANIST_INPUT_BURST  Moves accepted in a burst (default 10).
+ */
+void flood_init(void);
+
+/**
+ * @brief Prepares the flood protection state of a new session.
+ * @param input State to initialize (full bucket, nothing buffered).
+ */
+void flood_session_init(session_input_t *input);
+
+/**
+ * @brief Takes one token from the session's bucket.
+ * @param input Session's flood protection state.
+ * @return 1 if the move may be applied, 0 if it must be dropped.
+ */
+int flood_admit_move(session_input_t *input);
+
+/**
+ * @brief Accounts the outcome of one batch of requests.
+ * @param input Session's flood protection state.
+ * @param rate_limited Moves dropped by the token bucket.
+ * @param coalesced Moves superseded by a later move of the same batch.
+ * @param unknown_ops Bytes skipped as unknown opcodes.
+ */
+void flood_account(session_input_t *input, unsigned long rate_limited,
+                   unsigned long coalesced, unsigned long unknown_ops);
+
+/**
+ * @brief Prints a warning for a session at most once per second.
+ *
+ * Suppressed warnings are counted and reported with the next one printed.
+ * @param session Session the warning is about.
+ * @param format printf-style format.
+ */
+void flood_warn(session_t *session, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Writes the server-wide request-path counters.
+ * @param f Open stream to write to.
+ */
+void flood_dump_stats(FILE *f);
+
+#endif
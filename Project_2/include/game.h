@@ -2,6 +2,45 @@
 #define SERVER_GAME_H
 
 #include "../include/board.h"
+#include "../include/protocol.h"
+#include "../include/session.h"
+
+/**
+ * @brief Character a cell is drawn with in an OP_UPDATE frame.
+ * @param cell Cell of the board.
+ * @return '#' for walls, '@' portal, '.' dot, ' ' empty, else its content.
+ */
+char server_cell_visual(const board_pos_t *cell);
+
+/**
+ * @brief Fills the header of a frame (dimensions, points, lives, state,
+ * level name) from a board.
+ * @param board Board to describe.
+ * @param msg Frame to fill.
+ */
+void server_frame_header(const board_t *board, game_state_msg_t *msg);
+
+/**
+ * @brief Serializes a board into an OP_UPDATE frame.
+ * @param board Board to serialize (caller holds its lock).
+ * @param msg Frame to fill.
+ */
+void server_build_update(const board_t *board, game_state_msg_t *msg);
+
+/**
+ * @brief Reads PACMANIST_BOARD_LOCK ("global" or "striped", default global).
+ */
+void game_init(void);
+
+/**
+ * @brief Sets a level up for its threads in the configured lock mode.
+ *
+ * With PACMANIST_BOARD_LOCK=striped, ghosts and Pacman in different rows
+ * move in parallel (board_use_striped_locks()). Call it before anything
+ * else can reach the board.
+ * @param board Level about to be played.
+ */
+void game_prepare_board(board_t *board);
 
 /**
  * @brief Entry point for the game logic.
@@ -12,8 +51,26 @@
  * @param game_board Pointer to the initialized game board.
  * @param notif_fd Open file descriptor for client updates.
  * @param req_fd Pre-opened file descriptor for reading player input.
+ * @param session Session the level belongs to (tick phase, accounting).
  * @return int Exit status (NEXT_LEVEL, QUIT_GAME, etc.)
  */
-int run_game_logic(board_t *game_board, int notif_fd, int req_fd);
+int run_game_logic(board_t *game_board, int notif_fd, int req_fd,
+                   session_t *session);
+
+/**
+ * @brief Waits, with no game thread running, for an idle player to return.
+ *
+ * Called after run_game_logic() returned PAUSE_SESSION. Sends a frame with
+ * GAME_STATE_PAUSED, releases free heap pages and blocks until the request
+ * pipe has input; the listener of the resumed level reads it.
+ * @param board Level stopped at a tick boundary.
+ * @param notif_fd Client's notification pipe.
+ * @param req_fd Client's request pipe.
+ * @param session Paused session.
+ * @return CONTINUE_PLAY to resume the level, MIGRATE_SESSION if the session
+ * must move to another shard, QUIT_GAME if the client is gone.
+ */
+int pause_session(board_t *board, int notif_fd, int req_fd,
+                  session_t *session);
 
 #endif
@@ -0,0 +1,109 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Stats history ring.
+ *
+ * A sampler thread writes one history_sample_t per second to
+ * <data_dir>/history.ring, a fixed-size file mapped by the server that holds
+ * the last PACMANIST_HISTORY_DAYS days. Sample n (from 1) lives in slot
+ * (n - 1) % slots, so the file never grows and the oldest second is
+ * overwritten by the newest. Numbering continues across restarts; the time
+ * the server was down shows up as a gap in the timestamps.
+ *
+ * Each slot carries its sample number, cleared while the slot is rewritten,
+ * so readers (SIGUSR1, bin/history_query) copy samples without locking and
+ * skip the one being written.
+ */
+
+/** @brief "PHST" */
+#define HISTORY_MAGIC 0x54534850u
+/** @brief Ring layout version */
+#define HISTORY_VERSION 1
+/** @brief Seconds between samples */
+#define HISTORY_INTERVAL_S 1
+
+/**
+ * @brief One second of server activity (64 bytes).
+ *
+ * Rates are per second, normalized to the exact time between samples.
+ */
+typedef struct {
+  uint64_t seq;          /**< Sample number, 0 while being written */
+  int64_t time;          /**< Unix time of the sample */
+  uint32_t sessions;     /**< Sessions running on workers */
+  uint32_t queue_depth;  /**< Accepted sessions waiting for a worker */
+  uint32_t ticks;        /**< Frames ticked per second, all sessions */
+  uint32_t frames;       /**< Frames sent to players per second */
+  uint64_t bytes;        /**< Bytes written to clients per second */
+  uint32_t p99_late_us;  /**< p99 tick lateness over the second (bound) */
+  uint32_t lock_wait_us; /**< Time blocked on board locks per second */
+  uint32_t rss_kb;       /**< Resident memory not backed by files, in KiB */
+  uint32_t qos_level;    /**< Overload controller level */
+  uint32_t reserved[2];
+} history_sample_t;
+
+/**
+ * @brief Header at the start of history.ring, followed by the slots.
+ */
+typedef struct {
+  uint32_t magic;      /**< HISTORY_MAGIC */
+  uint32_t version;    /**< HISTORY_VERSION */
+  uint32_t slots;      /**< Samples the ring holds */
+  uint32_t interval_s; /**< HISTORY_INTERVAL_S */
+  uint64_t head;       /**< Samples written so far (atomic) */
+  int64_t created;     /**< Unix time the ring was created */
+  uint64_t reserved[4];
+  history_sample_t samples[]; /**< Ring of slots samples */
+} history_ring_t;
+
+/**
+ * @brief Size of a ring file holding a number of samples.
+ */
+static inline size_t history_ring_size(uint32_t slots) {
+  return sizeof(history_ring_t) + (size_t)slots * sizeof(history_sample_t);
+}
+
+/**
+ * @brief Copies sample n of a ring being written.
+ * @param ring Mapped ring.
+ * @param n Sample number, from 1.
+ * @param out Destination.
+ * @return 0 on success, -1 if the slot was overwritten or is being written.
+ */
+static inline int history_read(const history_ring_t *ring, uint64_t n,
+                               history_sample_t *out) {
+  const history_sample_t *slot = &ring->samples[(n - 1) % ring->slots];
+  uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+  if (before != n)
+    return -1;
+  __builtin_memcpy(out, slot, sizeof(*out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != before)
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief Maps the ring and starts the sampler thread.
+ *
+ * PACMANIST_HISTORY_DAYS  Days of samples kept (default 7, 0 disables the
+ *                         history). A ring sized for another number of days
+ *                         is started over.
+ *
+ * The ring lives in PACMANIST_DATA_DIR, next to the score store.
+ * @param queue_depth Returns the sessions waiting for a worker.
+ * @return 0 on success or when disabled, -1 if the ring cannot be opened.
+ */
+int history_start(int (*queue_depth)(void));
+
+/**
+ * @brief Writes the ring's size and coverage and the last sample.
+ * @param f Open stream to write to.
+ */
+void history_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "protocol.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Live leaderboard sent to clients with FEAT_LEADERBOARD.
+ *
+ * Sessions publish their points into a slot of their own, which costs one
+ * comparison per frame. A publisher thread rebuilds the top
+ * LEADERBOARD_SIZE from the live slots and the score store at most every
+ * PACMANIST_LEADERBOARD_MS, and only when something changed; a rebuild that
+ * gives the same entries keeps the version. Update threads compare the
+ * published version with the one their client last received and send the
+ * leaderboard only when it differs.
+ */
+
+/** @brief Sessions that can appear as playing */
+#define LEADERBOARD_MAX_LIVE 256
+
+/**
+ * @brief Starts the publisher thread.
+ *
+ * PACMANIST_LEADERBOARD_MS  Minimum time between rebuilds (default 250).
+ *
+ * @return 0 on success, -1 if the thread cannot be created.
+ */
+int leaderboard_start(void);
+
+/**
+ * @brief Lists a session as playing.
+ * @param client_id Client id of the session.
+ * @param name Player name.
+ * @return int Slot for leaderboard_set_points(), or -1 if all are taken.
+ */
+int leaderboard_join(int client_id, const char *name);
+
+/**
+ * @brief Publishes a session's current points. Cheap when unchanged.
+ * @param slot Slot from leaderboard_join() (ignored when -1).
+ * @param points Current points.
+ */
+void leaderboard_set_points(int slot, int points);
+
+/**
+ * @brief Removes a finished session; its score comes from the store next.
+ * @param slot Slot from leaderboard_join() (ignored when -1).
+ */
+void leaderboard_leave(int slot);
+
+/**
+ * @brief Copies the leaderboard if it is newer than the one last read.
+ * @param seen Version the caller last read; updated on success.
+ * @param out Destination, left as it was unless the call returns 1.
+ * @return int 1 if out was filled, 0 if the caller is up to date or the
+ * snapshot was being republished through every try.
+ */
+int leaderboard_read(uint32_t *seen, leaderboard_msg_t *out);
+
+/**
+ * @brief Writes rebuild and send counters.
+ * @param f Open stream to write to.
+ */
+void leaderboard_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef MIGRATE_H
+#define MIGRATE_H
+
+#include "board.h"
+#include "placement.h"
+#include "protocol.h"
+#include "session.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+/**
+ * Live session migration.
+ *
+ * A rebalancer thread moves sessions off overloaded cores while they play:
+ * it changes the session's core and bumps core_epoch, and every game thread
+ * re-pins itself at its next tick (migrate_follow()). Sessions can also move
+ * to another PacmanIST process (a shard): the pacman thread stops at a tick
+ * boundary, the worker serializes the board and session state and passes
+ * them with the client's pipe fds over a UNIX socket (SCM_RIGHTS). The
+ * handoff has two phases so the session never runs on both shards: the
+ * other shard restores the board, holds a worker and answers that it is
+ * ready; only once this shard confirms that it let the session go does the
+ * other one start it. If the other shard refuses or does not answer in
+ * time, the session resumes here and the other shard drops its copy.
+ *
+ * PACMANIST_REBALANCE_MS   Rebalancer period (default 1000, 0 disables).
+ * PACMANIST_SHARD_SOCKET   UNIX socket this shard accepts sessions on.
+ * PACMANIST_SHARD_PEER     UNIX socket of the shard to offload sessions to.
+ * PACMANIST_SHARD_OFFLOAD  Sessions per core above which the oldest session
+ *                          is offloaded to the peer (default 4).
+ */
+
+/**
+ * @brief State of a session travelling between shards, besides its board.
+ */
+typedef struct {
+  int client_id;
+  unsigned int features;
+  int max_fps;
+  int level;          /**< Catalog index of the level being played */
+  int levels_cleared; /**< Levels completed so far */
+  unsigned int leaderboard_seen;
+  double input_tokens;      /**< Token bucket of the request path */
+  int input_partial_len;    /**< Bytes of a split request */
+  unsigned char input_partial[2];
+  char player[PIPE_NAME_SIZE]; /**< Player name */
+  uint64_t resume_token;       /**< Client's resume token (0 for none) */
+} migrate_state_t;
+
+/**
+ * @brief A session received from another shard, waiting for a worker.
+ */
+typedef struct {
+  migrate_state_t state;
+  board_t board; /**< Restored level, ready to resume */
+  int notif_fd;  /**< Client's notification pipe */
+  int req_fd;    /**< Client's request pipe */
+} migrate_session_t;
+
+/**
+ * @brief Holds a worker for a session another shard offers.
+ * @return 0 if a worker is held for it, -1 if the shard is full.
+ */
+typedef int (*migrate_reserve_fn)(void);
+
+/**
+ * @brief Hands a received session to the worker held for it.
+ * @param session Session to run, owned by the worker from now on, or NULL
+ * to give the worker back when the sender kept the session.
+ */
+typedef void (*migrate_admit_fn)(migrate_session_t *session);
+
+/**
+ * @brief Starts the rebalancer and, if configured, the shard listener.
+ * @param reserve Called for every session another shard offers.
+ * @param admit Called once the offer is settled, after a successful reserve.
+ * @return 0 on success, -1 if the shard socket cannot be opened.
+ */
+int migrate_start(migrate_reserve_fn reserve, migrate_admit_fn admit);
+
+/**
+ * @brief Unlinks the shard socket.
+ */
+void migrate_stop(void);
+
+/**
+ * @brief Makes a running session visible to the rebalancer.
+ */
+void migrate_register(session_t *session);
+
+/**
+ * @brief Removes a session from the rebalancer (before releasing its core).
+ */
+void migrate_unregister(session_t *session);
+
+/**
+ * @brief Sends a session stopped with MIGRATE_SESSION to the peer shard.
+ *
+ * Clears the session's migrate_request whatever the outcome.
+ * @param session Session being moved.
+ * @param state Session state to send.
+ * @param board Level in play, stopped at a tick boundary.
+ * @param notif_fd Client's notification pipe.
+ * @param req_fd Client's request pipe.
+ * @return 0 if the peer took the session (close the fds), -1 to resume here;
+ * the peer only runs the session in the first case.
+ */
+int migrate_send(session_t *session, const migrate_state_t *state,
+                 const board_t *board, int notif_fd, int req_fd);
+
+/**
+ * @brief Frees a received session that was not run.
+ */
+void migrate_session_free(migrate_session_t *session);
+
+/**
+ * @brief Re-pins the calling game thread if its session changed core.
+ *
+ * One atomic load per tick when nothing changed.
+ * @param session Session of the thread.
+ * @param seen Epoch the thread is pinned for; start it at ~0u.
+ */
+static inline void migrate_follow(session_t *session, unsigned int *seen) {
+  unsigned int epoch =
+      atomic_load_explicit(&session->core_epoch, memory_order_acquire);
+  if (epoch == *seen)
+    return;
+  *seen = epoch;
+  placement_pin_self(__atomic_load_n(&session->core, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Writes core moves and shard handoffs.
+ * @param f Open stream to write to.
+ */
+void migrate_dump_stats(FILE *f);
+
+#endif
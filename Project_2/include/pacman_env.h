@@ -0,0 +1,156 @@
+#ifndef PACMAN_ENV_H
+#define PACMAN_ENV_H
+
+#include <semaphore.h>
+#include <stdint.h>
+
+/**
+ * @file pacman_env.h
+ * @brief Batched, thread-free environment API over the board logic.
+ *
+ * Many copies of one level are kept in contiguous arrays and advanced in
+ * lock step by a small worker pool. One step is one tick: Pacman takes the
+ * given action and every ghost plays its next pattern move, using the same
+ * move_pacman()/move_ghost() code as the server. There are no entity
+ * threads, no sleeps and no FIFOs.
+ */
+
+/** @brief Actions accepted by pacman_env_step() */
+#define PACMAN_ACT_NONE 0
+#define PACMAN_ACT_UP 1
+#define PACMAN_ACT_LEFT 2
+#define PACMAN_ACT_DOWN 3
+#define PACMAN_ACT_RIGHT 4
+#define PACMAN_ACTIONS 5
+
+/** @brief Cell codes of an observation (one byte per cell, row-major) */
+#define PACMAN_OBS_EMPTY 0
+#define PACMAN_OBS_WALL 1
+#define PACMAN_OBS_DOT 2
+#define PACMAN_OBS_PORTAL 3
+#define PACMAN_OBS_PACMAN 4
+#define PACMAN_OBS_GHOST 5
+
+/** @brief Values written to dones[] by pacman_env_step() */
+#define PACMAN_DONE_RUNNING 0   /**< Episode continues */
+#define PACMAN_DONE_DIED 1      /**< Pacman was caught */
+#define PACMAN_DONE_PORTAL 2    /**< Pacman reached the portal */
+#define PACMAN_DONE_TRUNCATED 3 /**< Step limit reached */
+
+/** @brief Default step limit of an episode */
+#define PACMAN_ENV_MAX_STEPS 1000
+
+typedef struct pacman_env pacman_env_t;
+
+/**
+ * @brief Loads a level once and prepares n_envs copies of it.
+ * @param level_file Path to the .lvl file (motion files next to it).
+ * @param n_envs Number of environments stepped together.
+ * @param n_threads Worker threads, caller included (<= 0 for one per CPU).
+ * @return The environment, or NULL if the level cannot be loaded.
+ */
+pacman_env_t *pacman_env_create(const char *level_file, int n_envs,
+                                int n_threads);
+
+/**
+ * @brief Stops the workers and frees the environment.
+ */
+void pacman_env_destroy(pacman_env_t *env);
+
+/** @brief Number of environments. */
+int pacman_env_count(const pacman_env_t *env);
+/** @brief Board width in cells. */
+int pacman_env_width(const pacman_env_t *env);
+/** @brief Board height in cells. */
+int pacman_env_height(const pacman_env_t *env);
+/** @brief Bytes of one environment's observation (width * height). */
+int pacman_env_obs_size(const pacman_env_t *env);
+/**
+ * @brief Zobrist hash of one environment's state (see board_hash()), e.g. to
+ * memoize states or spot repeated ones without comparing observations.
+ */
+uint64_t pacman_env_state_hash(const pacman_env_t *env, int i);
+
+/**
+ * @brief Sets the step limit after which an episode is truncated.
+ */
+void pacman_env_set_max_steps(pacman_env_t *env, int max_steps);
+
+/**
+ * @brief Restarts every environment.
+ * @param env Environment.
+ * @param seeds n_envs seeds for the random ghost moves (NULL uses 1..n).
+ * @param obs Output, n_envs * obs_size bytes.
+ */
+void pacman_env_reset(pacman_env_t *env, const unsigned int *seeds,
+                      uint8_t *obs);
+
+/**
+ * @brief Advances every environment by one tick.
+ *
+ * Finished environments restart on their own: their done code is reported
+ * and the observation is the first one of the next episode.
+ *
+ * @param env Environment.
+ * @param actions n_envs PACMAN_ACT_* values.
+ * @param obs Output, n_envs * obs_size bytes.
+ * @param rewards Output, points gained by each environment this step.
+ * @param dones Output, PACMAN_DONE_* per environment.
+ */
+void pacman_env_step(pacman_env_t *env, const uint8_t *actions, uint8_t *obs,
+                     float *rewards, uint8_t *dones);
+
+/* --- Shared-memory server mode --- */
+
+/** @brief First field of the shared segment */
+#define PACMAN_ENV_SHM_MAGIC 0x564e4550u
+/** @brief Commands a trainer puts in pacman_env_shm_t.command */
+#define PACMAN_ENV_CMD_RESET 1
+#define PACMAN_ENV_CMD_STEP 2
+#define PACMAN_ENV_CMD_CLOSE 3
+
+/**
+ * @brief Header of the POSIX shared memory segment served by pacman_envd.
+ *
+ * The arrays follow the header at the given offsets. A trainer fills seeds
+ * or actions, sets the command, posts 'request' and waits on 'response';
+ * the server then has written obs, rewards and dones.
+ */
+typedef struct {
+  uint32_t magic;       /**< PACMAN_ENV_SHM_MAGIC once the server is ready */
+  uint32_t n_envs;      /**< Number of environments */
+  uint32_t width;       /**< Board width */
+  uint32_t height;      /**< Board height */
+  uint32_t obs_size;    /**< Bytes per observation */
+  int32_t command;      /**< PACMAN_ENV_CMD_* */
+  sem_t request;        /**< Posted by the trainer */
+  sem_t response;       /**< Posted by the server when done */
+  uint64_t seeds_off;   /**< unsigned int[n_envs] */
+  uint64_t actions_off; /**< uint8_t[n_envs] */
+  uint64_t obs_off;     /**< uint8_t[n_envs * obs_size] */
+  uint64_t rewards_off; /**< float[n_envs] */
+  uint64_t dones_off;   /**< uint8_t[n_envs] */
+  uint64_t total_size;  /**< Size of the whole segment */
+} pacman_env_shm_t;
+
+/**
+ * @brief Maps a segment created by pacman_envd (trainer side).
+ * @param name Shared memory name, e.g. "/pacman_env".
+ * @return The mapped header, or NULL on error.
+ */
+pacman_env_shm_t *pacman_env_shm_attach(const char *name);
+
+/**
+ * @brief Runs one command on the server and waits for it to finish.
+ * @param shm Mapped segment.
+ * @param command PACMAN_ENV_CMD_*.
+ * @return 0 on success, -1 on error.
+ */
+int pacman_env_shm_call(pacman_env_shm_t *shm, int command);
+
+/**
+ * @brief Unmaps a segment mapped with pacman_env_shm_attach().
+ */
+void pacman_env_shm_detach(pacman_env_shm_t *shm);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+/**
+ * @brief Initializes the core placement policy from the environment.
+ *
+ * PACMANIST_CPUS     CPU list for session threads (e.g. "0-3,6"); defaults
+ *                    to the process affinity mask.
+ * PACMANIST_IO_CPUS  Optional CPU list for the host (registration) thread.
+ * PACMANIST_PIN      Set to "0" to disable pinning altogether.
+ * PACMANIST_MIGRATE_THRESHOLD  Session imbalance between the busiest and the
+ *                    idlest core that triggers a migration (default 2).
+ *
+ * @return 0 on success, -1 if no usable CPU was found (pinning disabled).
+ */
+int placement_init(void);
+
+/**
+ * @brief Pins the calling thread to the IO CPU set, if one is configured.
+ */
+void placement_pin_io(void);
+
+/**
+ * @brief Picks the least loaded core for a new session.
+ * @return Core id, or -1 when pinning is disabled.
+ */
+int placement_assign(void);
+
+/**
+ * @brief Moves a session to the idlest core if the imbalance is too high.
+ *
+ * Called by the rebalancer; the session's threads follow at their next tick.
+ *
+ * @param core Core currently owning the session.
+ * @return The (possibly new) core of the session.
+ */
+int placement_rebalance(int core);
+
+/**
+ * @brief Releases the session load accounted on a core.
+ * @param core Core returned by placement_assign() or placement_rebalance().
+ */
+void placement_release(int core);
+
+/**
+ * @brief Pins the calling thread to a core.
+ * @param core Core id (-1 is a no-op).
+ */
+void placement_pin_self(int core);
+
+/**
+ * @brief Prepares thread attributes that start a thread on a core.
+ * @param attr Attributes to initialize (destroy with pthread_attr_destroy).
+ * @param core Core id (-1 leaves the affinity unset).
+ */
+void placement_thread_attr(pthread_attr_t *attr, int core);
+
+/**
+ * @brief Opens a cache-miss counter covering the calling thread and every
+ * thread it creates afterwards.
+ * @return Counter handle, or -1 if hardware counters are unavailable.
+ */
+int placement_counter_open(void);
+
+/**
+ * @brief Closes a cache-miss counter and accounts it against a tick count.
+ * @param counter Handle from placement_counter_open() (-1 is ignored).
+ * @param ticks Ticks simulated while the counter was open.
+ */
+void placement_counter_close(int counter, unsigned long ticks);
+
+/**
+ * @brief Writes per-core load, migrations and cache misses per tick.
+ * @param f Open stream to write to.
+ */
+void placement_dump_stats(FILE *f);
+
+#endif
@@ -8,9 +8,24 @@
 #define OP_DISCONNECT 2
 #define OP_MOVE 3
 #define OP_UPDATE 4
+#define OP_CONNECT_EXT 5
+#define OP_LEADERBOARD 6
+#define OP_STATE_HASH 7
+#define OP_SPECTATE 8
+#define OP_SPECTATE_FRAME 9
+#define OP_SPECTATE_END 10
+#define OP_RESUME 11
+#define OP_RESUME_TOKEN 12
 
 // --- Protocol Constants ---
 #define PIPE_NAME_SIZE 40
+#define PROTOCOL_VERSION 1 // Highest extended handshake version spoken
+
+// --- Feature Bits (extended handshake) ---
+#define FEAT_FRAME_RATE_CAP 0x01 // Server honours the client's max_fps
+#define FEAT_LEADERBOARD 0x02    // Server sends OP_LEADERBOARD side messages
+#define FEAT_STATE_HASH 0x04     // Server follows frames with OP_STATE_HASH
+#define FEAT_RESUME 0x08         // Server sends a resume token (standby replica)
 
 // --- Message Structures ---
 
@@ -29,6 +44,41 @@ typedef struct {
   int8_t result;  // 0 for success, -1 for failure
 } connect_resp_t;
 
+// OP_CODE = 5: Extended Connection Request (Client -> Server)
+// Same pipes as OP_CONNECT followed by the client's version, the FEAT_* bits
+// it supports and its limits. A server older than this request reads it as
+// an 81-byte OP_CONNECT with an unknown op code and does not answer; the
+// client then asks again with OP_CONNECT. The 11 bytes left over are only
+// dropped if nothing else is queued: when another request already follows,
+// the old server reads them with the start of that request, and every
+// request after it is misread. Upgrade the server before its clients.
+// Size: 1 + 40 + 40 + 1 + 2 + 4 + 2 + 2 = 92 bytes
+typedef struct {
+  int8_t op_code;                  // OP_CONNECT_EXT
+  char req_pipe[PIPE_NAME_SIZE];   // Pipe for sending requests to server
+  char notif_pipe[PIPE_NAME_SIZE]; // Pipe for receiving updates from server
+  uint8_t version;                 // Highest version the client speaks
+  uint8_t reserved[2];             // Zero
+  uint32_t features;               // FEAT_* bits the client supports
+  uint16_t max_fps;                // Frames per second cap, 0 for none
+  uint8_t reserved_end[2];         // Zero
+} connect_ext_req_t;
+_Static_assert(sizeof(connect_ext_req_t) == 92, "connect_ext_req_t layout");
+
+// OP_CODE = 5 (Response): Extended Connection Response (Server -> Client)
+// Confirms the agreed version, feature set and limits.
+// Size: 1 + 1 + 1 + 1 + 4 + 2 + 2 = 12 bytes
+typedef struct {
+  int8_t op_code;          // OP_CONNECT_EXT
+  int8_t result;           // 0 for success, -1 for failure
+  uint8_t version;         // min(client, server) version
+  uint8_t reserved;        // Zero
+  uint32_t features;       // FEAT_* bits both sides support
+  uint16_t max_fps;        // Frame rate cap the server will apply, 0 for none
+  uint8_t reserved_end[2]; // Zero
+} connect_ext_resp_t;
+_Static_assert(sizeof(connect_ext_resp_t) == 12, "connect_ext_resp_t layout");
+
 // OP_CODE = 2: Disconnect Request (Client -> Server)
 // Size: 1 byte
 typedef struct {
@@ -50,11 +100,12 @@ typedef struct {
 #define GAME_STATE_PLAYING 0
 #define GAME_STATE_WIN 1
 #define GAME_STATE_GAME_OVER 2
+#define GAME_STATE_PAUSED 3 // Idle: ticks stopped until the next OP_MOVE
 
 // OP_CODE = 4: Game Update (Server -> Client)
 typedef struct {
   int8_t op_code;    // OP_UPDATE
-  int8_t game_state; // GAME_STATE_PLAYING, WIN, or GAME_OVER
+  int8_t game_state; // GAME_STATE_PLAYING, WIN, GAME_OVER or PAUSED
   int16_t width;
   int16_t height;
   int16_t points;
@@ -63,4 +114,136 @@ typedef struct {
   char board_data[MAX_BOARD_SIZE];
 } game_state_msg_t;
 
+// --- Leaderboard (FEAT_LEADERBOARD) ---
+#define LEADERBOARD_SIZE 5  // Entries in an OP_LEADERBOARD message
+#define LEADERBOARD_NAME 16 // Player name bytes, including the terminator
+#define LEADERBOARD_PLAYING 0x01 // Entry flag: the session is still running
+
+// Size: 4 + 4 + 1 + 16 + 3 = 28 bytes
+typedef struct {
+  int32_t client_id;
+  int32_t points;
+  uint8_t flags;               // LEADERBOARD_PLAYING
+  char name[LEADERBOARD_NAME]; // Player name
+  uint8_t reserved[3];         // Zero
+} leaderboard_entry_t;
+_Static_assert(sizeof(leaderboard_entry_t) == 28, "leaderboard_entry_t layout");
+
+// OP_CODE = 6: Leaderboard (Server -> Client)
+// Sent after an OP_UPDATE only when the leaderboard changed since the last
+// one this client received. Best live and all-time scores, best first.
+// Size: 1 + 1 + 2 + 4 + 5 * 28 = 148 bytes
+typedef struct {
+  int8_t op_code;      // OP_LEADERBOARD
+  uint8_t count;       // Valid entries
+  uint8_t reserved[2]; // Zero
+  uint32_t version;    // Increases with every change
+  leaderboard_entry_t entries[LEADERBOARD_SIZE];
+} leaderboard_msg_t;
+_Static_assert(sizeof(leaderboard_msg_t) == 148, "leaderboard_msg_t layout");
+
+// OP_CODE = 7: State Hash (Server -> Client, FEAT_STATE_HASH)
+// Sent right after every OP_UPDATE: the Zobrist hash of the board state the
+// frame was drawn from, so two runs (or a predicting client and the server)
+// can be compared tick by tick without comparing boards.
+// Size: 1 + 3 + 4 + 8 = 16 bytes
+typedef struct {
+  int8_t op_code;      // OP_STATE_HASH
+  uint8_t reserved[3]; // Zero
+  uint32_t tick;       // Frames ticked by the session when the frame was taken
+  uint64_t hash;       // Zobrist hash of the board
+} state_hash_msg_t;
+_Static_assert(sizeof(state_hash_msg_t) == 16, "state_hash_msg_t layout");
+
+// --- Spectators ---
+#define SPECTATE_MAX_SESSIONS 32 // Sessions one spectator connection follows
+
+// OP_CODE = 8: Spectate Request (Dashboard -> Server)
+// Attaches one notification pipe to several sessions at once. Sessions are
+// listed by client id, or with count 0 the server picks running sessions,
+// and later ones as slots free up, up to 'limit'.
+// Size: 1 + 40 + 1 + 1 + 1 + 2 + 2 + 32 * 4 = 176 bytes
+typedef struct {
+  int8_t op_code;                  // OP_SPECTATE
+  char notif_pipe[PIPE_NAME_SIZE]; // Pipe receiving every followed session
+  uint8_t count;                   // Client ids listed, 0 to follow any
+  uint8_t limit;                   // Sessions followed when count is 0
+  uint8_t reserved;                // Zero
+  uint16_t max_fps;                // Frames per second per session, 0 for all
+  uint8_t reserved_ids[2];         // Zero
+  int32_t client_ids[SPECTATE_MAX_SESSIONS];
+} spectate_req_t;
+_Static_assert(sizeof(spectate_req_t) == 176, "spectate_req_t layout");
+
+// OP_CODE = 8 (Response): Spectate Response (Server -> Dashboard)
+// First message on the notification pipe.
+// Size: 1 + 1 + 1 = 3 bytes
+typedef struct {
+  int8_t op_code;   // OP_SPECTATE
+  int8_t result;    // 0 for success, -1 if no spectator slot is free
+  uint8_t attached; // Sessions followed right away
+} spectate_resp_t;
+_Static_assert(sizeof(spectate_resp_t) == 3, "spectate_resp_t layout");
+
+// OP_CODE = 9: Spectated Frame (Server -> Dashboard)
+// A followed session's frame, sent only when its board changed. 'slot' is
+// stable while the session is followed and is reused after its end.
+// Size: 1 + 1 + 2 + 4 + 2442 + 2 = 2452 bytes
+typedef struct {
+  int8_t op_code;          // OP_SPECTATE_FRAME
+  uint8_t slot;            // Index of the session on this connection
+  uint8_t reserved[2];     // Zero
+  int32_t client_id;       // Session's client id
+  game_state_msg_t frame;
+  uint8_t reserved_end[2]; // Zero
+} spectate_frame_msg_t;
+_Static_assert(sizeof(spectate_frame_msg_t) == 2452,
+               "spectate_frame_msg_t layout");
+
+// OP_CODE = 10: Spectated Session End (Server -> Dashboard)
+// Size: 1 + 1 + 2 + 4 = 8 bytes
+typedef struct {
+  int8_t op_code;      // OP_SPECTATE_END
+  uint8_t slot;
+  uint8_t reserved[2]; // Zero
+  int32_t client_id;
+} spectate_end_msg_t;
+_Static_assert(sizeof(spectate_end_msg_t) == 8, "spectate_end_msg_t layout");
+
+// --- Session Resume (FEAT_RESUME) ---
+
+// OP_CODE = 12: Resume Token (Server -> Client)
+// Sent once the session starts. If the server dies, its standby replica takes
+// over the registration FIFO and continues the session for a client that
+// presents this token with OP_RESUME.
+// Size: 1 + 7 + 8 = 16 bytes
+typedef struct {
+  int8_t op_code;      // OP_RESUME_TOKEN
+  uint8_t reserved[7]; // Zero
+  uint64_t token;      // Secret identifying the session
+} resume_token_msg_t;
+_Static_assert(sizeof(resume_token_msg_t) == 16, "resume_token_msg_t layout");
+
+// OP_CODE = 11: Resume Request (Client -> Server)
+// Sent instead of OP_CONNECT by a client whose server went away, with the
+// same pipes as before.
+// Size: 1 + 40 + 40 + 7 + 8 = 96 bytes
+typedef struct {
+  int8_t op_code;                  // OP_RESUME
+  char req_pipe[PIPE_NAME_SIZE];   // Pipe for sending requests to server
+  char notif_pipe[PIPE_NAME_SIZE]; // Pipe for receiving updates from server
+  uint8_t reserved[7];             // Zero
+  uint64_t token;                  // From OP_RESUME_TOKEN
+} resume_req_t;
+_Static_assert(sizeof(resume_req_t) == 96, "resume_req_t layout");
+
+// OP_CODE = 11 (Response): Resume Response (Server -> Client)
+// On success, frames of the resumed game follow.
+// Size: 1 + 1 = 2 bytes
+typedef struct {
+  int8_t op_code; // OP_RESUME
+  int8_t result;  // 0 for success, -1 for an unknown token
+} resume_resp_t;
+_Static_assert(sizeof(resume_resp_t) == 2, "resume_resp_t layout");
+
 #endif // PROTOCOL_H
@@ -0,0 +1,80 @@
+#ifndef QOS_H
+#define QOS_H
+
+#include "session.h"
+#include <stdio.h>
+
+/**
+ * @brief Degradation levels, entered in this order as tick lateness grows.
+ */
+typedef enum {
+  QOS_NORMAL = 0,               /**< Full frame rate for everybody */
+  QOS_SPECTATORS_REDUCED = 1,   /**< Spectator streams send fewer frames */
+  QOS_LOW_PRIORITY_REDUCED = 2, /**< Idle players get fewer frames too */
+  QOS_ADMISSION_PAUSED = 3,     /**< New sessions wait to be admitted */
+} qos_level_t;
+
+/** @brief Number of degradation levels */
+#define QOS_LEVELS 4
+
+/**
+ * @brief Starts the overload controller thread.
+ *
+ * PACMANIST_QOS_THRESHOLDS  p99 tick lateness, in ms, that enters levels 1,
+ *                           2 and 3 (default "5,15,40").
+ * PACMANIST_QOS_IDLE_MS     Time without input after which a session is low
+ *                           priority (default 5000).
+ * PACMANIST_IDLE_PAUSE_MS   Time without input after which a session with
+ *                           no spectators is paused (default 60000, 0 never).
+ *
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int qos_start(void);
+
+/**
+ * @brief Returns the current degradation level.
+ */
+qos_level_t qos_level(void);
+
+/**
+ * @brief Tells whether a frame should be sent on this tick.
+ * @param session Session owning the stream.
+ * @param spectator 1 for a spectator stream, 0 for the player's own.
+ * @param tick Tick counter of the stream.
+ * @return 1 to send the frame, 0 to skip it.
+ */
+int qos_should_send(session_t *session, int spectator, unsigned long tick);
+
+/**
+ * @brief Records player input, keeping the session at normal priority.
+ * @param session Session that received input.
+ */
+void qos_note_input(session_t *session);
+
+/**
+ * @brief Tells whether a session has been idle long enough to be paused.
+ *
+ * Sessions with spectators attached are never paused.
+ * @param session Session to check, at a tick boundary.
+ * @return 1 to pause it until the player's next move.
+ */
+int qos_should_pause(session_t *session);
+
+/**
+ * @brief Accounts a pause that ended.
+ * @param paused_ns How long the session stayed paused.
+ */
+void qos_note_resumed(long long paused_ns);
+
+/**
+ * @brief Blocks the host thread while admission is paused.
+ */
+void qos_wait_admission(void);
+
+/**
+ * @brief Writes the current level, transitions and skipped frames.
+ * @param f Open stream to write to.
+ */
+void qos_dump_stats(FILE *f);
+
+#endif
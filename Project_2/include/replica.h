@@ -0,0 +1,110 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "board.h"
+#include "migrate.h"
+#include "session.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Warm standby replica.
+ *
+ * A primary started with PACMANIST_REPLICA_SOCKET streams every session to
+ * the standby connected there: a keyframe (board_save()) when a level
+ * starts, then each move in the order the board's lock applied it, with the
+ * board hash after it. The game threads only append the move to the
+ * session's ring under the lock they already hold; a sender thread ships
+ * the rings every PACMANIST_REPLICA_FLUSH_MS.
+ *
+ * A standby is a PacmanIST started with PACMANIST_REPLICA_OF pointing at
+ * that socket. Before doing anything else it replays the moves on its own
+ * copies of the boards, checking each hash; a copy that diverges asks the
+ * primary for a new keyframe. When the stream ends and the primary process
+ * is gone, the standby starts as a normal server on the same registration
+ * FIFO, and clients that negotiated FEAT_RESUME reconnect with OP_RESUME and
+ * their token to continue the level where the primary left it. Moves made in
+ * the last flush period before the crash are lost.
+ *
+ * PACMANIST_REPLICA_SOCKET    UNIX socket the primary streams sessions on.
+ * PACMANIST_REPLICA_FLUSH_MS  Stream flush period (default 10).
+ * PACMANIST_REPLICA_OF        Socket of the primary to stand by for.
+ */
+
+/**
+ * @return 1 if PACMANIST_REPLICA_OF makes this process a standby.
+ */
+int replica_standby(void);
+
+/**
+ * @brief Follows the primary until it dies (standby only).
+ *
+ * Connects to the primary, retrying until it is up, and keeps a replayed
+ * copy of each of its sessions. A stream that ends while the primary still
+ * runs is reconnected.
+ * @return 0 once the primary is gone and this process should take over.
+ */
+int replica_follow(void);
+
+/**
+ * @brief Opens the replication socket and starts the sender thread, if
+ * PACMANIST_REPLICA_SOCKET is set.
+ * @return 0 on success, -1 if the socket cannot be opened.
+ */
+int replica_start(void);
+
+/**
+ * @brief Unlinks the replication socket.
+ */
+void replica_stop(void);
+
+/**
+ * @return 1 if sessions are streamed to a standby (FEAT_RESUME is offered).
+ */
+int replica_streaming(void);
+
+/**
+ * @brief Gives a session its resume token and a stream slot (worker).
+ *
+ * Allocates the session's ring, so call it before the game threads start.
+ * @param session Session starting; sets resume_token and replica_slot.
+ * @param token Token of a resumed or migrated session, 0 for a new one.
+ */
+void replica_register(session_t *session, uint64_t token);
+
+/**
+ * @brief Removes a session from the stream; the standby drops its copy.
+ */
+void replica_unregister(session_t *session);
+
+/**
+ * @brief Streams a level about to be played (worker, before its threads).
+ *
+ * Hooks the board's moves into the session's ring and queues a keyframe.
+ * @param session Session playing it.
+ * @param board Level, kept until replica_level_end().
+ * @param state Session state the standby resumes with.
+ */
+void replica_level_start(session_t *session, board_t *board,
+                         const migrate_state_t *state);
+
+/**
+ * @brief Stops reading a level's board (worker, before unloading it).
+ */
+void replica_level_end(session_t *session);
+
+/**
+ * @brief Takes the replayed copy of a session for a client resuming it.
+ * @param token Token the client presented.
+ * @return Session to run, with both fds -1 (the worker opens the client's
+ * pipes), or NULL if no consistent copy has this token.
+ */
+migrate_session_t *replica_claim(uint64_t token);
+
+/**
+ * @brief Writes what was streamed or replayed and the takeover.
+ * @param f Open stream to write to.
+ */
+void replica_dump_stats(FILE *f);
+
+#endif
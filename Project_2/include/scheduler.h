@@ -0,0 +1,84 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include <time.h>
+
+/** @brief Maximum number of CPUs tracked by the smoothness metric */
+#define SCHED_MAX_CORES 64
+/** @brief Number of log2 (microsecond) buckets in the lateness histogram */
+#define SCHED_LATE_BUCKETS 24
+
+/**
+ * @brief Initializes the tick scheduler.
+ * @param max_sessions Maximum number of concurrently registered sessions.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int sched_init(int max_sessions);
+
+/**
+ * @brief Registers a session and rebalances the phases of all sessions.
+ * @param period_ms Tick period (the level's tempo) in milliseconds.
+ * @return Slot index, or -1 if the table is full.
+ */
+int sched_register(int period_ms);
+
+/**
+ * @brief Changes the tick period of a slot (e.g. on a new level).
+ * @param slot Slot returned by sched_register().
+ * @param period_ms New tick period in milliseconds.
+ */
+void sched_set_period(int slot, int period_ms);
+
+/**
+ * @brief Releases a slot and rebalances the phases of the remaining ones.
+ * @param slot Slot returned by sched_register().
+ */
+void sched_unregister(int slot);
+
+/**
+ * @brief Initializes a thread's deadline to the slot's next tick boundary.
+ * @param slot Slot of the session owning the thread (-1 for none).
+ * @param deadline Per-thread deadline to initialize.
+ */
+void sched_tick_start(int slot, struct timespec *deadline);
+
+/**
+ * @brief Sleeps until the phase-aligned boundary 'ticks' periods ahead.
+ *
+ * Boundaries live on the grid epoch + phase + k * period, so a phase change
+ * from a rebalance is picked up on the next wait. Without a slot this falls
+ * back to sleep_ms(period).
+ *
+ * @param slot Slot of the session owning the thread (-1 for none).
+ * @param deadline Per-thread deadline, advanced to the boundary waited for.
+ * @param period_ms Fallback period used when slot is -1.
+ * @param ticks Number of periods to wait (at least 1).
+ * @return Lateness of the wakeup in nanoseconds.
+ */
+long sched_wait_ticks(int slot, struct timespec *deadline, int period_ms,
+                      int ticks);
+
+/**
+ * @brief Copies the cumulative tick lateness histogram.
+ * @param hist Destination with SCHED_LATE_BUCKETS entries; bucket b counts
+ * wakeups that were late by less than 2^b microseconds.
+ */
+void sched_lateness_snapshot(unsigned long long hist[SCHED_LATE_BUCKETS]);
+
+/**
+ * @brief Returns the given percentile of a lateness histogram.
+ * @param hist Histogram filled by sched_lateness_snapshot().
+ * @param pct Percentile in [0, 100].
+ * @return Upper bound of the bucket holding the percentile, in microseconds.
+ */
+long sched_lateness_percentile(const unsigned long long hist[SCHED_LATE_BUCKETS],
+                               double pct);
+
+/**
+ * @brief Writes phases, lateness and per-core smoothness to a stats file.
+ * @param f Open stream to write to.
+ */
+void sched_dump_stats(FILE *f);
+
+#endif
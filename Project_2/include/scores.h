@@ -0,0 +1,144 @@
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Persistent score store.
+ *
+ * <data_dir>/scores.log is the source of truth: one score_record_t per
+ * finished session, appended and fdatasync'ed in batches by a committer
+ * thread. <data_dir>/scores.idx is a fixed-size file mapped by the server
+ * holding the all-time top scores, every player's best score and the next
+ * client id. It records how much of the log it covers, so startup only
+ * replays the records appended after it; an index that is missing or was
+ * torn by a crash is rebuilt from the whole log.
+ *
+ * Readers (SIGUSR1, bin/score_query) copy the index under a sequence lock
+ * and retry if the committer changed it meanwhile; nobody waits on them.
+ */
+
+/** @brief Longest player name kept, including the terminator */
+#define SCORES_NAME_SIZE 24
+/** @brief All-time top scores kept in the index */
+#define SCORES_TOP_K 100
+/** @brief Player slots of the index hash table (power of two) */
+#define SCORES_PLAYER_SLOTS 8192
+
+/** @brief "PSCR" */
+#define SCORES_RECORD_MAGIC 0x52435350u
+/** @brief "PSIX" */
+#define SCORES_INDEX_MAGIC 0x58495350u
+/** @brief Index layout version */
+#define SCORES_INDEX_VERSION 1
+
+/**
+ * @brief One finished session, as appended to scores.log (64 bytes).
+ */
+typedef struct {
+  uint32_t magic;     /**< SCORES_RECORD_MAGIC */
+  uint32_t checksum;  /**< FNV-1a of the record from seq on */
+  uint64_t seq;       /**< Position in the log, from 1 */
+  int64_t ended;      /**< Unix time the session ended */
+  int32_t client_id;  /**< Client id of the session */
+  int32_t points;     /**< Final score */
+  int32_t levels;     /**< Levels completed */
+  int32_t reserved;
+  char player[SCORES_NAME_SIZE]; /**< Player name */
+} score_record_t;
+
+/**
+ * @brief Best score of one player.
+ */
+typedef struct {
+  char player[SCORES_NAME_SIZE]; /**< Empty for a free slot */
+  int32_t best;                  /**< Best score */
+  uint32_t sessions;             /**< Sessions finished */
+  int64_t best_time;             /**< Unix time of the best score */
+} score_player_t;
+
+/**
+ * @brief Layout of scores.idx.
+ */
+typedef struct {
+  uint32_t magic;          /**< SCORES_INDEX_MAGIC */
+  uint32_t version;        /**< SCORES_INDEX_VERSION */
+  uint64_t seqlock;        /**< Odd while the committer updates the index */
+  uint64_t checksum;       /**< FNV-1a from log_offset on, seqlock even */
+  uint64_t next_client_id; /**< Next client id to hand out (atomic) */
+  uint64_t log_offset;     /**< Bytes of scores.log applied */
+  uint64_t records;        /**< Records applied */
+  uint32_t top_count;      /**< Valid entries of top */
+  uint32_t players;        /**< Used player slots */
+  score_record_t top[SCORES_TOP_K];             /**< Sorted, best first */
+  score_player_t slots[SCORES_PLAYER_SLOTS];    /**< Open addressing */
+} scores_index_t;
+
+/**
+ * @brief Copies a consistent snapshot of an index being updated.
+ * @param index Mapped index (possibly written concurrently).
+ * @param out Destination.
+ * @return 0 on success, -1 if no stable copy could be taken.
+ */
+static inline int scores_index_snapshot(const scores_index_t *index,
+                                        scores_index_t *out) {
+  for (int attempt = 0; attempt < 1000; attempt++) {
+    uint64_t before = __atomic_load_n(&index->seqlock, __ATOMIC_ACQUIRE);
+    if (before & 1)
+      continue;
+    __builtin_memcpy(out, index, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&index->seqlock, __ATOMIC_RELAXED) == before)
+      return 0;
+  }
+  return -1;
+}
+
+/**
+ * @brief Opens the store, recovering the index, and starts the committer.
+ *
+ * PACMANIST_DATA_DIR  Directory of scores.log and scores.idx (default
+ *                     "data").
+ *
+ * @return 0 on success, -1 if the files cannot be opened.
+ */
+int scores_start(void);
+
+/**
+ * @brief Hands out a client id never used before, across restarts.
+ */
+int scores_next_client_id(void);
+
+/**
+ * @brief Queues a finished session for the committer. Never waits on I/O.
+ * @param player Player name (truncated to SCORES_NAME_SIZE - 1).
+ * @param client_id Client id of the session.
+ * @param points Final score.
+ * @param levels Levels completed.
+ */
+void scores_record(const char *player, int client_id, int points, int levels);
+
+/**
+ * @brief Copies the current index (top scores and player bests).
+ * @param out Destination.
+ * @return 0 on success, -1 if the store is not open.
+ */
+int scores_snapshot(scores_index_t *out);
+
+/**
+ * @brief Copies only the best scores, without the player table.
+ * @param out Destination of up to n records, best first.
+ * @param n Records wanted.
+ * @param records Set to the number of sessions recorded so far.
+ * @return int Records copied, or -1 if the store is not open.
+ */
+int scores_top(score_record_t *out, int n, uint64_t *records);
+
+/**
+ * @brief Writes store size, commit batches and recovery figures.
+ * @param f Open stream to write to.
+ */
+void scores_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * @brief Resources consumed by a session, charged by all of its threads.
+ */
+typedef struct {
+  atomic_ullong cpu_ns;          /**< CPU time of the worker and game threads */
+  atomic_ullong bytes_written;   /**< Bytes written to the notification pipe */
+  atomic_ulong frames_written;   /**< OP_UPDATE frames written */
+  atomic_ulong moves_received;   /**< OP_MOVE requests received */
+  atomic_ulong allocs;           /**< Heap allocations made for the session */
+  atomic_ullong bytes_allocated; /**< Bytes of those allocations */
+  atomic_ullong lock_wait_ns;    /**< Time blocked on board state locks */
+  atomic_ulong ticks;            /**< Frames ticked by the update thread */
+} session_cost_t;
+
+/**
+ * @brief Request-path state of a session (flood protection).
+ *
+ * Persists across levels, so a message split over a level change is still
+ * reassembled and the rate limit cannot be reset by finishing a level.
+ */
+typedef struct {
+  double tokens;             /**< Token bucket: moves that may still pass */
+  long long refill_ns;       /**< Time of the last token refill */
+  long long last_warn_ns;    /**< Time of the last warning printed */
+  unsigned char partial[2];  /**< Bytes of a message split across reads */
+  int partial_len;           /**< Number of valid bytes in partial */
+  atomic_ulong rate_limited; /**< Moves dropped by the token bucket */
+  atomic_ulong coalesced;    /**< Moves superseded within one wakeup */
+  atomic_ulong unknown_ops;  /**< Bytes skipped as unknown opcodes */
+  atomic_ulong warnings_suppressed; /**< Warnings not printed */
+} session_input_t;
+
+/**
+ * @brief Server-side context of one connected client.
+ *
+ * Owned by the worker running the session and handed to the game threads of
+ * every level it plays.
+ */
+typedef struct {
+  int client_id;  /**< Scoreboard id of the connected client */
+  int sched_slot; /**< Tick scheduler slot (-1 if not registered) */
+  int core;       /**< CPU owning the session's threads (-1 if unpinned) */
+  atomic_uint core_epoch; /**< Bumped when core changes mid-level */
+  atomic_int migrate_request; /**< Set to stop at a tick and move shards */
+  int wake_fd; /**< eventfd waking the input listener at level end (-1) */
+  long long started_ns; /**< Monotonic time the session started here */
+  unsigned int features; /**< FEAT_* bits agreed in the handshake */
+  int max_fps;           /**< Negotiated frame rate cap (0 for none) */
+  int level_id;          /**< Archive id of the level being played */
+  int leaderboard_slot;  /**< Live leaderboard slot (-1 if not listed) */
+  unsigned int leaderboard_seen; /**< Leaderboard version sent to the client */
+  unsigned long ticks; /**< Frames ticked by the update thread */
+  session_cost_t cost; /**< Resource accounting */
+  atomic_llong last_input_ns; /**< Monotonic time of the last OP_MOVE */
+  atomic_int spectators; /**< Spectator streams attached (no idle pause) */
+  uint64_t resume_token; /**< Token the client resumes with (0 for none) */
+  int replica_slot;      /**< Slot in the replication stream (-1 if none) */
+  session_input_t input; /**< Flood protection state */
+} session_t;
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include "protocol.h"
+#include "session.h"
+#include <stdio.h>
+
+/**
+ * Spectator connections.
+ *
+ * A dashboard attaches one notification pipe to many sessions with
+ * OP_SPECTATE. The update thread of every followed session publishes its
+ * frames there, tagged with the session's slot on that connection, but only
+ * when the frame differs from the last one it published. The pipe is non
+ * blocking: a dashboard that falls behind loses frames instead of slowing
+ * the game, and frames stay under PIPE_BUF so sessions publishing at the
+ * same time never interleave.
+ */
+
+/** @brief Spectator connections served at once */
+#define SPECTATORS_MAX 8
+
+/**
+ * @brief Opens a spectator connection and answers it (host thread).
+ * @param req Request read from the registration FIFO.
+ * @return 0 if attached, -1 if the pipe could not be opened or every
+ * spectator slot is taken.
+ */
+int spectate_attach(const spectate_req_t *req);
+
+/**
+ * @brief Makes a session available to spectators.
+ *
+ * Spectators waiting for its client id, or following any session with a
+ * free slot, start following it.
+ */
+void spectate_register(session_t *session);
+
+/**
+ * @brief Removes an ending session; its spectators get OP_SPECTATE_END.
+ */
+void spectate_unregister(session_t *session);
+
+/**
+ * @brief Sends a frame to the spectators following a session.
+ *
+ * Called by the session's update thread when session->spectators > 0.
+ * @param session Session the frame belongs to.
+ * @param frame Frame of the session's board.
+ */
+void spectate_publish(session_t *session, const game_state_msg_t *frame);
+
+/**
+ * @brief Writes spectator connections and frames sent, skipped and dropped.
+ * @param f Open stream to write to.
+ */
+void spectate_dump_stats(FILE *f);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SPECULATE_H
+#define SPECULATE_H
+
+#include "board.h"
+#include "protocol.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+/**
+ * Speculative frames.
+ *
+ * Pacman's next step depends only on the key applied to it: W, A, S, D or
+ * none (its script command, or standing still). With PACMANIST_SPECULATE=1
+ * the pacman thread, once it has moved, copies the board into a scratch
+ * board, serializes it and plays each of the five moves on the copy,
+ * keeping Pacman's state after it and the cells it redraws. At the next
+ * step the frame of the move actually made is that snapshot plus the move's
+ * cells plus the cells ghosts left or entered since, and the pacman thread
+ * writes it at once instead of leaving it to the update thread's next tick.
+ * When the real move ends differently (a ghost got in the way, a random
+ * command drew another direction) the frame is serialized in full.
+ *
+ * Frames are full snapshots in the protocol, so the "delta" of a move is
+ * the two cells it can change; patching them costs a copy, not a scan.
+ */
+
+/** @brief Moves prepared per step: W, A, S, D and the default move */
+#define SPEC_MOVES 5
+
+/** @brief Index of the default move (no key: script command or none) */
+#define SPEC_DEFAULT_MOVE 4
+
+/**
+ * @brief Predicted result of one move.
+ */
+typedef struct {
+  pacman_t pacman;    /**< Pacman after the move */
+  int level_finished; /**< The move reaches the portal */
+  int n_cells;        /**< Cells the move redraws (1 or 2) */
+  int cells[2];       /**< Their indexes */
+  char visuals[2];    /**< Their characters in the frame */
+} spec_outcome_t;
+
+/**
+ * @brief Speculation state of a level in play, owned by its pacman thread.
+ */
+typedef struct {
+  board_t snapshot;        /**< Scratch copy of the board */
+  game_state_msg_t frame;  /**< Frame of the snapshot */
+  int ghost_cells[MAX_GHOSTS]; /**< Ghost cells in the snapshot */
+  spec_outcome_t outcomes[SPEC_MOVES];
+  int ready;               /**< Outcomes are for the board's current state */
+  atomic_ulong frame_tick; /**< Last tick whose frame a thread took */
+} speculation_t;
+
+/**
+ * @brief Reads PACMANIST_SPECULATE (1 enables speculative frames).
+ */
+void speculate_init(void);
+
+/**
+ * @return 1 if levels should prepare speculative frames.
+ */
+int speculate_enabled(void);
+
+/**
+ * @brief Allocates the scratch board of a level, before its threads start.
+ * @param spec State to initialize.
+ * @param board Level about to be played.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int speculate_alloc(speculation_t *spec, const board_t *board);
+
+/**
+ * @brief Frees what speculate_alloc() allocated.
+ */
+void speculate_release(speculation_t *spec);
+
+/**
+ * @brief Maps the key applied to Pacman to the outcome that predicts it.
+ * @param key Buffered client key, ' ' if none.
+ * @return Outcome index, -1 for a key no outcome covers.
+ */
+int speculate_move_index(char key);
+
+/**
+ * @brief Prepares the outcomes of Pacman's next move.
+ *
+ * Called by the pacman thread between its moves; takes the board's lock for
+ * reading only to copy it. Does not allocate.
+ * @param spec Level's speculation state.
+ * @param board Level in play.
+ */
+void speculate_prepare(speculation_t *spec, board_t *board);
+
+/**
+ * @brief Builds the frame of the move just made.
+ *
+ * Patches the prepared outcome of the move if it matches the board,
+ * serializes the board otherwise. Call with the board's lock held, right
+ * after move_pacman().
+ * @param spec Level's speculation state.
+ * @param board Level in play.
+ * @param move Outcome index of the move (speculate_move_index()).
+ * @param msg Frame to fill.
+ * @return 1 if the frame came from the prediction, 0 if it was serialized.
+ */
+int speculate_commit(speculation_t *spec, const board_t *board, int move,
+                     game_state_msg_t *msg);
+
+/**
+ * @brief Writes prediction hits, misses and their cost.
+ * @param f Open stream to write to.
+ */
+void speculate_dump_stats(FILE *f);
+
+#endif
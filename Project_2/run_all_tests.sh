@@ -23,7 +23,7 @@ fail() {
 cleanup() {
     killall PacmanIST 2>/dev/null
     killall client 2>/dev/null
-    rm -f /tmp/test_* /tmp/pacman_* score_log.txt
+    rm -f /tmp/test_* /tmp/pacman_* score_log.txt stats_log.txt
 }
 
 # Clean start
@@ -198,6 +198,191 @@ else
     fail "Client crashed on invalid FIFO"
 fi
 
+# ===========================================
+echo ""
+echo "=== TEST 9: Legacy Connect Handshake ==="
+bin/PacmanIST levels 1 /tmp/test_server9 &
+SERVER_PID=$!
+sleep 1
+
+# Old clients send the fixed 81-byte OP_CONNECT and expect a 2-byte reply
+REQ=/tmp/test_legacy_req
+NOTIF=/tmp/test_legacy_notif
+mkfifo $REQ $NOTIF
+# Held open read-write: the worker opens it again after the reply is sent
+exec 4<>$NOTIF
+{
+    printf '\x01'
+    printf '%s' "$REQ"; head -c $((40 - ${#REQ})) /dev/zero
+    printf '%s' "$NOTIF"; head -c $((40 - ${#NOTIF})) /dev/zero
+} > /tmp/test_server9
+RESP=$(timeout 2 head -c 2 <&4 | od -An -tx1 | tr -d ' \n')
+timeout 2 bash -c "exec 3>$REQ; printf '\\x02' >&3"
+exec 4<&-
+
+if [ "$RESP" = "0100" ]; then
+    pass "Legacy handshake answered with OP_CONNECT success"
+else
+    fail "Legacy handshake got '$RESP'"
+fi
+kill $SERVER_PID 2>/dev/null
+sleep 1
+
+# ===========================================
+echo ""
+echo "=== TEST 10: Allocation-Free Ticks ==="
+# Three corridor levels played by a scripted client; the ghost is walled in
+LEVELS=/tmp/test_alloc_levels
+REPORT=/tmp/test_alloc_report
+rm -rf $LEVELS $REPORT
+mkdir -p $LEVELS
+printf 'PASSO 0\n' > $LEVELS/pac.p
+printf 'PASSO 0\nW\nS\n' > $LEVELS/mon.m
+for i in 1 2 3; do
+    printf 'DIM 5 24\nTEMPO 50\nPAC pac.p\nMON mon.m\n' > $LEVELS/level0$i.lvl
+    printf 'XXXXXXXXXXXXXXXXXXXXXXXX\nXP...................@XX\n' >> $LEVELS/level0$i.lvl
+    printf 'XXXXXXXXXXXXXXXXXXXXXXXX\nXMXXXXXXXXXXXXXXXXXXXXXX\n' >> $LEVELS/level0$i.lvl
+    printf 'XXXXXXXXXXXXXXXXXXXXXXXX\n' >> $LEVELS/level0$i.lvl
+done
+yes d | head -120 > /tmp/test_alloc_moves.txt
+
+# Watch from 1.5 s after start, past the first frames, to the last level;
+# only the tick threads of the server, every thread of the client
+export ALLOC_GUARD_REPORT=$REPORT ALLOC_GUARD_ARM_MS=1500 ALLOC_GUARD_DISARM_MS=7500
+ALLOC_GUARD_THREADS=tick- LD_PRELOAD=bin/liballoc_guard.so \
+    bin/PacmanIST $LEVELS 1 /tmp/test_server10 > /dev/null 2>&1 &
+SERVER_PID=$!
+sleep 0.5
+LD_PRELOAD=bin/liballoc_guard.so bin/client test10 /tmp/test_server10 \
+    /tmp/test_alloc_moves.txt > /dev/null 2>&1 &
+CLIENT_PID=$!
+sleep 9
+unset ALLOC_GUARD_REPORT ALLOC_GUARD_ARM_MS ALLOC_GUARD_DISARM_MS
+
+LOADED=$(grep -c "loaded$" $REPORT 2>/dev/null)
+ALLOCS=$(grep -c " thread " $REPORT 2>/dev/null)
+if [ "$LOADED" = "2" ] && [ "$ALLOCS" = "0" ]; then
+    pass "No heap allocation during ticks over three levels"
+else
+    fail "Allocations during ticks ($ALLOCS, guard loaded in $LOADED processes)"
+    # Resolve bin/<program>(+offset) frames to functions
+    while read -r line; do
+        if [[ $line =~ ^(bin/[a-zA-Z]+)\(\+(0x[0-9a-f]+)\) ]]; then
+            echo "    $(addr2line -f -s -e ${BASH_REMATCH[1]} ${BASH_REMATCH[2]} | paste -sd' ')"
+        else
+            echo "    $line"
+        fi
+    done < $REPORT
+fi
+kill $CLIENT_PID $SERVER_PID 2>/dev/null
+rm -rf $LEVELS $REPORT /tmp/test_alloc_moves.txt
+sleep 1
+
+# ===========================================
+echo ""
+echo "=== TEST 11: Striped Board Locks ==="
+# Ghosts and Pacman hammer one board from their own threads in both lock
+# modes while a checker looks for lost or duplicated entities
+if bin/move_bench -c -s 0.5 4 24 > /tmp/test_move_bench.txt 2>&1; then
+    pass "No lost or duplicated entities under concurrent moves"
+else
+    fail "Concurrent moves broke the board"
+    cat /tmp/test_move_bench.txt
+fi
+
+# ===========================================
+echo ""
+echo "=== TEST 12: Live Shard Migration ==="
+# Shard A offloads every session to shard B; B must only start it once A
+# has let it go, and the client must finish its game on B
+export PACMANIST_ARCHIVE_DIR=0 PACMANIST_EVENTS_SHM=0 PACMANIST_HISTORY_DAYS=0
+PACMANIST_SHARD_SOCKET=/tmp/test_shard12.sock \
+    PACMANIST_DATA_DIR=/tmp/test_shard12_b bin/PacmanIST levels 2 /tmp/test_server12b > /dev/null 2>&1 &
+SHARD_B=$!
+PACMANIST_SHARD_PEER=/tmp/test_shard12.sock PACMANIST_SHARD_OFFLOAD=0 PACMANIST_REBALANCE_MS=200 \
+    PACMANIST_DATA_DIR=/tmp/test_shard12_a bin/PacmanIST levels 2 /tmp/test_server12a > /dev/null 2>&1 &
+SHARD_A=$!
+unset PACMANIST_ARCHIVE_DIR PACMANIST_EVENTS_SHM PACMANIST_HISTORY_DAYS
+sleep 1
+for i in $(seq 20); do printf 'w\nw\na\na\ns\ns\nd\nd\n'; done > /tmp/test_shard_moves.txt
+timeout 30 bin/client test12 /tmp/test_server12a /tmp/test_shard_moves.txt > /dev/null 2>&1
+CLIENT_STATUS=$?
+
+kill -USR1 $SHARD_A; sleep 0.5
+SENT=$(grep -o "Sent to peer shard: [0-9]*" stats_log.txt 2>/dev/null)
+RECORDED_A=$(grep -o "[0-9]* sessions recorded" stats_log.txt 2>/dev/null)
+kill -USR1 $SHARD_B; sleep 0.5
+RECEIVED=$(grep -o "Received from peers: [0-9]*" stats_log.txt 2>/dev/null)
+RECORDED_B=$(grep -o "[0-9]* sessions recorded" stats_log.txt 2>/dev/null)
+if [ $CLIENT_STATUS -eq 0 ] && [ "$SENT" = "Sent to peer shard: 1" ] && \
+   [ "$RECEIVED" = "Received from peers: 1" ] && \
+   [ "$RECORDED_A" = "0 sessions recorded" ] && [ "$RECORDED_B" = "1 sessions recorded" ]; then
+    pass "Session moved to the peer shard mid-game and ended there once"
+else
+    fail "Live migration (client $CLIENT_STATUS, A: $SENT, $RECORDED_A; B: $RECEIVED, $RECORDED_B)"
+fi
+kill $SHARD_A $SHARD_B 2>/dev/null
+rm -rf /tmp/test_shard12_a /tmp/test_shard12_b /tmp/test_shard_moves.txt stats_log.txt
+sleep 1
+
+# ===========================================
+echo ""
+echo "=== TEST 13: Standby Failover ==="
+# The primary dies while the player stands still; the client must resume
+# on the standby with its token, on the board it had, and finish the level
+LEVELS=/tmp/test_replica_levels
+mkdir -p $LEVELS
+printf 'PASSO 0\n' > $LEVELS/pac.p
+printf 'PASSO 0\nW\nS\n' > $LEVELS/mon.m
+printf 'DIM 5 24\nTEMPO 50\nPAC pac.p\nMON mon.m\n' > $LEVELS/level01.lvl
+printf 'XXXXXXXXXXXXXXXXXXXXXXXX\nXP...................@XX\n' >> $LEVELS/level01.lvl
+printf 'XXXXXXXXXXXXXXXXXXXXXXXX\nXMXXXXXXXXXXXXXXXXXXXXXX\n' >> $LEVELS/level01.lvl
+printf 'XXXXXXXXXXXXXXXXXXXXXXXX\n' >> $LEVELS/level01.lvl
+# Five steps, 2 s standing still, then on to the portal
+{ yes d | head -5; yes x | head -20; yes d | head -30; } > /tmp/test_replica_moves.txt
+export PACMANIST_ARCHIVE_DIR=0 PACMANIST_EVENTS_SHM=0 PACMANIST_HISTORY_DAYS=0
+PACMANIST_REPLICA_SOCKET=/tmp/test_replica13.sock PACMANIST_DATA_DIR=/tmp/test_replica13_a \
+    bin/PacmanIST $LEVELS 2 /tmp/test_server13 > /dev/null 2>&1 &
+PRIMARY=$!
+sleep 0.5
+PACMANIST_REPLICA_OF=/tmp/test_replica13.sock PACMANIST_DATA_DIR=/tmp/test_replica13_b \
+    bin/PacmanIST $LEVELS 2 /tmp/test_server13 > /dev/null 2>&1 &
+STANDBY=$!
+unset PACMANIST_ARCHIVE_DIR PACMANIST_EVENTS_SHM PACMANIST_HISTORY_DAYS
+sleep 0.5
+PACMANIST_STATE_HASH_LOG=/tmp/test_replica_hashes.txt timeout 30 bin/client test13 \
+    /tmp/test_server13 /tmp/test_replica_moves.txt > /dev/null 2>&1 &
+CLIENT_PID=$!
+# A following standby answers SIGUSR1 with its replication stats
+sleep 1
+kill -USR1 $STANDBY; sleep 0.3
+FOLLOWING=$(grep -c "^Standby: " stats_log.txt 2>/dev/null)
+sleep 0.2
+kill -9 $PRIMARY
+wait $CLIENT_PID
+CLIENT_STATUS=$?
+
+kill -USR1 $STANDBY; sleep 0.5
+TAKEOVER=$(grep -o "Took over with [0-9]* sessions, [0-9]* resumed" stats_log.txt 2>/dev/null)
+DIVERGED=$(grep -o "[0-9]* divergences" stats_log.txt 2>/dev/null)
+RECORDED=$(grep -o "[0-9]* sessions recorded" stats_log.txt 2>/dev/null)
+# The standby's ticks start over: its first frame must show a board state
+# (points, positions, hash) the primary had already sent
+RESUMED_ON=$(awk '$1 < last { print (seen[$2] ? "same" : "other"); exit }
+                  { seen[$2] = 1; last = $1 }' /tmp/test_replica_hashes.txt 2>/dev/null)
+if [ $CLIENT_STATUS -eq 0 ] && [ "$FOLLOWING" = "1" ] && \
+   [ "$TAKEOVER" = "Took over with 1 sessions, 1 resumed" ] && \
+   [ "$DIVERGED" = "0 divergences" ] && [ "$RESUMED_ON" = "same" ] && \
+   [ "$RECORDED" = "1 sessions recorded" ]; then
+    pass "Client resumed on the standby where the primary left it"
+else
+    fail "Failover (client $CLIENT_STATUS, stats while following: ${FOLLOWING:-0}, $TAKEOVER, $DIVERGED, resumed on ${RESUMED_ON:-none}, $RECORDED)"
+fi
+kill $STANDBY 2>/dev/null
+rm -rf $LEVELS /tmp/test_replica13_a /tmp/test_replica13_b /tmp/test_replica_moves.txt \
+    /tmp/test_replica_hashes.txt stats_log.txt
+sleep 1
+
 # ===========================================
 echo ""
 echo "=============================================="
@@ -0,0 +1,50 @@
+/**
+ * @file archive_format.c
+ * @brief Column codec of the event archive.
+ *
+ * Consecutive values of a column are close to each other (times grow,
+ * events of a session cluster, cells are near the previous one), so the
+ * deltas are small; zigzag maps them to small unsigned numbers and LEB128
+ * stores those in one or two bytes.
+ */
+
+#include "../include/archive_format.h"
+
+size_t archive_encode_column(const int32_t *values, uint32_t rows,
+                             uint8_t *out) {
+  size_t n = 0;
+  int32_t prev = 0;
+  for (uint32_t i = 0; i < rows; i++) {
+    uint32_t delta = (uint32_t)values[i] - (uint32_t)prev;
+    uint32_t zz = (delta << 1) ^ (uint32_t)-(int32_t)(delta >> 31);
+    prev = values[i];
+    while (zz >= 0x80) {
+      out[n++] = (uint8_t)(zz | 0x80);
+      zz >>= 7;
+    }
+    out[n++] = (uint8_t)zz;
+  }
+  return n;
+}
+
+int archive_decode_column(const uint8_t *in, size_t size, int32_t *values,
+                          uint32_t rows) {
+  size_t pos = 0;
+  uint32_t prev = 0;
+  for (uint32_t i = 0; i < rows; i++) {
+    uint32_t zz = 0;
+    int shift = 0;
+    while (1) {
+      if (pos >= size || shift > 28)
+        return -1;
+      uint8_t byte = in[pos++];
+      zz |= (uint32_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        break;
+      shift += 7;
+    }
+    prev += (zz >> 1) ^ (uint32_t)-(int32_t)(zz & 1);
+    values[i] = (int32_t)prev;
+  }
+  return pos == size ? 0 : -1;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "../include/board.h"
 #include <ctype.h>
 #include <errno.h>
@@ -11,6 +12,206 @@
 
 static int debug_fd = -1;
 
+/**
+ * @brief Reports a gameplay event to the board's hook, if any.
+ * @param board Board the event happened on (locked for writing).
+ * @param event Event kind.
+ * @param x Column of the cell.
+ * @param y Row of the cell.
+ * @param detail Event specific value.
+ */
+static inline void emit_event(board_t *board, board_event_t event, int x,
+                              int y, int detail) {
+  if (board->on_event != NULL)
+    board->on_event(board->event_ctx, event, x, y, board->pacmans[0].points,
+                    detail);
+}
+
+/**
+ * @brief Features hashed into board_t.hash.
+ *
+ * Keys are computed from (feature, a, b) instead of being read from tables,
+ * so boards of any size hash without per-cell storage.
+ */
+enum {
+  ZOBRIST_CONTENT = 1,   /**< a = cell, b = content character */
+  ZOBRIST_DOT,           /**< a = cell */
+  ZOBRIST_PORTAL,        /**< a = cell */
+  ZOBRIST_PACMAN,        /**< a = pacman, b = cell */
+  ZOBRIST_GHOST,         /**< a = ghost, b = cell */
+  ZOBRIST_PACMAN_CURSOR, /**< a = pacman, b = packed script cursor */
+  ZOBRIST_GHOST_CURSOR,  /**< a = ghost, b = packed script cursor */
+  ZOBRIST_DEAD,          /**< a = pacman */
+  ZOBRIST_CHARGED,       /**< a = ghost */
+};
+
+/**
+ * @brief SplitMix64 finalizer: a bijective 64-bit mix.
+ */
+static inline uint64_t zobrist_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Key of one feature value.
+ */
+static inline uint64_t zobrist_key(uint64_t feature, uint64_t a, uint64_t b) {
+  return zobrist_mix(zobrist_mix(0x9e3779b97f4a7c15ULL ^ (feature << 56) ^ a) ^
+                     b);
+}
+
+/**
+ * @brief Packs a script position: command index, passo countdown and the
+ * turns left of the current command (only the current one counts down).
+ */
+static inline uint64_t script_cursor(const command_t *moves, int n_moves,
+                                     int current_move, int waiting) {
+  uint64_t cursor = 0, turns = 0;
+  if (n_moves > 0) {
+    cursor = (uint64_t)(current_move % n_moves);
+    turns = (uint32_t)moves[cursor].turns_left;
+  }
+  return cursor | (uint64_t)(uint32_t)waiting << 20 | turns << 40;
+}
+
+static inline uint64_t pacman_cursor_key(const board_t *board, int p) {
+  const pacman_t *pac = &board->pacmans[p];
+  return zobrist_key(ZOBRIST_PACMAN_CURSOR, (uint64_t)p,
+                     script_cursor(pac->moves, pac->n_moves, pac->current_move,
+                                   pac->waiting));
+}
+
+static inline uint64_t ghost_cursor_key(const board_t *board, int g) {
+  const ghost_t *ghost = &board->ghosts[g];
+  return zobrist_key(ZOBRIST_GHOST_CURSOR, (uint64_t)g,
+                     script_cursor(ghost->moves, ghost->n_moves,
+                                   ghost->current_move, ghost->waiting));
+}
+
+/**
+ * @brief Flips a key in the board hash.
+ *
+ * Moves in BOARD_LOCK_STRIPED mode update it concurrently; XOR commutes, so
+ * the hash is the same whatever order they land in.
+ */
+static inline void xor_hash(board_t *board, uint64_t key) {
+  if (board->lock_mode == BOARD_LOCK_STRIPED)
+    __atomic_fetch_xor(&board->hash, key, __ATOMIC_RELAXED);
+  else
+    board->hash ^= key;
+}
+
+/**
+ * @brief Draws a random number from the board's rng_seed.
+ *
+ * In BOARD_LOCK_STRIPED mode the step is published with a compare-and-swap,
+ * so two entities never draw the same number.
+ */
+static int draw_random(board_t *board) {
+  if (board->lock_mode != BOARD_LOCK_STRIPED)
+    return rand_r(&board->rng_seed);
+  unsigned int seed = __atomic_load_n(&board->rng_seed, __ATOMIC_RELAXED);
+  unsigned int next;
+  int value;
+  do {
+    next = seed;
+    value = rand_r(&next);
+  } while (!__atomic_compare_exchange_n(&board->rng_seed, &seed, next, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return value;
+}
+
+/**
+ * @brief Changes a cell's content, updating the hash.
+ */
+static inline void set_content(board_t *board, int index, char content) {
+  board_pos_t *cell = &board->board[index];
+  xor_hash(board, zobrist_key(ZOBRIST_CONTENT, (uint64_t)index,
+                              (unsigned char)cell->content) ^
+                      zobrist_key(ZOBRIST_CONTENT, (uint64_t)index,
+                                  (unsigned char)content));
+  cell->content = content;
+}
+
+/**
+ * @brief Removes the dot of a cell, updating the hash.
+ */
+static inline void eat_dot(board_t *board, int index) {
+  xor_hash(board, zobrist_key(ZOBRIST_DOT, (uint64_t)index, 0));
+  board->board[index].has_dot = 0;
+}
+
+/**
+ * @brief Moves a pacman's coordinates, updating the hash.
+ */
+static inline void set_pacman_pos(board_t *board, int p, int x, int y) {
+  pacman_t *pac = &board->pacmans[p];
+  xor_hash(board,
+           zobrist_key(ZOBRIST_PACMAN, (uint64_t)p,
+                       (uint64_t)(pac->pos_y * board->width + pac->pos_x)) ^
+               zobrist_key(ZOBRIST_PACMAN, (uint64_t)p,
+                           (uint64_t)(y * board->width + x)));
+  pac->pos_x = x;
+  pac->pos_y = y;
+}
+
+/**
+ * @brief Moves a ghost's coordinates, updating the hash.
+ */
+static inline void set_ghost_pos(board_t *board, int g, int x, int y) {
+  ghost_t *ghost = &board->ghosts[g];
+  xor_hash(board,
+           zobrist_key(ZOBRIST_GHOST, (uint64_t)g,
+                       (uint64_t)(ghost->pos_y * board->width + ghost->pos_x)) ^
+               zobrist_key(ZOBRIST_GHOST, (uint64_t)g,
+                           (uint64_t)(y * board->width + x)));
+  ghost->pos_x = x;
+  ghost->pos_y = y;
+}
+
+/**
+ * @brief Charges or uncharges a ghost, updating the hash.
+ */
+static inline void set_charged(board_t *board, int g, int charged) {
+  ghost_t *ghost = &board->ghosts[g];
+  if ((ghost->charged != 0) != (charged != 0))
+    xor_hash(board, zobrist_key(ZOBRIST_CHARGED, (uint64_t)g, 0));
+  ghost->charged = charged;
+}
+
+uint64_t board_hash(const board_t *board) {
+  uint64_t hash = 0;
+  int cells = board->width * board->height;
+  for (int i = 0; i < cells; i++) {
+    const board_pos_t *cell = &board->board[i];
+    hash ^= zobrist_key(ZOBRIST_CONTENT, (uint64_t)i,
+                        (unsigned char)cell->content);
+    if (cell->has_dot)
+      hash ^= zobrist_key(ZOBRIST_DOT, (uint64_t)i, 0);
+    if (cell->has_portal)
+      hash ^= zobrist_key(ZOBRIST_PORTAL, (uint64_t)i, 0);
+  }
+  for (int p = 0; p < board->n_pacmans; p++) {
+    const pacman_t *pac = &board->pacmans[p];
+    hash ^= zobrist_key(ZOBRIST_PACMAN, (uint64_t)p,
+                        (uint64_t)(pac->pos_y * board->width + pac->pos_x));
+    hash ^= pacman_cursor_key(board, p);
+    if (!pac->alive)
+      hash ^= zobrist_key(ZOBRIST_DEAD, (uint64_t)p, 0);
+  }
+  for (int g = 0; g < board->n_ghosts; g++) {
+    const ghost_t *ghost = &board->ghosts[g];
+    hash ^= zobrist_key(ZOBRIST_GHOST, (uint64_t)g,
+                        (uint64_t)(ghost->pos_y * board->width + ghost->pos_x));
+    hash ^= ghost_cursor_key(board, g);
+    if (ghost->charged)
+      hash ^= zobrist_key(ZOBRIST_CHARGED, (uint64_t)g, 0);
+  }
+  return hash;
+}
+
 /**
  * @brief Helper private function to find and kill pacman at specific position.
  * @param board Pointer to the game board structure.
@@ -22,8 +223,9 @@ static int find_and_kill_pacman(board_t *board, int new_x, int new_y) {
   for (int p = 0; p < board->n_pacmans; p++) {
     pacman_t *pac = &board->pacmans[p];
     if (pac->pos_x == new_x && pac->pos_y == new_y && pac->alive) {
-      pac->alive = 0;
       kill_pacman(board, p);
+      emit_event(board, BOARD_EVENT_DEATH, new_x, new_y,
+                 DEATH_CAUGHT_BY_GHOST);
       return DEAD_PACMAN;
     }
   }
@@ -106,20 +308,129 @@ void sleep_ms(int milliseconds) {
 }
 
 /**
- * @brief Moves the Pacman based on the command.
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Acquires the state lock for writing, timing contended waits.
  * @param board Pointer to the game board structure.
- * @param pacman_index Index of the pacman to move.
- * @param command Pointer to the command structure.
- * @return Result of the move (VALID_MOVE, INVALID_MOVE, DEAD_PACMAN,
- * REACHED_PORTAL).
  */
-int move_pacman(board_t *board, int pacman_index, command_t *command) {
+void board_wrlock(board_t *board) {
+  if (pthread_rwlock_trywrlock(&board->state_lock) == 0)
+    return;
+  long long start = monotonic_ns();
   pthread_rwlock_wrlock(&board->state_lock);
-  if (pacman_index < 0 || !board->pacmans[pacman_index].alive) {
-    pthread_rwlock_unlock(&board->state_lock);
-    return DEAD_PACMAN; // Invalid or dead pacman
+  atomic_fetch_add(&board->lock_wait_ns, monotonic_ns() - start);
+}
+
+/**
+ * @brief Acquires the state lock shared, timing contended waits.
+ * @param board Pointer to the game board structure.
+ */
+static void shared_lock(board_t *board) {
+  if (pthread_rwlock_tryrdlock(&board->state_lock) == 0)
+    return;
+  long long start = monotonic_ns();
+  pthread_rwlock_rdlock(&board->state_lock);
+  atomic_fetch_add(&board->lock_wait_ns, monotonic_ns() - start);
+}
+
+/**
+ * @brief Acquires the state lock for reading, timing contended waits.
+ * @param board Pointer to the game board structure.
+ */
+void board_rdlock(board_t *board) {
+  // Striped moves share the lock: readers exclude them all
+  if (board->lock_mode == BOARD_LOCK_STRIPED)
+    board_wrlock(board);
+  else
+    shared_lock(board);
+}
+
+int board_use_striped_locks(board_t *board) {
+  if (board->lock_mode == BOARD_LOCK_STRIPED)
+    return 0;
+  int i = 0;
+  while (i < BOARD_LOCK_STRIPES &&
+         pthread_mutex_init(&board->row_locks[i], NULL) == 0)
+    i++;
+  // Moves hold the state lock shared all the time: readers must not starve
+  pthread_rwlockattr_t attr;
+  int failed = i < BOARD_LOCK_STRIPES || pthread_rwlockattr_init(&attr) != 0;
+  if (!failed) {
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    if (board->lock_initialized)
+      pthread_rwlock_destroy(&board->state_lock);
+    failed = pthread_rwlock_init(&board->state_lock, &attr) != 0;
+    board->lock_initialized = !failed;
+    pthread_rwlockattr_destroy(&attr);
+  }
+  if (failed) {
+    while (i-- > 0)
+      pthread_mutex_destroy(&board->row_locks[i]);
+    return -1;
+  }
+  board->lock_mode = BOARD_LOCK_STRIPED;
+  return 0;
+}
+
+/**
+ * @brief Locks what a move from row y may touch.
+ * @param board Pointer to the game board structure.
+ * @param y Row of the entity moving.
+ * @param any_row The move may reach any row (a charged ghost).
+ * @return Stripes held as a bit mask, 0 if the move holds the state lock for
+ * writing.
+ */
+static unsigned int lock_move(board_t *board, int y, int any_row) {
+  if (board->lock_mode != BOARD_LOCK_STRIPED || board->on_step != NULL) {
+    board_wrlock(board);
+    return 0;
   }
+  shared_lock(board);
+  int first = any_row ? 0 : y - 1;
+  int last = any_row ? board->height - 1 : y + 1;
+  unsigned int stripes = 0;
+  for (int row = first < 0 ? 0 : first; row <= last && row < board->height;
+       row++)
+    stripes |= 1u << (row % BOARD_LOCK_STRIPES);
+  // Always in stripe order, so two moves never wait on each other
+  for (int i = 0; i < BOARD_LOCK_STRIPES; i++) {
+    if (!(stripes & 1u << i) ||
+        pthread_mutex_trylock(&board->row_locks[i]) == 0)
+      continue;
+    long long start = monotonic_ns();
+    pthread_mutex_lock(&board->row_locks[i]);
+    atomic_fetch_add(&board->lock_wait_ns, monotonic_ns() - start);
+  }
+  return stripes;
+}
+
+/**
+ * @brief Releases what lock_move() took.
+ */
+static void unlock_move(board_t *board, unsigned int stripes) {
+  for (int i = 0; i < BOARD_LOCK_STRIPES; i++)
+    if (stripes & 1u << i)
+      pthread_mutex_unlock(&board->row_locks[i]);
+  pthread_rwlock_unlock(&board->state_lock);
+}
 
+/**
+ * @brief Moves a live Pacman; the caller holds the lock for writing and
+ * hashes the script cursor.
+ * @param board Pointer to the game board structure.
+ * @param pacman_index Index of the pacman to move.
+ * @param command Pointer to the command structure.
+ * @return Result of the move.
+ */
+static int pacman_step(board_t *board, int pacman_index, command_t *command) {
   pacman_t *pac = &board->pacmans[pacman_index];
   int new_x = pac->pos_x;
   int new_y = pac->pos_y;
@@ -127,7 +438,6 @@ int move_pacman(board_t *board, int pacman_index, command_t *command) {
   // check passo
   if (pac->waiting > 0) {
     pac->waiting -= 1;
-    pthread_rwlock_unlock(&board->state_lock);
     return VALID_MOVE;
   }
   pac->waiting = pac->passo;
@@ -136,7 +446,7 @@ int move_pacman(board_t *board, int pacman_index, command_t *command) {
 
   if (direction == 'R') {
     char directions[] = {'W', 'S', 'A', 'D'};
-    direction = directions[rand() % 4];
+    direction = directions[draw_random(board) % 4];
   }
 
   // Calculate new position based on direction
@@ -159,10 +469,8 @@ int move_pacman(board_t *board, int pacman_index, command_t *command) {
       command->turns_left = command->turns;
     } else
       command->turns_left -= 1;
-    pthread_rwlock_unlock(&board->state_lock);
     return VALID_MOVE;
   default:
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE; // Invalid direction
   }
 
@@ -171,7 +479,6 @@ int move_pacman(board_t *board, int pacman_index, command_t *command) {
 
   // Check boundaries
   if (!is_valid_position(board, new_x, new_y)) {
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE;
   }
 
@@ -180,45 +487,74 @@ int move_pacman(board_t *board, int pacman_index, command_t *command) {
   char target_content = board->board[new_index].content;
 
   if (board->board[new_index].has_portal) {
-    board->board[old_index].content = ' ';
-    board->board[new_index].content = 'C';
-    pac->pos_x = new_x;
-    pac->pos_y = new_y;
+    set_content(board, old_index, ' ');
+    set_content(board, new_index, 'C');
+    set_pacman_pos(board, pacman_index, new_x, new_y);
     board->level_finished = 1;
-    pthread_rwlock_unlock(&board->state_lock);
+    emit_event(board, BOARD_EVENT_PORTAL, new_x, new_y, 0);
     return REACHED_PORTAL;
   }
 
   // Check for walls
   if (target_content == 'W' || target_content == 'X') {
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE;
   }
 
   // Check for ghosts
   if (target_content == 'M') {
     kill_pacman(board, pacman_index);
-    pthread_rwlock_unlock(&board->state_lock);
+    emit_event(board, BOARD_EVENT_DEATH, new_x, new_y,
+               DEATH_WALKED_INTO_GHOST);
     return DEAD_PACMAN;
   }
 
   // Collect points
   if (board->board[new_index].has_dot) {
     pac->points += new_index;
-    board->board[new_index].has_dot = 0;
+    eat_dot(board, new_index);
+    emit_event(board, BOARD_EVENT_DOT, new_x, new_y, 0);
   }
   // ---> EXERCISE: COSTLY STEP <---
   // pac->points -= 1;
 
-  board->board[old_index].content = ' ';
-  pac->pos_x = new_x;
-  pac->pos_y = new_y;
-  board->board[new_index].content = 'C';
-
-  pthread_rwlock_unlock(&board->state_lock);
+  set_content(board, old_index, ' ');
+  set_pacman_pos(board, pacman_index, new_x, new_y);
+  set_content(board, new_index, 'C');
   return VALID_MOVE;
 }
 
+/**
+ * @brief Moves the Pacman based on the command.
+ * @param board Pointer to the game board structure.
+ * @param pacman_index Index of the pacman to move.
+ * @param command Pointer to the command structure.
+ * @return Result of the move (VALID_MOVE, INVALID_MOVE, DEAD_PACMAN,
+ * REACHED_PORTAL).
+ */
+int move_pacman(board_t *board, int pacman_index, command_t *command) {
+  if (pacman_index < 0)
+    return DEAD_PACMAN; // Invalid pacman
+  // Only this pacman's own moves change its row
+  unsigned int held =
+      lock_move(board, board->pacmans[pacman_index].pos_y, 0);
+  if (!board->pacmans[pacman_index].alive) {
+    unlock_move(board, held);
+    return DEAD_PACMAN; // Dead pacman
+  }
+
+  uint64_t cursor = pacman_cursor_key(board, pacman_index);
+  int result = pacman_step(board, pacman_index, command);
+  xor_hash(board, cursor ^ pacman_cursor_key(board, pacman_index));
+  if (board->on_step != NULL) {
+    const pacman_t *pac = &board->pacmans[pacman_index];
+    int scripted = command >= pac->moves && command < pac->moves + MAX_MOVES;
+    board->on_step(board->step_ctx, 0, scripted ? '\0' : command->command,
+                   board->hash);
+  }
+  unlock_move(board, held);
+  return result;
+}
+
 /**
  * @brief Helper private function for charged ghost movement in one direction.
  * @param board Pointer to the game board structure.
@@ -328,7 +664,7 @@ int move_ghost_charged(board_t *board, int ghost_index, char direction) {
   int new_x = x;
   int new_y = y;
 
-  ghost->charged = 0; // uncharge
+  set_charged(board, ghost_index, 0); // uncharge
   int result =
       move_ghost_charged_direction(board, ghost, direction, &new_x, &new_y);
   if (result == INVALID_MOVE) {
@@ -341,32 +677,68 @@ int move_ghost_charged(board_t *board, int ghost_index, char direction) {
   int new_index = get_board_index(board, new_x, new_y);
 
   // Update board - clear old position
-  board->board[old_index].content = ' ';
+  set_content(board, old_index, ' ');
   // Update ghost position
-  ghost->pos_x = new_x;
-  ghost->pos_y = new_y;
+  set_ghost_pos(board, ghost_index, new_x, new_y);
   // Update board - set new position
-  board->board[new_index].content = 'M';
+  set_content(board, new_index, 'M');
   return result;
 }
 
 /**
- * @brief Moves the ghost based on the command.
+ * @brief Moves a ghost to the next step of its precomputed path.
+ * @param board Pointer to the game board structure.
+ * @param ghost_index Index of the ghost to move.
+ * @return Same as ghost_step().
+ */
+static int ghost_path_step(board_t *board, int ghost_index) {
+  ghost_t *ghost = &board->ghosts[ghost_index];
+  int blocked = board->ghost_paths[ghost->path_start + ghost->path_step].blocked;
+  int step = ghost->path_step + 1;
+  if (step == ghost->path_len)
+    step = ghost->path_loop;
+  const ghost_path_t *next = &board->ghost_paths[ghost->path_start + step];
+  ghost->path_step = step;
+
+  // A wait that ran out is armed again, as in ghost_step()
+  command_t *command = &ghost->moves[ghost->current_move % ghost->n_moves];
+  command->turns_left = command->turns;
+  ghost->current_move = next->move;
+  ghost->waiting = next->waiting;
+  ghost->moves[next->move].turns_left = next->turns_left;
+  if (next->pos_x == ghost->pos_x && next->pos_y == ghost->pos_y)
+    return blocked ? INVALID_MOVE : VALID_MOVE;
+
+  int new_index = get_board_index(board, next->pos_x, next->pos_y);
+  int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
+  int result = VALID_MOVE;
+  if (board->board[new_index].content == 'C')
+    result = find_and_kill_pacman(board, next->pos_x, next->pos_y);
+  set_content(board, old_index, ' ');
+  set_ghost_pos(board, ghost_index, next->pos_x, next->pos_y);
+  set_content(board, new_index, 'M');
+  return result;
+}
+
+/**
+ * @brief Moves a ghost; the caller holds the lock for writing and hashes
+ * the script cursor.
  * @param board Pointer to the game board structure.
  * @param ghost_index Index of the ghost to move.
  * @param command Pointer to the command structure.
  * @return Result of the move.
  */
-int move_ghost(board_t *board, int ghost_index, command_t *command) {
-  pthread_rwlock_wrlock(&board->state_lock);
+static int ghost_step(board_t *board, int ghost_index, command_t *command) {
   ghost_t *ghost = &board->ghosts[ghost_index];
   int new_x = ghost->pos_x;
   int new_y = ghost->pos_y;
 
+  if (ghost->path_len > 0)
+    return ghost_path_step(board, ghost_index);
+
   // check passo
   if (ghost->waiting > 0) {
     ghost->waiting -= 1;
-    pthread_rwlock_unlock(&board->state_lock);
     return VALID_MOVE;
   }
 
@@ -381,7 +753,7 @@ int move_ghost(board_t *board, int ghost_index, command_t *command) {
 
   if (direction == 'R') {
     char directions[] = {'W', 'S', 'A', 'D'};
-    direction = directions[rand() % 4];
+    direction = directions[draw_random(board) % 4];
   }
 
   // Calculate new position based on direction
@@ -400,8 +772,7 @@ int move_ghost(board_t *board, int ghost_index, command_t *command) {
     break;
   case 'C': // Charge
     ghost->current_move += 1;
-    ghost->charged = 1;
-    pthread_rwlock_unlock(&board->state_lock);
+    set_charged(board, ghost_index, 1);
     return VALID_MOVE;
   case 'T': // Wait
     if (command->turns_left == 1) {
@@ -409,24 +780,18 @@ int move_ghost(board_t *board, int ghost_index, command_t *command) {
       command->turns_left = command->turns;
     } else
       command->turns_left -= 1;
-    pthread_rwlock_unlock(&board->state_lock);
     return VALID_MOVE;
   default:
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE; // Invalid direction
   }
 
   // Logic for the WASD movement
   ghost->current_move++;
-  if (ghost->charged) {
-    int res = move_ghost_charged(board, ghost_index, direction);
-    pthread_rwlock_unlock(&board->state_lock);
-    return res;
-  }
+  if (ghost->charged)
+    return move_ghost_charged(board, ghost_index, direction);
 
   // Check boundaries
   if (!is_valid_position(board, new_x, new_y)) {
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE;
   }
 
@@ -437,7 +802,6 @@ int move_ghost(board_t *board, int ghost_index, command_t *command) {
 
   // Check for walls and ghosts
   if (target_content == 'W' || target_content == 'X' || target_content == 'M') {
-    pthread_rwlock_unlock(&board->state_lock);
     return INVALID_MOVE;
   }
 
@@ -448,19 +812,56 @@ int move_ghost(board_t *board, int ghost_index, command_t *command) {
   }
 
   // Update board - clear old position (restore what was there)
-  board->board[old_index].content =
-      ' '; // Or restore the dot if ghost was on one
+  set_content(board, old_index, ' '); // Or restore the dot if ghost was on one
 
   // Update ghost position
-  ghost->pos_x = new_x;
-  ghost->pos_y = new_y;
+  set_ghost_pos(board, ghost_index, new_x, new_y);
 
   // Update board - set new position
-  board->board[new_index].content = 'M';
-  pthread_rwlock_unlock(&board->state_lock);
+  set_content(board, new_index, 'M');
+  return result;
+}
+
+/**
+ * @brief Moves the ghost based on the command.
+ * @param board Pointer to the game board structure.
+ * @param ghost_index Index of the ghost to move.
+ * @param command Pointer to the command structure.
+ * @return Result of the move.
+ */
+int move_ghost(board_t *board, int ghost_index, command_t *command) {
+  // Only this ghost's own moves change its row and charge
+  const ghost_t *mover = &board->ghosts[ghost_index];
+  unsigned int held = lock_move(board, mover->pos_y, mover->charged);
+  uint64_t cursor = ghost_cursor_key(board, ghost_index);
+  int result = ghost_step(board, ghost_index, command);
+  xor_hash(board, cursor ^ ghost_cursor_key(board, ghost_index));
+  if (board->on_step != NULL) {
+    const ghost_t *ghost = &board->ghosts[ghost_index];
+    int scripted =
+        command >= ghost->moves && command < ghost->moves + MAX_MOVES;
+    board->on_step(board->step_ctx, 1 + ghost_index,
+                   scripted ? '\0' : command->command, board->hash);
+  }
+  unlock_move(board, held);
   return result;
 }
 
+int ghost_path_position(const board_t *board, int ghost_index, long moves,
+                        int *x, int *y) {
+  const ghost_t *ghost = &board->ghosts[ghost_index];
+  if (ghost->path_len == 0 || moves < 0)
+    return -1;
+  long step = ghost->path_step + moves;
+  if (step >= ghost->path_len)
+    step = ghost->path_loop +
+           (step - ghost->path_loop) % (ghost->path_len - ghost->path_loop);
+  const ghost_path_t *at = &board->ghost_paths[ghost->path_start + step];
+  *x = at->pos_x;
+  *y = at->pos_y;
+  return 0;
+}
+
 /**
  * @brief Kills a pacman and removes it from the board.
  * @param board Pointer to the game board structure.
@@ -472,9 +873,11 @@ void kill_pacman(board_t *board, int pacman_index) {
   int index = pac->pos_y * board->width + pac->pos_x;
 
   // Remove pacman from the board
-  board->board[index].content = ' ';
+  set_content(board, index, ' ');
 
   // Mark pacman as dead
+  if (pac->alive)
+    xor_hash(board, zobrist_key(ZOBRIST_DEAD, (uint64_t)pacman_index, 0));
   pac->alive = 0;
 }
 
@@ -702,20 +1105,34 @@ static void reset_board(board_t *board) {
     pthread_rwlock_destroy(&board->state_lock);
     board->lock_initialized = 0;
   }
+  if (board->lock_mode == BOARD_LOCK_STRIPED) {
+    for (int i = 0; i < BOARD_LOCK_STRIPES; i++)
+      pthread_mutex_destroy(&board->row_locks[i]);
+    board->lock_mode = BOARD_LOCK_GLOBAL;
+  }
 
   free(board->board);
   free(board->pacmans);
   free(board->ghosts);
+  free(board->ghost_paths);
 
   board->board = NULL;
   board->pacmans = NULL;
   board->ghosts = NULL;
+  board->ghost_paths = NULL;
+  board->n_ghost_paths = 0;
   board->n_pacmans = 0;
   board->n_ghosts = 0;
   board->width = 0;
   board->height = 0;
   board->tempo = 0;
   board->level_finished = 0;
+  board->hash = 0;
+  atomic_store(&board->lock_wait_ns, 0);
+  board->on_event = NULL;
+  board->event_ctx = NULL;
+  board->on_step = NULL;
+  board->step_ctx = NULL;
   board->level_name[0] = '\0';
   board->pacman_file[0] = '\0';
   for (int i = 0; i < MAX_GHOSTS; i++) {
@@ -723,6 +1140,222 @@ static void reset_board(board_t *board) {
   }
 }
 
+/** @brief Slots of the table that finds where a ghost path loops */
+#define GHOST_PATH_SLOTS (2 * GHOST_PATH_MAX)
+
+/**
+ * @brief Tells whether a ghost's moves depend on nothing but its script
+ * and the walls (no random or charged moves).
+ */
+static int ghost_is_scripted(const ghost_t *ghost) {
+  if (ghost->n_moves == 0 || ghost->charged)
+    return 0;
+  for (int m = 0; m < ghost->n_moves; m++) {
+    char c = ghost->moves[m].command;
+    if (c == 'R' || c == 'C')
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Compares two ghost states (not how they are left).
+ */
+static int same_ghost_state(const ghost_path_t *a, const ghost_path_t *b) {
+  return a->pos_x == b->pos_x && a->pos_y == b->pos_y && a->move == b->move &&
+         a->waiting == b->waiting && a->turns_left == b->turns_left;
+}
+
+/**
+ * @brief Runs a scripted ghost alone on the walls until its state repeats.
+ * @param board Loaded level.
+ * @param ghost_index Ghost to run.
+ * @param steps Receives the states, from the current one.
+ * @param slots GHOST_PATH_SLOTS ints of scratch.
+ * @param loop Receives the step the path loops back to.
+ * @return Steps in the path, 0 if it does not loop within GHOST_PATH_MAX.
+ */
+static int trace_ghost_path(const board_t *board, int ghost_index,
+                            ghost_path_t *steps, int *slots, int *loop) {
+  size_t cells = (size_t)board->width * (size_t)board->height;
+  board_t solo;
+  memset(&solo, 0, sizeof(solo));
+  solo.width = board->width;
+  solo.height = board->height;
+  solo.board = malloc(cells * sizeof(board_pos_t));
+  if (solo.board == NULL)
+    return 0;
+  for (size_t i = 0; i < cells; i++) {
+    solo.board[i] = board->board[i];
+    if (solo.board[i].content == 'M' || solo.board[i].content == 'C')
+      solo.board[i].content = ' ';
+  }
+  ghost_t ghost = board->ghosts[ghost_index];
+  ghost.path_len = 0;
+  solo.ghosts = &ghost;
+  solo.n_ghosts = 1;
+
+  int len = 0;
+  memset(slots, -1, GHOST_PATH_SLOTS * sizeof(int));
+  for (int n = 0; n < GHOST_PATH_MAX; n++) {
+    int move = ghost.current_move % ghost.n_moves;
+    ghost_path_t state = {ghost.pos_x, ghost.pos_y, move, ghost.waiting,
+                          ghost.moves[move].turns_left, 0};
+    uint64_t key = zobrist_mix(
+        (uint64_t)(uint32_t)(state.pos_y * board->width + state.pos_x) ^
+        (uint64_t)(uint32_t)state.move << 32 ^
+        zobrist_mix((uint64_t)(uint32_t)state.waiting ^
+                    (uint64_t)(uint32_t)state.turns_left << 32));
+    int i = (int)(key & (GHOST_PATH_SLOTS - 1));
+    while (slots[i] != -1 && !same_ghost_state(&steps[slots[i]], &state))
+      i = (i + 1) & (GHOST_PATH_SLOTS - 1);
+    if (slots[i] != -1) {
+      *loop = slots[i];
+      len = n;
+      break;
+    }
+    slots[i] = n;
+    steps[n] = state;
+    steps[n].blocked = ghost_step(&solo, 0, &ghost.moves[move]) == INVALID_MOVE;
+  }
+  free(solo.board);
+  return len;
+}
+
+/**
+ * @brief Records that a ghost can stand on a cell.
+ * @param owner Ghost seen on each cell, -1 for none, -2 for several.
+ * @param clash Set for ghosts sharing a cell with another ghost.
+ */
+static void claim_cell(int *owner, unsigned char *clash, int cell, int g) {
+  if (owner[cell] == g)
+    return;
+  if (owner[cell] == -1) {
+    owner[cell] = g;
+    return;
+  }
+  clash[g] = 1;
+  if (owner[cell] >= 0)
+    clash[owner[cell]] = 1;
+  owner[cell] = -2;
+}
+
+/**
+ * @brief Precomputes the paths of the ghosts that always move the same way.
+ *
+ * A scripted ghost keeps its path only if no other ghost can stand on its
+ * cells: a ghost blocks ghosts, and the server moves them from separate
+ * threads. Ghosts without a path may go anywhere connected to their cell.
+ * Pacman never changes a ghost's path (a ghost walks onto it and kills it).
+ * Without memory for the tables every ghost keeps running its script.
+ * @param board Loaded level, with the ghosts on the board.
+ */
+static void build_ghost_paths(board_t *board) {
+  int n = board->n_ghosts;
+  size_t cells = (size_t)board->width * (size_t)board->height;
+  ghost_path_t *paths[MAX_GHOSTS] = {NULL};
+  int len[MAX_GHOSTS] = {0}, loop[MAX_GHOSTS] = {0};
+  ghost_path_t *steps = malloc(GHOST_PATH_MAX * sizeof(ghost_path_t));
+  int *slots = malloc(GHOST_PATH_SLOTS * sizeof(int));
+  int *owner = malloc(cells * sizeof(int));
+  int *queue = malloc(cells * sizeof(int));
+  unsigned char *seen = malloc(cells);
+  if (steps == NULL || slots == NULL || owner == NULL || queue == NULL ||
+      seen == NULL)
+    goto out;
+
+  for (int g = 0; g < n; g++) {
+    if (!ghost_is_scripted(&board->ghosts[g]))
+      continue;
+    len[g] = trace_ghost_path(board, g, steps, slots, &loop[g]);
+    if (len[g] > 0) {
+      paths[g] = malloc((size_t)len[g] * sizeof(ghost_path_t));
+      if (paths[g] == NULL)
+        len[g] = 0;
+      else
+        memcpy(paths[g], steps, (size_t)len[g] * sizeof(ghost_path_t));
+    }
+  }
+
+  // Dropping a path widens that ghost's cells, so repeat until stable
+  int changed = 1;
+  while (changed) {
+    unsigned char clash[MAX_GHOSTS] = {0};
+    for (size_t i = 0; i < cells; i++)
+      owner[i] = -1;
+    for (int g = 0; g < n; g++) {
+      if (len[g] > 0) {
+        for (int i = 0; i < len[g]; i++)
+          claim_cell(owner, clash,
+                     paths[g][i].pos_y * board->width + paths[g][i].pos_x, g);
+        continue;
+      }
+      // Flood fill of the open cells around the ghost
+      memset(seen, 0, cells);
+      int head = 0, tail = 0;
+      int start = board->ghosts[g].pos_y * board->width +
+                  board->ghosts[g].pos_x;
+      queue[tail++] = start;
+      seen[start] = 1;
+      while (head < tail) {
+        int cell = queue[head++];
+        claim_cell(owner, clash, cell, g);
+        int x = cell % board->width, y = cell / board->width;
+        int next[4][2] = {{x, y - 1}, {x, y + 1}, {x - 1, y}, {x + 1, y}};
+        for (int d = 0; d < 4; d++) {
+          if (!is_valid_position(board, next[d][0], next[d][1]))
+            continue;
+          int to = get_board_index(board, next[d][0], next[d][1]);
+          char c = board->board[to].content;
+          if (!seen[to] && c != 'W' && c != 'X') {
+            seen[to] = 1;
+            queue[tail++] = to;
+          }
+        }
+      }
+    }
+    changed = 0;
+    for (int g = 0; g < n; g++) {
+      if (len[g] > 0 && clash[g]) {
+        len[g] = 0;
+        changed = 1;
+      }
+    }
+  }
+
+  int total = 0;
+  for (int g = 0; g < n; g++)
+    total += len[g];
+  if (total > 0) {
+    board->ghost_paths = malloc((size_t)total * sizeof(ghost_path_t));
+    if (board->ghost_paths == NULL)
+      goto out;
+    board->n_ghost_paths = total;
+    int start = 0;
+    for (int g = 0; g < n; g++) {
+      if (len[g] == 0)
+        continue;
+      ghost_t *ghost = &board->ghosts[g];
+      memcpy(board->ghost_paths + start, paths[g],
+             (size_t)len[g] * sizeof(ghost_path_t));
+      ghost->path_start = start;
+      ghost->path_len = len[g];
+      ghost->path_loop = loop[g];
+      ghost->path_step = 0;
+      start += len[g];
+    }
+  }
+
+out:
+  for (int g = 0; g < n; g++)
+    free(paths[g]);
+  free(steps);
+  free(slots);
+  free(owner);
+  free(queue);
+  free(seen);
+}
+
 /**
  * @brief Loads a level from a file, parsing dimensions, map, and entities.
  * @param board Pointer to the game board structure.
@@ -991,7 +1624,11 @@ int load_level(board_t *board, const char *filename, int accumulated_points) {
     }
   }
 
+  build_ghost_paths(board);
+
   snprintf(board->level_name, sizeof(board->level_name), "%s", filename);
+  board->rng_seed = (unsigned int)rand();
+  board->hash = board_hash(board);
   pthread_rwlock_init(&board->state_lock, NULL);
   board->lock_initialized = 1;
 
@@ -1016,6 +1653,204 @@ int load_level(board_t *board, const char *filename, int accumulated_points) {
   return 0;
 }
 
+/**
+ * @brief Allocates one of a board copy's arrays, accounting it in allocs.
+ */
+static void *board_alloc(board_t *board, size_t size) {
+  void *p = malloc(size);
+  if (p != NULL) {
+    board->allocs++;
+    board->alloc_bytes += size;
+  }
+  return p;
+}
+
+/**
+ * @brief Copies a loaded level into a new board with its own arrays and lock.
+ * @param dst Board to populate.
+ * @param src Loaded level to copy.
+ * @param accumulated_points Points carried over from previous levels.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int board_clone(board_t *dst, const board_t *src, int accumulated_points) {
+  size_t cells = (size_t)src->width * (size_t)src->height;
+  memcpy(dst, src, sizeof(board_t));
+  dst->allocs = 0;
+  dst->alloc_bytes = 0;
+  dst->board = board_alloc(dst, cells * sizeof(board_pos_t));
+  dst->pacmans = board_alloc(dst, (size_t)src->n_pacmans * sizeof(pacman_t));
+  dst->ghosts = board_alloc(dst, (size_t)src->n_ghosts * sizeof(ghost_t));
+  dst->ghost_paths =
+      board_alloc(dst, (size_t)src->n_ghost_paths * sizeof(ghost_path_t));
+  if (dst->board == NULL || dst->pacmans == NULL ||
+      (src->n_ghosts > 0 && dst->ghosts == NULL) ||
+      (src->n_ghost_paths > 0 && dst->ghost_paths == NULL)) {
+    free(dst->board);
+    free(dst->pacmans);
+    free(dst->ghosts);
+    free(dst->ghost_paths);
+    memset(dst, 0, sizeof(board_t));
+    return -1;
+  }
+  memcpy(dst->board, src->board, cells * sizeof(board_pos_t));
+  memcpy(dst->pacmans, src->pacmans,
+         (size_t)src->n_pacmans * sizeof(pacman_t));
+  memcpy(dst->ghosts, src->ghosts, (size_t)src->n_ghosts * sizeof(ghost_t));
+  memcpy(dst->ghost_paths, src->ghost_paths,
+         (size_t)src->n_ghost_paths * sizeof(ghost_path_t));
+
+  if (dst->n_pacmans > 0)
+    dst->pacmans[0].points = accumulated_points;
+  dst->level_finished = 0;
+  dst->shutdown = 0;
+  atomic_store(&dst->lock_wait_ns, 0);
+  dst->rng_seed = (unsigned int)rand();
+  pthread_rwlock_init(&dst->state_lock, NULL);
+  dst->lock_initialized = 1;
+  dst->lock_mode = BOARD_LOCK_GLOBAL; // The stripes are the source's
+  return 0;
+}
+
+/** @brief Marks a board saved by board_save() ("PBRD") */
+#define BOARD_SAVE_MAGIC 0x44524250u
+
+/**
+ * @brief Fixed part of a saved board, followed by the cells, the pacmans,
+ * the ghosts and the ghost paths.
+ */
+typedef struct {
+  unsigned int magic;
+  int width, height;
+  int n_pacmans, n_ghosts;
+  int n_ghost_paths;
+  int tempo;
+  int level_finished;
+  unsigned int rng_seed;
+  uint64_t hash;
+  char level_name[256];
+} board_save_header_t;
+
+size_t board_save_size(const board_t *board) {
+  return sizeof(board_save_header_t) +
+         (size_t)board->width * (size_t)board->height * sizeof(board_pos_t) +
+         (size_t)board->n_pacmans * sizeof(pacman_t) +
+         (size_t)board->n_ghosts * sizeof(ghost_t) +
+         (size_t)board->n_ghost_paths * sizeof(ghost_path_t);
+}
+
+long board_save(const board_t *board, void *buf, size_t size) {
+  size_t total = board_save_size(board);
+  if (size < total)
+    return -1;
+  board_save_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = BOARD_SAVE_MAGIC;
+  header.width = board->width;
+  header.height = board->height;
+  header.n_pacmans = board->n_pacmans;
+  header.n_ghosts = board->n_ghosts;
+  header.n_ghost_paths = board->n_ghost_paths;
+  header.tempo = board->tempo;
+  header.level_finished = board->level_finished;
+  header.rng_seed = board->rng_seed;
+  header.hash = board->hash;
+  memcpy(header.level_name, board->level_name, sizeof(header.level_name));
+
+  char *p = buf;
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  size_t cells = (size_t)board->width * (size_t)board->height;
+  memcpy(p, board->board, cells * sizeof(board_pos_t));
+  p += cells * sizeof(board_pos_t);
+  memcpy(p, board->pacmans, (size_t)board->n_pacmans * sizeof(pacman_t));
+  p += (size_t)board->n_pacmans * sizeof(pacman_t);
+  memcpy(p, board->ghosts, (size_t)board->n_ghosts * sizeof(ghost_t));
+  p += (size_t)board->n_ghosts * sizeof(ghost_t);
+  memcpy(p, board->ghost_paths,
+         (size_t)board->n_ghost_paths * sizeof(ghost_path_t));
+  return (long)total;
+}
+
+int board_restore(board_t *dst, const void *buf, size_t size) {
+  board_save_header_t header;
+  if (size < sizeof(header))
+    return -1;
+  memcpy(&header, buf, sizeof(header));
+  if (header.magic != BOARD_SAVE_MAGIC || header.width <= 0 ||
+      header.height <= 0 || header.width > 4096 || header.height > 4096 ||
+      header.n_pacmans < 1 || header.n_pacmans > 1 || header.n_ghosts < 0 ||
+      header.n_ghosts > MAX_GHOSTS || header.n_ghost_paths < 0 ||
+      header.n_ghost_paths > MAX_GHOSTS * GHOST_PATH_MAX)
+    return -1;
+
+  memset(dst, 0, sizeof(board_t));
+  dst->width = header.width;
+  dst->height = header.height;
+  dst->n_pacmans = header.n_pacmans;
+  dst->n_ghosts = header.n_ghosts;
+  dst->n_ghost_paths = header.n_ghost_paths;
+  if (board_save_size(dst) != size)
+    return -1;
+
+  size_t cells = (size_t)header.width * (size_t)header.height;
+  dst->board = board_alloc(dst, cells * sizeof(board_pos_t));
+  dst->pacmans =
+      board_alloc(dst, (size_t)header.n_pacmans * sizeof(pacman_t));
+  dst->ghosts = board_alloc(dst, (size_t)header.n_ghosts * sizeof(ghost_t));
+  dst->ghost_paths =
+      board_alloc(dst, (size_t)header.n_ghost_paths * sizeof(ghost_path_t));
+  if (dst->board == NULL || dst->pacmans == NULL ||
+      (header.n_ghosts > 0 && dst->ghosts == NULL) ||
+      (header.n_ghost_paths > 0 && dst->ghost_paths == NULL)) {
+    free(dst->board);
+    free(dst->pacmans);
+    free(dst->ghosts);
+    free(dst->ghost_paths);
+    memset(dst, 0, sizeof(board_t));
+    return -1;
+  }
+  const char *p = (const char *)buf + sizeof(header);
+  memcpy(dst->board, p, cells * sizeof(board_pos_t));
+  p += cells * sizeof(board_pos_t);
+  memcpy(dst->pacmans, p, (size_t)header.n_pacmans * sizeof(pacman_t));
+  p += (size_t)header.n_pacmans * sizeof(pacman_t);
+  memcpy(dst->ghosts, p, (size_t)header.n_ghosts * sizeof(ghost_t));
+  p += (size_t)header.n_ghosts * sizeof(ghost_t);
+  memcpy(dst->ghost_paths, p,
+         (size_t)header.n_ghost_paths * sizeof(ghost_path_t));
+
+  // A path step out of the saved paths would be read out of bounds
+  int valid = 1;
+  for (int g = 0; g < dst->n_ghosts; g++) {
+    const ghost_t *ghost = &dst->ghosts[g];
+    if (ghost->path_len != 0 &&
+        (ghost->path_start < 0 || ghost->path_len < 0 ||
+         ghost->path_start > dst->n_ghost_paths - ghost->path_len ||
+         ghost->path_loop < 0 || ghost->path_loop >= ghost->path_len ||
+         ghost->path_step < 0 || ghost->path_step >= ghost->path_len ||
+         ghost->n_moves <= 0))
+      valid = 0;
+  }
+
+  dst->tempo = header.tempo;
+  dst->level_finished = header.level_finished;
+  dst->rng_seed = header.rng_seed;
+  memcpy(dst->level_name, header.level_name, sizeof(dst->level_name));
+  dst->level_name[sizeof(dst->level_name) - 1] = '\0';
+  dst->hash = board_hash(dst);
+  if (!valid || dst->hash != header.hash) {
+    free(dst->board);
+    free(dst->pacmans);
+    free(dst->ghosts);
+    free(dst->ghost_paths);
+    memset(dst, 0, sizeof(board_t));
+    return -1;
+  }
+  pthread_rwlock_init(&dst->state_lock, NULL);
+  dst->lock_initialized = 1;
+  return 0;
+}
+
 /**
  * @brief Unloads the level and frees memory.
  * @param board Pointer to the game board structure.
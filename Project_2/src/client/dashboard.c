@@ -0,0 +1,484 @@
+/**
+ * @file dashboard.c
+ * @brief PacmanIST Dashboard - Spectates many sessions in one terminal.
+ *
+ * Attaches to several sessions over a single notification pipe
+ * (OP_SPECTATE) and draws each one as a tile, scaled down so every tile
+ * fits the terminal. A single loop polls the pipe and the keyboard; every
+ * redraw goes through one shadow copy of the screen, so only the cells that
+ * changed reach the terminal. With a frame budget (-b) the screen is redrawn
+ * at most once per budget and tiles whose frame did not change since they
+ * were last drawn are not even rescaled.
+ */
+
+#include "../../include/protocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ncurses.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Color pairs, as in the game client
+#define COLOR_PACMAN 1
+#define COLOR_GHOST 2
+#define COLOR_WALL 3
+#define COLOR_DOT 4
+#define COLOR_UI 5
+#define COLOR_PORTAL 6
+
+/** @brief Bytes read from the notification pipe per wakeup */
+#define DASH_READ_BYTES 65536
+/** @brief Time to wait for the server's answer */
+#define DASH_CONNECT_MS 2000
+
+/**
+ * @brief Latest frame of one followed session.
+ */
+typedef struct {
+  int used;              /**< A session is, or was, shown here */
+  int ended;             /**< Its session ended */
+  int32_t client_id;
+  game_state_msg_t frame;
+  int changed; /**< Received since the tile was last drawn */
+} tile_t;
+
+static tile_t tiles[SPECTATE_MAX_SESSIONS];
+static int n_tiles;
+
+/* What is on screen: one character and color pair per cell */
+static char *shadow_ch;
+static unsigned char *shadow_color;
+static int screen_rows, screen_cols;
+static int grid_cols, box_w, box_h;
+
+static unsigned long frames_received;
+static unsigned long tiles_drawn;
+static unsigned long tiles_skipped;
+static unsigned long cells_written;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in milliseconds.
+ */
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Writes one cell if it differs from what is on screen.
+ */
+static void put_cell(int y, int x, char ch, unsigned char color) {
+  if (y < 0 || y >= screen_rows || x < 0 || x >= screen_cols)
+    return;
+  int i = y * screen_cols + x;
+  if (shadow_ch[i] == ch && shadow_color[i] == color)
+    return;
+  shadow_ch[i] = ch;
+  shadow_color[i] = color;
+  if (color != 0)
+    attron(COLOR_PAIR(color));
+  mvaddch(y, x, (chtype)(unsigned char)ch);
+  if (color != 0)
+    attroff(COLOR_PAIR(color));
+  cells_written++;
+}
+
+/**
+ * @brief Writes a string through put_cell(), padded to a width.
+ */
+static void put_text(int y, int x, int width, const char *text,
+                     unsigned char color) {
+  int len = (int)strlen(text);
+  for (int i = 0; i < width; i++)
+    put_cell(y, x + i, i < len ? text[i] : ' ', color);
+}
+
+/**
+ * @brief Chooses the tile grid that gives each tile the largest box.
+ *
+ * Terminal cells are about twice as tall as wide, so a box is weighed by
+ * min(width, 2 * height). Resets the shadow screen.
+ */
+static void layout(void) {
+  getmaxyx(stdscr, screen_rows, screen_cols);
+  free(shadow_ch);
+  free(shadow_color);
+  size_t cells = (size_t)screen_rows * (size_t)screen_cols;
+  shadow_ch = malloc(cells);
+  shadow_color = malloc(cells);
+  if (shadow_ch == NULL || shadow_color == NULL) {
+    endwin();
+    perror("Failed to allocate the screen");
+    exit(EXIT_FAILURE);
+  }
+  memset(shadow_ch, ' ', cells);
+  memset(shadow_color, 0, cells);
+
+  int best = -1;
+  for (int cols = 1; cols <= n_tiles; cols++) {
+    int rows = (n_tiles + cols - 1) / cols;
+    int w = (screen_cols + 1) / cols - 1;
+    int h = (screen_rows - 1) / rows; // Last line is the status line
+    int score = w < 2 * h ? w : 2 * h;
+    if (score > best) {
+      best = score;
+      grid_cols = cols;
+      box_w = w;
+      box_h = h;
+    }
+  }
+  erase();
+  for (int i = 0; i < n_tiles; i++)
+    tiles[i].changed = 1;
+}
+
+/**
+ * @brief Rank of a frame character when several share a scaled cell.
+ */
+static int cell_rank(char ch) {
+  switch (ch) {
+  case 'C':
+    return 5;
+  case 'M':
+    return 4;
+  case '@':
+    return 3;
+  case '.':
+    return 2;
+  case '#':
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Color pair of a frame character.
+ */
+static unsigned char cell_color(char ch) {
+  switch (ch) {
+  case 'C':
+    return COLOR_PACMAN;
+  case 'M':
+    return COLOR_GHOST;
+  case '@':
+    return COLOR_PORTAL;
+  case '.':
+    return COLOR_DOT;
+  case '#':
+    return COLOR_WALL;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Draws a tile: a title line and the board scaled into its box.
+ *
+ * Each screen cell shows the most important character of the board cells
+ * it covers (Pacman, then ghosts, portal, dots, walls).
+ */
+static void draw_tile(int index) {
+  tile_t *tile = &tiles[index];
+  int top = (index / grid_cols) * box_h;
+  int left = (index % grid_cols) * (box_w + 1);
+  int rows = box_h - 1;
+  if (box_w < 1 || rows < 1)
+    return;
+
+  char title[64];
+  if (!tile->used)
+    snprintf(title, sizeof(title), "[%d] waiting", index);
+  else if (tile->ended)
+    snprintf(title, sizeof(title), "#%d ended", tile->client_id);
+  else
+    snprintf(title, sizeof(title), "#%d %d%s", tile->client_id,
+             tile->frame.points,
+             tile->frame.game_state == GAME_STATE_WIN        ? " WIN"
+             : tile->frame.game_state == GAME_STATE_GAME_OVER ? " DEAD"
+             : tile->frame.game_state == GAME_STATE_PAUSED    ? " PAUSED"
+                                                             : "");
+  put_text(top, left, box_w, title, COLOR_UI);
+
+  const game_state_msg_t *frame = &tile->frame;
+  int width = tile->used ? frame->width : 0;
+  int height = tile->used ? frame->height : 0;
+  if (width < 0 || height < 0 || width * height > MAX_BOARD_SIZE)
+    width = height = 0;
+  int sx = width > box_w ? (width + box_w - 1) / box_w : 1;
+  int sy = height > rows ? (height + rows - 1) / rows : 1;
+
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < box_w; x++) {
+      char best = ' ';
+      for (int by = y * sy; by < (y + 1) * sy && by < height; by++)
+        for (int bx = x * sx; bx < (x + 1) * sx && bx < width; bx++) {
+          char ch = frame->board_data[by * width + bx];
+          if (cell_rank(ch) > cell_rank(best))
+            best = ch;
+        }
+      put_cell(top + 1 + y, left + x, best, tile->ended ? 0 : cell_color(best));
+    }
+  }
+}
+
+/**
+ * @brief Redraws the tiles and the status line.
+ * @param skip_unchanged Leave tiles with no new frame untouched.
+ * @param fps Frames received per second, for the status line.
+ */
+static void render(int skip_unchanged, double fps) {
+  for (int i = 0; i < n_tiles; i++) {
+    if (skip_unchanged && !tiles[i].changed) {
+      tiles_skipped++;
+      continue;
+    }
+    draw_tile(i);
+    tiles[i].changed = 0;
+    tiles_drawn++;
+  }
+  char status[128];
+  snprintf(status, sizeof(status),
+           "%d tiles | %.0f frames/s | %lu drawn, %lu skipped | q: quit",
+           n_tiles, fps, tiles_drawn, tiles_skipped);
+  put_text(screen_rows - 1, 0, screen_cols, status, COLOR_UI);
+  refresh();
+}
+
+/**
+ * @brief Applies the messages in a buffer to the tiles.
+ * @param buf Bytes read from the notification pipe.
+ * @param len Number of bytes.
+ * @return Bytes consumed; the rest is an incomplete message.
+ */
+static size_t consume(const char *buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    int8_t op = buf[done];
+    size_t size;
+    if (op == OP_SPECTATE_FRAME)
+      size = sizeof(spectate_frame_msg_t);
+    else if (op == OP_SPECTATE_END)
+      size = sizeof(spectate_end_msg_t);
+    else
+      size = 1; // Not a message start: skip the byte
+    if (len - done < size)
+      break;
+
+    if (op == OP_SPECTATE_FRAME) {
+      spectate_frame_msg_t msg;
+      memcpy(&msg, buf + done, sizeof(msg));
+      if (msg.slot < n_tiles) {
+        tile_t *tile = &tiles[msg.slot];
+        tile->used = 1;
+        tile->ended = 0;
+        tile->client_id = msg.client_id;
+        tile->frame = msg.frame;
+        tile->changed = 1;
+      }
+      frames_received++;
+    } else if (op == OP_SPECTATE_END) {
+      spectate_end_msg_t msg;
+      memcpy(&msg, buf + done, sizeof(msg));
+      if (msg.slot < n_tiles) {
+        tiles[msg.slot].ended = 1;
+        tiles[msg.slot].changed = 1;
+      }
+    }
+    done += size;
+  }
+  return done;
+}
+
+/**
+ * @brief Waits for the answer to the spectate request.
+ * @return Sessions attached, or -1 if refused or unanswered.
+ */
+static int read_response(int fd) {
+  spectate_resp_t resp;
+  size_t got = 0;
+  long long deadline = now_ms() + DASH_CONNECT_MS;
+  while (got < sizeof(resp) && now_ms() < deadline) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    ssize_t n = read(fd, (char *)&resp + got, sizeof(resp) - got);
+    if (n > 0)
+      got += (size_t)n;
+  }
+  if (got < sizeof(resp) || resp.op_code != OP_SPECTATE || resp.result != 0)
+    return -1;
+  return resp.attached;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-n tiles] [-f fps] [-b budget_ms] <registration_fifo> "
+          "[client_id...]\n"
+          "  -n  sessions to follow when no client id is given (default 9)\n"
+          "  -f  frames per second per session (default: every change)\n"
+          "  -b  redraw at most every budget_ms, skipping unchanged tiles\n",
+          prog);
+}
+
+/**
+ * @brief Main entry point for the dashboard.
+ *
+ * Creates a private notification FIFO, asks the server to attach it to the
+ * listed sessions (or to any sessions), then runs the single input and
+ * render loop until 'q' or the server goes away.
+ */
+int main(int argc, char *argv[]) {
+  int limit = 9, max_fps = 0, budget_ms = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:f:b:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      limit = atoi(optarg);
+      break;
+    case 'f':
+      max_fps = atoi(optarg);
+      break;
+    case 'b':
+      budget_ms = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *server_fifo = argv[optind++];
+
+  spectate_req_t req = {.op_code = OP_SPECTATE,
+                        .max_fps = (uint16_t)(max_fps > 0 ? max_fps : 0)};
+  while (optind < argc && req.count < SPECTATE_MAX_SESSIONS)
+    req.client_ids[req.count++] = atoi(argv[optind++]);
+  if (limit < 1)
+    limit = 1;
+  if (limit > SPECTATE_MAX_SESSIONS)
+    limit = SPECTATE_MAX_SESSIONS;
+  req.limit = (uint8_t)limit;
+  n_tiles = req.count > 0 ? req.count : limit;
+
+  char notif_pipe_path[PIPE_NAME_SIZE];
+  snprintf(notif_pipe_path, PIPE_NAME_SIZE, "/tmp/pacman_dash_%d",
+           (int)getpid());
+  strncpy(req.notif_pipe, notif_pipe_path, PIPE_NAME_SIZE);
+  unlink(notif_pipe_path);
+  if (mkfifo(notif_pipe_path, 0666) == -1) {
+    perror("Failed to create notification FIFO");
+    return 1;
+  }
+  /* Open our end first: the server opens its end without blocking */
+  int notif_fd = open(notif_pipe_path, O_RDONLY | O_NONBLOCK);
+  if (notif_fd == -1) {
+    perror("Failed to open notification FIFO");
+    unlink(notif_pipe_path);
+    return 1;
+  }
+
+  int server_fd = open(server_fifo, O_WRONLY);
+  if (server_fd == -1 || write(server_fd, &req, sizeof(req)) == -1) {
+    perror("Failed to connect to server");
+    close(notif_fd);
+    unlink(notif_pipe_path);
+    return 1;
+  }
+  close(server_fd);
+
+  int attached = read_response(notif_fd);
+  if (attached < 0) {
+    fprintf(stderr, "Server refused or did not answer the spectate request\n");
+    close(notif_fd);
+    unlink(notif_pipe_path);
+    return 1;
+  }
+
+  initscr();
+  cbreak();
+  noecho();
+  keypad(stdscr, TRUE);
+  curs_set(0);
+  nodelay(stdscr, TRUE);
+  if (has_colors()) {
+    start_color();
+    init_pair(COLOR_PACMAN, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(COLOR_GHOST, COLOR_RED, COLOR_BLACK);
+    init_pair(COLOR_WALL, COLOR_BLUE, COLOR_BLACK);
+    init_pair(COLOR_DOT, COLOR_WHITE, COLOR_BLACK);
+    init_pair(COLOR_UI, COLOR_GREEN, COLOR_BLACK);
+    init_pair(COLOR_PORTAL, COLOR_MAGENTA, COLOR_BLACK);
+  }
+  layout();
+
+  static char buf[DASH_READ_BYTES];
+  size_t buffered = 0;
+  int running = 1;
+  long long last_render = 0, rate_start = now_ms();
+  unsigned long rate_frames = 0;
+  double fps = 0.0;
+  render(0, fps);
+
+  while (running) {
+    struct pollfd pfds[2] = {{.fd = notif_fd, .events = POLLIN},
+                             {.fd = STDIN_FILENO, .events = POLLIN}};
+    int timeout = budget_ms > 0 ? budget_ms : 250;
+    if (poll(pfds, 2, timeout) == -1 && errno != EINTR)
+      break;
+
+    if (pfds[0].revents & (POLLIN | POLLHUP)) {
+      ssize_t n = read(notif_fd, buf + buffered, sizeof(buf) - buffered);
+      if (n == 0)
+        break; // Server gone
+      if (n > 0) {
+        buffered += (size_t)n;
+        size_t used = consume(buf, buffered);
+        memmove(buf, buf + used, buffered - used);
+        buffered -= used;
+      }
+    }
+
+    int ch;
+    while ((ch = getch()) != ERR) {
+      if (ch == 'q' || ch == 'Q')
+        running = 0;
+      else if (ch == KEY_RESIZE)
+        layout();
+    }
+
+    long long now = now_ms();
+    if (now - rate_start >= 1000) {
+      fps = (double)(frames_received - rate_frames) * 1000.0 /
+            (double)(now - rate_start);
+      rate_frames = frames_received;
+      rate_start = now;
+    }
+    if (budget_ms == 0)
+      render(0, fps);
+    else if (now - last_render >= budget_ms) {
+      render(1, fps);
+      last_render = now;
+    }
+  }
+
+  endwin();
+  close(notif_fd);
+  unlink(notif_pipe_path);
+  free(shadow_ch);
+  free(shadow_color);
+  printf("Followed %d sessions (%d at start): %lu frames, %lu tiles drawn, "
+         "%lu skipped, %lu cells written\n",
+         n_tiles, attached, frames_received, tiles_drawn, tiles_skipped,
+         cells_written);
+  return 0;
+}
@@ -61,6 +61,21 @@ char get_input(void) {
   return (char)ch;
 }
 
+/* Last leaderboard received, drawn under the status line */
+static leaderboard_msg_t leaderboard;
+
+/**
+ * @brief Keeps the leaderboard shown by the next draw_board() calls.
+ * @param msg OP_LEADERBOARD message received from the server.
+ */
+void display_set_leaderboard(const leaderboard_msg_t *msg) {
+  leaderboard = *msg;
+  if (leaderboard.count > LEADERBOARD_SIZE)
+    leaderboard.count = LEADERBOARD_SIZE;
+  for (int i = 0; i < leaderboard.count; i++)
+    leaderboard.entries[i].name[LEADERBOARD_NAME - 1] = '\0';
+}
+
 /**
  * @brief Draws the board content to the screen.
  * @param board Pointer to the game board structure.
@@ -163,9 +178,29 @@ void draw_board(board_t *board, int mode) {
     attrset(A_NORMAL);
     clrtoeol();
     break;
+  case DRAW_PAUSED:
+    attron(COLOR_PAIR(COLOR_UI) | A_BOLD);
+    addstr("PAUSED - Move (WASD) to resume | Quit: Q");
+    attrset(A_NORMAL);
+    clrtoeol();
+    break;
   default:
     break;
   }
 
+  // Leaderboard, if the server sends one
+  if (leaderboard.count > 0) {
+    info_row += 2;
+    attron(COLOR_PAIR(COLOR_UI) | A_BOLD);
+    mvprintw(info_row++, 0, "--- Leaderboard ---");
+    attrset(A_NORMAL);
+    for (int i = 0; i < leaderboard.count; i++) {
+      const leaderboard_entry_t *e = &leaderboard.entries[i];
+      mvprintw(info_row++, 0, "%d. %-15s %6d%s", i + 1, e->name, e->points,
+               (e->flags & LEADERBOARD_PLAYING) ? "  (playing)" : "");
+      clrtoeol();
+    }
+  }
+
   // No unlock needed - client temp board has no lock
 }
@@ -7,6 +7,7 @@
 #include "../../include/protocol.h"
 #include <fcntl.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,11 +17,126 @@
 
 volatile int client_running = 1;
 
+/* How long a client whose server died waits for its standby (FEAT_RESUME) */
+#define RESUME_TIMEOUT_MS 10000
+
+/* How long the client waits for an OP_CONNECT_EXT response before it asks
+ * again with OP_CONNECT, for a server without the extended handshake */
+#define CONNECT_EXT_TIMEOUT_MS 1000
+
+/* Cells of the frame being drawn, reused so frames do not allocate */
+static board_pos_t frame_cells[MAX_BOARD_SIZE];
+
 typedef struct {
   char req_pipe_path[PIPE_NAME_SIZE];
   char moves_file[256];
 } client_thread_arg_t;
 
+/**
+ * @brief Reads exactly 'size' bytes from the notification pipe.
+ *
+ * @return int 1 on success, 0 on EOF or error.
+ */
+static int read_full(int fd, void *buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, (char *)buf + done, size - done);
+    if (n <= 0)
+      return 0;
+    done += (size_t)n;
+  }
+  return 1;
+}
+
+/**
+ * @brief Size of a message on the notification pipe from its op code.
+ */
+static size_t message_size(int8_t op_code) {
+  if (op_code == OP_LEADERBOARD)
+    return sizeof(leaderboard_msg_t);
+  if (op_code == OP_STATE_HASH)
+    return sizeof(state_hash_msg_t);
+  if (op_code == OP_RESUME_TOKEN)
+    return sizeof(resume_token_msg_t);
+  return sizeof(game_state_msg_t);
+}
+
+/**
+ * @brief Waits for a connection response on the notification pipe, opened
+ * non-blocking so a server that never answers cannot hang the client.
+ *
+ * @param timeout_ms Time to wait for the first byte, -1 for no limit.
+ * @return int 1 once 'size' bytes arrived, 0 on timeout or quit.
+ */
+static int wait_response(int notif_fd, void *buf, size_t size,
+                         int timeout_ms) {
+  size_t done = 0;
+  int waited = 0;
+  while (client_running) {
+    ssize_t n = read(notif_fd, (char *)buf + done, size - done);
+    if (n > 0) {
+      done += (size_t)n;
+      if (done == size)
+        return 1;
+      continue;
+    }
+    // EOF while the server has not opened the pipe, EAGAIN while it has
+    if (done == 0 && timeout_ms >= 0 && waited >= timeout_ms)
+      return 0;
+    sleep_ms(10);
+    waited += 10;
+  }
+  return 0;
+}
+
+/**
+ * @brief Asks the standby that took over the registration FIFO to continue
+ * the session after the server died (FEAT_RESUME).
+ *
+ * Both private FIFOs stay open, so the input thread's request pipe and the
+ * notification pipe work again once the standby opens their other ends.
+ *
+ * @return int 1 if the session goes on, 0 if no server resumed it in time.
+ */
+static int resume_session(const char *server_fifo, const char *req_pipe_path,
+                          const char *notif_pipe_path, int notif_fd,
+                          uint64_t token) {
+  resume_req_t req = {.op_code = OP_RESUME, .token = token};
+  strncpy(req.req_pipe, req_pipe_path, PIPE_NAME_SIZE);
+  strncpy(req.notif_pipe, notif_pipe_path, PIPE_NAME_SIZE);
+
+  int waited = 0, sent = 0;
+  ino_t sent_to = 0;
+  struct stat st;
+  while (client_running && waited < RESUME_TIMEOUT_MS) {
+    /* A dying server may still hold its FIFO open: ask again once the
+     * standby has created a new one */
+    if (sent && stat(server_fifo, &st) == 0 && st.st_ino != sent_to)
+      sent = 0;
+    if (!sent) {
+      // Fails until a server reads the FIFO again
+      int server_fd = open(server_fifo, O_WRONLY | O_NONBLOCK);
+      if (server_fd != -1) {
+        sent = fstat(server_fd, &st) == 0 &&
+               write(server_fd, &req, sizeof(req)) == (ssize_t)sizeof(req);
+        sent_to = st.st_ino;
+        close(server_fd);
+      }
+    } else {
+      // Reads EOF until the server opens the notification pipe
+      resume_resp_t resp;
+      ssize_t n = read(notif_fd, &resp, sizeof(resp));
+      if (n == (ssize_t)sizeof(resp))
+        return resp.op_code == OP_RESUME && resp.result == 0;
+      if (n > 0)
+        return 0;
+    }
+    sleep_ms(10);
+    waited += 10;
+  }
+  return 0;
+}
+
 /**
  * @brief Input thread function.
  *
@@ -147,30 +263,72 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  connect_req_t req = {.op_code = OP_CONNECT};
-  strncpy(req.req_pipe, req_pipe_path, PIPE_NAME_SIZE);
-  strncpy(req.notif_pipe, notif_pipe_path, PIPE_NAME_SIZE);
-
-  if (write(server_fd, &req, sizeof(connect_req_t)) == -1) {
-    perror("Failed to send connection request");
+  /* Open before asking: the server's answer then never blocks on us */
+  int notif_fd = open(notif_pipe_path, O_RDONLY | O_NONBLOCK);
+  if (notif_fd == -1) {
+    perror("Failed to open notification FIFO");
     close(server_fd);
     unlink(req_pipe_path);
     unlink(notif_pipe_path);
     return 1;
   }
 
-  /* Wait for server response */
-  int notif_fd = open(notif_pipe_path, O_RDONLY);
-  if (notif_fd == -1) {
-    perror("Failed to open notification FIFO");
+  /* Extended handshake: offer our version, features and frame rate cap */
+  connect_ext_req_t req = {.op_code = OP_CONNECT_EXT,
+                           .version = PROTOCOL_VERSION};
+  strncpy(req.req_pipe, req_pipe_path, PIPE_NAME_SIZE);
+  strncpy(req.notif_pipe, notif_pipe_path, PIPE_NAME_SIZE);
+  const char *max_fps = getenv("PACMANIST_MAX_FPS");
+  if (max_fps != NULL && atoi(max_fps) > 0) {
+    req.features |= FEAT_FRAME_RATE_CAP;
+    req.max_fps = (uint16_t)atoi(max_fps);
+  }
+  req.features |= FEAT_LEADERBOARD | FEAT_RESUME;
+  /* Record the server's state hashes, e.g. to compare two runs */
+  FILE *hash_log = NULL;
+  const char *hash_log_path = getenv("PACMANIST_STATE_HASH_LOG");
+  if (hash_log_path != NULL && hash_log_path[0] != '\0') {
+    hash_log = fopen(hash_log_path, "w");
+    if (hash_log != NULL) {
+      setvbuf(hash_log, NULL, _IOLBF, 0); // Keep lines if we are killed
+      req.features |= FEAT_STATE_HASH;
+    }
+  }
+
+  if (write(server_fd, &req, sizeof(connect_ext_req_t)) == -1) {
+    perror("Failed to send connection request");
+    close(notif_fd);
     close(server_fd);
     unlink(req_pipe_path);
     unlink(notif_pipe_path);
     return 1;
   }
 
-  connect_resp_t resp;
-  if (read(notif_fd, &resp, sizeof(connect_resp_t)) != sizeof(connect_resp_t)) {
+  /* Wait for server response */
+  connect_ext_resp_t resp = {0};
+  int answered = wait_response(notif_fd, &resp, sizeof(resp),
+                               CONNECT_EXT_TIMEOUT_MS);
+  /* An answer that came in after the last poll makes the retry needless */
+  if (!answered)
+    answered = wait_response(notif_fd, &resp, sizeof(resp), 0);
+  if (!answered) {
+    /* A server without the extended handshake dropped the request: ask the
+     * way it understands, for a session without features. A late
+     * OP_CONNECT_EXT answer may still come first; the server then ignores
+     * this retry */
+    connect_req_t legacy = {.op_code = OP_CONNECT};
+    memcpy(legacy.req_pipe, req.req_pipe, PIPE_NAME_SIZE);
+    memcpy(legacy.notif_pipe, req.notif_pipe, PIPE_NAME_SIZE);
+    answered =
+        write(server_fd, &legacy, sizeof(legacy)) == (ssize_t)sizeof(legacy) &&
+        wait_response(notif_fd, &resp, 1, -1) &&
+        wait_response(notif_fd, (char *)&resp + 1,
+                      (resp.op_code == OP_CONNECT_EXT ? sizeof(resp)
+                                                      : sizeof(connect_resp_t)) -
+                          1,
+                      -1);
+  }
+  if (!answered) {
     perror("Failed to read connection response");
     close(notif_fd);
     close(server_fd);
@@ -178,6 +336,8 @@ int main(int argc, char *argv[]) {
     unlink(notif_pipe_path);
     return 1;
   }
+  /* Frames are read blocking from here on */
+  fcntl(notif_fd, F_SETFL, fcntl(notif_fd, F_GETFL) & ~O_NONBLOCK);
 
   if (resp.result == -1) {
     fprintf(stderr, "Server rejected connection.\n");
@@ -188,6 +348,9 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  /* A server that dies must not take us with it; we resume on its standby */
+  signal(SIGPIPE, SIG_IGN);
+
   /* Initialize UI and input thread */
   terminal_init();
 
@@ -200,20 +363,65 @@ int main(int argc, char *argv[]) {
   pthread_create(&input_tid, NULL, client_input_thread, c_arg);
 
   /* Game loop - receive and render updates */
+  /* Messages are framed by their op code: OP_UPDATE, then OP_STATE_HASH
+   * if requested and an optional OP_LEADERBOARD when the leaderboard
+   * changed; OP_RESUME_TOKEN once, if the session can be resumed */
+  union {
+    int8_t op_code;
+    game_state_msg_t update;
+    leaderboard_msg_t leaderboard;
+    state_hash_msg_t state;
+    resume_token_msg_t resume;
+  } frame;
   game_state_msg_t msg;
+  uint64_t resume_token = 0;
+  int served = 0; // A worker has opened the notification pipe
+  struct stat fifo_st;
   while (client_running) {
-    ssize_t bytes_read = read(notif_fd, &msg, sizeof(game_state_msg_t));
-    if (bytes_read <= 0) {
+    if (!read_full(notif_fd, &frame.op_code, 1) ||
+        !read_full(notif_fd, (char *)&frame + 1,
+                   message_size(frame.op_code) - 1)) {
+      /* Until a worker takes the session the pipe has no writer and reads
+       * EOF; keep waiting while the server is up */
+      if (client_running && !served && stat(server_fifo, &fifo_st) == 0) {
+        sleep_ms(10);
+        continue;
+      }
+      /* The server is gone: resume on its standby if it gave us a token */
+      if (client_running && resume_token != 0 &&
+          resume_session(server_fifo, req_pipe_path, notif_pipe_path,
+                         notif_fd, resume_token))
+        continue;
       client_running = 0;
       break;
     }
+    served = 1;
+
+    if (frame.op_code == OP_RESUME_TOKEN) {
+      resume_token = frame.resume.token;
+      continue;
+    }
+    if (frame.op_code == OP_LEADERBOARD) {
+      display_set_leaderboard(&frame.leaderboard);
+      continue;
+    }
+    if (frame.op_code == OP_STATE_HASH) {
+      if (hash_log != NULL)
+        fprintf(hash_log, "%u %016llx\n", frame.state.tick,
+                (unsigned long long)frame.state.hash);
+      continue;
+    }
 
+    msg = frame.update;
     if (msg.op_code == OP_UPDATE) {
       board_t temp_board;
       temp_board.width = msg.width;
       temp_board.height = msg.height;
       int size = msg.width * msg.height;
-      temp_board.board = calloc(size, sizeof(board_pos_t));
+      if (size < 0 || size > MAX_BOARD_SIZE)
+        size = 0;
+      memset(frame_cells, 0, (size_t)size * sizeof(board_pos_t));
+      temp_board.board = frame_cells;
 
       for (int i = 0; i < size; i++) {
         char ch = msg.board_data[i];
@@ -238,10 +446,11 @@ int main(int argc, char *argv[]) {
         display_mode = DRAW_WIN;
       else if (msg.game_state == GAME_STATE_GAME_OVER)
         display_mode = DRAW_GAME_OVER;
+      else if (msg.game_state == GAME_STATE_PAUSED)
+        display_mode = DRAW_PAUSED;
 
       draw_board(&temp_board, display_mode);
       refresh_screen();
-      free(temp_board.board);
     }
   }
 
@@ -252,6 +461,8 @@ int main(int argc, char *argv[]) {
 
   close(server_fd);
   close(notif_fd);
+  if (hash_log != NULL)
+    fclose(hash_log);
   unlink(req_pipe_path);
   unlink(notif_pipe_path);
 
@@ -0,0 +1,208 @@
+/**
+ * @file envd.c
+ * @brief pacman_envd - serves a batched environment over shared memory.
+ *
+ * Usage:
+ *   pacman_envd <level_file> <n_envs> <n_threads> <shm_name>
+ *   pacman_envd -b <level_file> <n_envs> <n_threads> <steps>
+ *
+ * The first form creates the segment described by pacman_env_shm_t and
+ * answers RESET/STEP commands from a trainer process until CLOSE or SIGINT.
+ * The second steps random actions locally and prints the throughput.
+ */
+
+#include "../../include/pacman_env.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * @brief SIGINT/SIGTERM handler: asks the serve loop to exit.
+ */
+static void handle_stop(int sig) {
+  (void)sig;
+  stop_requested = 1;
+}
+
+/**
+ * @brief Rounds a segment offset up to 64 bytes (one cache line).
+ */
+static uint64_t align64(uint64_t offset) { return (offset + 63) & ~63ULL; }
+
+/**
+ * @brief Steps random actions and prints environment steps per second.
+ * @param env Environment.
+ * @param steps Batched steps to run.
+ * @return int Exit status.
+ */
+static int bench(pacman_env_t *env, long steps) {
+  int n = pacman_env_count(env);
+  size_t obs_size = (size_t)pacman_env_obs_size(env);
+  uint8_t *actions = malloc((size_t)n);
+  uint8_t *obs = malloc((size_t)n * obs_size);
+  float *rewards = malloc((size_t)n * sizeof(float));
+  uint8_t *dones = malloc((size_t)n);
+  if (!actions || !obs || !rewards || !dones) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  unsigned int seed = 1;
+  pacman_env_reset(env, NULL, obs);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned long episodes = 0;
+  for (long s = 0; s < steps; s++) {
+    for (int i = 0; i < n; i++)
+      actions[i] = (uint8_t)(rand_r(&seed) % PACMAN_ACTIONS);
+    pacman_env_step(env, actions, obs, rewards, dones);
+    for (int i = 0; i < n; i++)
+      episodes += dones[i] != PACMAN_DONE_RUNNING;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double secs = (double)(end.tv_sec - start.tv_sec) +
+                (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  double total = (double)steps * (double)n;
+  printf("%.0f env steps in %.3f s: %.0f steps/s, %lu episodes\n", total,
+         secs, secs > 0 ? total / secs : 0.0, episodes);
+
+  free(actions);
+  free(obs);
+  free(rewards);
+  free(dones);
+  return 0;
+}
+
+/**
+ * @brief Creates the shared segment and answers trainer commands.
+ * @param env Environment.
+ * @param name Shared memory name.
+ * @return int Exit status.
+ */
+static int serve(pacman_env_t *env, const char *name) {
+  uint32_t n = (uint32_t)pacman_env_count(env);
+  uint32_t obs_size = (uint32_t)pacman_env_obs_size(env);
+
+  uint64_t off = align64(sizeof(pacman_env_shm_t));
+  uint64_t seeds_off = off;
+  off = align64(off + n * sizeof(unsigned int));
+  uint64_t actions_off = off;
+  off = align64(off + n);
+  uint64_t obs_off = off;
+  off = align64(off + (uint64_t)n * obs_size);
+  uint64_t rewards_off = off;
+  off = align64(off + n * sizeof(float));
+  uint64_t dones_off = off;
+  uint64_t total = align64(off + n);
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1) {
+    perror("shm_open");
+    return 1;
+  }
+  if (ftruncate(fd, (off_t)total) == -1) {
+    perror("ftruncate");
+    close(fd);
+    shm_unlink(name);
+    return 1;
+  }
+  char *base = mmap(NULL, (size_t)total, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    shm_unlink(name);
+    return 1;
+  }
+
+  pacman_env_shm_t *shm = (pacman_env_shm_t *)base;
+  shm->n_envs = n;
+  shm->width = (uint32_t)pacman_env_width(env);
+  shm->height = (uint32_t)pacman_env_height(env);
+  shm->obs_size = obs_size;
+  shm->seeds_off = seeds_off;
+  shm->actions_off = actions_off;
+  shm->obs_off = obs_off;
+  shm->rewards_off = rewards_off;
+  shm->dones_off = dones_off;
+  shm->total_size = total;
+  sem_init(&shm->request, 1, 0);
+  sem_init(&shm->response, 1, 0);
+
+  unsigned int *seeds = (unsigned int *)(base + seeds_off);
+  uint8_t *actions = (uint8_t *)(base + actions_off);
+  uint8_t *obs = (uint8_t *)(base + obs_off);
+  float *rewards = (float *)(base + rewards_off);
+  uint8_t *dones = (uint8_t *)(base + dones_off);
+
+  pacman_env_reset(env, NULL, obs);
+  __atomic_store_n(&shm->magic, PACMAN_ENV_SHM_MAGIC, __ATOMIC_RELEASE);
+  printf("Serving %u environments (%ux%u) on %s\n", n, shm->width, shm->height,
+         name);
+  fflush(stdout);
+
+  while (!stop_requested) {
+    if (sem_wait(&shm->request) != 0)
+      continue; // Interrupted: re-check stop_requested
+
+    int command = shm->command;
+    if (command == PACMAN_ENV_CMD_CLOSE)
+      break;
+    if (command == PACMAN_ENV_CMD_RESET)
+      pacman_env_reset(env, seeds, obs);
+    else if (command == PACMAN_ENV_CMD_STEP)
+      pacman_env_step(env, actions, obs, rewards, dones);
+    sem_post(&shm->response);
+  }
+
+  sem_destroy(&shm->request);
+  sem_destroy(&shm->response);
+  munmap(base, (size_t)total);
+  shm_unlink(name);
+  return 0;
+}
+
+/**
+ * @brief Main entry point of pacman_envd.
+ */
+int main(int argc, char *argv[]) {
+  int bench_mode = argc == 6 && strcmp(argv[1], "-b") == 0;
+  if (argc != 5 && !bench_mode) {
+    fprintf(stderr,
+            "Usage: %s <level_file> <n_envs> <n_threads> <shm_name>\n"
+            "       %s -b <level_file> <n_envs> <n_threads> <steps>\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+  char **args = argv + (bench_mode ? 2 : 1);
+
+  pacman_env_t *env = pacman_env_create(args[0], atoi(args[1]), atoi(args[2]));
+  if (env == NULL) {
+    fprintf(stderr, "Failed to load level %s\n", args[0]);
+    return 1;
+  }
+
+  int status;
+  if (bench_mode) {
+    status = bench(env, atol(args[3]));
+  } else {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    status = serve(env, args[3]);
+  }
+  pacman_env_destroy(env);
+  return status;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file pacman_env.c
+ * @brief Batched environment stepping many boards without entity threads.
+ *
+ * The level is parsed once into a template board. Every environment is a
+ * board_t whose cells, Pacman and ghosts live in three shared arenas, so a
+ * reset is three memcpy()s and no allocation. Work is split into contiguous
+ * ranges of environments, one per worker; the calling thread takes the first
+ * range and waits for the others.
+ */
+
+#include "../../include/pacman_env.h"
+#include "../../include/board.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** @brief Job kinds handed to the workers */
+#define JOB_RESET 1
+#define JOB_STEP 2
+#define JOB_STOP 3
+
+struct pacman_env {
+  board_t template;      /**< Level as loaded from disk */
+  int n_envs;            /**< Number of environments */
+  int cells;             /**< width * height */
+  int max_steps;         /**< Episode step limit */
+  board_t *boards;       /**< n_envs boards */
+  board_pos_t *cell_arena; /**< n_envs * cells cells */
+  pacman_t *pacman_arena;  /**< n_envs pacmans */
+  ghost_t *ghost_arena;    /**< n_envs * n_ghosts ghosts */
+  int *steps;              /**< Steps taken in the current episode */
+  int *last_points;        /**< Points at the previous step */
+
+  /* Worker pool */
+  int n_threads;
+  pthread_t *workers;
+  pthread_mutex_t mutex;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation; /**< Bumped for every job */
+  int pending;              /**< Workers still busy with the job */
+  int job;                  /**< JOB_* */
+  const unsigned int *seeds;
+  const uint8_t *actions;
+  uint8_t *obs;
+  float *rewards;
+  uint8_t *dones;
+};
+
+/**
+ * @brief Arguments of a worker thread.
+ */
+typedef struct {
+  pacman_env_t *env;
+  int index; /**< Range index, 1..n_threads-1 */
+} worker_arg_t;
+
+static const char action_commands[PACMAN_ACTIONS] = {' ', 'W', 'A', 'S', 'D'};
+
+/**
+ * @brief Restores one environment to the start of the level.
+ * @param env Environment set.
+ * @param i Index of the environment.
+ * @param seed Seed of its random ghost moves.
+ */
+static void reset_one(pacman_env_t *env, int i, unsigned int seed) {
+  board_t *b = &env->boards[i];
+  memcpy(b->board, env->template.board,
+         (size_t)env->cells * sizeof(board_pos_t));
+  memcpy(b->pacmans, env->template.pacmans, sizeof(pacman_t));
+  memcpy(b->ghosts, env->template.ghosts,
+         (size_t)env->template.n_ghosts * sizeof(ghost_t));
+  b->level_finished = 0;
+  b->hash = env->template.hash;
+  b->rng_seed = seed;
+  env->steps[i] = 0;
+  env->last_points[i] = b->pacmans[0].points;
+}
+
+/**
+ * @brief Writes the observation of one board.
+ * @param env Environment set.
+ * @param b Board to encode.
+ * @param out Destination, env->cells bytes.
+ */
+static void encode(const pacman_env_t *env, const board_t *b, uint8_t *out) {
+  for (int c = 0; c < env->cells; c++) {
+    const board_pos_t *cell = &b->board[c];
+    uint8_t code = PACMAN_OBS_EMPTY;
+    if (cell->content == 'C')
+      code = PACMAN_OBS_PACMAN;
+    else if (cell->content == 'M')
+      code = PACMAN_OBS_GHOST;
+    else if (cell->content == 'X' || cell->content == 'W')
+      code = PACMAN_OBS_WALL;
+    else if (cell->has_portal)
+      code = PACMAN_OBS_PORTAL;
+    else if (cell->has_dot)
+      code = PACMAN_OBS_DOT;
+    out[c] = code;
+  }
+}
+
+/**
+ * @brief Advances one environment by a tick, restarting it when it ends.
+ * @param env Environment set.
+ * @param i Index of the environment.
+ * @param action PACMAN_ACT_* for Pacman.
+ * @param reward Output, points gained.
+ * @return PACMAN_DONE_* code.
+ */
+static int step_one(pacman_env_t *env, int i, uint8_t action, float *reward) {
+  board_t *b = &env->boards[i];
+  pacman_t *pac = &b->pacmans[0];
+
+  command_t c = {' ', 1, 1};
+  if (action < PACMAN_ACTIONS)
+    c.command = action_commands[action];
+  int result = move_pacman(b, 0, &c);
+
+  for (int g = 0; g < b->n_ghosts && result != DEAD_PACMAN &&
+                  result != REACHED_PORTAL;
+       g++) {
+    ghost_t *ghost = &b->ghosts[g];
+    if (ghost->n_moves > 0) {
+      result =
+          move_ghost(b, g, &ghost->moves[ghost->current_move % ghost->n_moves]);
+    } else {
+      command_t random_move = {'R', 1, 1};
+      result = move_ghost(b, g, &random_move);
+    }
+  }
+
+  *reward = (float)(pac->points - env->last_points[i]);
+  env->last_points[i] = pac->points;
+
+  int done = PACMAN_DONE_RUNNING;
+  if (!pac->alive)
+    done = PACMAN_DONE_DIED;
+  else if (b->level_finished)
+    done = PACMAN_DONE_PORTAL;
+  else if (++env->steps[i] >= env->max_steps)
+    done = PACMAN_DONE_TRUNCATED;
+
+  if (done != PACMAN_DONE_RUNNING)
+    reset_one(env, i, (unsigned int)rand_r(&b->rng_seed));
+  return done;
+}
+
+/**
+ * @brief Runs the current job on one range of environments.
+ * @param env Environment set.
+ * @param index Range index, 0..n_threads-1.
+ */
+static void run_range(pacman_env_t *env, int index) {
+  int begin = (int)((long)env->n_envs * index / env->n_threads);
+  int end = (int)((long)env->n_envs * (index + 1) / env->n_threads);
+
+  for (int i = begin; i < end; i++) {
+    if (env->job == JOB_RESET) {
+      reset_one(env, i, env->seeds ? env->seeds[i] : (unsigned int)i + 1);
+    } else {
+      env->dones[i] = (uint8_t)step_one(env, i, env->actions[i],
+                                        &env->rewards[i]);
+    }
+    encode(env, &env->boards[i], env->obs + (size_t)i * (size_t)env->cells);
+  }
+}
+
+/**
+ * @brief Worker loop: waits for a new job generation and runs its range.
+ * @param arg worker_arg_t, freed by the worker.
+ * @return void* Always NULL.
+ */
+static void *env_worker(void *arg) {
+  worker_arg_t *w = (worker_arg_t *)arg;
+  pacman_env_t *env = w->env;
+  int index = w->index;
+  free(w);
+
+  unsigned long seen = 0;
+  while (1) {
+    pthread_mutex_lock(&env->mutex);
+    while (env->generation == seen)
+      pthread_cond_wait(&env->start, &env->mutex);
+    seen = env->generation;
+    int job = env->job;
+    pthread_mutex_unlock(&env->mutex);
+
+    if (job == JOB_STOP)
+      break;
+    run_range(env, index);
+
+    pthread_mutex_lock(&env->mutex);
+    if (--env->pending == 0)
+      pthread_cond_signal(&env->done);
+    pthread_mutex_unlock(&env->mutex);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Hands a job to the workers, runs range 0 and waits for the rest.
+ * @param env Environment set (job fields already filled).
+ * @param job JOB_*.
+ */
+static void dispatch(pacman_env_t *env, int job) {
+  pthread_mutex_lock(&env->mutex);
+  env->job = job;
+  env->pending = env->n_threads - 1;
+  env->generation++;
+  pthread_cond_broadcast(&env->start);
+  pthread_mutex_unlock(&env->mutex);
+
+  if (job == JOB_STOP)
+    return;
+  run_range(env, 0);
+
+  pthread_mutex_lock(&env->mutex);
+  while (env->pending > 0)
+    pthread_cond_wait(&env->done, &env->mutex);
+  pthread_mutex_unlock(&env->mutex);
+}
+
+pacman_env_t *pacman_env_create(const char *level_file, int n_envs,
+                                int n_threads) {
+  if (n_envs <= 0)
+    return NULL;
+  pacman_env_t *env = calloc(1, sizeof(pacman_env_t));
+  if (env == NULL)
+    return NULL;
+  if (load_level(&env->template, level_file, 0) != 0) {
+    free(env);
+    return NULL;
+  }
+  env->template.pacmans[0].n_moves = 0; // Actions drive Pacman
+  env->template.pacmans[0].next_user_move = ' ';
+  env->template.hash = board_hash(&env->template);
+
+  int n_ghosts = env->template.n_ghosts;
+  env->n_envs = n_envs;
+  env->cells = env->template.width * env->template.height;
+  env->max_steps = PACMAN_ENV_MAX_STEPS;
+  env->boards = calloc((size_t)n_envs, sizeof(board_t));
+  env->cell_arena =
+      calloc((size_t)n_envs * (size_t)env->cells, sizeof(board_pos_t));
+  env->pacman_arena = calloc((size_t)n_envs, sizeof(pacman_t));
+  env->ghost_arena =
+      calloc((size_t)n_envs * (size_t)(n_ghosts > 0 ? n_ghosts : 1),
+             sizeof(ghost_t));
+  env->steps = calloc((size_t)n_envs, sizeof(int));
+  env->last_points = calloc((size_t)n_envs, sizeof(int));
+  if (!env->boards || !env->cell_arena || !env->pacman_arena ||
+      !env->ghost_arena || !env->steps || !env->last_points) {
+    unload_level(&env->template);
+    free(env->boards);
+    free(env->cell_arena);
+    free(env->pacman_arena);
+    free(env->ghost_arena);
+    free(env->steps);
+    free(env->last_points);
+    free(env);
+    return NULL;
+  }
+
+  for (int i = 0; i < n_envs; i++) {
+    board_t *b = &env->boards[i];
+    b->width = env->template.width;
+    b->height = env->template.height;
+    b->tempo = env->template.tempo;
+    b->n_pacmans = 1;
+    b->n_ghosts = n_ghosts;
+    b->board = env->cell_arena + (size_t)i * (size_t)env->cells;
+    b->pacmans = env->pacman_arena + i;
+    b->ghosts = env->ghost_arena + (size_t)i * (size_t)n_ghosts;
+    b->ghost_paths = env->template.ghost_paths; // Read only, shared
+    b->n_ghost_paths = env->template.n_ghost_paths;
+    pthread_rwlock_init(&b->state_lock, NULL);
+    b->lock_initialized = 1;
+    reset_one(env, i, (unsigned int)i + 1);
+  }
+
+  if (n_threads <= 0)
+    n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_threads > n_envs)
+    n_threads = n_envs;
+  if (n_threads < 1)
+    n_threads = 1;
+  env->n_threads = n_threads;
+  pthread_mutex_init(&env->mutex, NULL);
+  pthread_cond_init(&env->start, NULL);
+  pthread_cond_init(&env->done, NULL);
+  env->workers = calloc((size_t)n_threads, sizeof(pthread_t));
+  for (int t = 1; t < n_threads; t++) {
+    worker_arg_t *w = malloc(sizeof(worker_arg_t));
+    w->env = env;
+    w->index = t;
+    pthread_create(&env->workers[t], NULL, env_worker, w);
+  }
+  return env;
+}
+
+void pacman_env_destroy(pacman_env_t *env) {
+  if (env == NULL)
+    return;
+  dispatch(env, JOB_STOP);
+  for (int t = 1; t < env->n_threads; t++)
+    pthread_join(env->workers[t], NULL);
+  free(env->workers);
+  pthread_mutex_destroy(&env->mutex);
+  pthread_cond_destroy(&env->start);
+  pthread_cond_destroy(&env->done);
+
+  for (int i = 0; i < env->n_envs; i++)
+    pthread_rwlock_destroy(&env->boards[i].state_lock);
+  free(env->boards);
+  free(env->cell_arena);
+  free(env->pacman_arena);
+  free(env->ghost_arena);
+  free(env->steps);
+  free(env->last_points);
+  unload_level(&env->template);
+  free(env);
+}
+
+int pacman_env_count(const pacman_env_t *env) { return env->n_envs; }
+
+int pacman_env_width(const pacman_env_t *env) { return env->template.width; }
+
+int pacman_env_height(const pacman_env_t *env) {
+  return env->template.height;
+}
+
+int pacman_env_obs_size(const pacman_env_t *env) { return env->cells; }
+
+uint64_t pacman_env_state_hash(const pacman_env_t *env, int i) {
+  return env->boards[i].hash;
+}
+
+void pacman_env_set_max_steps(pacman_env_t *env, int max_steps) {
+  env->max_steps = max_steps > 0 ? max_steps : PACMAN_ENV_MAX_STEPS;
+}
+
+void pacman_env_reset(pacman_env_t *env, const unsigned int *seeds,
+                      uint8_t *obs) {
+  env->seeds = seeds;
+  env->obs = obs;
+  dispatch(env, JOB_RESET);
+}
+
+void pacman_env_step(pacman_env_t *env, const uint8_t *actions, uint8_t *obs,
+                     float *rewards, uint8_t *dones) {
+  env->actions = actions;
+  env->obs = obs;
+  env->rewards = rewards;
+  env->dones = dones;
+  dispatch(env, JOB_STEP);
+}
+
+pacman_env_shm_t *pacman_env_shm_attach(const char *name) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd == -1)
+    return NULL;
+  pacman_env_shm_t *head = mmap(NULL, sizeof(pacman_env_shm_t),
+                                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (head == MAP_FAILED || head->magic != PACMAN_ENV_SHM_MAGIC) {
+    if (head != MAP_FAILED)
+      munmap(head, sizeof(pacman_env_shm_t));
+    close(fd);
+    return NULL;
+  }
+  size_t total = (size_t)head->total_size;
+  munmap(head, sizeof(pacman_env_shm_t));
+
+  pacman_env_shm_t *shm =
+      mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return shm == MAP_FAILED ? NULL : shm;
+}
+
+int pacman_env_shm_call(pacman_env_shm_t *shm, int command) {
+  shm->command = command;
+  if (sem_post(&shm->request) != 0)
+    return -1;
+  if (command == PACMAN_ENV_CMD_CLOSE)
+    return 0;
+  while (sem_wait(&shm->response) != 0) {
+    if (errno != EINTR)
+      return -1;
+  }
+  return 0;
+}
+
+void pacman_env_shm_detach(pacman_env_shm_t *shm) {
+  munmap(shm, (size_t)shm->total_size);
+}
@@ -0,0 +1,232 @@
+/**
+ * @file feature_planes.c
+ * @brief Frame to feature-plane encoders: SSE2 and per-cell reference.
+ *
+ * The SSE2 path compares 16 cells at a time against each plane's character
+ * and stores the masks either as 0/1 bytes or, through movemask, as 16 bits.
+ * Cells left over at the end of a frame go through the scalar code. The
+ * distance plane adds a per-column |x - px| row to |y - py| with saturating
+ * byte adds.
+ */
+
+#include "../include/feature_planes.h"
+#include "../include/protocol.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** @brief Character of each plane in a frame */
+static const char plane_chars[FEATURE_PLANES] = {'#', '.', '@', 'C', 'M'};
+
+/**
+ * @brief Bytes of one plane.
+ */
+static size_t plane_size(int cells, int flags) {
+  return (flags & FEATURES_BITS) ? (size_t)(cells + 7) / 8 : (size_t)cells;
+}
+
+size_t features_size(int cells, int flags) {
+  size_t size = FEATURE_PLANES * plane_size(cells, flags);
+  if (flags & FEATURES_DISTANCE)
+    size += (size_t)cells;
+  return size;
+}
+
+void features_frame_from_board(const board_t *board, char *board_data) {
+  int size = board->width * board->height;
+  for (int i = 0; i < size; i++) {
+    char visual = board->board[i].content;
+    if (visual == 'X' || visual == 'W') {
+      visual = '#';
+    } else if (visual == ' ' || visual == '\0') {
+      if (board->board[i].has_portal)
+        visual = '@';
+      else if (board->board[i].has_dot)
+        visual = '.';
+      else
+        visual = ' ';
+    }
+    board_data[i] = visual;
+  }
+}
+
+/**
+ * @brief Sets one cell of one plane.
+ */
+static void set_cell(uint8_t *plane, int cell, int flags) {
+  if (flags & FEATURES_BITS)
+    plane[cell >> 3] |= (uint8_t)(1u << (cell & 7));
+  else
+    plane[cell] = 1;
+}
+
+/**
+ * @brief Fills the distance plane once the pacman cell is known.
+ * @param width Board width.
+ * @param height Board height.
+ * @param pacman Pacman cell index, -1 if there is none.
+ * @param out Distance plane, width * height bytes.
+ */
+static void distance_scalar(int width, int height, int pacman, uint8_t *out) {
+  if (pacman < 0) {
+    memset(out, 255, (size_t)width * (size_t)height);
+    return;
+  }
+  int px = pacman % width, py = pacman / width;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int d = (x > px ? x - px : px - x) + (y > py ? y - py : py - y);
+      out[y * width + x] = (uint8_t)(d > 255 ? 255 : d);
+    }
+  }
+}
+
+void features_encode_scalar(const char *board_data, int width, int height,
+                            int flags, uint8_t *out) {
+  int cells = width * height;
+  size_t psize = plane_size(cells, flags);
+  memset(out, 0, FEATURE_PLANES * psize);
+
+  int pacman = -1;
+  for (int i = 0; i < cells; i++) {
+    switch (board_data[i]) {
+    case '#':
+      set_cell(out + FEATURE_WALL * psize, i, flags);
+      break;
+    case '.':
+      set_cell(out + FEATURE_DOT * psize, i, flags);
+      break;
+    case '@':
+      set_cell(out + FEATURE_PORTAL * psize, i, flags);
+      break;
+    case 'C':
+      set_cell(out + FEATURE_PACMAN * psize, i, flags);
+      if (pacman < 0)
+        pacman = i;
+      break;
+    case 'M':
+      set_cell(out + FEATURE_GHOST * psize, i, flags);
+      break;
+    default:
+      break;
+    }
+  }
+  if (flags & FEATURES_DISTANCE)
+    distance_scalar(width, height, pacman, out + FEATURE_PLANES * psize);
+}
+
+#ifdef __SSE2__
+
+/**
+ * @brief Fills the distance plane with saturating byte adds.
+ */
+static void distance_sse2(int width, int height, int pacman, uint8_t *out) {
+  if (pacman < 0) {
+    memset(out, 255, (size_t)width * (size_t)height);
+    return;
+  }
+  int px = pacman % width, py = pacman / width;
+  uint8_t dx[MAX_BOARD_SIZE];
+  for (int x = 0; x < width; x++) {
+    int d = x > px ? x - px : px - x;
+    dx[x] = (uint8_t)(d > 255 ? 255 : d);
+  }
+
+  for (int y = 0; y < height; y++) {
+    int d = y > py ? y - py : py - y;
+    uint8_t dy = (uint8_t)(d > 255 ? 255 : d);
+    __m128i vdy = _mm_set1_epi8((char)dy);
+    uint8_t *row = out + y * width;
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(dx + x));
+      _mm_storeu_si128((__m128i *)(row + x), _mm_adds_epu8(v, vdy));
+    }
+    for (; x < width; x++) {
+      int sum = dx[x] + dy;
+      row[x] = (uint8_t)(sum > 255 ? 255 : sum);
+    }
+  }
+}
+
+void features_encode(const char *board_data, int width, int height, int flags,
+                     uint8_t *out) {
+  int cells = width * height;
+  if (cells > MAX_BOARD_SIZE) {
+    features_encode_scalar(board_data, width, height, flags, out);
+    return;
+  }
+  size_t psize = plane_size(cells, flags);
+  int bits = flags & FEATURES_BITS;
+  if (bits)
+    memset(out, 0, FEATURE_PLANES * psize);
+
+  __m128i keys[FEATURE_PLANES];
+  for (int p = 0; p < FEATURE_PLANES; p++)
+    keys[p] = _mm_set1_epi8(plane_chars[p]);
+  const __m128i one = _mm_set1_epi8(1);
+
+  int pacman = -1;
+  int i = 0;
+  for (; i + 16 <= cells; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(board_data + i));
+    for (int p = 0; p < FEATURE_PLANES; p++) {
+      __m128i eq = _mm_cmpeq_epi8(v, keys[p]);
+      uint8_t *plane = out + (size_t)p * psize;
+      if (bits) {
+        // i is a multiple of 16, so the 16 bits land on two whole bytes
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+        plane[i >> 3] = (uint8_t)mask;
+        plane[(i >> 3) + 1] = (uint8_t)(mask >> 8);
+        if (p == FEATURE_PACMAN && mask && pacman < 0)
+          pacman = i + __builtin_ctz(mask);
+      } else {
+        _mm_storeu_si128((__m128i *)(plane + i), _mm_and_si128(eq, one));
+        if (p == FEATURE_PACMAN && pacman < 0) {
+          unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+          if (mask)
+            pacman = i + __builtin_ctz(mask);
+        }
+      }
+    }
+  }
+
+  // Tail: fewer than 16 cells left
+  if (!bits) {
+    for (int p = 0; p < FEATURE_PLANES; p++)
+      memset(out + (size_t)p * psize + i, 0, (size_t)(cells - i));
+  }
+  for (; i < cells; i++) {
+    for (int p = 0; p < FEATURE_PLANES; p++) {
+      if (board_data[i] == plane_chars[p]) {
+        set_cell(out + (size_t)p * psize, i, flags);
+        if (p == FEATURE_PACMAN && pacman < 0)
+          pacman = i;
+      }
+    }
+  }
+
+  if (flags & FEATURES_DISTANCE)
+    distance_sse2(width, height, pacman, out + FEATURE_PLANES * psize);
+}
+
+#else
+
+void features_encode(const char *board_data, int width, int height, int flags,
+                     uint8_t *out) {
+  features_encode_scalar(board_data, width, height, flags, out);
+}
+
+#endif
+
+void features_encode_batch(const char *frames, int n, int width, int height,
+                           int flags, uint8_t *out) {
+  int cells = width * height;
+  size_t size = features_size(cells, flags);
+  for (int f = 0; f < n; f++) {
+    features_encode(frames + (size_t)f * (size_t)cells, width, height, flags,
+                    out + (size_t)f * size);
+  }
+}
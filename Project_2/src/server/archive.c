@@ -0,0 +1,452 @@
+/**
+ * @file archive.c
+ * @brief Hourly columnar event archive and per-level aggregates.
+ *
+ * Fed by the analytics thread only. Events are buffered column by column
+ * and written as a compressed row group (see archive_format.h) when the
+ * group is full, the hour changes or it has waited ARCHIVE_FLUSH_MS. Each
+ * level keeps running totals and death and dot heatmaps; they are loaded
+ * at startup and rewritten when they changed, so they cover every run
+ * without rescanning the archive.
+ */
+
+#include "../../include/archive.h"
+#include "../../include/archive_format.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Longest wait before buffered events and aggregates hit the disk */
+#define ARCHIVE_FLUSH_MS 5000
+/** @brief Longest archive_stop() waits for a game thread to release the
+ * level registry, in milliseconds */
+#define ARCHIVE_STOP_MS 500
+/** @brief Sessions tracked at once for time to portal */
+#define ARCHIVE_TRACKED 1024
+/** @brief Largest heatmap accepted from an .agg file */
+#define ARCHIVE_MAX_CELLS (1 << 20)
+
+/**
+ * @brief Aggregates of one level.
+ */
+typedef struct {
+  archive_level_header_t h; /**< Totals, as written to the .agg file */
+  uint32_t *death_heat;     /**< Deaths per cell */
+  uint32_t *dot_heat;       /**< Dots eaten per cell */
+  int dirty;                /**< Changed since last written */
+} level_stats_t;
+
+static char archive_dir[512];
+static int archive_enabled = 0;
+
+/* Level registry; id 0 stands for levels that could not be registered */
+static level_stats_t *levels[ARCHIVE_MAX_LEVELS];
+static int n_levels = 1;
+static pthread_mutex_t archive_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Row group being filled, owned by the analytics thread */
+static int32_t (*group)[ARCHIVE_GROUP_ROWS] = NULL;
+static uint32_t group_rows = 0;
+static long long group_started_ms = 0;
+static uint8_t *encoded = NULL;
+static int file_fd = -1;
+static long long file_hour = -1;
+static char file_name[64];
+static long long wall_offset_ms; /* Wall clock minus monotonic clock */
+static long long last_save_ms = 0;
+
+static struct {
+  int client_id;
+  uint64_t start_ns;
+} level_starts[ARCHIVE_TRACKED];
+
+static unsigned long long rows_written;
+static unsigned long long groups_written;
+static unsigned long long bytes_written;
+static unsigned long write_errors;
+
+/**
+ * @brief Reads a clock in milliseconds.
+ */
+static long long clock_ms(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * @brief Writes a whole buffer, counting failures.
+ */
+static int write_all(int fd, const void *buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(fd, (const char *)buf + done, size - done);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      write_errors++;
+      return -1;
+    }
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Allocates the aggregates of a level.
+ */
+static level_stats_t *level_new(const char *name, uint32_t width,
+                                uint32_t height) {
+  size_t cells = (size_t)width * height;
+  level_stats_t *level = calloc(1, sizeof(level_stats_t));
+  if (level == NULL)
+    return NULL;
+  level->death_heat = calloc(cells ? cells : 1, sizeof(uint32_t));
+  level->dot_heat = calloc(cells ? cells : 1, sizeof(uint32_t));
+  if (level->death_heat == NULL || level->dot_heat == NULL) {
+    free(level->death_heat);
+    free(level->dot_heat);
+    free(level);
+    return NULL;
+  }
+  level->h.magic = ARCHIVE_LEVEL_MAGIC;
+  level->h.width = width;
+  level->h.height = height;
+  strncpy(level->h.name, name, sizeof(level->h.name) - 1);
+  return level;
+}
+
+/**
+ * @brief Rewrites level_<id>.agg through a temporary file.
+ */
+static void save_level(int id) {
+  level_stats_t *level = levels[id];
+  size_t cells = (size_t)level->h.width * level->h.height;
+  char path[600], tmp[610];
+  snprintf(path, sizeof(path), "%s/level_%d.agg", archive_dir, id);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    write_errors++;
+    return;
+  }
+  int failed = write_all(fd, &level->h, sizeof(level->h)) ||
+               write_all(fd, level->death_heat, cells * sizeof(uint32_t)) ||
+               write_all(fd, level->dot_heat, cells * sizeof(uint32_t));
+  close(fd);
+  if (failed || rename(tmp, path) != 0) {
+    unlink(tmp);
+    return;
+  }
+  level->dirty = 0;
+}
+
+/**
+ * @brief Loads level_<id>.agg files left by previous runs.
+ */
+static void load_levels(void) {
+  DIR *d = opendir(archive_dir);
+  if (d == NULL)
+    return;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    int id;
+    char rest;
+    if (sscanf(entry->d_name, "level_%d.ag%c", &id, &rest) != 2 ||
+        rest != 'g' || id <= 0 || id >= ARCHIVE_MAX_LEVELS ||
+        levels[id] != NULL)
+      continue;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", archive_dir, entry->d_name);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+      continue;
+    archive_level_header_t h;
+    if (read(fd, &h, sizeof(h)) != (ssize_t)sizeof(h) ||
+        h.magic != ARCHIVE_LEVEL_MAGIC ||
+        (size_t)h.width * h.height > ARCHIVE_MAX_CELLS) {
+      close(fd);
+      continue;
+    }
+    h.name[sizeof(h.name) - 1] = '\0';
+    level_stats_t *level = level_new(h.name, h.width, h.height);
+    size_t bytes = (size_t)h.width * h.height * sizeof(uint32_t);
+    if (level != NULL &&
+        read(fd, level->death_heat, bytes) == (ssize_t)bytes &&
+        read(fd, level->dot_heat, bytes) == (ssize_t)bytes) {
+      level->h = h;
+      levels[id] = level;
+      if (id >= n_levels)
+        n_levels = id + 1;
+    } else if (level != NULL) {
+      free(level->death_heat);
+      free(level->dot_heat);
+      free(level);
+    }
+    close(fd);
+  }
+  closedir(d);
+}
+
+/**
+ * @brief Encodes and appends the buffered row group to the hour's file.
+ */
+static void flush_group(void) {
+  if (group_rows == 0 || file_fd == -1)
+    return;
+  archive_group_header_t header = {.magic = ARCHIVE_GROUP_MAGIC,
+                                   .rows = group_rows};
+  uint8_t *cursor = encoded;
+  for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+    size_t n = archive_encode_column(group[c], group_rows, cursor);
+    header.column_bytes[c] = (uint32_t)n;
+    cursor += n;
+  }
+  size_t data = (size_t)(cursor - encoded);
+  if (write_all(file_fd, &header, sizeof(header)) == 0 &&
+      write_all(file_fd, encoded, data) == 0) {
+    rows_written += group_rows;
+    groups_written++;
+    bytes_written += sizeof(header) + data;
+  }
+  group_rows = 0;
+}
+
+/**
+ * @brief Switches to the file of the given hour, creating it if needed.
+ */
+static void open_hour(long long hour) {
+  flush_group();
+  if (file_fd != -1)
+    close(file_fd);
+  file_hour = hour;
+
+  time_t start = (time_t)(hour * 3600);
+  struct tm tm;
+  gmtime_r(&start, &tm);
+  strftime(file_name, sizeof(file_name), "events_%Y%m%d_%H.pca", &tm);
+  char path[600];
+  snprintf(path, sizeof(path), "%s/%s", archive_dir, file_name);
+
+  file_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (file_fd == -1) {
+    write_errors++;
+    return;
+  }
+  struct stat st;
+  if (fstat(file_fd, &st) == 0 && st.st_size == 0) {
+    archive_file_header_t header = {.magic = ARCHIVE_FILE_MAGIC,
+                                    .columns = ARCHIVE_COLUMNS,
+                                    .hour_start = (uint64_t)start};
+    write_all(file_fd, &header, sizeof(header));
+    bytes_written += sizeof(header);
+  }
+}
+
+int archive_start(void) {
+  const char *dir = getenv("PACMANIST_ARCHIVE_DIR");
+  if (dir == NULL || dir[0] == '\0')
+    dir = "archive";
+  if (strcmp(dir, "0") == 0)
+    return 0;
+
+  strncpy(archive_dir, dir, sizeof(archive_dir) - 1);
+  if (mkdir(archive_dir, 0755) == -1 && errno != EEXIST)
+    return -1;
+  group = malloc(ARCHIVE_COLUMNS * sizeof(*group));
+  encoded = malloc(ARCHIVE_COLUMNS * archive_column_bound(ARCHIVE_GROUP_ROWS));
+  if (group == NULL || encoded == NULL)
+    return -1;
+  wall_offset_ms = clock_ms(CLOCK_REALTIME) - clock_ms(CLOCK_MONOTONIC);
+  load_levels();
+  archive_enabled = 1;
+  return 0;
+}
+
+int archive_level_id(const char *level_name, int width, int height) {
+  const char *slash = strrchr(level_name, '/');
+  const char *name = slash ? slash + 1 : level_name;
+
+  pthread_mutex_lock(&archive_mutex);
+  int id = 0;
+  for (int i = 1; i < n_levels && id == 0; i++) {
+    if (levels[i] != NULL && levels[i]->h.width == (uint32_t)width &&
+        levels[i]->h.height == (uint32_t)height &&
+        strcmp(levels[i]->h.name, name) == 0)
+      id = i;
+  }
+  if (id == 0 && n_levels < ARCHIVE_MAX_LEVELS) {
+    level_stats_t *level =
+        level_new(name, (uint32_t)width, (uint32_t)height);
+    if (level != NULL) {
+      level->dirty = 1;
+      id = n_levels++;
+      levels[id] = level;
+    }
+  }
+  pthread_mutex_unlock(&archive_mutex);
+  return id;
+}
+
+/**
+ * @brief Adds one to a heatmap cell if the event has a cell on the board.
+ */
+static void heat(const level_stats_t *level, uint32_t *map,
+                 const game_event_t *event) {
+  if (event->x >= 0 && event->y >= 0 && (uint32_t)event->x < level->h.width &&
+      (uint32_t)event->y < level->h.height)
+    map[(uint32_t)event->y * level->h.width + (uint32_t)event->x]++;
+}
+
+void archive_record(const game_event_t *event) {
+  if (archive_enabled) {
+    long long wall_ms = (long long)(event->time_ns / 1000000ULL) +
+                        wall_offset_ms;
+    long long hour = wall_ms / 3600000LL;
+    if (hour != file_hour)
+      open_hour(hour);
+    if (group_rows == 0)
+      group_started_ms = clock_ms(CLOCK_MONOTONIC);
+
+    uint32_t row = group_rows++;
+    group[ARCHIVE_COL_TIME][row] = (int32_t)(wall_ms - hour * 3600000LL);
+    group[ARCHIVE_COL_SESSION][row] = event->client_id;
+    group[ARCHIVE_COL_LEVEL][row] = event->level;
+    group[ARCHIVE_COL_TYPE][row] = event->type;
+    group[ARCHIVE_COL_X][row] = event->x;
+    group[ARCHIVE_COL_Y][row] = event->y;
+    group[ARCHIVE_COL_POINTS][row] = event->points;
+    group[ARCHIVE_COL_DETAIL][row] = event->detail;
+    if (group_rows == ARCHIVE_GROUP_ROWS)
+      flush_group();
+  }
+
+  int tracked = event->client_id % ARCHIVE_TRACKED;
+  pthread_mutex_lock(&archive_mutex);
+  level_stats_t *level = event->level < n_levels ? levels[event->level] : NULL;
+  if (level != NULL && event->level != 0) {
+    switch (event->type) {
+    case EVENT_LEVEL_START:
+      level->h.starts++;
+      level_starts[tracked].client_id = event->client_id;
+      level_starts[tracked].start_ns = event->time_ns;
+      break;
+    case EVENT_LEVEL_END:
+      if (event->detail == QUIT_GAME)
+        level->h.quits++;
+      break;
+    case EVENT_DOT:
+      level->h.dots++;
+      heat(level, level->dot_heat, event);
+      break;
+    case EVENT_DEATH:
+      level->h.deaths++;
+      heat(level, level->death_heat, event);
+      break;
+    case EVENT_PORTAL:
+      level->h.portals++;
+      if (level_starts[tracked].client_id == event->client_id)
+        level->h.portal_ms +=
+            (event->time_ns - level_starts[tracked].start_ns) / 1000000ULL;
+      break;
+    default:
+      break;
+    }
+    level->dirty = 1;
+  }
+  pthread_mutex_unlock(&archive_mutex);
+}
+
+void archive_idle(void) {
+  if (!archive_enabled)
+    return;
+  long long now = clock_ms(CLOCK_MONOTONIC);
+  if (group_rows > 0 && now - group_started_ms >= ARCHIVE_FLUSH_MS)
+    flush_group();
+  if (now - last_save_ms < ARCHIVE_FLUSH_MS)
+    return;
+  last_save_ms = now;
+
+  pthread_mutex_lock(&archive_mutex);
+  for (int id = 1; id < n_levels; id++) {
+    if (levels[id] != NULL && levels[id]->dirty)
+      save_level(id);
+  }
+  pthread_mutex_unlock(&archive_mutex);
+}
+
+void archive_stop(void) {
+  if (!archive_enabled)
+    return;
+  flush_group();
+  if (file_fd != -1) {
+    fdatasync(file_fd);
+    close(file_fd);
+    file_fd = -1;
+  }
+
+  /* The shutdown signal may have interrupted a thread holding the mutex;
+   * its level's aggregates then keep the last copy written */
+  int waited = 0;
+  while (pthread_mutex_trylock(&archive_mutex) != 0) {
+    if (waited >= ARCHIVE_STOP_MS)
+      return;
+    sleep_ms(1);
+    waited++;
+  }
+  for (int id = 1; id < n_levels; id++) {
+    if (levels[id] != NULL && levels[id]->dirty)
+      save_level(id);
+  }
+  pthread_mutex_unlock(&archive_mutex);
+}
+
+void archive_dump_stats(FILE *f) {
+  fprintf(f, "=== EVENT ARCHIVE ===\n");
+  if (archive_enabled)
+    fprintf(f, "Directory: %s (current file %s)\n", archive_dir,
+            file_hour >= 0 ? file_name : "none yet");
+  else
+    fprintf(f, "Directory: none (aggregates kept in memory)\n");
+  fprintf(f, "Rows: %llu in %llu row groups, %llu bytes (%.1f bytes/event)",
+          rows_written, groups_written, bytes_written,
+          rows_written ? (double)bytes_written / (double)rows_written : 0.0);
+  fprintf(f, ", write errors: %lu\n", write_errors);
+
+  pthread_mutex_lock(&archive_mutex);
+  for (int id = 1; id < n_levels; id++) {
+    const level_stats_t *level = levels[id];
+    if (level == NULL || level->h.starts == 0)
+      continue;
+    size_t cells = (size_t)level->h.width * level->h.height;
+    size_t worst = 0;
+    for (size_t c = 1; c < cells; c++) {
+      if (level->death_heat[c] > level->death_heat[worst])
+        worst = c;
+    }
+    fprintf(f,
+            "Level %d %s: %llu starts, %llu completed", id, level->h.name,
+            (unsigned long long)level->h.starts,
+            (unsigned long long)level->h.portals);
+    if (level->h.portals > 0)
+      fprintf(f, " (avg %.1f s to portal)",
+              (double)level->h.portal_ms / (double)level->h.portals / 1000.0);
+    fprintf(f, ", quit rate %.1f%%, %llu dots, %llu deaths",
+            100.0 * (double)level->h.quits / (double)level->h.starts,
+            (unsigned long long)level->h.dots,
+            (unsigned long long)level->h.deaths);
+    if (level->h.deaths > 0)
+      fprintf(f, " (most at %zu,%zu)", worst % level->h.width,
+              worst / level->h.width);
+    fprintf(f, "\n");
+  }
+  pthread_mutex_unlock(&archive_mutex);
+}
@@ -0,0 +1,354 @@
+/**
+ * @file catalog.c
+ * @brief Level catalog: parsed once, hot-reloaded via inotify.
+ *
+ * Sessions take a reference to the current catalog when they start and copy
+ * boards out of it with board_clone(), so starting a level does no I/O. A
+ * rebuild produces a whole new catalog and swaps the current pointer under
+ * a mutex; sessions holding the old one keep playing it and the last
+ * reference frees it.
+ */
+
+#include "../../include/catalog.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief Quiet period after the last event before rebuilding */
+#define CATALOG_SETTLE_MS 200
+/** @brief Directory events that can change the catalog */
+#define CATALOG_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+static char levels_dir[512];
+static level_catalog_t *current = NULL;
+static pthread_mutex_t current_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_ulong reloads;
+static atomic_ulong levels_parsed;
+static atomic_ulong levels_reused;
+static atomic_ulong load_failures;
+static atomic_int live_catalogs;
+static atomic_ulong current_version; /* Of current, for the stats */
+static atomic_int current_count;
+static int watching = 0;
+
+/**
+ * @brief Tells whether a file name ends with the given suffix.
+ */
+static int has_suffix(const char *name, const char *suffix) {
+  size_t n = strlen(name), s = strlen(suffix);
+  return n > s && strcmp(name + n - s, suffix) == 0;
+}
+
+/**
+ * @brief Level files are *.lvl and *.txt.
+ */
+static int is_level_file(const char *name) {
+  return has_suffix(name, ".lvl") || has_suffix(name, ".txt");
+}
+
+/**
+ * @brief Motion scripts are *.p and *.m.
+ */
+static int is_script_file(const char *name) {
+  return has_suffix(name, ".p") || has_suffix(name, ".m");
+}
+
+/**
+ * @brief qsort comparator ordering level paths alphabetically.
+ */
+static int compare_paths(const void *a, const void *b) {
+  return strcmp((const char *)a, (const char *)b);
+}
+
+/**
+ * @brief Frees a catalog and all of its boards.
+ */
+static void free_catalog(level_catalog_t *catalog) {
+  for (int i = 0; i < catalog->count; i++)
+    unload_level(&catalog->levels[i].board);
+  free(catalog->levels);
+  free(catalog);
+  atomic_fetch_sub(&live_catalogs, 1);
+}
+
+/**
+ * @brief Finds a level by path in the previous catalog.
+ */
+static const catalog_level_t *find_level(const level_catalog_t *catalog,
+                                         const char *path) {
+  if (catalog == NULL)
+    return NULL;
+  for (int i = 0; i < catalog->count; i++) {
+    if (strcmp(catalog->levels[i].path, path) == 0)
+      return &catalog->levels[i];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Records the file identity a level was loaded from.
+ */
+static void set_identity(catalog_level_t *level, const struct stat *st) {
+  level->ino = st->st_ino;
+  level->size = st->st_size;
+  level->mtime = st->st_mtim;
+  level->ctime = st->st_ctim;
+}
+
+/**
+ * @brief Tells whether a level's file is still the one it was loaded from.
+ *
+ * Whole-second times miss a rewrite within the same second that keeps the
+ * size, so the times are compared to the nanosecond; the inode and status
+ * change time catch a file replaced by rename or restored with its old
+ * modification time.
+ */
+static int same_file(const catalog_level_t *level, const struct stat *st) {
+  return level->ino == st->st_ino && level->size == st->st_size &&
+         level->mtime.tv_sec == st->st_mtim.tv_sec &&
+         level->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+         level->ctime.tv_sec == st->st_ctim.tv_sec &&
+         level->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+/**
+ * @brief Builds a catalog from the directory, reusing unchanged levels.
+ *
+ * A level that fails to parse keeps its previous version, if any.
+ *
+ * @param prev Current catalog (may be NULL), only read.
+ * @param scripts_changed Re-parse every level even if its file is unchanged.
+ * @return The new catalog, or NULL if the directory cannot be read.
+ */
+static level_catalog_t *build_catalog(const level_catalog_t *prev,
+                                      int scripts_changed) {
+  DIR *d = opendir(levels_dir);
+  if (d == NULL)
+    return NULL;
+
+  char(*paths)[512] = NULL;
+  int n_paths = 0, cap = 0;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (!is_level_file(entry->d_name))
+      continue;
+    if (n_paths == cap) {
+      cap = cap ? cap * 2 : 16;
+      char(*grown)[512] = realloc(paths, (size_t)cap * sizeof(*paths));
+      if (grown == NULL)
+        break;
+      paths = grown;
+    }
+    int len = snprintf(paths[n_paths], sizeof(paths[0]), "%s/%s", levels_dir,
+                       entry->d_name);
+    if (len > 0 && (size_t)len < sizeof(paths[0]))
+      n_paths++;
+  }
+  closedir(d);
+  qsort(paths, (size_t)n_paths, sizeof(*paths), compare_paths);
+
+  level_catalog_t *catalog = calloc(1, sizeof(level_catalog_t));
+  if (catalog == NULL) {
+    free(paths);
+    return NULL;
+  }
+  catalog->levels = calloc((size_t)(n_paths > 0 ? n_paths : 1),
+                           sizeof(catalog_level_t));
+  if (catalog->levels == NULL) {
+    free(catalog);
+    free(paths);
+    return NULL;
+  }
+  atomic_init(&catalog->refs, 1);
+  catalog->version = prev ? prev->version + 1 : 1;
+  atomic_fetch_add(&live_catalogs, 1);
+
+  for (int i = 0; i < n_paths; i++) {
+    catalog_level_t *level = &catalog->levels[catalog->count];
+    const catalog_level_t *old = find_level(prev, paths[i]);
+    struct stat st;
+    if (stat(paths[i], &st) != 0)
+      continue;
+
+    int loaded = -1;
+    if (old != NULL && !scripts_changed && same_file(old, &st)) {
+      loaded = board_clone(&level->board, &old->board, 0);
+      if (loaded == 0)
+        atomic_fetch_add(&levels_reused, 1);
+    } else {
+      loaded = load_level(&level->board, paths[i], 0);
+      if (loaded == 0) {
+        atomic_fetch_add(&levels_parsed, 1);
+      } else {
+        atomic_fetch_add(&load_failures, 1);
+        fprintf(stderr, "[Catalog] Failed to load %s%s\n", paths[i],
+                old ? ", keeping the previous version" : "");
+        if (old != NULL) {
+          loaded = board_clone(&level->board, &old->board, 0);
+          st.st_ino = old->ino;
+          st.st_size = old->size;
+          st.st_mtim = old->mtime;
+          st.st_ctim = old->ctime;
+        }
+      }
+    }
+    if (loaded != 0)
+      continue;
+    strncpy(level->path, paths[i], sizeof(level->path) - 1);
+    set_identity(level, &st);
+    catalog->count++;
+  }
+  free(paths);
+  return catalog;
+}
+
+/**
+ * @brief Makes a new catalog current and drops the current one's reference.
+ */
+static void publish(level_catalog_t *catalog) {
+  pthread_mutex_lock(&current_mutex);
+  level_catalog_t *old = current;
+  current = catalog;
+  atomic_store(&current_version, catalog->version);
+  atomic_store(&current_count, catalog->count);
+  pthread_mutex_unlock(&current_mutex);
+  if (old != NULL)
+    catalog_release(old);
+}
+
+/**
+ * @brief Scans a buffer of inotify events for level or script changes.
+ * @param buf Events read from the inotify descriptor.
+ * @param len Bytes in buf.
+ * @param relevant Set to 1 if a level or script changed.
+ * @param scripts Set to 1 if a script changed.
+ */
+static void scan_events(const char *buf, ssize_t len, int *relevant,
+                        int *scripts) {
+  const char *p = buf;
+  while (p < buf + len) {
+    const struct inotify_event *ev = (const struct inotify_event *)p;
+    if (ev->len > 0) {
+      if (is_level_file(ev->name))
+        *relevant = 1;
+      if (is_script_file(ev->name)) {
+        *relevant = 1;
+        *scripts = 1;
+      }
+    }
+    p += sizeof(struct inotify_event) + ev->len;
+  }
+}
+
+/**
+ * @brief Watcher thread: rebuilds the catalog after directory changes.
+ * @param arg inotify descriptor, as intptr_t.
+ * @return void* Never returns unless the descriptor fails.
+ */
+static void *catalog_watcher(void *arg) {
+  int fd = (int)(intptr_t)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  while (1) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      if (n == -1 && errno == EINTR)
+        continue;
+      break;
+    }
+    int relevant = 0, scripts = 0;
+    scan_events(buf, n, &relevant, &scripts);
+
+    // Wait for the burst of events of a multi-file deploy to settle
+    while (poll(&pfd, 1, CATALOG_SETTLE_MS) > 0) {
+      n = read(fd, buf, sizeof(buf));
+      if (n <= 0)
+        break;
+      scan_events(buf, n, &relevant, &scripts);
+    }
+    if (!relevant)
+      continue;
+
+    level_catalog_t *prev = catalog_acquire();
+    level_catalog_t *next = build_catalog(prev, scripts);
+    unsigned long prev_version = prev->version;
+    catalog_release(prev);
+    if (next == NULL) {
+      fprintf(stderr, "[Catalog] Cannot read %s, keeping version %lu\n",
+              levels_dir, prev_version);
+      continue;
+    }
+    publish(next);
+    atomic_fetch_add(&reloads, 1);
+    fprintf(stderr, "[Catalog] Version %lu: %d levels\n", next->version,
+            next->count);
+  }
+  close(fd);
+  return NULL;
+}
+
+int catalog_start(const char *dir) {
+  strncpy(levels_dir, dir, sizeof(levels_dir) - 1);
+  level_catalog_t *catalog = build_catalog(NULL, 1);
+  if (catalog == NULL)
+    return -1;
+  publish(catalog);
+
+  int fd = inotify_init();
+  if (fd == -1 || inotify_add_watch(fd, dir, CATALOG_EVENTS) == -1) {
+    perror("[Catalog] inotify, levels will not be reloaded");
+    if (fd != -1)
+      close(fd);
+    return 0;
+  }
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, catalog_watcher, (void *)(intptr_t)fd) != 0) {
+    close(fd);
+    return 0;
+  }
+  pthread_detach(tid);
+  watching = 1;
+  return 0;
+}
+
+level_catalog_t *catalog_acquire(void) {
+  pthread_mutex_lock(&current_mutex);
+  level_catalog_t *catalog = current;
+  atomic_fetch_add(&catalog->refs, 1);
+  pthread_mutex_unlock(&current_mutex);
+  return catalog;
+}
+
+void catalog_release(level_catalog_t *catalog) {
+  if (atomic_fetch_sub(&catalog->refs, 1) == 1)
+    free_catalog(catalog);
+}
+
+void catalog_dump_stats(FILE *f) {
+  // No reference: releasing one could free a replaced catalog here
+  fprintf(f, "=== LEVEL CATALOG ===\n");
+  fprintf(f, "Version %lu: %d levels from %s (%s)\n",
+          atomic_load(&current_version), atomic_load(&current_count),
+          levels_dir, watching ? "watching" : "not watching");
+  fprintf(f, "Reloads: %lu, levels parsed: %lu, reused: %lu, failed: %lu\n",
+          atomic_load(&reloads), atomic_load(&levels_parsed),
+          atomic_load(&levels_reused), atomic_load(&load_failures));
+  fprintf(f, "Catalog versions still in memory: %d\n",
+          atomic_load(&live_catalogs));
+}
@@ -0,0 +1,226 @@
+/**
+ * @file cost.c
+ * @brief Per-session and per-level resource cost accounting.
+ *
+ * Game threads charge their session directly through the atomic counters in
+ * session_cost_t; this module keeps the set of live sessions, the final
+ * costs of recently finished ones and per-level totals for the reports.
+ */
+
+#include "../../include/cost.h"
+#include "../../include/board.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** @brief Maximum number of sessions tracked while they run */
+#define COST_MAX_LIVE 256
+/** @brief Number of finished sessions kept for the report */
+#define COST_HISTORY 64
+/** @brief Maximum number of distinct levels tracked */
+#define COST_MAX_LEVELS 64
+/** @brief Number of rows printed by each "top" report */
+#define COST_TOP 5
+
+/**
+ * @brief Point-in-time copy of a session's costs.
+ */
+typedef struct {
+  int client_id;
+  int live;
+  unsigned long long cpu_ns;
+  unsigned long long bytes_written;
+  unsigned long frames_written;
+  unsigned long moves_received;
+  unsigned long allocs;
+  unsigned long long bytes_allocated;
+  unsigned long long lock_wait_ns;
+} cost_row_t;
+
+/**
+ * @brief Accumulated cost of one level across all plays.
+ */
+typedef struct {
+  char name[MAX_FILENAME];
+  unsigned long plays;
+  unsigned long long cpu_ns;
+  unsigned long long ticks;
+} level_cost_t;
+
+static session_t *live[COST_MAX_LIVE];
+static cost_row_t history[COST_HISTORY];
+static int history_next = 0;
+static int history_count = 0;
+static level_cost_t levels[COST_MAX_LEVELS];
+static int level_count = 0;
+static cost_totals_t ended; /* Sessions that left the live set */
+static pthread_mutex_t cost_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Copies the counters of a session into a row.
+ * @param session Session to read.
+ * @param row Destination row.
+ */
+static void snapshot(session_t *session, cost_row_t *row) {
+  session_cost_t *c = &session->cost;
+  row->client_id = session->client_id;
+  row->cpu_ns = atomic_load(&c->cpu_ns);
+  row->bytes_written = atomic_load(&c->bytes_written);
+  row->frames_written = atomic_load(&c->frames_written);
+  row->moves_received = atomic_load(&c->moves_received);
+  row->allocs = atomic_load(&c->allocs);
+  row->bytes_allocated = atomic_load(&c->bytes_allocated);
+  row->lock_wait_ns = atomic_load(&c->lock_wait_ns);
+}
+
+/**
+ * @brief qsort comparator ordering rows by CPU time, most expensive first.
+ */
+static int compare_rows(const void *a, const void *b) {
+  const cost_row_t *ra = (const cost_row_t *)a;
+  const cost_row_t *rb = (const cost_row_t *)b;
+  return (rb->cpu_ns > ra->cpu_ns) - (rb->cpu_ns < ra->cpu_ns);
+}
+
+/**
+ * @brief qsort comparator ordering levels by CPU per tick, highest first.
+ */
+static int compare_levels(const void *a, const void *b) {
+  const level_cost_t *la = (const level_cost_t *)a;
+  const level_cost_t *lb = (const level_cost_t *)b;
+  double ca = la->ticks ? (double)la->cpu_ns / (double)la->ticks : 0.0;
+  double cb = lb->ticks ? (double)lb->cpu_ns / (double)lb->ticks : 0.0;
+  return (cb > ca) - (cb < ca);
+}
+
+unsigned long long cost_thread_cpu_ns(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+  return (unsigned long long)ts.tv_sec * 1000000000ULL +
+         (unsigned long long)ts.tv_nsec;
+}
+
+void cost_add_thread_cpu(session_t *session) {
+  atomic_fetch_add(&session->cost.cpu_ns, cost_thread_cpu_ns());
+}
+
+void cost_add_alloc(session_t *session, unsigned long count,
+                    unsigned long long bytes) {
+  atomic_fetch_add(&session->cost.allocs, count);
+  atomic_fetch_add(&session->cost.bytes_allocated, bytes);
+}
+
+void cost_session_begin(session_t *session) {
+  pthread_mutex_lock(&cost_mutex);
+  for (int i = 0; i < COST_MAX_LIVE; i++) {
+    if (live[i] == NULL) {
+      live[i] = session;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&cost_mutex);
+}
+
+void cost_session_end(session_t *session) {
+  pthread_mutex_lock(&cost_mutex);
+  for (int i = 0; i < COST_MAX_LIVE; i++) {
+    if (live[i] == session) {
+      live[i] = NULL;
+      break;
+    }
+  }
+  snapshot(session, &history[history_next]);
+  history[history_next].live = 0;
+  ended.ticks += atomic_load(&session->cost.ticks);
+  ended.frames_written += history[history_next].frames_written;
+  ended.bytes_written += history[history_next].bytes_written;
+  ended.lock_wait_ns += history[history_next].lock_wait_ns;
+  history_next = (history_next + 1) % COST_HISTORY;
+  if (history_count < COST_HISTORY)
+    history_count++;
+  pthread_mutex_unlock(&cost_mutex);
+}
+
+void cost_level_played(const char *level_name, unsigned long long cpu_ns,
+                       unsigned long ticks) {
+  pthread_mutex_lock(&cost_mutex);
+  level_cost_t *entry = NULL;
+  for (int i = 0; i < level_count; i++) {
+    if (strcmp(levels[i].name, level_name) == 0) {
+      entry = &levels[i];
+      break;
+    }
+  }
+  if (entry == NULL && level_count < COST_MAX_LEVELS) {
+    entry = &levels[level_count++];
+    strncpy(entry->name, level_name, MAX_FILENAME - 1);
+    entry->name[MAX_FILENAME - 1] = '\0';
+  }
+  if (entry != NULL) {
+    entry->plays++;
+    entry->cpu_ns += cpu_ns;
+    entry->ticks += ticks;
+  }
+  pthread_mutex_unlock(&cost_mutex);
+}
+
+void cost_totals(cost_totals_t *out) {
+  pthread_mutex_lock(&cost_mutex);
+  *out = ended;
+  for (int i = 0; i < COST_MAX_LIVE; i++) {
+    if (live[i] == NULL)
+      continue;
+    session_cost_t *c = &live[i]->cost;
+    out->sessions++;
+    out->ticks += atomic_load(&c->ticks);
+    out->frames_written += atomic_load(&c->frames_written);
+    out->bytes_written += atomic_load(&c->bytes_written);
+    out->lock_wait_ns += atomic_load(&c->lock_wait_ns);
+  }
+  pthread_mutex_unlock(&cost_mutex);
+}
+
+void cost_dump_stats(FILE *f) {
+  cost_row_t rows[COST_MAX_LIVE + COST_HISTORY];
+  level_cost_t level_rows[COST_MAX_LEVELS];
+  int n = 0;
+
+  pthread_mutex_lock(&cost_mutex);
+  for (int i = 0; i < COST_MAX_LIVE; i++) {
+    if (live[i] != NULL) {
+      snapshot(live[i], &rows[n]);
+      rows[n++].live = 1;
+    }
+  }
+  for (int i = 0; i < history_count; i++) {
+    rows[n++] = history[i];
+  }
+  int n_levels = level_count;
+  memcpy(level_rows, levels, sizeof(level_cost_t) * (size_t)n_levels);
+  pthread_mutex_unlock(&cost_mutex);
+
+  qsort(rows, (size_t)n, sizeof(cost_row_t), compare_rows);
+  fprintf(f, "=== TOP SESSIONS BY COST ===\n");
+  if (n == 0)
+    fprintf(f, "No sessions yet.\n");
+  for (int i = 0; i < n && i < COST_TOP; i++) {
+    cost_row_t *r = &rows[i];
+    fprintf(f,
+            "%d. Client %d%s: cpu %.1f ms, %lu frames / %llu bytes out, "
+            "%lu moves in, %lu allocs / %llu bytes, lock wait %.1f ms\n",
+            i + 1, r->client_id, r->live ? " (playing)" : "",
+            (double)r->cpu_ns / 1e6, r->frames_written, r->bytes_written,
+            r->moves_received, r->allocs, r->bytes_allocated,
+            (double)r->lock_wait_ns / 1e6);
+  }
+
+  qsort(level_rows, (size_t)n_levels, sizeof(level_cost_t), compare_levels);
+  fprintf(f, "=== TOP LEVELS BY CPU PER TICK ===\n");
+  for (int i = 0; i < n_levels && i < COST_TOP; i++) {
+    level_cost_t *l = &level_rows[i];
+    fprintf(f, "%d. %s: %lu plays, %.1f us/tick\n", i + 1, l->name, l->plays,
+            l->ticks ? (double)l->cpu_ns / (double)l->ticks / 1e3 : 0.0);
+  }
+}
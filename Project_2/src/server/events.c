@@ -0,0 +1,311 @@
+/**
+ * @file events.c
+ * @brief Game event bus: lock-free MPSC ring drained by an analytics thread.
+ *
+ * Game threads push events into a bounded ring (Vyukov's per-slot turn
+ * counters): a producer claims a slot with one CAS and publishes it with a
+ * release store, and never waits; when the ring is full the event is
+ * dropped and counted. A single analytics thread drains the ring, keeps the
+ * counters written on SIGUSR1, hands every event to the archive (per-level
+ * aggregates and hourly files) and copies it into a shared memory stream
+ * that local processes can tail (see events_shm_t).
+ */
+
+#include "../../include/events.h"
+#include "../../include/archive.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Slots of the in-process ring (power of two) */
+#define EVENTS_RING_SIZE 16384
+/** @brief Slots of the shared memory stream */
+#define EVENTS_SHM_CAPACITY 65536
+/** @brief Analytics thread sleep when the ring is empty */
+#define EVENTS_IDLE_MS 2
+/** @brief Longest events_stop() waits for the ring to drain */
+#define EVENTS_STOP_MS 1000
+
+/**
+ * @brief Ring slot; turn == position when free, position + 1 when full.
+ */
+typedef struct {
+  atomic_ulong turn;
+  game_event_t event;
+} ring_slot_t;
+
+static ring_slot_t *ring = NULL;
+static atomic_ulong ring_head; /* Next position producers claim */
+static unsigned long ring_tail; /* Next position the consumer reads */
+static atomic_int stopping;     /* Set by events_stop() */
+static atomic_int stopped;      /* The consumer drained the ring and exited */
+
+static events_shm_t *shm = NULL;
+static char shm_name[256];
+
+static atomic_ulong emitted;
+static atomic_ulong dropped;
+
+/* Aggregates, written only by the analytics thread */
+static unsigned long published;
+static unsigned long type_counts[EVENT_TYPES];
+static unsigned long death_causes[3];
+static pthread_mutex_t aggregates_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static uint64_t events_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Pushes an event into the ring, or drops it if the ring is full.
+ */
+static void ring_push(const game_event_t *event) {
+  unsigned long pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+  ring_slot_t *slot;
+  while (1) {
+    slot = &ring[pos & (EVENTS_RING_SIZE - 1)];
+    unsigned long turn =
+        atomic_load_explicit(&slot->turn, memory_order_acquire);
+    long diff = (long)(turn - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ring_head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+      return;
+    } else {
+      pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    }
+  }
+  slot->event = *event;
+  atomic_store_explicit(&slot->turn, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Pops the oldest event (consumer side).
+ * @return 1 if an event was copied to out, 0 if the ring is empty.
+ */
+static int ring_pop(game_event_t *out) {
+  ring_slot_t *slot = &ring[ring_tail & (EVENTS_RING_SIZE - 1)];
+  if (atomic_load_explicit(&slot->turn, memory_order_acquire) !=
+      ring_tail + 1)
+    return 0;
+  *out = slot->event;
+  atomic_store_explicit(&slot->turn, ring_tail + EVENTS_RING_SIZE,
+                        memory_order_release);
+  ring_tail++;
+  return 1;
+}
+
+/**
+ * @brief Copies an event into the shared memory stream.
+ */
+static void shm_publish(game_event_t *event) {
+  game_event_t *slot = &shm->events[(event->seq - 1) % shm->capacity];
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  uint64_t seq = event->seq;
+  event->seq = 0;
+  memcpy(slot, event, sizeof(*slot));
+  event->seq = seq;
+  __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n(&shm->write_seq, seq, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Folds an event into the counters.
+ */
+static void aggregate(const game_event_t *event) {
+  pthread_mutex_lock(&aggregates_mutex);
+  published++;
+  type_counts[event->type]++;
+  if (event->type == EVENT_DEATH && event->detail < 3)
+    death_causes[event->detail]++;
+  pthread_mutex_unlock(&aggregates_mutex);
+}
+
+/**
+ * @brief Analytics thread: drains the ring into the aggregates and stream.
+ * @param arg Unused.
+ * @return void* NULL once events_stop() asked it to stop.
+ */
+static void *analytics_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it; SIGINT and SIGTERM
+   * too, as the shutdown waits for this thread to drain the ring */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  uint64_t seq = 0;
+  game_event_t event;
+  while (1) {
+    if (!ring_pop(&event)) {
+      if (atomic_load(&stopping)) {
+        atomic_store(&stopped, 1);
+        return NULL;
+      }
+      archive_idle();
+      sleep_ms(EVENTS_IDLE_MS);
+      continue;
+    }
+    event.seq = ++seq;
+    aggregate(&event);
+    archive_record(&event);
+    if (shm != NULL)
+      shm_publish(&event);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Returns the pid of the running server that writes an existing
+ * stream, or 0 if the stream is left over from a server that is gone.
+ */
+static pid_t shm_owner(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1)
+    return 0;
+  events_shm_t header;
+  ssize_t n = pread(fd, &header, sizeof(header), 0);
+  close(fd);
+  if (n != (ssize_t)sizeof(header) || header.magic != EVENTS_SHM_MAGIC ||
+      header.owner_pid <= 0 || header.owner_pid == getpid())
+    return 0;
+  if (kill(header.owner_pid, 0) == -1 && errno == ESRCH)
+    return 0;
+  return header.owner_pid;
+}
+
+/**
+ * @brief Creates the shared memory stream.
+ * @return 0 on success, -1 on failure (events stay in-process).
+ */
+static int shm_create(const char *name) {
+  size_t size = sizeof(events_shm_t) +
+                (size_t)EVENTS_SHM_CAPACITY * sizeof(game_event_t);
+  pid_t owner = shm_owner(name);
+  if (owner != 0) {
+    fprintf(stderr,
+            "[Events] %s belongs to running server %d, set "
+            "PACMANIST_EVENTS_SHM to stream this one's events\n",
+            name, (int)owner);
+    errno = EEXIST;
+    return -1;
+  }
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd == -1)
+    return -1;
+  if (ftruncate(fd, (off_t)size) == -1) {
+    close(fd);
+    shm_unlink(name);
+    return -1;
+  }
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name);
+    return -1;
+  }
+  shm = (events_shm_t *)base;
+  shm->capacity = EVENTS_SHM_CAPACITY;
+  shm->owner_pid = (int32_t)getpid();
+  __atomic_store_n(&shm->magic, EVENTS_SHM_MAGIC, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int events_start(void) {
+  ring = calloc(EVENTS_RING_SIZE, sizeof(ring_slot_t));
+  if (ring == NULL)
+    return -1;
+  for (unsigned long i = 0; i < EVENTS_RING_SIZE; i++)
+    atomic_init(&ring[i].turn, i);
+
+  const char *name = getenv("PACMANIST_EVENTS_SHM");
+  if (name == NULL || name[0] == '\0')
+    name = EVENTS_SHM_DEFAULT;
+  if (strcmp(name, "0") != 0) {
+    strncpy(shm_name, name, sizeof(shm_name) - 1);
+    if (shm_create(shm_name) != 0) {
+      perror("[Events] shm_open, events stay in-process");
+      shm_name[0] = '\0';
+    }
+  }
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, analytics_thread, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+int events_stop(void) {
+  int drained = 1;
+  if (ring != NULL) {
+    atomic_store(&stopping, 1);
+    for (int waited = 0; !atomic_load(&stopped) && waited < EVENTS_STOP_MS;
+         waited += EVENTS_IDLE_MS)
+      sleep_ms(EVENTS_IDLE_MS);
+    drained = atomic_load(&stopped);
+  }
+  if (shm_name[0] != '\0')
+    shm_unlink(shm_name);
+  return drained ? 0 : -1;
+}
+
+void events_emit(const session_t *session, game_event_type_t type, int x,
+                 int y, int points, int detail) {
+  if (ring == NULL)
+    return;
+  game_event_t event = {.time_ns = events_now_ns(),
+                        .client_id = session->client_id,
+                        .points = points,
+                        .type = (uint8_t)type,
+                        .detail = (uint8_t)detail,
+                        .level = (uint16_t)session->level_id,
+                        .x = (int16_t)x,
+                        .y = (int16_t)y};
+  atomic_fetch_add_explicit(&emitted, 1, memory_order_relaxed);
+  ring_push(&event);
+}
+
+void events_board_hook(void *ctx, board_event_t event, int x, int y,
+                       int points, int detail) {
+  game_event_type_t type = event == BOARD_EVENT_DOT     ? EVENT_DOT
+                           : event == BOARD_EVENT_DEATH ? EVENT_DEATH
+                                                        : EVENT_PORTAL;
+  events_emit((const session_t *)ctx, type, x, y, points, detail);
+}
+
+void events_dump_stats(FILE *f) {
+  pthread_mutex_lock(&aggregates_mutex);
+  fprintf(f, "=== GAME EVENTS ===\n");
+  fprintf(f, "Emitted: %lu, published: %lu, dropped (ring full): %lu\n",
+          atomic_load(&emitted), published, atomic_load(&dropped));
+  fprintf(f, "Stream: %s\n", shm_name[0] ? shm_name : "(in-process only)");
+  for (int t = 1; t < EVENT_TYPES; t++)
+    fprintf(f, "%-14s %lu\n", events_type_name(t), type_counts[t]);
+  fprintf(f, "Deaths: %lu walked into a ghost, %lu caught by a ghost\n",
+          death_causes[DEATH_WALKED_INTO_GHOST],
+          death_causes[DEATH_CAUGHT_BY_GHOST]);
+  pthread_mutex_unlock(&aggregates_mutex);
+}
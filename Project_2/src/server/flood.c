@@ -0,0 +1,110 @@
+/**
+ * @file flood.c
+ * @brief Request-path flood protection: token buckets and quiet warnings.
+ */
+
+#include "../../include/flood.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NS_PER_SEC 1000000000LL
+
+static double move_rate = 30.0;
+static double move_burst = 10.0;
+
+static atomic_ulong total_rate_limited;
+static atomic_ulong total_coalesced;
+static atomic_ulong total_unknown_ops;
+static atomic_ulong total_warnings;
+static atomic_ulong total_suppressed;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long flood_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void flood_init(void) {
+  const char *rate = getenv("PACMANIST_INPUT_RATE");
+  if (rate != NULL && atof(rate) > 0)
+    move_rate = atof(rate);
+  const char *burst = getenv("PACMANIST_INPUT_BURST");
+  if (burst != NULL && atof(burst) >= 1)
+    move_burst = atof(burst);
+}
+
+void flood_session_init(session_input_t *input) {
+  input->tokens = move_burst;
+  input->refill_ns = flood_now_ns();
+  input->last_warn_ns = 0;
+  input->partial_len = 0;
+}
+
+int flood_admit_move(session_input_t *input) {
+  long long now = flood_now_ns();
+  input->tokens += (double)(now - input->refill_ns) * move_rate / NS_PER_SEC;
+  if (input->tokens > move_burst)
+    input->tokens = move_burst;
+  input->refill_ns = now;
+
+  if (input->tokens < 1.0)
+    return 0;
+  input->tokens -= 1.0;
+  return 1;
+}
+
+void flood_account(session_input_t *input, unsigned long rate_limited,
+                   unsigned long coalesced, unsigned long unknown_ops) {
+  if (rate_limited) {
+    atomic_fetch_add(&input->rate_limited, rate_limited);
+    atomic_fetch_add(&total_rate_limited, rate_limited);
+  }
+  if (coalesced) {
+    atomic_fetch_add(&input->coalesced, coalesced);
+    atomic_fetch_add(&total_coalesced, coalesced);
+  }
+  if (unknown_ops) {
+    atomic_fetch_add(&input->unknown_ops, unknown_ops);
+    atomic_fetch_add(&total_unknown_ops, unknown_ops);
+  }
+}
+
+void flood_warn(session_t *session, const char *format, ...) {
+  session_input_t *input = &session->input;
+  long long now = flood_now_ns();
+  if (input->last_warn_ns != 0 && now - input->last_warn_ns < NS_PER_SEC) {
+    atomic_fetch_add(&input->warnings_suppressed, 1);
+    atomic_fetch_add(&total_suppressed, 1);
+    return;
+  }
+  input->last_warn_ns = now;
+  atomic_fetch_add(&total_warnings, 1);
+
+  char message[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  unsigned long suppressed = atomic_exchange(&input->warnings_suppressed, 0);
+  if (suppressed > 0) {
+    fprintf(stderr, "[Listener] Client %d: %s (%lu similar suppressed)\n",
+            session->client_id, message, suppressed);
+  } else {
+    fprintf(stderr, "[Listener] Client %d: %s\n", session->client_id, message);
+  }
+}
+
+void flood_dump_stats(FILE *f) {
+  fprintf(f, "=== REQUEST PATH ===\n");
+  fprintf(f, "Move limit: %.0f/s, burst %.0f\n", move_rate, move_burst);
+  fprintf(f, "Moves rate limited: %lu, coalesced: %lu\n",
+          atomic_load(&total_rate_limited), atomic_load(&total_coalesced));
+  fprintf(f, "Unknown opcode bytes: %lu\n", atomic_load(&total_unknown_ops));
+  fprintf(f, "Warnings printed: %lu, suppressed: %lu\n",
+          atomic_load(&total_warnings), atomic_load(&total_suppressed));
+}
@@ -1,8 +1,22 @@
+#define _GNU_SOURCE
 #include "../../include/game.h"
 #include "../../include/board.h"
+#include "../../include/cost.h"
+#include "../../include/events.h"
+#include "../../include/flood.h"
+#include "../../include/leaderboard.h"
+#include "../../include/migrate.h"
+#include "../../include/placement.h"
 #include "../../include/protocol.h"
+#include "../../include/qos.h"
+#include "../../include/scheduler.h"
+#include "../../include/spectate.h"
+#include "../../include/speculate.h"
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <malloc.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -13,6 +27,10 @@
 #include <time.h>
 #include <unistd.h>
 
+/** @brief Lock mode of played levels (PACMANIST_BOARD_LOCK) */
+static int board_lock_mode = BOARD_LOCK_GLOBAL;
+/** @brief Set once a level thread had to start without its core */
+static atomic_bool unpinned_warned;
 
 /**
  * @brief Argument structure passed to ghost and pacman threads.
@@ -22,13 +40,27 @@ typedef struct {
   int ghost_index; /**< Index of the ghost (ignored for pacman) */
   int notif_fd;    /**< Open file descriptor for client updates */
   int req_fd;      /**< Pre-opened request pipe fd (for input listener) */
+  session_t *session; /**< Session owning the board (tick scheduling) */
+  speculation_t *spec; /**< Next-move frames (NULL unless speculating) */
 } thread_arg_t;
 
+/** @brief How often a paused session checks for a migration request */
+#define PAUSE_POLL_MS 1000
+
+/** @brief Bytes drained from the request pipe per wakeup */
+#define INPUT_BATCH_BYTES 256
+
 /**
  * @brief Thread that listens for movement requests from a specific client.
  *
- * Reads move_req_t structures from the pre-opened request file descriptor.
- * Updates the pacman's next_user_move buffer when a valid move is received.
+ * Drains everything pending on the pre-opened request file descriptor in one
+ * read and parses it as a byte stream (OP_MOVE is 2 bytes, OP_DISCONNECT 1),
+ * keeping a message split across reads for the next wakeup. Moves pass a
+ * per-session token bucket and only the last accepted one of a batch is
+ * applied, so the board lock is taken at most once per wakeup however fast
+ * the client writes. Warnings about malformed input are rate limited.
+ * Waits on the session's wake_fd too, so a level can end (or stop for a
+ * migration) without waiting for the client's next key press.
  *
  * @param arg Pointer to thread_arg_t containing board and req_fd.
  * @return void* Always NULL.
@@ -37,27 +69,47 @@ void *input_listener_thread(void *arg) {
   thread_arg_t *i_arg = (thread_arg_t *)arg;
   board_t *board = i_arg->board;
   int fd = i_arg->req_fd; // Use pre-opened fd
-  free(i_arg);
+  session_t *session = i_arg->session;
+  pthread_setname_np(pthread_self(), "tick-input");
 
   if (fd == -1)
     return NULL;
 
-  move_req_t move;
+  session_input_t *input = &session->input;
+  unsigned char buf[INPUT_BATCH_BYTES];
+  struct pollfd pfds[2] = {{.fd = fd, .events = POLLIN},
+                           {.fd = session->wake_fd, .events = POLLIN}};
+  unsigned int core_seen = ~0u;
   while (true) {
-    pthread_rwlock_rdlock(&board->state_lock);
+    board_rdlock(board);
     if (board->shutdown) {
       pthread_rwlock_unlock(&board->state_lock);
       break;
     }
     pthread_rwlock_unlock(&board->state_lock);
 
-    ssize_t n = read(fd, &move, sizeof(move_req_t));
+    if (poll(pfds, session->wake_fd != -1 ? 2 : 1, -1) == -1)
+      continue;
+    if (pfds[1].revents & POLLIN) {
+      uint64_t wakeups;
+      if (read(session->wake_fd, &wakeups, sizeof(wakeups)) < 0)
+        perror("Failed to clear input listener wakeup");
+      continue; // Level ending: the shutdown check above exits
+    }
+    migrate_follow(session, &core_seen);
+
+    int len = input->partial_len;
+    memcpy(buf, input->partial, (size_t)len);
+    ssize_t n = read(fd, buf + len, sizeof(buf) - (size_t)len);
 
     // Handle read errors and EOF
     if (n <= 0) {
       if (n == 0) {
         // Client closed pipe (EOF) - Shutdown game threads
-        pthread_rwlock_wrlock(&board->state_lock);
+        if (input->partial_len > 0)
+          flood_warn(session, "Partial message at disconnect (%d bytes)",
+                     input->partial_len);
+        board_wrlock(board);
         board->shutdown = 1;
         pthread_rwlock_unlock(&board->state_lock);
         break;
@@ -65,38 +117,66 @@ void *input_listener_thread(void *arg) {
       // Read error - continue trying
       continue;
     }
-
-    // Handle partial reads (malicious client sending incomplete data)
-    if (n < (ssize_t)sizeof(move_req_t)) {
-      fprintf(stderr,
-              "[Listener] Warning: Partial message received (%zd bytes)\n", n);
-      continue;
+    len += (int)n;
+
+    char move_key = '\0';
+    bool disconnect = false;
+    unsigned long moves = 0, rate_limited = 0, unknown = 0;
+    int i = 0;
+    while (i < len && !disconnect) {
+      if (buf[i] == OP_MOVE) {
+        if (i + (int)sizeof(move_req_t) > len)
+          break; // Rest of the message arrives with the next read
+        moves++;
+        if (flood_admit_move(input))
+          move_key = (char)buf[i + 1];
+        else
+          rate_limited++;
+        i += sizeof(move_req_t);
+      } else if (buf[i] == OP_DISCONNECT) {
+        disconnect = true;
+        i += sizeof(disconnect_req_t);
+      } else {
+        unknown++;
+        i++;
+      }
     }
 
-    // Handle different opcodes
-    switch (move.op_code) {
-    case OP_MOVE:
-      pthread_rwlock_wrlock(&board->state_lock);
-      board->pacmans[0].next_user_move = move.key;
-      pthread_rwlock_unlock(&board->state_lock);
-      break;
+    input->partial_len = len - i;
+    memcpy(input->partial, buf + i, (size_t)input->partial_len);
+
+    if (unknown > 0)
+      flood_warn(session, "%lu bytes with unknown opcodes ignored", unknown);
+    if (rate_limited > 0)
+      flood_warn(session, "%lu moves over the rate limit dropped",
+                 rate_limited);
+    unsigned long applied = (move_key != '\0') ? 1 : 0;
+    flood_account(input, rate_limited, moves - rate_limited - applied,
+                  unknown);
+
+    if (moves > 0) {
+      atomic_fetch_add(&session->cost.moves_received, moves);
+      qos_note_input(session);
+    }
 
-    case OP_DISCONNECT:
-      // Client requested clean disconnect
-      pthread_rwlock_wrlock(&board->state_lock);
-      board->shutdown = 1;
+    if (applied || disconnect) {
+      board_wrlock(board);
+      if (applied) {
+        pacman_t *pacman = &board->pacmans[0];
+        pacman->next_user_move = move_key;
+        events_emit(session, EVENT_INPUT, pacman->pos_x, pacman->pos_y,
+                    pacman->points, move_key);
+      }
+      if (disconnect)
+        board->shutdown = 1; // Client requested clean disconnect
       pthread_rwlock_unlock(&board->state_lock);
-      return NULL;
-
-    default:
-      // Unknown opcode - log but don't crash
-      fprintf(stderr, "[Listener] Warning: Unknown opcode %d ignored\n",
-              move.op_code);
-      break;
     }
+    if (disconnect)
+      break;
   }
 
   // Don't close fd here - owned by worker_task for multi-level reuse
+  cost_add_thread_cpu(session);
   return NULL;
 }
 
@@ -108,69 +188,162 @@ void *input_listener_thread(void *arg) {
  *
  * @param board Pointer to the game board.
  * @param notif_fd File descriptor of the client's notification pipe.
+ * @return ssize_t Bytes written, or -1 on error.
  */
-void server_send_update(board_t *board, int notif_fd) {
+ssize_t server_send_update(board_t *board, int notif_fd) {
   if (notif_fd == -1)
-    return;
+    return -1;
 
   game_state_msg_t msg;
-  msg.op_code = OP_UPDATE;
-  msg.width = board->width;
-  msg.height = board->height;
-  msg.points = board->pacmans[0].points;
-  msg.lives = board->pacmans[0].alive ? 1 : 0;
+  server_build_update(board, &msg);
+  return write(notif_fd, &msg, sizeof(game_state_msg_t));
+}
+
+char server_cell_visual(const board_pos_t *cell) {
+  char visual = cell->content;
+  if (visual == 'X' || visual == 'W')
+    return '#';
+  if (visual == ' ' || visual == '\0') {
+    if (cell->has_portal)
+      return '@';
+    if (cell->has_dot)
+      return '.';
+    return ' ';
+  }
+  return visual;
+}
+
+void server_frame_header(const board_t *board, game_state_msg_t *msg) {
+  msg->op_code = OP_UPDATE;
+  msg->width = board->width;
+  msg->height = board->height;
+  msg->points = board->pacmans[0].points;
+  msg->lives = board->pacmans[0].alive ? 1 : 0;
 
   // Set game state
   if (board->level_finished) {
-    msg.game_state = GAME_STATE_WIN;
+    msg->game_state = GAME_STATE_WIN;
   } else if (!board->pacmans[0].alive) {
-    msg.game_state = GAME_STATE_GAME_OVER;
+    msg->game_state = GAME_STATE_GAME_OVER;
   } else {
-    msg.game_state = GAME_STATE_PLAYING;
+    msg->game_state = GAME_STATE_PLAYING;
   }
 
   // Copy level name
-  strncpy(msg.level_name, board->level_name, MAX_LEVEL_NAME - 1);
-  msg.level_name[MAX_LEVEL_NAME - 1] = '\0';
+  strncpy(msg->level_name, board->level_name, MAX_LEVEL_NAME - 1);
+  msg->level_name[MAX_LEVEL_NAME - 1] = '\0';
+}
+
+void server_build_update(const board_t *board, game_state_msg_t *msg) {
+  server_frame_header(board, msg);
 
   int size = board->width * board->height;
   if (size > MAX_BOARD_SIZE)
     size = MAX_BOARD_SIZE;
-  // what are we doing here?
-  /**
-   * @brief Sends a binary game state update to the connected client.
-   *
-   * Serializes the current board state into a game_state_msg_t structure
-   * and writes it to the client's notification pipe.
-   *
-   * @param board Pointer to the game board.
-   * @param notif_fd File descriptor of the client's notification pipe.
-   */
-  for (int i = 0; i < size; i++) {
-    char visual = board->board[i].content;
-
-    if (visual == 'X' || visual == 'W') {
-      visual = '#';
-    } else if (visual == ' ' || visual == '\0') {
-      if (board->board[i].has_portal) {
-        visual = '@';
-      } else if (board->board[i].has_dot) {
-        visual = '.';
-      } else {
-        visual = ' ';
-      }
-    }
-    msg.board_data[i] = visual;
+  for (int i = 0; i < size; i++)
+    msg->board_data[i] = server_cell_visual(&board->board[i]);
+}
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Charges a written frame to the session's bandwidth counters.
+ * @param session Session the frame was sent for.
+ * @param written Result of the write (ignored when it failed).
+ */
+static void account_frame(session_t *session, ssize_t written) {
+  if (written <= 0)
+    return;
+  atomic_fetch_add(&session->cost.frames_written, 1);
+  atomic_fetch_add(&session->cost.bytes_written, (unsigned long long)written);
+}
+
+/**
+ * @brief Charges a tick, with the board lock wait accrued since the last
+ * one, so the stats history sees lock wait as it happens.
+ */
+static void account_tick(session_t *session, board_t *board) {
+  atomic_fetch_add(&session->cost.ticks, 1);
+  long long waited = atomic_exchange(&board->lock_wait_ns, 0);
+  if (waited > 0)
+    atomic_fetch_add(&session->cost.lock_wait_ns, (unsigned long long)waited);
+}
+
+/**
+ * @brief Ticks per frame under the frame rate cap negotiated in the handshake.
+ */
+static unsigned long frame_divisor(const session_t *session,
+                                   const board_t *board) {
+  if (session->max_fps <= 0 || board->tempo <= 0)
+    return 1;
+  int fps = 1000 / board->tempo;
+  unsigned long divisor =
+      (unsigned long)((fps + session->max_fps - 1) / session->max_fps);
+  return divisor == 0 ? 1 : divisor;
+}
+
+/**
+ * @brief Whether a tick's frame goes to the player: the cap, then QoS.
+ */
+static bool frame_due(session_t *session, unsigned long divisor,
+                      unsigned long tick) {
+  return tick % divisor == 0 && qos_should_send(session, 0, tick);
+}
+
+/**
+ * @brief Takes the send decision of a tick for the calling thread.
+ * @return false if the other thread of the level already took it.
+ */
+static bool claim_frame(speculation_t *spec, unsigned long tick) {
+  return atomic_exchange(&spec->frame_tick, tick) != tick;
+}
+
+/**
+ * @brief Writes the side messages that follow a frame sent to the player.
+ *
+ * The state hash of the frame's tick, then the leaderboard when its top
+ * changed.
+ * @param session Session to charge the bytes to.
+ * @param notif_fd Client's notification pipe.
+ * @param tick Tick the frame stands for.
+ * @param hash Board hash read with the frame.
+ */
+static void send_frame_followers(session_t *session, int notif_fd,
+                                 unsigned long tick, uint64_t hash) {
+  if (session->features & FEAT_STATE_HASH) {
+    state_hash_msg_t state = {
+        .op_code = OP_STATE_HASH, .tick = (uint32_t)tick, .hash = hash};
+    ssize_t hash_written = write(notif_fd, &state, sizeof(state));
+    if (hash_written > 0)
+      atomic_fetch_add(&session->cost.bytes_written,
+                       (unsigned long long)hash_written);
   }
 
-  write(notif_fd, &msg, sizeof(game_state_msg_t));
+  leaderboard_msg_t leaderboard;
+  if ((session->features & FEAT_LEADERBOARD) &&
+      leaderboard_read(&session->leaderboard_seen, &leaderboard)) {
+    ssize_t lb_written = write(notif_fd, &leaderboard, sizeof(leaderboard));
+    if (lb_written > 0)
+      atomic_fetch_add(&session->cost.bytes_written,
+                       (unsigned long long)lb_written);
+  }
 }
 
 /**
  * @brief Dedicated thread for sending periodic updates to the client.
  *
- * Wakes up every tempo milliseconds and sends the current board state.
- * This centralizes updates instead of having each entity thread send updates.
+ * Wakes up on every tick of the session's phase-staggered grid and sends the
+ * current board state. This centralizes updates instead of having each
+ * entity thread send updates. Frames also go to the spectators following the
+ * session. Under overload the QoS controller may ask it to skip frames; the
+ * entity threads keep ticking at full rate.
  *
  * @param arg Pointer to thread_arg_t containing board and notif_fd.
  * @return void* Always NULL.
@@ -179,31 +352,100 @@ void *update_thread(void *arg) {
   thread_arg_t *u_arg = (thread_arg_t *)arg;
   board_t *board = u_arg->board;
   int notif_fd = u_arg->notif_fd;
-  free(u_arg);
+  session_t *session = u_arg->session;
+  speculation_t *spec = u_arg->spec;
+  int slot = session->sched_slot;
+  pthread_setname_np(pthread_self(), "tick-update");
 
-  pthread_rwlock_rdlock(&board->state_lock);
-  server_send_update(board, notif_fd);
+  board_rdlock(board);
+  ssize_t written = server_send_update(board, notif_fd);
   pthread_rwlock_unlock(&board->state_lock);
+  account_frame(session, written);
 
-  while (true) {
-    sleep_ms(board->tempo);
+  unsigned long cap_divisor = frame_divisor(session, board);
 
-    pthread_rwlock_rdlock(&board->state_lock);
+  game_state_msg_t spectator_frame;
+  unsigned int core_seen = ~0u;
+  struct timespec deadline;
+  sched_tick_start(slot, &deadline);
+  while (true) {
+    sched_wait_ticks(slot, &deadline, board->tempo, 1);
+    migrate_follow(session, &core_seen);
+
+    // Read by the pacman thread to pick the tick its move frame stands for
+    __atomic_store_n(&session->ticks, session->ticks + 1, __ATOMIC_RELAXED);
+    account_tick(session, board);
+    // The tick's frame goes out once: here, or with Pacman's move
+    bool send = (spec == NULL || claim_frame(spec, session->ticks)) &&
+                frame_due(session, cap_divisor, session->ticks);
+    bool spectated = atomic_load(&session->spectators) > 0 &&
+                     qos_should_send(session, 1, session->ticks);
+
+    board_rdlock(board);
     if (board->shutdown) {
       pthread_rwlock_unlock(&board->state_lock);
       break;
     }
-    server_send_update(board, notif_fd);
+    written = send ? server_send_update(board, notif_fd) : 0;
+    if (spectated)
+      server_build_update(board, &spectator_frame);
+    uint64_t hash = board->hash;
+    if (board->n_pacmans > 0)
+      leaderboard_set_points(session->leaderboard_slot,
+                             board->pacmans[0].points);
     pthread_rwlock_unlock(&board->state_lock);
+    account_frame(session, written);
+    if (spectated)
+      spectate_publish(session, &spectator_frame);
+
+    if (written > 0)
+      send_frame_followers(session, notif_fd, session->ticks, hash);
   }
+  cost_add_thread_cpu(session);
   return NULL;
 }
 
+/**
+ * @brief Sends the frame of Pacman's move right after it.
+ *
+ * The frame is the prepared outcome of the move patched with the ghosts'
+ * cells, or a full serialization when the move was not predicted. It stands
+ * for the next tick's frame, so it goes out only if that frame would, under
+ * the same cap and QoS decision, and the update thread then skips that tick.
+ * It fits in PIPE_BUF, so it does not interleave with the update thread's
+ * frames.
+ * @param board Level in play.
+ * @param notif_fd Client's notification pipe.
+ * @param session Session to charge the frame to.
+ * @param spec Level's speculation state.
+ * @param move Outcome index of the move made.
+ */
+static void send_move_frame(board_t *board, int notif_fd, session_t *session,
+                            speculation_t *spec, int move) {
+  if (notif_fd == -1)
+    return;
+  unsigned long tick = __atomic_load_n(&session->ticks, __ATOMIC_RELAXED) + 1;
+  if (!claim_frame(spec, tick) ||
+      !frame_due(session, frame_divisor(session, board), tick))
+    return;
+  game_state_msg_t msg;
+  board_rdlock(board);
+  speculate_commit(spec, board, move, &msg);
+  uint64_t hash = board->hash;
+  pthread_rwlock_unlock(&board->state_lock);
+  ssize_t written = write(notif_fd, &msg, sizeof(msg));
+  account_frame(session, written);
+  if (written > 0)
+    send_frame_followers(session, notif_fd, tick, hash);
+}
+
 /**
  * @brief Main logic for the Pacman thread.
  *
  * Handles Pacman's movement, interaction with the board (eating dots, portals),
- * and checks for win/loss conditions. Sends updates to the client after moves.
+ * and checks for win/loss conditions. With speculation on, prepares the
+ * outcomes of its next move while it waits and sends the frame of each move
+ * as soon as it is made.
  *
  * @param arg Pointer to thread_arg_t containing board and notif_fd.
  * @return void* Pointer to an integer containing the exit status (NEXT_LEVEL,
@@ -214,26 +456,46 @@ void *pacman_thread(void *arg) {
   board_t *board = p_arg->board;
 
   pacman_t *pacman = &board->pacmans[0];
-  int *retval = malloc(sizeof(int));
-  *retval = QUIT_GAME;
+  intptr_t retval = QUIT_GAME;
 
-  free(p_arg);
+  session_t *session = p_arg->session;
+  speculation_t *spec = p_arg->spec;
+  int slot = session->sched_slot;
+  pthread_setname_np(pthread_self(), "tick-pacman");
 
+  unsigned int core_seen = ~0u;
+  struct timespec deadline;
+  sched_tick_start(slot, &deadline);
   while (true) {
     if (!pacman->alive) {
-      *retval = LOAD_BACKUP;
-      return (void *)retval;
+      retval = LOAD_BACKUP;
+      break;
     }
+    // Tick boundary: the last move is complete, the next not started
+    if (atomic_load_explicit(&session->migrate_request,
+                             memory_order_relaxed)) {
+      retval = MIGRATE_SESSION;
+      break;
+    }
+    // A scripted Pacman plays on without input
+    if (pacman->n_moves == 0 && qos_should_pause(session)) {
+      retval = PAUSE_SESSION;
+      break;
+    }
+    migrate_follow(session, &core_seen);
+    if (spec != NULL)
+      speculate_prepare(spec, board);
     if (pacman->points >= 20) {
-      sleep_ms(board->tempo * (1 + pacman->passo+1));
+      sched_wait_ticks(slot, &deadline, board->tempo, 1 + pacman->passo + 1);
     } else {
-      sleep_ms(board->tempo * (1 + pacman->passo));
+      sched_wait_ticks(slot, &deadline, board->tempo, 1 + pacman->passo);
     }
 
     command_t c = {' ', 0, 0};
     command_t *play = &c;
 
-    pthread_rwlock_wrlock(&board->state_lock);
+    board_wrlock(board);
+    int spec_move = speculate_move_index(pacman->next_user_move);
     if (pacman->next_user_move != ' ') {
       c.command = pacman->next_user_move;
       pacman->next_user_move = ' ';
@@ -244,24 +506,27 @@ void *pacman_thread(void *arg) {
     pthread_rwlock_unlock(&board->state_lock);
 
     int result = move_pacman(board, 0, play);
-    // Updates now handled by dedicated update_thread
+    // Updates handled by update_thread, unless the move was prepared
+    if (spec != NULL)
+      send_move_frame(board, p_arg->notif_fd, session, spec, spec_move);
 
     if (result == REACHED_PORTAL) {
-      *retval = NEXT_LEVEL;
+      retval = NEXT_LEVEL;
       break;
     }
     if (result == DEAD_PACMAN) {
-      *retval = LOAD_BACKUP;
+      retval = LOAD_BACKUP;
       break;
     }
 
-    pthread_rwlock_rdlock(&board->state_lock);
+    board_rdlock(board);
     if (board->shutdown) {
       pthread_rwlock_unlock(&board->state_lock);
       break;
     }
     pthread_rwlock_unlock(&board->state_lock);
   }
+  cost_add_thread_cpu(session);
   return (void *)retval;
 }
 
@@ -279,17 +544,24 @@ void *ghost_thread(void *arg) {
   thread_arg_t *ghost_arg = (thread_arg_t *)arg;
   board_t *board = ghost_arg->board;
   int ghost_ind = ghost_arg->ghost_index;
-  free(ghost_arg);
+  session_t *session = ghost_arg->session;
+  int slot = session->sched_slot;
+  pthread_setname_np(pthread_self(), "tick-ghost");
 
   ghost_t *ghost = &board->ghosts[ghost_ind];
 
+  unsigned int core_seen = ~0u;
+  struct timespec deadline;
+  sched_tick_start(slot, &deadline);
   while (true) {
-    sleep_ms(board->tempo * (1 + ghost->passo));
+    sched_wait_ticks(slot, &deadline, board->tempo, 1 + ghost->passo);
+    migrate_follow(session, &core_seen);
 
-    pthread_rwlock_rdlock(&board->state_lock);
+    board_rdlock(board);
+    // Return instead of pthread_exit(): unwinding loads libgcc_s (malloc)
     if (board->shutdown) {
       pthread_rwlock_unlock(&board->state_lock);
-      pthread_exit(NULL);
+      break;
     }
     pthread_rwlock_unlock(&board->state_lock);
 
@@ -301,73 +573,197 @@ void *ghost_thread(void *arg) {
       move_ghost(board, ghost_ind, &random_move);
     }
   }
+  cost_add_thread_cpu(session);
   return NULL;
 }
 
+void game_init(void) {
+  const char *mode = getenv("PACMANIST_BOARD_LOCK");
+  board_lock_mode = mode != NULL && strcmp(mode, "striped") == 0
+                        ? BOARD_LOCK_STRIPED
+                        : BOARD_LOCK_GLOBAL;
+}
+
+void game_prepare_board(board_t *board) {
+  // Without the stripes the level simply plays under the global lock
+  if (board_lock_mode == BOARD_LOCK_STRIPED &&
+      board_use_striped_locks(board) != 0)
+    fprintf(stderr, "Failed to create the board's row locks\n");
+}
+
+/**
+ * @brief Starts a level thread on the session's core.
+ *
+ * A core the process may not run on (outside its affinity mask, e.g. under
+ * taskset or a cgroup cpuset) makes pthread_create() fail with EINVAL; the
+ * thread then starts unpinned instead.
+ * @return 0 on success, or the error of the unpinned attempt.
+ */
+static int start_level_thread(pthread_t *tid, const pthread_attr_t *attr,
+                              void *(*start)(void *), void *arg) {
+  if (pthread_create(tid, attr, start, arg) == 0)
+    return 0;
+  int err = pthread_create(tid, NULL, start, arg);
+  if (err == 0 && !atomic_exchange(&unpinned_warned, true))
+    fprintf(stderr, "Cannot pin level threads to their core, running "
+                    "them unpinned\n");
+  return err;
+}
+
 /**
  * @brief Entry point for the game logic of a single level.
  *
- * Spawns threads for Pacman, Ghosts, and the Input Listener. Waits for the
- * Pacman thread to finish (win/loss) before cleaning up all threads.
+ * Spawns threads for Pacman, Ghosts, and the Input Listener, all pinned to
+ * the session's core. Waits for the Pacman thread to finish (win/loss)
+ * before cleaning up all threads.
  *
  * @param game_board Pointer to the initialized game board.
  * @param notif_fd Open file descriptor for client updates.
  * @param req_fd Open file descriptor for reading client requests.
- * @return int Exit status of the level (e.g., NEXT_LEVEL, QUIT_GAME).
+ * @param session Session the level belongs to.
+ * @return int Exit status of the level (e.g., NEXT_LEVEL, QUIT_GAME), or
+ * MIGRATE_SESSION if it stopped at a tick boundary because the session's
+ * migrate_request was set; the board can then be saved or run again.
+ * PAUSE_SESSION if it stopped because the player is idle (pause_session()).
  */
-int run_game_logic(board_t *game_board, int notif_fd, int req_fd) {
+int run_game_logic(board_t *game_board, int notif_fd, int req_fd,
+                   session_t *session) {
   pthread_t pacman_tid, listener_tid, update_tid;
-  pthread_t *ghost_tids = malloc(game_board->n_ghosts * sizeof(pthread_t));
+  pthread_t ghost_tids[MAX_GHOSTS];
+  // Allocated here: the tick threads must not allocate
+  speculation_t *spec = NULL;
+  if (speculate_enabled()) {
+    spec = malloc(sizeof(speculation_t));
+    if (spec != NULL && speculate_alloc(spec, game_board) != 0) {
+      free(spec);
+      spec = NULL;
+    }
+  }
+  // Arguments live on this stack: every thread is joined before returning
+  thread_arg_t update_arg = {.board = game_board,
+                             .notif_fd = notif_fd,
+                             .req_fd = -1,
+                             .session = session,
+                             .spec = spec};
+  thread_arg_t pac_arg = {.board = game_board,
+                          .notif_fd = notif_fd,
+                          .req_fd = -1, // Pacman doesn't use req_fd
+                          .session = session,
+                          .spec = spec};
+  thread_arg_t list_arg = {.board = game_board,
+                           .req_fd = req_fd, // Pass pre-opened fd
+                           .session = session};
+  thread_arg_t ghost_args[MAX_GHOSTS];
+  int n_ghosts = game_board->n_ghosts < MAX_GHOSTS ? game_board->n_ghosts
+                                                   : MAX_GHOSTS;
 
   game_board->shutdown = 0;
 
+  pthread_attr_t attr;
+  placement_thread_attr(&attr,
+                        __atomic_load_n(&session->core, __ATOMIC_RELAXED));
+
   // Create Update Thread (dedicated for sending periodic state updates)
-  thread_arg_t *update_arg = malloc(sizeof(thread_arg_t));
-  update_arg->board = game_board;
-  update_arg->notif_fd = notif_fd;
-  update_arg->req_fd = -1;
-  pthread_create(&update_tid, NULL, update_thread, (void *)update_arg);
-
-  // Create Pacman Thread
-  thread_arg_t *pac_arg = malloc(sizeof(thread_arg_t));
-  pac_arg->board = game_board;
-  pac_arg->notif_fd = notif_fd;
-  pac_arg->req_fd = -1; // Pacman doesn't use req_fd
-  pthread_create(&pacman_tid, NULL, pacman_thread, (void *)pac_arg);
+  bool started =
+      start_level_thread(&update_tid, &attr, update_thread, &update_arg) == 0;
+  bool update_started = started;
 
   // Create Listener Thread
-  thread_arg_t *list_arg = malloc(sizeof(thread_arg_t));
-  list_arg->board = game_board;
-  list_arg->req_fd = req_fd; // Pass pre-opened fd
-  pthread_create(&listener_tid, NULL, input_listener_thread, (void *)list_arg);
+  bool listener_started =
+      started && start_level_thread(&listener_tid, &attr,
+                                    input_listener_thread, &list_arg) == 0;
+  started = listener_started;
 
   // Create Ghost Threads
-  for (int i = 0; i < game_board->n_ghosts; i++) {
-    thread_arg_t *ghost_arg = malloc(sizeof(thread_arg_t));
-    ghost_arg->board = game_board;
-    ghost_arg->ghost_index = i;
-    ghost_arg->notif_fd = notif_fd;
-    pthread_create(&ghost_tids[i], NULL, ghost_thread, (void *)ghost_arg);
+  int ghosts_started = 0;
+  for (int i = 0; i < n_ghosts && started; i++) {
+    ghost_args[i] = (thread_arg_t){.board = game_board,
+                                   .ghost_index = i,
+                                   .notif_fd = notif_fd,
+                                   .session = session};
+    started = start_level_thread(&ghost_tids[i], &attr, ghost_thread,
+                                 &ghost_args[i]) == 0;
+    if (started)
+      ghosts_started++;
   }
 
+  // Create Pacman Thread last: it is the only one that ignores shutdown
+  started = started && start_level_thread(&pacman_tid, &attr, pacman_thread,
+                                          &pac_arg) == 0;
+  pthread_attr_destroy(&attr);
+
   // Blocking wait for the player's thread
-  int *retval;
-  pthread_join(pacman_tid, (void **)&retval);
+  void *retval = (void *)(intptr_t)QUIT_GAME;
+  if (started)
+    pthread_join(pacman_tid, &retval);
+  else
+    fprintf(stderr, "Failed to start the level's threads, ending session\n");
 
   // Signalling ghosts and listener to stop
-  pthread_rwlock_wrlock(&game_board->state_lock);
+  board_wrlock(game_board);
   game_board->shutdown = 1;
   pthread_rwlock_unlock(&game_board->state_lock);
+  if (listener_started && session->wake_fd != -1) {
+    uint64_t one = 1;
+    if (write(session->wake_fd, &one, sizeof(one)) < 0)
+      perror("Failed to wake input listener");
+  }
 
-  pthread_join(listener_tid, NULL);
-  pthread_join(update_tid, NULL);
+  if (listener_started)
+    pthread_join(listener_tid, NULL);
+  if (update_started)
+    pthread_join(update_tid, NULL);
 
-  for (int i = 0; i < game_board->n_ghosts; i++) {
+  for (int i = 0; i < ghosts_started; i++) {
     pthread_join(ghost_tids[i], NULL);
   }
+  if (spec != NULL) {
+    speculate_release(spec);
+    free(spec);
+  }
 
-  free(ghost_tids);
-  int result = *retval;
-  free(retval); 
+  long long waited = atomic_exchange(&game_board->lock_wait_ns, 0);
+  atomic_fetch_add(&session->cost.lock_wait_ns, (unsigned long long)waited);
+  return (int)(intptr_t)retval;
+}
+
+int pause_session(board_t *board, int notif_fd, int req_fd,
+                  session_t *session) {
+  long long start = monotonic_ns();
+  if (notif_fd != -1) {
+    game_state_msg_t msg;
+    server_build_update(board, &msg);
+    msg.game_state = GAME_STATE_PAUSED;
+    account_frame(session, write(notif_fd, &msg, sizeof(msg)));
+  }
+  // Give back the pages freed by the stopped threads and the level's copies
+  malloc_trim(0);
+
+  int result = CONTINUE_PLAY;
+  struct pollfd pfd = {.fd = req_fd, .events = POLLIN};
+  while (true) {
+    int ready = poll(&pfd, 1, PAUSE_POLL_MS);
+    if (ready > 0) {
+      // Input resumes the level, whose listener reads it; a bare hang-up
+      // means the client is gone
+      if (!(pfd.revents & POLLIN))
+        result = QUIT_GAME;
+      else
+        qos_note_input(session);
+      break;
+    }
+    if (ready == -1 && errno != EINTR) {
+      result = QUIT_GAME;
+      break;
+    }
+    if (atomic_load(&session->migrate_request)) {
+      result = MIGRATE_SESSION;
+      break;
+    }
+    // Someone started watching: play on for them
+    if (atomic_load(&session->spectators) > 0)
+      break;
+  }
+  qos_note_resumed(monotonic_ns() - start);
   return result;
 }
@@ -0,0 +1,259 @@
+/**
+ * @file history.c
+ * @brief Stats history: one-second samples written to a mapped ring file.
+ *
+ * The sampler wakes on every wall-clock second, turns the growth of the
+ * cumulative counters (cost totals, the scheduler's lateness histogram)
+ * since the previous wakeup into per-second rates and stores them in the
+ * next slot. It never takes a lock the game threads hold for more than a
+ * copy, and a slow disk only delays the kernel's writeback of the ring.
+ */
+
+#include "../../include/history.h"
+#include "../../include/cost.h"
+#include "../../include/qos.h"
+#include "../../include/scheduler.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Longest history kept, in days (a ring of about 2 GB) */
+#define HISTORY_MAX_DAYS 366
+
+static history_ring_t *ring = NULL;
+static char ring_path[600];
+static int (*queue_probe)(void) = NULL;
+static int ring_reset;
+static uint64_t head_at_start;
+static atomic_ulong samples_late; /* Taken more than 1.5 intervals apart */
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long history_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Resident memory not backed by files, in KiB.
+ *
+ * Leaves out the ring's own pages, which would otherwise grow the figure
+ * for days after a restart.
+ */
+static uint32_t read_rss_kb(void) {
+  char buf[128];
+  int fd = open("/proc/self/statm", O_RDONLY);
+  if (fd == -1)
+    return 0;
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0)
+    return 0;
+  buf[n] = '\0';
+  unsigned long size, resident, shared;
+  if (sscanf(buf, "%lu %lu %lu", &size, &resident, &shared) != 3 ||
+      resident < shared)
+    return 0;
+  unsigned long page_kb = (unsigned long)sysconf(_SC_PAGESIZE) / 1024;
+  return (uint32_t)((resident - shared) * page_kb);
+}
+
+/**
+ * @brief Converts the growth of a counter to a per-second rate.
+ */
+static double per_second(unsigned long long now, unsigned long long before,
+                         long long elapsed_ns) {
+  if (now < before || elapsed_ns <= 0)
+    return 0.0;
+  return (double)(now - before) * 1e9 / (double)elapsed_ns;
+}
+
+/**
+ * @brief Clamps a rate to a sample field.
+ */
+static uint32_t clamp32(double value) {
+  if (value >= 4294967295.0)
+    return UINT32_MAX;
+  return (uint32_t)(value + 0.5);
+}
+
+/**
+ * @brief Stores the next sample, clearing its number while it is written.
+ */
+static void append(history_sample_t *sample) {
+  uint64_t n = ring->head + 1;
+  history_sample_t *slot = &ring->samples[(n - 1) % ring->slots];
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy((char *)slot + offsetof(history_sample_t, time),
+         (const char *)sample + offsetof(history_sample_t, time),
+         sizeof(*sample) - offsetof(history_sample_t, time));
+  __atomic_store_n(&slot->seq, n, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, n, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Sleeps until the next whole wall-clock second.
+ * @return That second, as a Unix time.
+ */
+static int64_t sleep_to_next_interval(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  struct timespec next = {.tv_sec = now.tv_sec + HISTORY_INTERVAL_S,
+                          .tv_nsec = 0};
+  while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next, NULL) == EINTR)
+    ;
+  return (int64_t)next.tv_sec;
+}
+
+/**
+ * @brief Sampler thread: appends one sample per interval.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *sampler_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  cost_totals_t prev, cur;
+  unsigned long long prev_late[SCHED_LATE_BUCKETS];
+  unsigned long long cur_late[SCHED_LATE_BUCKETS];
+  unsigned long long window[SCHED_LATE_BUCKETS];
+  cost_totals(&prev);
+  sched_lateness_snapshot(prev_late);
+  long long prev_ns = history_now_ns();
+
+  while (1) {
+    int64_t second = sleep_to_next_interval();
+
+    cost_totals(&cur);
+    sched_lateness_snapshot(cur_late);
+    long long now_ns = history_now_ns();
+    long long elapsed = now_ns - prev_ns;
+    if (elapsed > HISTORY_INTERVAL_S * 1500000000LL)
+      atomic_fetch_add(&samples_late, 1);
+    for (int b = 0; b < SCHED_LATE_BUCKETS; b++)
+      window[b] = cur_late[b] - prev_late[b];
+
+    history_sample_t sample = {0};
+    sample.time = second;
+    sample.sessions = (uint32_t)cur.sessions;
+    sample.queue_depth = queue_probe != NULL ? (uint32_t)queue_probe() : 0;
+    sample.ticks = clamp32(per_second(cur.ticks, prev.ticks, elapsed));
+    sample.frames =
+        clamp32(per_second(cur.frames_written, prev.frames_written, elapsed));
+    sample.bytes = (uint64_t)(
+        per_second(cur.bytes_written, prev.bytes_written, elapsed) + 0.5);
+    sample.p99_late_us = (uint32_t)sched_lateness_percentile(window, 99.0);
+    sample.lock_wait_us = clamp32(
+        per_second(cur.lock_wait_ns, prev.lock_wait_ns, elapsed) / 1000.0);
+    sample.rss_kb = read_rss_kb();
+    sample.qos_level = (uint32_t)qos_level();
+    append(&sample);
+
+    prev = cur;
+    memcpy(prev_late, cur_late, sizeof(prev_late));
+    prev_ns = now_ns;
+  }
+  return NULL;
+}
+
+int history_start(int (*queue_depth)(void)) {
+  const char *env = getenv("PACMANIST_HISTORY_DAYS");
+  int days = env != NULL ? atoi(env) : 7;
+  if (days <= 0)
+    return 0;
+  if (days > HISTORY_MAX_DAYS)
+    days = HISTORY_MAX_DAYS;
+  uint32_t slots = (uint32_t)days * 86400u / HISTORY_INTERVAL_S;
+  size_t size = history_ring_size(slots);
+
+  const char *dir = getenv("PACMANIST_DATA_DIR");
+  if (dir == NULL || dir[0] == '\0')
+    dir = "data";
+  if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+    return -1;
+  snprintf(ring_path, sizeof(ring_path), "%s/history.ring", dir);
+
+  int fd = open(ring_path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1)
+    return -1;
+  // Keep the samples only if the ring has the layout and length asked for
+  history_ring_t header;
+  struct stat st;
+  int valid = fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+              pread(fd, &header, sizeof(header), 0) ==
+                  (ssize_t)sizeof(header) &&
+              header.magic == HISTORY_MAGIC &&
+              header.version == HISTORY_VERSION && header.slots == slots &&
+              header.interval_s == HISTORY_INTERVAL_S;
+  // Truncating first zeroes every slot, so stale samples never reappear
+  if (!valid && (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)size) != 0)) {
+    close(fd);
+    return -1;
+  }
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return -1;
+  ring = (history_ring_t *)base;
+
+  if (!valid) {
+    ring->magic = HISTORY_MAGIC;
+    ring->version = HISTORY_VERSION;
+    ring->slots = slots;
+    ring->interval_s = HISTORY_INTERVAL_S;
+    ring->created = (int64_t)time(NULL);
+    ring_reset = 1;
+  }
+  head_at_start = ring->head;
+  queue_probe = queue_depth;
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, sampler_thread, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+void history_dump_stats(FILE *f) {
+  fprintf(f, "=== STATS HISTORY ===\n");
+  if (ring == NULL) {
+    fprintf(f, "Disabled\n");
+    return;
+  }
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t kept = head < ring->slots ? head : ring->slots;
+  fprintf(f, "Ring: %s, %u slots (%.1f days), %.1f MB%s\n", ring_path,
+          ring->slots, (double)ring->slots * HISTORY_INTERVAL_S / 86400.0,
+          (double)history_ring_size(ring->slots) / (1024.0 * 1024.0),
+          ring_reset ? ", started over" : "");
+  fprintf(f, "Samples: %llu kept, %llu this run, %lu late\n",
+          (unsigned long long)kept, (unsigned long long)(head - head_at_start),
+          atomic_load(&samples_late));
+
+  history_sample_t last;
+  if (head > 0 && history_read(ring, head, &last) == 0)
+    fprintf(f,
+            "Last: %u sessions, %u queued, %u ticks/s, %u fps, %llu B/s, "
+            "p99 late < %u us, lock wait %u us/s, RSS %u KiB, QoS %u\n",
+            last.sessions, last.queue_depth, last.ticks, last.frames,
+            (unsigned long long)last.bytes, last.p99_late_us,
+            last.lock_wait_us, last.rss_kb, last.qos_level);
+}
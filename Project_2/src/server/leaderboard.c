@@ -0,0 +1,224 @@
+/**
+ * @file leaderboard.c
+ * @brief Live leaderboard: per-session slots and a versioned top-N snapshot.
+ *
+ * The hot path (leaderboard_set_points() every frame, leaderboard_read()
+ * every sent frame) touches one atomic each when nothing changed. All the
+ * sorting happens in the publisher thread, which takes no lock the game
+ * threads use: the snapshot is published under a sequence lock.
+ */
+
+#include "../../include/leaderboard.h"
+#include "../../include/board.h"
+#include "../../include/scores.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Default minimum time between rebuilds */
+#define LEADERBOARD_PERIOD_MS 250
+/** @brief Copies leaderboard_read() tries before giving up for this frame */
+#define LEADERBOARD_READ_TRIES 64
+
+typedef struct {
+  atomic_int used;    /**< 1 for a running session, -1 while claimed */
+  atomic_int points;  /**< Points at the last frame */
+  int client_id;      /**< Written before used is set */
+  char name[LEADERBOARD_NAME];
+} live_slot_t;
+
+static live_slot_t live[LEADERBOARD_MAX_LIVE];
+static atomic_int dirty;
+static int period_ms = LEADERBOARD_PERIOD_MS;
+
+/* Published snapshot: msg is only valid while seqlock is even */
+static leaderboard_msg_t published;
+static atomic_uint published_version;
+static atomic_ulong seqlock;
+
+static atomic_ulong rebuilds;
+static atomic_ulong unchanged;
+static atomic_ulong sent;
+static atomic_ulong live_full;
+static atomic_ulong reads_deferred;
+
+/**
+ * @brief Orders entries best first, live ones first among equal scores.
+ */
+static int compare_entries(const void *a, const void *b) {
+  const leaderboard_entry_t *ea = a, *eb = b;
+  if (ea->points != eb->points)
+    return ea->points < eb->points ? 1 : -1;
+  return (int)eb->flags - (int)ea->flags;
+}
+
+/**
+ * @brief Rebuilds the top entries and publishes them if they changed.
+ * @param stored Best scores of the store.
+ * @param n_stored Number of stored entries.
+ */
+static void rebuild(const score_record_t *stored, int n_stored) {
+  static leaderboard_entry_t candidates[LEADERBOARD_MAX_LIVE +
+                                        LEADERBOARD_SIZE];
+  int n = 0;
+  for (int i = 0; i < LEADERBOARD_MAX_LIVE; i++) {
+    // A slot still being claimed (-1) has its name half written
+    if (atomic_load_explicit(&live[i].used, memory_order_acquire) != 1)
+      continue;
+    leaderboard_entry_t *e = &candidates[n++];
+    memset(e, 0, sizeof(*e));
+    e->client_id = live[i].client_id;
+    e->points = atomic_load_explicit(&live[i].points, memory_order_relaxed);
+    e->flags = LEADERBOARD_PLAYING;
+    memcpy(e->name, live[i].name, LEADERBOARD_NAME);
+  }
+  for (int i = 0; i < n_stored; i++) {
+    leaderboard_entry_t *e = &candidates[n++];
+    memset(e, 0, sizeof(*e));
+    e->client_id = stored[i].client_id;
+    e->points = stored[i].points;
+    strncpy(e->name, stored[i].player, LEADERBOARD_NAME - 1);
+  }
+  qsort(candidates, (size_t)n, sizeof(candidates[0]), compare_entries);
+  if (n > LEADERBOARD_SIZE)
+    n = LEADERBOARD_SIZE;
+  atomic_fetch_add(&rebuilds, 1);
+
+  if (n == published.count &&
+      memcmp(candidates, published.entries, (size_t)n * sizeof(*candidates)) ==
+          0) {
+    atomic_fetch_add(&unchanged, 1);
+    return;
+  }
+
+  atomic_fetch_add_explicit(&seqlock, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memset(&published, 0, sizeof(published));
+  published.op_code = OP_LEADERBOARD;
+  published.count = (uint8_t)n;
+  published.version = atomic_load(&published_version) + 1;
+  memcpy(published.entries, candidates, (size_t)n * sizeof(*candidates));
+  atomic_fetch_add_explicit(&seqlock, 1, memory_order_release);
+  atomic_store_explicit(&published_version, published.version,
+                        memory_order_release);
+}
+
+/**
+ * @brief Publisher thread: rebuilds the leaderboard when scores changed.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *publisher_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  score_record_t stored[LEADERBOARD_SIZE];
+  uint64_t seen_records = 0;
+  while (1) {
+    sleep_ms(period_ms);
+    uint64_t records = 0;
+    int n_stored = scores_top(stored, LEADERBOARD_SIZE, &records);
+    if (n_stored < 0)
+      n_stored = 0;
+    // Finished sessions reach the store a commit after leaving the slots
+    if (!atomic_exchange(&dirty, 0) && records == seen_records)
+      continue;
+    seen_records = records;
+    rebuild(stored, n_stored);
+  }
+  return NULL;
+}
+
+int leaderboard_start(void) {
+  const char *period = getenv("PACMANIST_LEADERBOARD_MS");
+  if (period != NULL && atoi(period) > 0)
+    period_ms = atoi(period);
+  atomic_store(&dirty, 1);
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, publisher_thread, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+int leaderboard_join(int client_id, const char *name) {
+  for (int i = 0; i < LEADERBOARD_MAX_LIVE; i++) {
+    if (atomic_load_explicit(&live[i].used, memory_order_relaxed))
+      continue;
+    int expected = 0;
+    // Claim with -1 so the publisher skips the slot until it is filled in
+    if (!atomic_compare_exchange_strong(&live[i].used, &expected, -1))
+      continue;
+    live[i].client_id = client_id;
+    memset(live[i].name, 0, LEADERBOARD_NAME);
+    strncpy(live[i].name, name, LEADERBOARD_NAME - 1);
+    atomic_store_explicit(&live[i].points, 0, memory_order_relaxed);
+    atomic_store_explicit(&live[i].used, 1, memory_order_release);
+    atomic_store(&dirty, 1);
+    return i;
+  }
+  atomic_fetch_add(&live_full, 1);
+  return -1;
+}
+
+void leaderboard_set_points(int slot, int points) {
+  if (slot < 0)
+    return;
+  if (atomic_load_explicit(&live[slot].points, memory_order_relaxed) ==
+      points)
+    return;
+  atomic_store_explicit(&live[slot].points, points, memory_order_relaxed);
+  atomic_store_explicit(&dirty, 1, memory_order_relaxed);
+}
+
+void leaderboard_leave(int slot) {
+  if (slot < 0)
+    return;
+  atomic_store_explicit(&live[slot].used, 0, memory_order_release);
+  atomic_store(&dirty, 1);
+}
+
+int leaderboard_read(uint32_t *seen, leaderboard_msg_t *out) {
+  if (atomic_load_explicit(&published_version, memory_order_acquire) ==
+      *seen)
+    return 0;
+  /* Copied aside, so out keeps the last good copy if the publisher keeps
+   * the lock; the next frame tries again */
+  leaderboard_msg_t copy;
+  for (int tries = 0; tries < LEADERBOARD_READ_TRIES; tries++) {
+    unsigned long before =
+        atomic_load_explicit(&seqlock, memory_order_acquire);
+    if (before & 1)
+      continue;
+    memcpy(&copy, &published, sizeof(copy));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&seqlock, memory_order_relaxed) == before) {
+      memcpy(out, &copy, sizeof(*out));
+      *seen = out->version;
+      atomic_fetch_add(&sent, 1);
+      return 1;
+    }
+  }
+  atomic_fetch_add(&reads_deferred, 1);
+  return 0;
+}
+
+void leaderboard_dump_stats(FILE *f) {
+  fprintf(f, "=== LEADERBOARD ===\n");
+  fprintf(f, "Version: %u, rebuilds: %lu (%lu unchanged), every >= %d ms\n",
+          atomic_load(&published_version), atomic_load(&rebuilds),
+          atomic_load(&unchanged), period_ms);
+  fprintf(f,
+          "Messages sent: %lu (%lu deferred to the next frame), sessions not "
+          "listed (slots full): %lu\n",
+          atomic_load(&sent), atomic_load(&reads_deferred),
+          atomic_load(&live_full));
+}
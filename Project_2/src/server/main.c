@@ -5,19 +5,38 @@
  * @author Eric Muthami
  */
 
+#include "../../include/archive.h"
 #include "../../include/board.h"
+#include "../../include/catalog.h"
+#include "../../include/cost.h"
+#include "../../include/events.h"
+#include "../../include/flood.h"
 #include "../../include/game.h"
+#include "../../include/history.h"
+#include "../../include/leaderboard.h"
+#include "../../include/migrate.h"
+#include "../../include/placement.h"
 #include "../../include/protocol.h"
-#include <dirent.h>
+#include "../../include/qos.h"
+#include "../../include/replica.h"
+#include "../../include/scheduler.h"
+#include "../../include/scores.h"
+#include "../../include/session.h"
+#include "../../include/spectate.h"
+#include "../../include/speculate.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 /* Global configuration */
@@ -28,8 +47,16 @@ char *global_levels_dir = NULL;
 typedef struct {
   char req_pipe[PIPE_NAME_SIZE];
   char notif_pipe[PIPE_NAME_SIZE];
+  unsigned int features; /* FEAT_* bits agreed in the handshake */
+  int max_fps;           /* Negotiated frame rate cap (0 for none) */
+  migrate_session_t *resume; /* Session moved from another shard or kept by
+                                the standby, or NULL */
 } game_session_t;
 
+/* Features this server implements for the extended handshake */
+#define SERVER_FEATURES                                                        \
+  (FEAT_FRAME_RATE_CAP | FEAT_LEADERBOARD | FEAT_STATE_HASH | FEAT_RESUME)
+
 game_session_t *session_buffer = NULL;
 int buffer_size = 0;
 int buffer_in = 0;
@@ -51,7 +78,12 @@ typedef struct {
 
 score_entry_t scoreboard[MAX_SCOREBOARD];
 pthread_mutex_t scoreboard_mutex = PTHREAD_MUTEX_INITIALIZER;
-int next_client_id = 1;
+
+/* Copy of the score store index taken for score_log.txt */
+static scores_index_t score_snapshot;
+
+/* Set once every module has started and the registration FIFO is ours */
+static atomic_int serving;
 
 /**
  * @brief Comparator function for qsort to sort scores in descending order.
@@ -67,37 +99,21 @@ static int compare_scores(const void *a, const void *b) {
 }
 
 /**
- * @brief Sorts level filenames alphabetically using bubble sort.
- *
- * @param files Matrix of filenames to sort.
- * @param count Number of files in the matrix.
- */
-static void sort_level_files(char files[][512], int count) {
-  for (int i = 0; i < count - 1; i++) {
-    for (int j = i + 1; j < count; j++) {
-      if (strcmp(files[i], files[j]) > 0) {
-        char temp[512];
-        strncpy(temp, files[i], 512);
-        strncpy(files[i], files[j], 512);
-        strncpy(files[j], temp, 512);
-      }
-    }
-  }
-}
-
-/**
- * @brief Signal handler for SIGINT and SIGTERM.
- *
- * Performs graceful server shutdown: unlinks the registration FIFO,
- * destroys synchronization primitives, and exits.
+ * @brief Shuts the server down on SIGINT or SIGTERM (signal thread).
  *
- * @param sig Signal number (SIGINT or SIGTERM).
+ * Performs graceful server shutdown: unlinks the registration FIFO, drains
+ * the event bus into the archive and flushes it, stops the shard and
+ * replication sockets, destroys synchronization primitives, and exits.
  */
-void handle_cleanup(int sig) {
-  (void)sig;
+static void shutdown_server(void) {
   if (global_fifo_name != NULL) {
     unlink(global_fifo_name);
   }
+  /* Events still queued reach the archive before it is flushed */
+  if (events_stop() == 0)
+    archive_stop();
+  migrate_stop();
+  replica_stop();
   sem_destroy(&sem_empty);
   sem_destroy(&sem_full);
   pthread_mutex_destroy(&buffer_mutex);
@@ -106,48 +122,205 @@ void handle_cleanup(int sig) {
 }
 
 /**
- * @brief Signal handler for SIGUSR1.
- *
- * Sorts the scoreboard and writes the top 5 active/completed client scores
- * to score_log.txt. Thread-safe via scoreboard_mutex.
+ * @brief Writes the server performance statistics to stats_log.txt.
+ */
+static void write_stats_log(void) {
+  FILE *f = fopen("stats_log.txt", "w");
+  if (f == NULL)
+    return;
+  sched_dump_stats(f);
+  catalog_dump_stats(f);
+  placement_dump_stats(f);
+  cost_dump_stats(f);
+  qos_dump_stats(f);
+  flood_dump_stats(f);
+  events_dump_stats(f);
+  archive_dump_stats(f);
+  scores_dump_stats(f);
+  leaderboard_dump_stats(f);
+  migrate_dump_stats(f);
+  speculate_dump_stats(f);
+  spectate_dump_stats(f);
+  replica_dump_stats(f);
+  history_dump_stats(f);
+  fclose(f);
+}
+
+/**
+ * @brief Writes the top scores to score_log.txt.
  *
- * @param sig Signal number (unused, always SIGUSR1).
+ * Merges the all-time top scores of the score store with the sessions still
+ * playing and writes the top 5, followed by every player's best.
+ * Thread-safe via scoreboard_mutex; the store is read without locking.
  */
-void handle_sigusr1(int sig) {
-  (void)sig;
+static void write_score_log(void) {
   pthread_mutex_lock(&scoreboard_mutex);
 
   score_entry_t sorted[MAX_SCOREBOARD];
   memcpy(sorted, scoreboard, sizeof(scoreboard));
   qsort(sorted, MAX_SCOREBOARD, sizeof(score_entry_t), compare_scores);
 
+  int stored = scores_snapshot(&score_snapshot) == 0;
+  int top_count = stored ? (int)score_snapshot.top_count : 0;
+
   FILE *f = fopen("score_log.txt", "w");
   if (f) {
     fprintf(f, "=== TOP 5 SCORES ===\n");
-    int count = 0;
-    for (int i = 0; i < MAX_SCOREBOARD && count < 5; i++) {
-      if (sorted[i].score > 0 || sorted[i].active) {
-        fprintf(f, "%d. Client %d: %d points%s\n", count + 1,
-                sorted[i].client_id, sorted[i].score,
-                sorted[i].active ? " (playing)" : "");
-        count++;
+    /* Finished sessions come from the store, live ones from the scoreboard */
+    int count = 0, s = 0, a = 0;
+    while (count < 5) {
+      while (a < MAX_SCOREBOARD && !sorted[a].active)
+        a++;
+      int take_live = a < MAX_SCOREBOARD &&
+                      (s >= top_count ||
+                       sorted[a].score > score_snapshot.top[s].points);
+      if (take_live) {
+        fprintf(f, "%d. Client %d: %d points (playing)\n", count + 1,
+                sorted[a].client_id, sorted[a].score);
+        a++;
+      } else if (s < top_count) {
+        const score_record_t *r = &score_snapshot.top[s++];
+        fprintf(f, "%d. Client %d (%s): %d points\n", count + 1, r->client_id,
+                r->player, r->points);
+      } else {
+        break;
       }
+      count++;
     }
     if (count == 0) {
       fprintf(f, "No scores recorded yet.\n");
     }
+    if (stored && score_snapshot.players > 0) {
+      fprintf(f, "=== BEST PER PLAYER ===\n");
+      for (int i = 0; i < SCORES_PLAYER_SLOTS; i++) {
+        const score_player_t *p = &score_snapshot.slots[i];
+        if (p->player[0] != '\0')
+          fprintf(f, "%s: %d points (%u sessions)\n", p->player, p->best,
+                  p->sessions);
+      }
+    }
     fclose(f);
   }
 
   pthread_mutex_unlock(&scoreboard_mutex);
 }
 
+/**
+ * @brief Signal thread: answers SIGUSR1 with score_log.txt and
+ * stats_log.txt, and SIGINT or SIGTERM with a shutdown.
+ *
+ * Every other thread has these signals blocked, so the work is done here
+ * and not in a handler: the logs and the shutdown take locks that an
+ * interrupted thread could be holding, and the shutdown waits for others.
+ * Until the server is serving (a standby follows its primary for as long
+ * as the primary lives), SIGUSR1 only writes the replication stats and
+ * SIGINT or SIGTERM exit without touching the FIFO.
+ *
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *signal_thread(void *arg) {
+  (void)arg;
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  while (1) {
+    int sig;
+    if (sigwait(&set, &sig) != 0)
+      continue;
+    if (!atomic_load(&serving)) {
+      /* A standby still following, or a server starting: the FIFO and
+       * most modules are not ours yet */
+      if (sig != SIGUSR1)
+        exit(EXIT_SUCCESS);
+      FILE *f = fopen("stats_log.txt", "w");
+      if (f != NULL) {
+        replica_dump_stats(f);
+        fclose(f);
+      }
+      continue;
+    }
+    if (sig != SIGUSR1)
+      shutdown_server();
+    write_score_log();
+    write_stats_log();
+  }
+  return NULL;
+}
+
+/**
+ * @brief Player name of a session: its request pipe without the directory
+ * and the "pacman_req_" prefix the client puts in front of its id.
+ *
+ * @param req_pipe Path of the client's request pipe.
+ * @return const char* Pointer into req_pipe.
+ */
+static const char *player_name(const char *req_pipe) {
+  const char *name = strrchr(req_pipe, '/');
+  name = name != NULL ? name + 1 : req_pipe;
+  if (strncmp(name, "pacman_req_", 11) == 0 && name[11] != '\0')
+    name += 11;
+  return name;
+}
+
+/**
+ * @brief Collects what another process needs to continue a session.
+ *
+ * @param game_session Session to describe.
+ * @param level Catalog index of the level.
+ * @param levels_cleared Levels completed so far.
+ * @param player Player name.
+ * @param state Filled with the session state.
+ */
+static void session_state(const session_t *game_session, int level,
+                          int levels_cleared, const char *player,
+                          migrate_state_t *state) {
+  memset(state, 0, sizeof(*state));
+  state->client_id = game_session->client_id;
+  state->features = game_session->features;
+  state->max_fps = game_session->max_fps;
+  state->level = level;
+  state->levels_cleared = levels_cleared;
+  state->leaderboard_seen = game_session->leaderboard_seen;
+  state->input_tokens = game_session->input.tokens;
+  state->input_partial_len = game_session->input.partial_len;
+  memcpy(state->input_partial, game_session->input.partial,
+         sizeof(state->input_partial));
+  strncpy(state->player, player, PIPE_NAME_SIZE - 1);
+  state->resume_token = game_session->resume_token;
+}
+
+/**
+ * @brief Sends a session stopped at a tick boundary to the peer shard.
+ *
+ * @param game_session Session to move.
+ * @param board Level in play.
+ * @param level Catalog index of the level.
+ * @param levels_cleared Levels completed so far.
+ * @param player Player name.
+ * @param notif_fd Client's notification pipe.
+ * @param req_fd Client's request pipe.
+ * @return 0 if the peer took the session, -1 to resume it here.
+ */
+static int send_session(session_t *game_session, const board_t *board,
+                        int level, int levels_cleared, const char *player,
+                        int notif_fd, int req_fd) {
+  migrate_state_t state;
+  session_state(game_session, level, levels_cleared, player, &state);
+  return migrate_send(game_session, &state, board, notif_fd, req_fd);
+}
+
 /**
  * @brief Worker thread function (Consumer in Producer-Consumer pattern).
  *
  * Waits for game sessions in the shared buffer, retrieves client pipe paths,
  * loads levels, runs game logic, and manages the client scoreboard entry.
- * Blocks SIGUSR1 to ensure only the main thread handles it.
+ * A session received from another shard, or resumed by its client from the
+ * standby's copy, continues its level where it stopped; a session sent to
+ * another shard ends here without being recorded.
+ * Blocks SIGUSR1 to ensure only the signal thread handles it.
  *
  * @param arg Pointer to an integer containing the worker thread ID.
  * @return void* Always returns NULL.
@@ -156,7 +329,7 @@ void *worker_task(void *arg) {
   int thread_id = *(int *)arg;
   free(arg);
 
-  /* Block SIGUSR1 - only main thread handles it */
+  /* Block SIGUSR1 - only the signal thread handles it */
   sigset_t set;
   sigemptyset(&set);
   sigaddset(&set, SIGUSR1);
@@ -170,55 +343,65 @@ void *worker_task(void *arg) {
     buffer_out = (buffer_out + 1) % buffer_size;
     pthread_mutex_unlock(&buffer_mutex);
     sem_post(&sem_empty);
+    migrate_session_t *resume = session.resume;
 
-    /* Load level files */
-    char level_files[32][512];
-    int level_count = 0;
-
-    DIR *d = opendir(global_levels_dir);
-    if (!d) {
-      fprintf(stderr, "Worker %d: Cannot open levels directory\n", thread_id);
-      continue;
-    }
-
-    struct dirent *dir;
-    while ((dir = readdir(d)) != NULL && level_count < 32) {
-      if (strstr(dir->d_name, ".lvl") || strstr(dir->d_name, ".txt")) {
-        snprintf(level_files[level_count], sizeof(level_files[0]), "%s/%s",
-                 global_levels_dir, dir->d_name);
-        level_count++;
-      }
-    }
-    closedir(d);
+    /* Pin the catalog version for the whole session; levels are already
+     * parsed, so no level file is read from here on */
+    level_catalog_t *catalog = catalog_acquire();
+    int level_count = catalog->count;
 
-    if (level_count == 0) {
+    if (level_count == 0 ||
+        (resume != NULL && resume->state.level >= level_count)) {
       fprintf(stderr, "Worker %d: No level files found\n", thread_id);
+      migrate_session_free(resume);
+      catalog_release(catalog);
       continue;
     }
 
-    /* Sort levels alphabetically */
-    sort_level_files(level_files, level_count);
-
-    /* Open client pipes */
-    int notif_fd = open(session.notif_pipe, O_WRONLY);
-    if (notif_fd == -1) {
-      fprintf(stderr, "Worker %d: Failed to open notification pipe\n",
-              thread_id);
-      continue;
-    }
+    /* Open client pipes; a migrated session brings them along */
+    int notif_fd, req_fd;
+    char player[PIPE_NAME_SIZE];
+    if (resume != NULL && resume->notif_fd != -1) {
+      notif_fd = resume->notif_fd;
+      req_fd = resume->req_fd;
+      memcpy(player, resume->state.player, sizeof(player));
+    } else {
+      notif_fd = open(session.notif_pipe, O_WRONLY);
+      if (notif_fd == -1) {
+        fprintf(stderr, "Worker %d: Failed to open notification pipe\n",
+                thread_id);
+        migrate_session_free(resume);
+        catalog_release(catalog);
+        continue;
+      }
 
-    int req_fd = open(session.req_pipe, O_RDONLY);
-    if (req_fd == -1) {
-      fprintf(stderr, "Worker %d: Failed to open request pipe\n", thread_id);
-      close(notif_fd);
-      continue;
+      req_fd = open(session.req_pipe, O_RDONLY);
+      if (req_fd == -1) {
+        fprintf(stderr, "Worker %d: Failed to open request pipe\n",
+                thread_id);
+        close(notif_fd);
+        migrate_session_free(resume);
+        catalog_release(catalog);
+        continue;
+      }
+      if (resume != NULL) {
+        /* Resumed from the standby's copy: answer once the pipes are ours */
+        resume_resp_t resp = {.op_code = OP_RESUME, .result = 0};
+        if (write(notif_fd, &resp, sizeof(resp)) < 0)
+          perror("Failed to answer resume request");
+        memcpy(player, resume->state.player, sizeof(player));
+      } else {
+        strncpy(player, player_name(session.req_pipe), sizeof(player));
+        player[PIPE_NAME_SIZE - 1] = '\0';
+      }
     }
 
     /* Register in scoreboard */
     int my_client_id = 0;
     int my_scoreboard_idx = -1;
     pthread_mutex_lock(&scoreboard_mutex);
-    my_client_id = next_client_id++;
+    my_client_id = resume != NULL ? resume->state.client_id
+                                  : scores_next_client_id();
     for (int i = 0; i < MAX_SCOREBOARD; i++) {
       if (!scoreboard[i].active) {
         scoreboard[i].client_id = my_client_id;
@@ -230,23 +413,123 @@ void *worker_task(void *arg) {
     }
     pthread_mutex_unlock(&scoreboard_mutex);
 
+    /* Take a tick phase slot; the period is set per level below */
+    session_t game_session = {.client_id = my_client_id,
+                              .sched_slot = sched_register(0),
+                              .core = placement_assign(),
+                              .wake_fd = eventfd(0, EFD_CLOEXEC),
+                              .features = session.features,
+                              .max_fps = session.max_fps,
+                              .replica_slot = -1,
+                              .leaderboard_slot =
+                                  leaderboard_join(my_client_id, player)};
+    cost_session_begin(&game_session);
+    qos_note_input(&game_session);
+    flood_session_init(&game_session.input);
+    if (resume != NULL) {
+      game_session.features = resume->state.features;
+      game_session.max_fps = resume->state.max_fps;
+      game_session.leaderboard_seen = resume->state.leaderboard_seen;
+      game_session.input.tokens = resume->state.input_tokens;
+      game_session.input.partial_len = resume->state.input_partial_len;
+      memcpy(game_session.input.partial, resume->state.input_partial,
+             sizeof(game_session.input.partial));
+    }
+    migrate_register(&game_session);
+    spectate_register(&game_session);
+    replica_register(&game_session,
+                     resume != NULL ? resume->state.resume_token : 0);
+    if (game_session.features & FEAT_RESUME) {
+      resume_token_msg_t token = {.op_code = OP_RESUME_TOKEN,
+                                  .token = game_session.resume_token};
+      if (write(notif_fd, &token, sizeof(token)) < 0)
+        perror("Failed to send resume token");
+    }
+    unsigned long long worker_cpu_start = cost_thread_cpu_ns();
+    events_emit(&game_session, EVENT_SESSION_START, -1, -1, 0,
+                (int)game_session.features);
+
     /* Run game levels */
     int accumulated_points = 0;
+    int levels_cleared = 0;
     int current_level = 0;
     int game_result = NEXT_LEVEL;
+    int migrated = 0;
+    if (resume != NULL) {
+      accumulated_points = resume->board.pacmans[0].points;
+      levels_cleared = resume->state.levels_cleared;
+      current_level = resume->state.level;
+    }
 
     while (current_level < level_count && game_result == NEXT_LEVEL) {
+      /* The rebalancer may have moved the session to another core; pin
+       * before copying so the board is first touched there */
+      placement_pin_self(__atomic_load_n(&game_session.core, __ATOMIC_RELAXED));
+
       board_t board;
       memset(&board, 0, sizeof(board));
 
-      if (load_level(&board, level_files[current_level], accumulated_points) !=
-          0) {
+      if (resume != NULL) {
+        /* Resume the level where the other shard stopped it; the lock of
+         * the restored copy was never used, so it is simply re-created */
+        memcpy(&board, &resume->board, sizeof(board));
+        pthread_rwlock_init(&board.state_lock, NULL);
+        free(resume);
+        resume = NULL;
+      } else if (board_clone(&board, &catalog->levels[current_level].board,
+                             accumulated_points) != 0) {
         fprintf(stderr, "Worker %d: Failed to load level\n", thread_id);
         break;
       }
-
-      game_result = run_game_logic(&board, notif_fd, req_fd);
-
+      game_session.level_id =
+          archive_level_id(board.level_name, board.width, board.height);
+      game_prepare_board(&board);
+      board.on_event = events_board_hook;
+      board.event_ctx = &game_session;
+      events_emit(&game_session, EVENT_LEVEL_START, -1, -1, accumulated_points,
+                  0);
+
+      /* Counted by board_clone() here, or board_restore() on the shard or
+       * standby that restored the session for this worker */
+      cost_add_alloc(&game_session, board.allocs, board.alloc_bytes);
+
+      migrate_state_t state;
+      session_state(&game_session, current_level, levels_cleared, player,
+                    &state);
+      replica_level_start(&game_session, &board, &state);
+
+      sched_set_period(game_session.sched_slot, board.tempo);
+      unsigned long ticks_before = game_session.ticks;
+      unsigned long long cpu_before = atomic_load(&game_session.cost.cpu_ns);
+      int counter = placement_counter_open();
+      game_result = run_game_logic(&board, notif_fd, req_fd, &game_session);
+      while (game_result == MIGRATE_SESSION || game_result == PAUSE_SESSION) {
+        /* Idle player: no thread ticks until the next move */
+        if (game_result == PAUSE_SESSION)
+          game_result =
+              pause_session(&board, notif_fd, req_fd, &game_session);
+        if (game_result == QUIT_GAME)
+          break;
+        if (game_result == MIGRATE_SESSION &&
+            send_session(&game_session, &board, current_level, levels_cleared,
+                         player, notif_fd, req_fd) == 0) {
+          migrated = 1;
+          break;
+        }
+        game_result = run_game_logic(&board, notif_fd, req_fd, &game_session);
+      }
+      replica_level_end(&game_session);
+      placement_counter_close(counter, game_session.ticks - ticks_before);
+      cost_level_played(board.level_name,
+                        atomic_load(&game_session.cost.cpu_ns) - cpu_before,
+                        game_session.ticks - ticks_before);
+
+      events_emit(&game_session, EVENT_LEVEL_END, -1, -1,
+                  board.n_pacmans > 0 ? board.pacmans[0].points : 0,
+                  game_result);
+
+      if (game_result == NEXT_LEVEL)
+        levels_cleared++;
       if (board.n_pacmans > 0) {
         accumulated_points = board.pacmans[0].points;
         if (my_scoreboard_idx >= 0) {
@@ -260,8 +543,25 @@ void *worker_task(void *arg) {
       current_level++;
     }
 
+    events_emit(&game_session, EVENT_SESSION_END, -1, -1, accumulated_points,
+                0);
+    catalog_release(catalog);
+    sched_unregister(game_session.sched_slot);
+    replica_unregister(&game_session);
+    spectate_unregister(&game_session);
+    migrate_unregister(&game_session);
+    placement_release(game_session.core);
+    atomic_fetch_add(&game_session.cost.cpu_ns,
+                     cost_thread_cpu_ns() - worker_cpu_start);
+    cost_session_end(&game_session);
     close(notif_fd);
     close(req_fd);
+    if (game_session.wake_fd != -1)
+      close(game_session.wake_fd);
+    /* A migrated session is recorded by the shard where it ends */
+    if (!migrated)
+      scores_record(player, my_client_id, accumulated_points, levels_cleared);
+    leaderboard_leave(game_session.leaderboard_slot);
 
     /* Finalize scoreboard entry */
     if (my_scoreboard_idx >= 0) {
@@ -274,6 +574,177 @@ void *worker_task(void *arg) {
   return NULL;
 }
 
+/* How long after an OP_CONNECT_EXT answer an OP_CONNECT on the same
+ * notification pipe counts as the client's retry */
+#define CONNECT_RETRY_WINDOW_MS 5000
+/* OP_CONNECT_EXT answers remembered to recognize those retries */
+#define EXT_ANSWERS 64
+
+/* Recent OP_CONNECT_EXT answers, oldest overwritten first (main thread) */
+static struct {
+  char notif_pipe[PIPE_NAME_SIZE];
+  long long answered_ns;
+} ext_answers[EXT_ANSWERS];
+static int ext_answers_next;
+
+/**
+ * @brief Reads exactly 'size' bytes from the registration FIFO.
+ *
+ * Requests are written atomically, so the rest of a message is already in
+ * the pipe once its op code has been read.
+ *
+ * @param fd Registration FIFO.
+ * @param buf Destination buffer.
+ * @param size Number of bytes to read.
+ * @return 0 on success, -1 on EOF or error.
+ */
+static int read_full(int fd, void *buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, (char *)buf + done, size - done);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long main_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Records an answered OP_CONNECT_EXT.
+ *
+ * A client that gets no OP_CONNECT_EXT response in time asks again with
+ * OP_CONNECT, in case the server predates the extended handshake. When the
+ * answer was only late, the retry reaches the FIFO before or just after it.
+ *
+ * @param notif_pipe Notification pipe of the answered client.
+ */
+static void note_ext_answered(const char *notif_pipe) {
+  memcpy(ext_answers[ext_answers_next].notif_pipe, notif_pipe,
+         PIPE_NAME_SIZE);
+  ext_answers[ext_answers_next].answered_ns = main_now_ns();
+  ext_answers_next = (ext_answers_next + 1) % EXT_ANSWERS;
+}
+
+/**
+ * @brief Tells whether an OP_CONNECT is the retry of an extended request
+ * that was answered after all, so it does not start a second session on
+ * the same pipes.
+ */
+static int is_connect_retry(const connect_req_t *req) {
+  long long now = main_now_ns();
+  for (int i = 0; i < EXT_ANSWERS; i++) {
+    if (ext_answers[i].answered_ns == 0 ||
+        now - ext_answers[i].answered_ns >
+            CONNECT_RETRY_WINDOW_MS * 1000000LL ||
+        strncmp(req->notif_pipe, ext_answers[i].notif_pipe,
+                PIPE_NAME_SIZE) != 0)
+      continue;
+    ext_answers[i].answered_ns = 0; // One retry per request
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Sends a connection response on the client's notification pipe.
+ *
+ * @param notif_pipe Path of the client's notification pipe.
+ * @param resp Response message.
+ * @param size Size of the response message.
+ * @return 0 on success, -1 if the pipe could not be opened.
+ */
+static int send_connect_response(const char *notif_pipe, const void *resp,
+                                 size_t size) {
+  int client_fd = open(notif_pipe, O_WRONLY);
+  if (client_fd == -1) {
+    perror("Failed to open client pipe");
+    return -1;
+  }
+  write(client_fd, resp, size);
+  close(client_fd);
+  return 0;
+}
+
+/**
+ * @brief Hands an accepted session to the workers (Producer role).
+ *
+ * @param req_pipe Path of the client's request pipe.
+ * @param notif_pipe Path of the client's notification pipe.
+ * @param features FEAT_* bits agreed with the client.
+ * @param max_fps Frame rate cap agreed with the client (0 for none).
+ * @param resume Session kept by the standby that the client resumes, or
+ * NULL for a new one.
+ */
+static void enqueue_session(const char *req_pipe, const char *notif_pipe,
+                            unsigned int features, int max_fps,
+                            migrate_session_t *resume) {
+  sem_wait(&sem_empty);
+  pthread_mutex_lock(&buffer_mutex);
+  game_session_t *slot = &session_buffer[buffer_in];
+  memset(slot, 0, sizeof(*slot));
+  strncpy(slot->req_pipe, req_pipe, PIPE_NAME_SIZE);
+  strncpy(slot->notif_pipe, notif_pipe, PIPE_NAME_SIZE);
+  slot->features = features;
+  slot->max_fps = max_fps;
+  slot->resume = resume;
+  buffer_in = (buffer_in + 1) % buffer_size;
+  pthread_mutex_unlock(&buffer_mutex);
+  sem_post(&sem_full);
+}
+
+/**
+ * @brief Holds a worker for a session another shard offers.
+ *
+ * Unlike new clients, which wait for a free worker, a migrated session is
+ * only taken when one is available right away: otherwise the sending shard
+ * keeps it.
+ *
+ * @return 0 if a worker is held, -1 if every worker is busy.
+ */
+static int reserve_migrated(void) {
+  return sem_trywait(&sem_empty) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Hands a session received from another shard to the worker held
+ * by reserve_migrated().
+ *
+ * @param resume Received session, or NULL if the sending shard kept it.
+ */
+static void admit_migrated(migrate_session_t *resume) {
+  if (resume == NULL) {
+    sem_post(&sem_empty);
+    return;
+  }
+  pthread_mutex_lock(&buffer_mutex);
+  game_session_t *slot = &session_buffer[buffer_in];
+  memset(slot, 0, sizeof(*slot));
+  slot->resume = resume;
+  buffer_in = (buffer_in + 1) % buffer_size;
+  pthread_mutex_unlock(&buffer_mutex);
+  sem_post(&sem_full);
+}
+
+/**
+ * @brief Counts accepted sessions waiting for a worker (stats history).
+ */
+static int queued_sessions(void) {
+  int value = 0;
+  sem_getvalue(&sem_full, &value);
+  return value > 0 ? value : 0;
+}
+
 /**
  * @brief Creates the worker thread pool.
  *
@@ -299,7 +770,7 @@ void create_threads(int max_games) {
  * @brief Main entry point for the PacmanIST server.
  *
  * Parses command-line arguments, initializes the Producer-Consumer buffer
- * and synchronization primitives, sets up signal handlers, creates the
+ * and synchronization primitives, starts the signal thread, creates the
  * registration FIFO, spawns worker threads, and enters the main loop to
  * accept client connections (Producer role).
  *
@@ -318,6 +789,20 @@ int main(int argc, char *argv[]) {
   int max_games = atoi(argv[2]);
   global_fifo_name = argv[3];
 
+  /* Signals are taken by signal_thread; every thread inherits this mask */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+  pthread_t signal_tid;
+  if (pthread_create(&signal_tid, NULL, signal_thread, NULL) != 0) {
+    perror("Failed to start signal thread");
+    exit(EXIT_FAILURE);
+  }
+  pthread_detach(signal_tid);
+
   buffer_size = max_games;
   session_buffer = calloc((size_t)buffer_size, sizeof(game_session_t));
   if (session_buffer == NULL) {
@@ -325,6 +810,59 @@ int main(int argc, char *argv[]) {
     exit(EXIT_FAILURE);
   }
 
+  /* A standby replays the primary's sessions and starts serving, on the
+   * same FIFO, only once the primary is gone */
+  if (replica_standby()) {
+    printf("PacmanIST standby following %s\n",
+           getenv("PACMANIST_REPLICA_OF"));
+    fflush(stdout);
+    if (replica_follow() != 0) {
+      fprintf(stderr, "Invalid PACMANIST_REPLICA_OF\n");
+      exit(EXIT_FAILURE);
+    }
+    printf("Primary gone, taking over %s\n", global_fifo_name);
+  }
+
+  flood_init();
+  speculate_init();
+  game_init();
+
+  if (placement_init() != 0) {
+    fprintf(stderr, "Core placement unavailable, threads will float\n");
+  }
+
+  if (sched_init(max_games) != 0) {
+    perror("Failed to init tick scheduler");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Recover the score store first: client ids continue from its index */
+  if (scores_start() != 0) {
+    perror("Failed to open score store");
+    exit(EXIT_FAILURE);
+  }
+
+  if (leaderboard_start() != 0) {
+    perror("Failed to start leaderboard");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Parse every level up front; sessions then start without any I/O */
+  if (catalog_start(global_levels_dir) != 0) {
+    perror("Failed to read levels directory");
+    exit(EXIT_FAILURE);
+  }
+
+  if (archive_start() != 0) {
+    perror("Failed to open event archive");
+    exit(EXIT_FAILURE);
+  }
+
+  if (events_start() != 0) {
+    perror("Failed to start event bus");
+    exit(EXIT_FAILURE);
+  }
+
   if (sem_init(&sem_empty, 0, (unsigned int)buffer_size) != 0 ||
       sem_init(&sem_full, 0, 0) != 0) {
     perror("Failed to init semaphores");
@@ -332,9 +870,7 @@ int main(int argc, char *argv[]) {
   }
 
   signal(SIGPIPE, SIG_IGN);
-  signal(SIGINT, handle_cleanup);
-  signal(SIGTERM, handle_cleanup);
-  signal(SIGUSR1, handle_sigusr1);
+  atomic_store(&serving, 1);
 
   unlink(global_fifo_name);
   if (mkfifo(global_fifo_name, 0666) == -1) {
@@ -347,6 +883,28 @@ int main(int argc, char *argv[]) {
 
   create_threads(max_games);
 
+  if (migrate_start(reserve_migrated, admit_migrated) != 0) {
+    perror("Failed to open shard socket");
+    exit(EXIT_FAILURE);
+  }
+
+  if (replica_start() != 0) {
+    perror("Failed to open replication socket");
+    exit(EXIT_FAILURE);
+  }
+
+  if (qos_start() != 0) {
+    perror("Failed to start overload controller");
+    exit(EXIT_FAILURE);
+  }
+
+  if (history_start(queued_sessions) != 0) {
+    perror("Failed to open stats history");
+    exit(EXIT_FAILURE);
+  }
+
+  placement_pin_io();
+
   int fifo_fd = open(global_fifo_name, O_RDWR);
   if (fifo_fd == -1) {
     perror("Failed to open FIFO");
@@ -355,38 +913,79 @@ int main(int argc, char *argv[]) {
   }
 
   while (1) {
-    connect_req_t req;
-    ssize_t bytes_read = read(fifo_fd, &req, sizeof(connect_req_t));
+    /* Under heavy overload new sessions wait here */
+    qos_wait_admission();
+
+    int8_t op_code;
+    ssize_t bytes_read = read(fifo_fd, &op_code, sizeof(op_code));
 
     if (bytes_read == 0)
       break;
     if (bytes_read == -1) {
+      if (errno == EINTR)
+        continue; // A signal interrupted the read
       perror("Read error");
       break;
     }
-    if (bytes_read != sizeof(connect_req_t))
-      continue;
 
-    if (req.op_code == OP_CONNECT) {
-      int client_fd = open(req.notif_pipe, O_WRONLY);
-      if (client_fd == -1) {
-        perror("Failed to open client pipe");
+    if (op_code == OP_CONNECT) {
+      /* Legacy 81-byte handshake: no features, 2-byte response */
+      connect_req_t req = {.op_code = op_code};
+      if (read_full(fifo_fd, (char *)&req + 1, sizeof(req) - 1) != 0)
+        continue;
+      if (is_connect_retry(&req))
         continue;
-      }
 
       connect_resp_t resp = {.op_code = OP_CONNECT, .result = 0};
-      write(client_fd, &resp, sizeof(connect_resp_t));
-      close(client_fd);
-
-      sem_wait(&sem_empty);
-      pthread_mutex_lock(&buffer_mutex);
-      strncpy(session_buffer[buffer_in].req_pipe, req.req_pipe, PIPE_NAME_SIZE);
-      strncpy(session_buffer[buffer_in].notif_pipe, req.notif_pipe,
-              PIPE_NAME_SIZE);
-      buffer_in = (buffer_in + 1) % buffer_size;
-      pthread_mutex_unlock(&buffer_mutex);
-      sem_post(&sem_full);
+      if (send_connect_response(req.notif_pipe, &resp, sizeof(resp)) != 0)
+        continue;
+      enqueue_session(req.req_pipe, req.notif_pipe, 0, 0, NULL);
+    } else if (op_code == OP_CONNECT_EXT) {
+      connect_ext_req_t req = {.op_code = op_code};
+      if (read_full(fifo_fd, (char *)&req + 1, sizeof(req) - 1) != 0)
+        continue;
+
+      /* The server chooses: common version and features, client's cap */
+      connect_ext_resp_t resp = {
+          .op_code = OP_CONNECT_EXT,
+          .result = 0,
+          .version = req.version < PROTOCOL_VERSION ? req.version
+                                                    : PROTOCOL_VERSION,
+          .features = req.features & SERVER_FEATURES,
+      };
+      /* Tokens are only worth something with a standby to resume on */
+      if (!replica_streaming())
+        resp.features &= ~FEAT_RESUME;
+      if (resp.features & FEAT_FRAME_RATE_CAP)
+        resp.max_fps = req.max_fps;
+      if (send_connect_response(req.notif_pipe, &resp, sizeof(resp)) != 0)
+        continue;
+      note_ext_answered(req.notif_pipe);
+      enqueue_session(req.req_pipe, req.notif_pipe, resp.features,
+                      resp.max_fps, NULL);
+    } else if (op_code == OP_SPECTATE) {
+      /* Dashboards take no worker: game threads publish to them */
+      spectate_req_t req = {.op_code = op_code};
+      if (read_full(fifo_fd, (char *)&req + 1, sizeof(req) - 1) != 0)
+        continue;
+      spectate_attach(&req);
+    } else if (op_code == OP_RESUME) {
+      resume_req_t req = {.op_code = op_code};
+      if (read_full(fifo_fd, (char *)&req + 1, sizeof(req) - 1) != 0)
+        continue;
+
+      /* Only a standby that took over holds sessions to resume; the worker
+       * answers once it has the client's pipes */
+      migrate_session_t *resume = replica_claim(req.token);
+      if (resume == NULL) {
+        resume_resp_t resp = {.op_code = OP_RESUME, .result = -1};
+        send_connect_response(req.notif_pipe, &resp, sizeof(resp));
+        continue;
+      }
+      enqueue_session(req.req_pipe, req.notif_pipe, resume->state.features,
+                      resume->state.max_fps, resume);
     }
+    /* Any other byte is not a request start and is skipped */
   }
 
   close(fifo_fd);
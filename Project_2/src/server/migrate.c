@@ -0,0 +1,486 @@
+/**
+ * @file migrate.c
+ * @brief Live session migration between cores and between shard processes.
+ *
+ * Moving a session to another core needs no serialization: the game threads
+ * share the process, so the rebalancer only changes the session's core and
+ * each thread re-pins itself at its next tick. Moving it to another shard
+ * stops the level at a tick boundary; the worker then sends the board and
+ * the session state in one SOCK_SEQPACKET message that also carries the
+ * client's pipes (SCM_RIGHTS). The other shard restores it and answers
+ * ready; the sender then confirms it let the session go, and only then
+ * does the other shard restart the game threads on its copy. Without that
+ * confirmation the sender may have resumed the session itself, so the copy
+ * is dropped. The client keeps the same pipes and only sees the frames of
+ * that tick arrive late.
+ */
+
+#define _GNU_SOURCE
+#include "../../include/migrate.h"
+#include "../../include/catalog.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Marks a migration message ("PMIG") */
+#define MIGRATE_MAGIC 0x47494d50u
+/** @brief Sessions the rebalancer can track */
+#define MIGRATE_MAX_SESSIONS 256
+/** @brief Default rebalancer period */
+#define MIGRATE_PERIOD_MS 1000
+/** @brief Default sessions per core above which sessions are offloaded */
+#define MIGRATE_OFFLOAD 4
+/** @brief Time the peer has to accept or refuse a session */
+#define MIGRATE_ACK_MS 1000
+/** @brief Time the sender has to confirm a handoff the peer accepted; longer
+ * than MIGRATE_ACK_MS, as the sender confirms as soon as it reads the ack */
+#define MIGRATE_COMMIT_MS (2 * MIGRATE_ACK_MS)
+
+/**
+ * @brief Fixed part of a migration message, followed by the saved board.
+ */
+typedef struct {
+  unsigned int magic;
+  unsigned int board_size; /**< Bytes of board_save() output that follow */
+  migrate_state_t state;
+} migrate_msg_t;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static session_t *registry[MIGRATE_MAX_SESSIONS];
+
+static migrate_reserve_fn reserve_worker = NULL;
+static migrate_admit_fn admit_session = NULL;
+static int period_ms = MIGRATE_PERIOD_MS;
+static int offload_load = MIGRATE_OFFLOAD;
+static const char *peer_path = NULL;
+static char listen_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static atomic_int in_flight; /**< A session was asked to move shards */
+
+static atomic_ulong core_moves;
+static atomic_ulong sent;
+static atomic_ulong send_failed;
+static atomic_ulong received;
+static atomic_ulong refused;
+static atomic_ulong abandoned; /**< Accepted, but never confirmed */
+static atomic_ullong handoff_ns;
+static atomic_ullong handoff_max_ns;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long migrate_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void migrate_register(session_t *session) {
+  session->started_ns = migrate_now_ns();
+  pthread_mutex_lock(&registry_mutex);
+  for (int i = 0; i < MIGRATE_MAX_SESSIONS; i++) {
+    if (registry[i] == NULL) {
+      registry[i] = session;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&registry_mutex);
+}
+
+void migrate_unregister(session_t *session) {
+  pthread_mutex_lock(&registry_mutex);
+  for (int i = 0; i < MIGRATE_MAX_SESSIONS; i++) {
+    if (registry[i] == session)
+      registry[i] = NULL;
+  }
+  // Ended before reaching a tick boundary: let another session go
+  if (atomic_exchange(&session->migrate_request, 0))
+    atomic_store(&in_flight, 0);
+  pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * @brief One rebalancing pass over the registered sessions.
+ *
+ * Finds the core running the most sessions, moves its longest running
+ * session to the idlest core if placement allows it, and, if that core is
+ * still above the offload limit, asks its longest running session to move
+ * to the peer shard.
+ */
+static void rebalance(void) {
+  pthread_mutex_lock(&registry_mutex);
+  int busiest_core = -1, busiest_load = 0;
+  for (int i = 0; i < MIGRATE_MAX_SESSIONS; i++) {
+    if (registry[i] == NULL)
+      continue;
+    int core = __atomic_load_n(&registry[i]->core, __ATOMIC_RELAXED);
+    int load = 0;
+    for (int j = 0; j < MIGRATE_MAX_SESSIONS; j++) {
+      if (registry[j] != NULL &&
+          __atomic_load_n(&registry[j]->core, __ATOMIC_RELAXED) == core)
+        load++;
+    }
+    if (load > busiest_load) {
+      busiest_load = load;
+      busiest_core = core;
+    }
+  }
+  if (busiest_load == 0) {
+    pthread_mutex_unlock(&registry_mutex);
+    return;
+  }
+
+  // Oldest sessions first: they are the ones that pin a hot spot for hours
+  session_t *oldest = NULL;
+  for (int i = 0; i < MIGRATE_MAX_SESSIONS; i++) {
+    session_t *s = registry[i];
+    if (s != NULL && __atomic_load_n(&s->core, __ATOMIC_RELAXED) ==
+                         busiest_core &&
+        !atomic_load(&s->migrate_request) &&
+        (oldest == NULL || s->started_ns < oldest->started_ns))
+      oldest = s;
+  }
+
+  if (oldest != NULL && busiest_core >= 0) {
+    int core = placement_rebalance(busiest_core);
+    if (core != busiest_core) {
+      __atomic_store_n(&oldest->core, core, __ATOMIC_RELAXED);
+      atomic_fetch_add_explicit(&oldest->core_epoch, 1, memory_order_release);
+      atomic_fetch_add(&core_moves, 1);
+      busiest_load--;
+      oldest = NULL; // It just moved, offload someone else next time
+    }
+  }
+
+  // Sessions that just arrived stay a while, so shards cannot ping-pong
+  long long min_age = 2LL * period_ms * 1000000LL;
+  if (peer_path != NULL && oldest != NULL && busiest_load > offload_load &&
+      migrate_now_ns() - oldest->started_ns >= min_age &&
+      !atomic_exchange(&in_flight, 1))
+    atomic_store(&oldest->migrate_request, 1);
+  pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * @brief Rebalancer thread: runs a rebalancing pass every period.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *rebalancer_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (1) {
+    sleep_ms(period_ms);
+    rebalance();
+  }
+  return NULL;
+}
+
+/**
+ * @brief Fills a UNIX socket address.
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int socket_address(struct sockaddr_un *addr, const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path))
+    return -1;
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+int migrate_send(session_t *session, const migrate_state_t *state,
+                 const board_t *board, int notif_fd, int req_fd) {
+  long long start = migrate_now_ns();
+  int result = -1;
+  int sock = -1;
+  size_t board_size = board_save_size(board);
+  void *saved = malloc(board_size);
+  struct sockaddr_un addr;
+
+  if (saved == NULL || peer_path == NULL ||
+      socket_address(&addr, peer_path) != 0 ||
+      board_save(board, saved, board_size) < 0)
+    goto out;
+  sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock == -1 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    goto out;
+
+  migrate_msg_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.magic = MIGRATE_MAGIC;
+  msg.board_size = (unsigned int)board_size;
+  msg.state = *state;
+
+  struct iovec iov[2] = {{.iov_base = &msg, .iov_len = sizeof(msg)},
+                         {.iov_base = saved, .iov_len = board_size}};
+  union {
+    char buf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr hdr = {.msg_iov = iov,
+                       .msg_iovlen = 2,
+                       .msg_control = control.buf,
+                       .msg_controllen = sizeof(control.buf)};
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+  int fds[2] = {notif_fd, req_fd};
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if (sendmsg(sock, &hdr, MSG_NOSIGNAL) != (ssize_t)(sizeof(msg) + board_size))
+    goto out;
+
+  // A peer that does not answer in time is treated as refusing; closing
+  // the socket without confirming makes it drop its copy
+  struct pollfd pfd = {.fd = sock, .events = POLLIN};
+  char ack = 0;
+  if (poll(&pfd, 1, MIGRATE_ACK_MS) == 1 && read(sock, &ack, 1) == 1 &&
+      ack == 1) {
+    // The session stops here for good once the peer can read this
+    char commit = 1;
+    if (send(sock, &commit, 1, MSG_NOSIGNAL) == 1)
+      result = 0;
+  }
+
+out:
+  if (sock != -1)
+    close(sock);
+  free(saved);
+  if (result == 0) {
+    unsigned long long ns = (unsigned long long)(migrate_now_ns() - start);
+    atomic_fetch_add(&sent, 1);
+    atomic_fetch_add(&handoff_ns, ns);
+    unsigned long long max = atomic_load(&handoff_max_ns);
+    while (ns > max && !atomic_compare_exchange_weak(&handoff_max_ns, &max, ns))
+      ;
+  } else {
+    atomic_fetch_add(&send_failed, 1);
+  }
+  atomic_store(&session->migrate_request, 0);
+  atomic_store(&in_flight, 0);
+  return result;
+}
+
+void migrate_session_free(migrate_session_t *session) {
+  if (session == NULL)
+    return;
+  unload_level(&session->board);
+  close(session->notif_fd);
+  close(session->req_fd);
+  free(session);
+}
+
+/**
+ * @brief Waits for the sender to confirm it let a session go.
+ * @param conn Connected socket.
+ * @return 1 if it confirmed, 0 if it closed the socket or timed out.
+ */
+static int wait_commit(int conn) {
+  struct pollfd pfd = {.fd = conn, .events = POLLIN};
+  char commit = 0;
+  return poll(&pfd, 1, MIGRATE_COMMIT_MS) == 1 &&
+         recv(conn, &commit, 1, 0) == 1 && commit == 1;
+}
+
+/**
+ * @brief Receives one session from a peer and hands it to a worker.
+ *
+ * A worker is held for the session before the peer is told it can send it,
+ * so the session is admitted at once when the peer confirms.
+ * @param conn Connected socket.
+ * @return 1 if the session was admitted, 0 otherwise.
+ */
+static int receive_session(int conn) {
+  // Size the buffer from the pending message without consuming it
+  char probe;
+  ssize_t size = recv(conn, &probe, 1, MSG_PEEK | MSG_TRUNC);
+  if (size < (ssize_t)sizeof(migrate_msg_t))
+    return 0;
+  char *buf = malloc((size_t)size);
+  if (buf == NULL)
+    return 0;
+
+  union {
+    char buf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov = {.iov_base = buf, .iov_len = (size_t)size};
+  struct msghdr hdr = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = control.buf,
+                       .msg_controllen = sizeof(control.buf)};
+  ssize_t n = recvmsg(conn, &hdr, MSG_CMSG_CLOEXEC);
+
+  int fds[2] = {-1, -1};
+  struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&hdr) : NULL;
+  if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS &&
+      cmsg->cmsg_len == CMSG_LEN(2 * sizeof(int)))
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  migrate_msg_t msg;
+  migrate_session_t *session = NULL;
+  if (n != size || fds[0] == -1 || fds[1] == -1)
+    goto refuse;
+  memcpy(&msg, buf, sizeof(msg));
+  if (msg.magic != MIGRATE_MAGIC ||
+      (size_t)size != sizeof(msg) + msg.board_size)
+    goto refuse;
+
+  session = calloc(1, sizeof(*session));
+  if (session == NULL ||
+      board_restore(&session->board, buf + sizeof(msg), msg.board_size) != 0)
+    goto refuse;
+  session->state = msg.state;
+  session->state.player[PIPE_NAME_SIZE - 1] = '\0';
+  session->notif_fd = fds[0];
+  session->req_fd = fds[1];
+
+  // Catalogs may list levels differently: continue from the same file
+  level_catalog_t *catalog = catalog_acquire();
+  session->state.level = -1;
+  for (int i = 0; i < catalog->count; i++) {
+    if (strcmp(catalog->levels[i].board.level_name,
+               session->board.level_name) == 0) {
+      session->state.level = i;
+      break;
+    }
+  }
+  catalog_release(catalog);
+  if (session->state.level < 0 || reserve_worker() != 0)
+    goto refuse;
+
+  free(buf);
+  char ack = 1;
+  if (send(conn, &ack, 1, MSG_NOSIGNAL) != 1 || !wait_commit(conn)) {
+    // The sender resumed the session itself
+    admit_session(NULL);
+    migrate_session_free(session);
+    atomic_fetch_add(&abandoned, 1);
+    return 0;
+  }
+  admit_session(session);
+  atomic_fetch_add(&received, 1);
+  return 1;
+
+refuse:
+  if (session != NULL && session->board.lock_initialized) {
+    migrate_session_free(session); // Closes the fds too
+  } else {
+    free(session);
+    for (int i = 0; i < 2; i++) {
+      if (fds[i] != -1)
+        close(fds[i]);
+    }
+  }
+  free(buf);
+  char nack = 0;
+  send(conn, &nack, 1, MSG_NOSIGNAL);
+  atomic_fetch_add(&refused, 1);
+  return 0;
+}
+
+/**
+ * @brief Shard listener thread: accepts sessions sent by peers.
+ * @param arg Listening socket.
+ * @return void* Never returns.
+ */
+static void *receiver_thread(void *arg) {
+  int listen_fd = (int)(intptr_t)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (1) {
+    int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (conn == -1)
+      continue;
+    receive_session(conn);
+    close(conn);
+  }
+  return NULL;
+}
+
+int migrate_start(migrate_reserve_fn reserve, migrate_admit_fn admit) {
+  reserve_worker = reserve;
+  admit_session = admit;
+  const char *period = getenv("PACMANIST_REBALANCE_MS");
+  if (period != NULL)
+    period_ms = atoi(period);
+  const char *offload = getenv("PACMANIST_SHARD_OFFLOAD");
+  if (offload != NULL && atoi(offload) >= 0)
+    offload_load = atoi(offload);
+  const char *peer = getenv("PACMANIST_SHARD_PEER");
+  if (peer != NULL && peer[0] != '\0')
+    peer_path = peer;
+
+  if (period_ms > 0) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, rebalancer_thread, NULL) != 0)
+      return -1;
+    pthread_detach(tid);
+  }
+
+  const char *path = getenv("PACMANIST_SHARD_SOCKET");
+  if (path == NULL || path[0] == '\0')
+    return 0;
+  struct sockaddr_un addr;
+  if (socket_address(&addr, path) != 0)
+    return -1;
+  int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1)
+    return -1;
+  unlink(path);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 16) != 0) {
+    close(listen_fd);
+    return -1;
+  }
+  strcpy(listen_path, path);
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, receiver_thread,
+                     (void *)(intptr_t)listen_fd) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+void migrate_stop(void) {
+  if (listen_path[0] != '\0')
+    unlink(listen_path);
+}
+
+void migrate_dump_stats(FILE *f) {
+  fprintf(f, "=== SESSION MIGRATION ===\n");
+  fprintf(f, "Core moves: %lu, rebalancing every %d ms\n",
+          atomic_load(&core_moves), period_ms);
+  unsigned long n_sent = atomic_load(&sent);
+  fprintf(f, "Sent to peer shard: %lu (%lu failed, resumed here)\n", n_sent,
+          atomic_load(&send_failed));
+  if (n_sent > 0)
+    fprintf(f, "Handoff: avg %.2f ms, max %.2f ms\n",
+            (double)atomic_load(&handoff_ns) / (double)n_sent / 1e6,
+            (double)atomic_load(&handoff_max_ns) / 1e6);
+  fprintf(f,
+          "Received from peers: %lu (%lu refused, %lu kept by the sender)\n",
+          atomic_load(&received), atomic_load(&refused),
+          atomic_load(&abandoned));
+}
@@ -0,0 +1,243 @@
+/**
+ * @file placement.c
+ * @brief Cache-local placement of sessions on CPU cores.
+ *
+ * Each session is owned by one core: the worker running it and every game
+ * thread it spawns are pinned there, so the board stays in that core's
+ * caches. Sessions only move when the busiest core carries
+ * PACMANIST_MIGRATE_THRESHOLD more sessions than the idlest one; the
+ * rebalancer (migrate.c) then moves them mid-level.
+ */
+
+#define _GNU_SOURCE
+#include "../../include/placement.h"
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int pin_enabled = 0;
+static int migrate_threshold = 2;
+static int n_cores = 0;
+static int cores[CPU_SETSIZE];        /**< CPU ids usable by sessions */
+static int core_load[CPU_SETSIZE];    /**< Sessions per entry of cores[] */
+static int io_enabled = 0;
+static cpu_set_t io_set;
+static pthread_mutex_t placement_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_ulong migrations;
+static atomic_ullong cache_misses;
+static atomic_ullong measured_ticks;
+static atomic_int counters_unavailable;
+
+/**
+ * @brief Parses a CPU list such as "0-3,6" into a CPU set.
+ * @param list CPU list string.
+ * @param set Set to fill.
+ * @return Number of CPUs in the set.
+ */
+static int parse_cpu_list(const char *list, cpu_set_t *set) {
+  CPU_ZERO(set);
+  const char *p = list;
+  while (*p != '\0') {
+    char *end = NULL;
+    long first = strtol(p, &end, 10);
+    if (end == p)
+      break;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+      if (cpu >= 0)
+        CPU_SET((int)cpu, set);
+    }
+    if (*p == ',')
+      p++;
+  }
+  return CPU_COUNT(set);
+}
+
+/**
+ * @brief Returns the index in cores[] of a core id.
+ * @param core Core id.
+ * @return Index, or -1 if the core is not managed.
+ */
+static int core_index(int core) {
+  for (int i = 0; i < n_cores; i++) {
+    if (cores[i] == core)
+      return i;
+  }
+  return -1;
+}
+
+int placement_init(void) {
+  const char *pin = getenv("PACMANIST_PIN");
+  if (pin != NULL && strcmp(pin, "0") == 0)
+    return 0;
+
+  const char *threshold = getenv("PACMANIST_MIGRATE_THRESHOLD");
+  if (threshold != NULL && atoi(threshold) > 0)
+    migrate_threshold = atoi(threshold);
+
+  cpu_set_t set;
+  const char *list = getenv("PACMANIST_CPUS");
+  if (list != NULL && list[0] != '\0') {
+    parse_cpu_list(list, &set);
+  } else if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return -1;
+  }
+
+  n_cores = 0;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set))
+      cores[n_cores++] = cpu;
+  }
+  if (n_cores == 0)
+    return -1;
+
+  const char *io_list = getenv("PACMANIST_IO_CPUS");
+  if (io_list != NULL && io_list[0] != '\0')
+    io_enabled = parse_cpu_list(io_list, &io_set) > 0;
+
+  pin_enabled = 1;
+  return 0;
+}
+
+void placement_pin_io(void) {
+  if (pin_enabled && io_enabled)
+    pthread_setaffinity_np(pthread_self(), sizeof(io_set), &io_set);
+}
+
+int placement_assign(void) {
+  if (!pin_enabled)
+    return -1;
+  pthread_mutex_lock(&placement_mutex);
+  int best = 0;
+  for (int i = 1; i < n_cores; i++) {
+    if (core_load[i] < core_load[best])
+      best = i;
+  }
+  core_load[best]++;
+  pthread_mutex_unlock(&placement_mutex);
+  return cores[best];
+}
+
+int placement_rebalance(int core) {
+  if (!pin_enabled || core < 0)
+    return core;
+  pthread_mutex_lock(&placement_mutex);
+  int cur = core_index(core);
+  int idlest = 0;
+  for (int i = 1; i < n_cores; i++) {
+    if (core_load[i] < core_load[idlest])
+      idlest = i;
+  }
+  if (cur >= 0 && core_load[cur] - core_load[idlest] >= migrate_threshold) {
+    core_load[cur]--;
+    core_load[idlest]++;
+    core = cores[idlest];
+    atomic_fetch_add(&migrations, 1);
+  }
+  pthread_mutex_unlock(&placement_mutex);
+  return core;
+}
+
+void placement_release(int core) {
+  if (!pin_enabled || core < 0)
+    return;
+  pthread_mutex_lock(&placement_mutex);
+  int idx = core_index(core);
+  if (idx >= 0 && core_load[idx] > 0)
+    core_load[idx]--;
+  pthread_mutex_unlock(&placement_mutex);
+}
+
+void placement_pin_self(int core) {
+  if (core < 0)
+    return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void placement_thread_attr(pthread_attr_t *attr, int core) {
+  pthread_attr_init(attr);
+  if (core < 0)
+    return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+int placement_counter_open(void) {
+  if (atomic_load(&counters_unavailable))
+    return -1;
+
+  struct perf_event_attr pe;
+  memset(&pe, 0, sizeof(pe));
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.size = sizeof(pe);
+  pe.config = PERF_COUNT_HW_CACHE_MISSES;
+  pe.disabled = 1;
+  pe.inherit = 1; // Count the game threads spawned by this worker too
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+
+  int fd = (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+  if (fd == -1) {
+    atomic_store(&counters_unavailable, 1);
+    return -1;
+  }
+  ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  return fd;
+}
+
+void placement_counter_close(int counter, unsigned long ticks) {
+  if (counter == -1)
+    return;
+  // Children have been joined, so their counts are folded into ours.
+  unsigned long long count = 0;
+  ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+  if (read(counter, &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+    atomic_fetch_add(&cache_misses, count);
+    atomic_fetch_add(&measured_ticks, ticks);
+  }
+  close(counter);
+}
+
+void placement_dump_stats(FILE *f) {
+  fprintf(f, "=== CORE PLACEMENT ===\n");
+  if (!pin_enabled) {
+    fprintf(f, "Pinning disabled\n");
+    return;
+  }
+
+  pthread_mutex_lock(&placement_mutex);
+  for (int i = 0; i < n_cores; i++) {
+    fprintf(f, "  cpu %d: %d sessions\n", cores[i], core_load[i]);
+  }
+  pthread_mutex_unlock(&placement_mutex);
+
+  fprintf(f, "Cross-core migrations: %lu (threshold %d)\n",
+          atomic_load(&migrations), migrate_threshold);
+
+  unsigned long long ticks = atomic_load(&measured_ticks);
+  if (atomic_load(&counters_unavailable)) {
+    fprintf(f, "Cache misses per tick: n/a (no hardware counters)\n");
+  } else if (ticks > 0) {
+    fprintf(f, "Cache misses per tick: %.1f\n",
+            (double)atomic_load(&cache_misses) / (double)ticks);
+  } else {
+    fprintf(f, "Cache misses per tick: no ticks measured yet\n");
+  }
+}
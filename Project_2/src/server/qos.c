@@ -0,0 +1,215 @@
+/**
+ * @file qos.c
+ * @brief Overload controller degrading frame rates before gameplay.
+ *
+ * A controller thread samples the tick lateness histogram. When the p99 of
+ * the last window crosses a threshold it enters the next degradation level:
+ * first spectator streams get fewer frames, then the streams of idle
+ * players, and finally new sessions wait before being admitted. Entity
+ * ticks are never slowed down on purpose. Levels are left one at a time once
+ * lateness has stayed low for a few windows.
+ *
+ * Independently of the load, sessions idle for long are paused: their game
+ * threads stop until the player's next move.
+ */
+
+#include "../../include/qos.h"
+#include "../../include/board.h"
+#include "../../include/scheduler.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+/** @brief Length of a lateness sampling window */
+#define QOS_SAMPLE_MS 250
+/** @brief Calm windows needed before leaving a level */
+#define QOS_CALM_SAMPLES 4
+/** @brief Frame divisor of spectator streams when reduced */
+#define QOS_SPECTATOR_DIVISOR 2
+/** @brief Frame divisor of low priority streams when reduced */
+#define QOS_LOW_PRIORITY_DIVISOR 3
+
+static atomic_int current_level = QOS_NORMAL;
+static long thresholds_us[QOS_LEVELS - 1] = {5000, 15000, 40000};
+static long long idle_ns = 5000LL * 1000000LL;
+static long long pause_ns = 60000LL * 1000000LL;
+
+static atomic_ulong level_entered[QOS_LEVELS];
+static atomic_ullong level_time_ms[QOS_LEVELS];
+static atomic_ulong frames_skipped;
+static atomic_ulong admissions_delayed;
+static atomic_long last_p99_us;
+static atomic_ulong sessions_paused;
+static atomic_ulong sessions_resumed;
+static atomic_ullong paused_ms;
+
+static pthread_mutex_t admission_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t admission_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long qos_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Switches to a new level and wakes the host if admission resumed.
+ * @param level Level to enter.
+ */
+static void set_level(int level) {
+  atomic_store(&current_level, level);
+  atomic_fetch_add(&level_entered[level], 1);
+  pthread_mutex_lock(&admission_mutex);
+  pthread_cond_broadcast(&admission_cond);
+  pthread_mutex_unlock(&admission_mutex);
+}
+
+/**
+ * @brief Controller thread: samples lateness and moves between levels.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *qos_controller(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  unsigned long long prev[SCHED_LATE_BUCKETS];
+  unsigned long long cur[SCHED_LATE_BUCKETS];
+  unsigned long long window[SCHED_LATE_BUCKETS];
+  sched_lateness_snapshot(prev);
+  int calm = 0;
+
+  while (1) {
+    sleep_ms(QOS_SAMPLE_MS);
+
+    sched_lateness_snapshot(cur);
+    for (int b = 0; b < SCHED_LATE_BUCKETS; b++) {
+      window[b] = cur[b] - prev[b];
+      prev[b] = cur[b];
+    }
+    long p99 = sched_lateness_percentile(window, 99.0);
+    atomic_store(&last_p99_us, p99);
+
+    int level = atomic_load(&current_level);
+    atomic_fetch_add(&level_time_ms[level], QOS_SAMPLE_MS);
+
+    if (level < QOS_LEVELS - 1 && p99 >= thresholds_us[level]) {
+      calm = 0;
+      set_level(level + 1);
+    } else if (level > QOS_NORMAL && p99 < thresholds_us[level - 1] / 2) {
+      if (++calm >= QOS_CALM_SAMPLES) {
+        calm = 0;
+        set_level(level - 1);
+      }
+    } else {
+      calm = 0;
+    }
+  }
+  return NULL;
+}
+
+int qos_start(void) {
+  const char *list = getenv("PACMANIST_QOS_THRESHOLDS");
+  if (list != NULL) {
+    char *end = NULL;
+    for (int i = 0; i < QOS_LEVELS - 1 && *list != '\0'; i++) {
+      long ms = strtol(list, &end, 10);
+      if (end == list)
+        break;
+      thresholds_us[i] = ms * 1000;
+      list = (*end == ',') ? end + 1 : end;
+    }
+  }
+  const char *idle = getenv("PACMANIST_QOS_IDLE_MS");
+  if (idle != NULL && atoll(idle) > 0)
+    idle_ns = atoll(idle) * 1000000LL;
+  const char *pause = getenv("PACMANIST_IDLE_PAUSE_MS");
+  if (pause != NULL && atoll(pause) >= 0)
+    pause_ns = atoll(pause) * 1000000LL;
+
+  atomic_fetch_add(&level_entered[QOS_NORMAL], 1);
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, qos_controller, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+qos_level_t qos_level(void) { return (qos_level_t)atomic_load(&current_level); }
+
+int qos_should_send(session_t *session, int spectator, unsigned long tick) {
+  int level = atomic_load(&current_level);
+  unsigned long divisor = 1;
+
+  if (spectator && level >= QOS_SPECTATORS_REDUCED) {
+    divisor = QOS_SPECTATOR_DIVISOR;
+    if (level >= QOS_LOW_PRIORITY_REDUCED)
+      divisor *= QOS_SPECTATOR_DIVISOR;
+  } else if (!spectator && level >= QOS_LOW_PRIORITY_REDUCED &&
+             qos_now_ns() - atomic_load(&session->last_input_ns) > idle_ns) {
+    divisor = QOS_LOW_PRIORITY_DIVISOR;
+  }
+
+  if (tick % divisor == 0)
+    return 1;
+  atomic_fetch_add(&frames_skipped, 1);
+  return 0;
+}
+
+void qos_note_input(session_t *session) {
+  atomic_store(&session->last_input_ns, qos_now_ns());
+}
+
+int qos_should_pause(session_t *session) {
+  if (pause_ns == 0 || atomic_load(&session->spectators) > 0 ||
+      qos_now_ns() - atomic_load(&session->last_input_ns) <= pause_ns)
+    return 0;
+  atomic_fetch_add(&sessions_paused, 1);
+  return 1;
+}
+
+void qos_note_resumed(long long ns) {
+  atomic_fetch_add(&sessions_resumed, 1);
+  atomic_fetch_add(&paused_ms, (unsigned long long)(ns / 1000000LL));
+}
+
+void qos_wait_admission(void) {
+  if (atomic_load(&current_level) < QOS_ADMISSION_PAUSED)
+    return;
+  atomic_fetch_add(&admissions_delayed, 1);
+  pthread_mutex_lock(&admission_mutex);
+  while (atomic_load(&current_level) >= QOS_ADMISSION_PAUSED) {
+    pthread_cond_wait(&admission_cond, &admission_mutex);
+  }
+  pthread_mutex_unlock(&admission_mutex);
+}
+
+void qos_dump_stats(FILE *f) {
+  static const char *names[QOS_LEVELS] = {"normal", "spectators reduced",
+                                          "low priority reduced",
+                                          "admission paused"};
+  int level = atomic_load(&current_level);
+  fprintf(f, "=== OVERLOAD CONTROL ===\n");
+  fprintf(f, "Level: %d (%s), last window p99 < %ld us\n", level, names[level],
+          atomic_load(&last_p99_us));
+  for (int i = 0; i < QOS_LEVELS; i++) {
+    fprintf(f, "  %-20s entered %lu times, %.1f s total\n", names[i],
+            atomic_load(&level_entered[i]),
+            (double)atomic_load(&level_time_ms[i]) / 1000.0);
+  }
+  fprintf(f, "Frames skipped: %lu, admissions delayed: %lu\n",
+          atomic_load(&frames_skipped), atomic_load(&admissions_delayed));
+  fprintf(f, "Idle sessions paused: %lu, resumed: %lu, %.1f s paused\n",
+          atomic_load(&sessions_paused), atomic_load(&sessions_resumed),
+          (double)atomic_load(&paused_ms) / 1000.0);
+}
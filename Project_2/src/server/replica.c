@@ -0,0 +1,712 @@
+/**
+ * @file replica.c
+ * @brief Session state stream to a warm standby, and the standby's replay.
+ *
+ * On the primary every session has a ring of moves. The game threads append
+ * to it from the board's step hook, under the write lock the move already
+ * holds, so the ring has a single producer and the moves are in the order
+ * they were applied. One sender thread drains the rings onto a SOCK_STREAM
+ * UNIX socket and sends a keyframe instead when a level starts, a ring
+ * overflowed or the standby asks for one.
+ *
+ * The standby's main thread reads the stream before the server starts:
+ * keyframes are restored with board_restore() and moves are replayed with
+ * the movement functions the game threads call, so random ghosts draw the
+ * same numbers from the copied rng_seed.
+ */
+
+#define _GNU_SOURCE
+#include "../../include/replica.h"
+#include "../../include/catalog.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Marks a stream message ("PRPL") */
+#define REPLICA_MAGIC 0x4c505250u
+/** @brief Sessions streamed at once */
+#define REPLICA_MAX_SESSIONS 256
+/** @brief Moves a session can record between two flushes */
+#define REPLICA_RING 4096
+/** @brief Default flush period */
+#define REPLICA_FLUSH_MS 10
+/** @brief A standby that takes longer to read a message is dropped */
+#define REPLICA_SEND_TIMEOUT_MS 1000
+/** @brief Standby retry period while the primary is unreachable */
+#define REPLICA_RETRY_MS 200
+/** @brief Largest message a standby accepts */
+#define REPLICA_MAX_MESSAGE (64u << 20)
+
+/** @brief Stream message types */
+enum {
+  REPLICA_HELLO = 1, /**< Primary's pid in seq */
+  REPLICA_KEYFRAME,  /**< replica_keyframe_t and a saved board */
+  REPLICA_STEPS,     /**< replica_step_t array, seq is the first step */
+  REPLICA_END,       /**< The session ended or left */
+  REPLICA_RESYNC,    /**< Standby -> primary: send a keyframe */
+};
+
+/**
+ * @brief Header of every stream message.
+ */
+typedef struct {
+  unsigned int magic;
+  unsigned int type;
+  int slot;          /**< Session slot on the primary */
+  unsigned int size; /**< Bytes that follow */
+  uint64_t seq;      /**< Steps recorded before a keyframe, first step */
+} replica_hdr_t;
+
+/**
+ * @brief Fixed part of a keyframe, followed by the saved board.
+ */
+typedef struct {
+  uint64_t token;
+  migrate_state_t state;
+} replica_keyframe_t;
+
+/**
+ * @brief One move, as applied under the board's lock.
+ */
+typedef struct {
+  uint64_t hash;  /**< Board hash after the move */
+  uint8_t entity; /**< 0 for Pacman, 1 + index for a ghost */
+  char key;       /**< Command played, '\0' for the script's own */
+} replica_step_t;
+
+/**
+ * @brief A session streamed by the primary.
+ */
+typedef struct {
+  session_t *session; /**< NULL if the slot is free */
+  uint64_t token;
+  board_t *board;        /**< Level in play, NULL between levels */
+  migrate_state_t state; /**< Session state at level start */
+  replica_step_t *ring;  /**< REPLICA_RING moves */
+  atomic_ulong head;     /**< Moves recorded (board write lock held) */
+  atomic_ulong tail;     /**< Moves sent or dropped */
+  atomic_int keyframe;   /**< Send a keyframe before more moves */
+} stream_slot_t;
+
+/**
+ * @brief The standby's copy of a session.
+ */
+typedef struct {
+  int used;
+  int diverged; /**< Waiting for a keyframe after a hash mismatch */
+  uint64_t token;
+  uint64_t seq; /**< Next move expected */
+  migrate_state_t state;
+  board_t board;
+} shadow_t;
+
+static pthread_mutex_t stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static stream_slot_t slots[REPLICA_MAX_SESSIONS];
+static int conn = -1; /**< Connected standby, -1 for none */
+static int flush_ms = REPLICA_FLUSH_MS;
+static char listen_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static shadow_t shadows[REPLICA_MAX_SESSIONS];
+static int standby = 0;
+static atomic_int held_at_takeover;
+
+static atomic_ulong steps_streamed;
+static atomic_ulong keyframes_sent;
+static atomic_ullong bytes_streamed;
+static atomic_ulong ring_overflows;
+static atomic_ulong resyncs_asked;
+static atomic_ulong standby_connects;
+/* Standby counters, read by the signal thread while the stream replays */
+static atomic_ulong steps_replayed;
+static atomic_ulong keyframes_received;
+static atomic_ulong divergences;
+static atomic_ulong sessions_resumed;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long replica_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Fills a UNIX socket address.
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int socket_address(struct sockaddr_un *addr, const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path))
+    return -1;
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/**
+ * @brief Writes a whole buffer to a socket.
+ * @return 0 on success, -1 on error or send timeout.
+ */
+static int send_all(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads a whole buffer from a socket.
+ * @return 0 on success, -1 on EOF or error.
+ */
+static int read_all(int fd, void *buf, size_t len) {
+  char *p = buf;
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Sends a message to the standby (stream_mutex held).
+ * @return 0 on success, -1 if the standby was dropped.
+ */
+static int send_message(unsigned int type, int slot, uint64_t seq,
+                        const void *payload, size_t size) {
+  replica_hdr_t hdr = {.magic = REPLICA_MAGIC,
+                       .type = type,
+                       .slot = slot,
+                       .size = (unsigned int)size,
+                       .seq = seq};
+  if (send_all(conn, &hdr, sizeof(hdr)) != 0 ||
+      (size > 0 && send_all(conn, payload, size) != 0)) {
+    close(conn);
+    conn = -1;
+    return -1;
+  }
+  atomic_fetch_add(&bytes_streamed, sizeof(hdr) + size);
+  return 0;
+}
+
+/**
+ * @brief Step hook of streamed boards: appends the move to the ring.
+ *
+ * Runs under the board's write lock, so moves of a session never race; a
+ * full ring drops the move and asks for a keyframe instead.
+ */
+static void record_step(void *ctx, int entity, char key, uint64_t hash) {
+  stream_slot_t *s = ctx;
+  unsigned long head = atomic_load_explicit(&s->head, memory_order_relaxed);
+  if (head - atomic_load_explicit(&s->tail, memory_order_acquire) >=
+      REPLICA_RING) {
+    if (!atomic_exchange(&s->keyframe, 1))
+      atomic_fetch_add(&ring_overflows, 1);
+    return;
+  }
+  replica_step_t *step = &s->ring[head % REPLICA_RING];
+  step->hash = hash;
+  step->entity = (uint8_t)entity;
+  step->key = key;
+  atomic_store_explicit(&s->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Sends the board of a slot as a keyframe (stream_mutex held).
+ *
+ * Takes the board's read lock, so no move is recorded meanwhile: the moves
+ * still in the ring are part of the keyframe and are dropped.
+ * @return 0 on success, -1 if the standby was dropped.
+ */
+static int send_keyframe(int index) {
+  static char *buf = NULL;
+  static size_t capacity = 0;
+  stream_slot_t *s = &slots[index];
+  board_t *board = s->board;
+
+  board_rdlock(board);
+  size_t size = sizeof(replica_keyframe_t) + board_save_size(board);
+  if (size > capacity) {
+    char *grown = realloc(buf, size);
+    if (grown == NULL) {
+      pthread_rwlock_unlock(&board->state_lock);
+      atomic_store(&s->keyframe, 1); // Try again at the next flush
+      return 0;
+    }
+    buf = grown;
+    capacity = size;
+  }
+  board_save(board, buf + sizeof(replica_keyframe_t),
+             size - sizeof(replica_keyframe_t));
+  unsigned long head = atomic_load(&s->head);
+  atomic_store_explicit(&s->tail, head, memory_order_release);
+  pthread_rwlock_unlock(&board->state_lock);
+
+  replica_keyframe_t keyframe = {.token = s->token, .state = s->state};
+  memcpy(buf, &keyframe, sizeof(keyframe));
+  atomic_fetch_add(&keyframes_sent, 1);
+  return send_message(REPLICA_KEYFRAME, index, head, buf, size);
+}
+
+/**
+ * @brief Sends the moves recorded since the last flush (stream_mutex held).
+ * @return 0 on success, -1 if the standby was dropped.
+ */
+static int send_steps(int index) {
+  static replica_step_t batch[REPLICA_RING];
+  stream_slot_t *s = &slots[index];
+  unsigned long tail = atomic_load(&s->tail);
+  unsigned long head = atomic_load_explicit(&s->head, memory_order_acquire);
+  if (head == tail)
+    return 0;
+  unsigned long n = head - tail;
+  for (unsigned long i = 0; i < n; i++)
+    batch[i] = s->ring[(tail + i) % REPLICA_RING];
+  // Copied: the game threads may reuse those entries now
+  atomic_store_explicit(&s->tail, head, memory_order_release);
+  atomic_fetch_add(&steps_streamed, n);
+  return send_message(REPLICA_STEPS, index, tail, batch,
+                      n * sizeof(replica_step_t));
+}
+
+/**
+ * @brief Reads the standby's keyframe requests (stream_mutex held).
+ */
+static void read_resyncs(void) {
+  replica_hdr_t hdr;
+  while (conn != -1) {
+    ssize_t n = recv(conn, &hdr, sizeof(hdr), MSG_DONTWAIT | MSG_PEEK);
+    if (n == 0) {
+      close(conn); // Standby gone
+      conn = -1;
+      return;
+    }
+    if (n != (ssize_t)sizeof(hdr) || read_all(conn, &hdr, sizeof(hdr)) != 0)
+      return;
+    if (hdr.magic == REPLICA_MAGIC && hdr.type == REPLICA_RESYNC &&
+        hdr.slot >= 0 && hdr.slot < REPLICA_MAX_SESSIONS) {
+      atomic_store(&slots[hdr.slot].keyframe, 1);
+      atomic_fetch_add(&resyncs_asked, 1);
+    }
+  }
+}
+
+/**
+ * @brief Sender thread: flushes every session's moves each period.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *sender_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (1) {
+    sleep_ms(flush_ms);
+    pthread_mutex_lock(&stream_mutex);
+    read_resyncs();
+    for (int i = 0; i < REPLICA_MAX_SESSIONS; i++) {
+      stream_slot_t *s = &slots[i];
+      if (s->session == NULL)
+        continue;
+      if (conn == -1) {
+        // Nobody listens: keep the ring empty, the next standby gets a
+        // keyframe anyway
+        atomic_store(&s->tail, atomic_load(&s->head));
+        continue;
+      }
+      if (s->board == NULL)
+        continue;
+      if (atomic_exchange(&s->keyframe, 0))
+        send_keyframe(i);
+      else
+        send_steps(i);
+    }
+    pthread_mutex_unlock(&stream_mutex);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Listener thread: a standby connecting replaces the previous one.
+ * @param arg Listening socket.
+ * @return void* Never returns.
+ */
+static void *accept_thread(void *arg) {
+  int listen_fd = (int)(intptr_t)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (1) {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd == -1)
+      continue;
+    // A stuck standby must not stall the sender thread for long
+    struct timeval timeout = {.tv_sec = REPLICA_SEND_TIMEOUT_MS / 1000,
+                              .tv_usec = REPLICA_SEND_TIMEOUT_MS % 1000 * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    pthread_mutex_lock(&stream_mutex);
+    if (conn != -1)
+      close(conn);
+    conn = fd;
+    atomic_fetch_add(&standby_connects, 1);
+    if (send_message(REPLICA_HELLO, -1, (uint64_t)getpid(), NULL, 0) == 0) {
+      for (int i = 0; i < REPLICA_MAX_SESSIONS; i++)
+        atomic_store(&slots[i].keyframe, 1);
+    }
+    pthread_mutex_unlock(&stream_mutex);
+  }
+  return NULL;
+}
+
+int replica_start(void) {
+  const char *flush = getenv("PACMANIST_REPLICA_FLUSH_MS");
+  if (flush != NULL && atoi(flush) > 0)
+    flush_ms = atoi(flush);
+  const char *path = getenv("PACMANIST_REPLICA_SOCKET");
+  if (path == NULL || path[0] == '\0')
+    return 0;
+
+  struct sockaddr_un addr;
+  if (socket_address(&addr, path) != 0)
+    return -1;
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1)
+    return -1;
+  unlink(path);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 1) != 0) {
+    close(listen_fd);
+    return -1;
+  }
+  strcpy(listen_path, path);
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, accept_thread,
+                     (void *)(intptr_t)listen_fd) != 0)
+    return -1;
+  pthread_detach(tid);
+  if (pthread_create(&tid, NULL, sender_thread, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+void replica_stop(void) {
+  if (listen_path[0] != '\0')
+    unlink(listen_path);
+}
+
+int replica_streaming(void) { return listen_path[0] != '\0'; }
+
+void replica_register(session_t *session, uint64_t token) {
+  while (token == 0) {
+    if (getrandom(&token, sizeof(token), 0) != sizeof(token))
+      token = (uint64_t)replica_now_ns() ^ ((uint64_t)getpid() << 32);
+  }
+  session->resume_token = token;
+  session->replica_slot = -1;
+  if (!replica_streaming())
+    return;
+
+  replica_step_t *ring = malloc(REPLICA_RING * sizeof(replica_step_t));
+  if (ring == NULL)
+    return;
+  pthread_mutex_lock(&stream_mutex);
+  for (int i = 0; i < REPLICA_MAX_SESSIONS; i++) {
+    stream_slot_t *s = &slots[i];
+    if (s->session != NULL)
+      continue;
+    s->session = session;
+    s->token = token;
+    s->board = NULL;
+    s->ring = ring;
+    atomic_store(&s->head, 0);
+    atomic_store(&s->tail, 0);
+    atomic_store(&s->keyframe, 1);
+    session->replica_slot = i;
+    break;
+  }
+  pthread_mutex_unlock(&stream_mutex);
+  if (session->replica_slot == -1)
+    free(ring);
+}
+
+void replica_unregister(session_t *session) {
+  if (session->replica_slot < 0)
+    return;
+  pthread_mutex_lock(&stream_mutex);
+  stream_slot_t *s = &slots[session->replica_slot];
+  if (conn != -1)
+    send_message(REPLICA_END, session->replica_slot, 0, NULL, 0);
+  free(s->ring);
+  s->ring = NULL;
+  s->board = NULL;
+  s->session = NULL;
+  pthread_mutex_unlock(&stream_mutex);
+  session->replica_slot = -1;
+}
+
+void replica_level_start(session_t *session, board_t *board,
+                         const migrate_state_t *state) {
+  if (session->replica_slot < 0)
+    return;
+  pthread_mutex_lock(&stream_mutex);
+  stream_slot_t *s = &slots[session->replica_slot];
+  s->board = board;
+  s->state = *state;
+  board->on_step = record_step;
+  board->step_ctx = s;
+  atomic_store(&s->keyframe, 1);
+  pthread_mutex_unlock(&stream_mutex);
+}
+
+void replica_level_end(session_t *session) {
+  if (session->replica_slot < 0)
+    return;
+  pthread_mutex_lock(&stream_mutex);
+  slots[session->replica_slot].board = NULL;
+  pthread_mutex_unlock(&stream_mutex);
+}
+
+int replica_standby(void) {
+  const char *path = getenv("PACMANIST_REPLICA_OF");
+  return path != NULL && path[0] != '\0';
+}
+
+/**
+ * @brief Frees the copy of a session.
+ */
+static void drop_shadow(shadow_t *shadow) {
+  if (shadow->used)
+    unload_level(&shadow->board);
+  memset(shadow, 0, sizeof(*shadow));
+}
+
+/**
+ * @brief Marks a copy as diverged and asks the primary for a keyframe.
+ */
+static void diverge(int fd, int slot) {
+  shadows[slot].diverged = 1;
+  divergences++;
+  replica_hdr_t hdr = {
+      .magic = REPLICA_MAGIC, .type = REPLICA_RESYNC, .slot = slot};
+  send_all(fd, &hdr, sizeof(hdr));
+}
+
+/**
+ * @brief Replays one move on a copy, as the game thread that made it did.
+ * @return 0 if the board hash matches the primary's after the move.
+ */
+static int replay_step(board_t *board, const replica_step_t *step) {
+  if (step->entity == 0) {
+    pacman_t *pacman = &board->pacmans[0];
+    command_t key = {step->key, 0, 0};
+    command_t *play = &key;
+    if (step->key == '\0' && pacman->n_moves > 0)
+      play = &pacman->moves[pacman->current_move % pacman->n_moves];
+    move_pacman(board, 0, play);
+  } else {
+    int index = step->entity - 1;
+    if (index >= board->n_ghosts)
+      return -1;
+    ghost_t *ghost = &board->ghosts[index];
+    command_t key = {step->key, 1, 1};
+    command_t *play = &key;
+    if (step->key == '\0' && ghost->n_moves > 0)
+      play = &ghost->moves[ghost->current_move % ghost->n_moves];
+    move_ghost(board, index, play);
+  }
+  return board->hash == step->hash ? 0 : -1;
+}
+
+/**
+ * @brief Applies one stream message to the copies.
+ */
+static void apply_message(int fd, const replica_hdr_t *hdr, const char *payload,
+                          pid_t *primary) {
+  if (hdr->type == REPLICA_HELLO) {
+    *primary = (pid_t)hdr->seq;
+    return;
+  }
+  if (hdr->slot < 0 || hdr->slot >= REPLICA_MAX_SESSIONS)
+    return;
+  shadow_t *shadow = &shadows[hdr->slot];
+
+  if (hdr->type == REPLICA_KEYFRAME) {
+    drop_shadow(shadow);
+    replica_keyframe_t keyframe;
+    if (hdr->size < sizeof(keyframe))
+      return;
+    memcpy(&keyframe, payload, sizeof(keyframe));
+    if (board_restore(&shadow->board, payload + sizeof(keyframe),
+                      hdr->size - sizeof(keyframe)) != 0)
+      return;
+    shadow->used = 1;
+    shadow->token = keyframe.token;
+    shadow->state = keyframe.state;
+    shadow->state.player[PIPE_NAME_SIZE - 1] = '\0';
+    shadow->seq = hdr->seq;
+    keyframes_received++;
+  } else if (hdr->type == REPLICA_STEPS) {
+    if (!shadow->used || shadow->diverged)
+      return; // A keyframe is on its way
+    if (hdr->seq != shadow->seq) {
+      diverge(fd, hdr->slot);
+      return;
+    }
+    const replica_step_t *steps = (const replica_step_t *)payload;
+    size_t n = hdr->size / sizeof(replica_step_t);
+    for (size_t i = 0; i < n; i++) {
+      if (replay_step(&shadow->board, &steps[i]) != 0) {
+        diverge(fd, hdr->slot);
+        return;
+      }
+      shadow->seq++;
+      steps_replayed++;
+    }
+  } else if (hdr->type == REPLICA_END) {
+    drop_shadow(shadow);
+  }
+}
+
+/**
+ * @brief Applies the primary's stream until it ends.
+ * @param fd Connected socket.
+ * @param primary Receives the primary's pid.
+ */
+static void follow_stream(int fd, pid_t *primary) {
+  static char *payload = NULL;
+  static size_t capacity = 0;
+  replica_hdr_t hdr;
+  while (read_all(fd, &hdr, sizeof(hdr)) == 0) {
+    if (hdr.magic != REPLICA_MAGIC || hdr.size > REPLICA_MAX_MESSAGE)
+      return;
+    if (hdr.size > capacity) {
+      char *grown = realloc(payload, hdr.size);
+      if (grown == NULL)
+        return;
+      payload = grown;
+      capacity = hdr.size;
+    }
+    if (hdr.size > 0 && read_all(fd, payload, hdr.size) != 0)
+      return;
+    apply_message(fd, &hdr, payload, primary);
+  }
+}
+
+int replica_follow(void) {
+  const char *path = getenv("PACMANIST_REPLICA_OF");
+  struct sockaddr_un addr;
+  if (path == NULL || socket_address(&addr, path) != 0)
+    return -1;
+  standby = 1;
+
+  pid_t primary = 0;
+  while (1) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd != -1 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+      follow_stream(fd, &primary);
+    if (fd != -1)
+      close(fd);
+    // The stream also ends when the primary drops a slow standby
+    if (primary > 0 && kill(primary, 0) == -1 && errno == ESRCH)
+      break;
+    sleep_ms(REPLICA_RETRY_MS);
+  }
+
+  for (int i = 0; i < REPLICA_MAX_SESSIONS; i++)
+    if (shadows[i].used && !shadows[i].diverged)
+      held_at_takeover++;
+  return 0;
+}
+
+migrate_session_t *replica_claim(uint64_t token) {
+  if (token == 0)
+    return NULL;
+  for (int i = 0; i < REPLICA_MAX_SESSIONS; i++) {
+    shadow_t *shadow = &shadows[i];
+    if (!shadow->used || shadow->diverged || shadow->token != token)
+      continue;
+
+    // Catalogs may list levels differently: continue from the same file
+    int level = -1;
+    level_catalog_t *catalog = catalog_acquire();
+    for (int l = 0; l < catalog->count && level < 0; l++)
+      if (strcmp(catalog->levels[l].board.level_name,
+                 shadow->board.level_name) == 0)
+        level = l;
+    catalog_release(catalog);
+    migrate_session_t *session = calloc(1, sizeof(*session));
+    if (level < 0 || session == NULL) {
+      free(session);
+      return NULL;
+    }
+
+    session->state = shadow->state;
+    session->state.level = level;
+    session->state.resume_token = token;
+    session->board = shadow->board;
+    session->notif_fd = -1;
+    session->req_fd = -1;
+    memset(shadow, 0, sizeof(*shadow)); // The board now belongs to it
+    sessions_resumed++;
+    return session;
+  }
+  return NULL;
+}
+
+void replica_dump_stats(FILE *f) {
+  fprintf(f, "=== REPLICATION ===\n");
+  if (replica_streaming()) {
+    fprintf(f, "Streaming sessions on %s every %d ms (standby %s)\n",
+            listen_path, flush_ms, conn != -1 ? "connected" : "absent");
+    fprintf(f,
+            "Moves streamed: %lu, keyframes: %lu, %.1f KB, standby "
+            "connections: %lu\n",
+            atomic_load(&steps_streamed), atomic_load(&keyframes_sent),
+            (double)atomic_load(&bytes_streamed) / 1024.0,
+            atomic_load(&standby_connects));
+    fprintf(f, "Keyframes for full rings: %lu, asked by the standby: %lu\n",
+            atomic_load(&ring_overflows), atomic_load(&resyncs_asked));
+  } else if (!standby) {
+    fprintf(f, "Not replicated\n");
+  }
+  if (standby) {
+    fprintf(f,
+            "Standby: %lu moves replayed, %lu keyframes, %lu divergences\n",
+            atomic_load(&steps_replayed), atomic_load(&keyframes_received),
+            atomic_load(&divergences));
+    fprintf(f, "Took over with %d sessions, %lu resumed\n",
+            atomic_load(&held_at_takeover), atomic_load(&sessions_resumed));
+  }
+}
@@ -0,0 +1,293 @@
+/**
+ * @file scheduler.c
+ * @brief Phase-staggered tick scheduling for game sessions.
+ *
+ * Every session ticks on its own grid (epoch + phase + k * tempo). Phases are
+ * spread evenly across the period of each session and recomputed whenever a
+ * session registers or leaves, so sessions that start together do not wake
+ * up together.
+ */
+
+#define _GNU_SOURCE
+#include "../../include/scheduler.h"
+#include "../../include/board.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define NS_PER_MS 1000000LL
+#define NS_PER_SEC 1000000000LL
+
+/** @brief Number of 1 ms buckets in the per-core wakeup window (1 second) */
+#define SMOOTH_BUCKETS 1000
+
+/**
+ * @brief Scheduling state of one registered session.
+ */
+typedef struct {
+  int active;                  /**< 1 while a session owns the slot */
+  atomic_int period_ms;        /**< Tick period (level tempo) */
+  atomic_llong phase_ns;       /**< Offset of the tick grid inside the period */
+} sched_slot_t;
+
+static sched_slot_t *slots = NULL;
+static int slot_capacity = 0;
+static int active_slots = 0;
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static long long epoch_ns = 0;
+
+static atomic_ullong lateness_hist[SCHED_LATE_BUCKETS];
+static atomic_ullong total_wakeups;
+static atomic_ullong overruns;
+static atomic_ullong rebalances;
+
+/* Each bucket packs (absolute ms << 16) | wakeups, so stale buckets from a
+ * previous second are recognized and restarted without a lock. */
+static atomic_ullong core_buckets[SCHED_MAX_CORES][SMOOTH_BUCKETS];
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ * @return Current monotonic time.
+ */
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * @brief Spreads the phases of all active slots evenly over their periods.
+ *
+ * Must be called with sched_mutex held.
+ */
+static void rebalance_phases(void) {
+  int rank = 0;
+  for (int i = 0; i < slot_capacity; i++) {
+    if (!slots[i].active)
+      continue;
+    long long period = (long long)atomic_load(&slots[i].period_ms) * NS_PER_MS;
+    atomic_store(&slots[i].phase_ns, period * rank / active_slots);
+    rank++;
+  }
+  atomic_fetch_add(&rebalances, 1);
+}
+
+/**
+ * @brief Accounts a wakeup on the calling thread's CPU.
+ * @param t Wakeup time in nanoseconds.
+ */
+static void record_core_wakeup(long long t) {
+  int cpu = sched_getcpu();
+  if (cpu < 0)
+    cpu = 0;
+  cpu %= SCHED_MAX_CORES;
+
+  unsigned long long ms = (unsigned long long)(t / NS_PER_MS);
+  atomic_ullong *bucket = &core_buckets[cpu][ms % SMOOTH_BUCKETS];
+  unsigned long long old = atomic_load(bucket);
+  unsigned long long next;
+  do {
+    if ((old >> 16) == ms)
+      next = old + 1;
+    else
+      next = (ms << 16) | 1;
+  } while (!atomic_compare_exchange_weak(bucket, &old, next));
+}
+
+/**
+ * @brief Accounts the lateness of a wakeup in the histogram.
+ * @param late_ns Lateness in nanoseconds.
+ */
+static void record_lateness(long long late_ns) {
+  long long us = late_ns > 0 ? late_ns / 1000 : 0;
+  int b = 0;
+  while (b < SCHED_LATE_BUCKETS - 1 && us >= (1LL << b))
+    b++;
+  atomic_fetch_add(&lateness_hist[b], 1);
+  atomic_fetch_add(&total_wakeups, 1);
+}
+
+/**
+ * @brief Returns the period of a slot in nanoseconds (at least 1 ms).
+ * @param slot Valid slot index.
+ * @return Period in nanoseconds.
+ */
+static long long slot_period_ns(int slot) {
+  long long period = (long long)atomic_load(&slots[slot].period_ms) * NS_PER_MS;
+  return period > 0 ? period : NS_PER_MS;
+}
+
+int sched_init(int max_sessions) {
+  slots = calloc((size_t)max_sessions, sizeof(sched_slot_t));
+  if (slots == NULL)
+    return -1;
+  slot_capacity = max_sessions;
+  epoch_ns = now_ns();
+  return 0;
+}
+
+int sched_register(int period_ms) {
+  int slot = -1;
+  pthread_mutex_lock(&sched_mutex);
+  for (int i = 0; i < slot_capacity; i++) {
+    if (!slots[i].active) {
+      slots[i].active = 1;
+      atomic_store(&slots[i].period_ms, period_ms);
+      active_slots++;
+      rebalance_phases();
+      slot = i;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&sched_mutex);
+  return slot;
+}
+
+void sched_set_period(int slot, int period_ms) {
+  if (slot < 0 || slot >= slot_capacity)
+    return;
+  pthread_mutex_lock(&sched_mutex);
+  atomic_store(&slots[slot].period_ms, period_ms);
+  rebalance_phases();
+  pthread_mutex_unlock(&sched_mutex);
+}
+
+void sched_unregister(int slot) {
+  if (slot < 0 || slot >= slot_capacity)
+    return;
+  pthread_mutex_lock(&sched_mutex);
+  if (slots[slot].active) {
+    slots[slot].active = 0;
+    active_slots--;
+    if (active_slots > 0)
+      rebalance_phases();
+  }
+  pthread_mutex_unlock(&sched_mutex);
+}
+
+void sched_tick_start(int slot, struct timespec *deadline) {
+  long long t = now_ns();
+  if (slot >= 0 && slot < slot_capacity) {
+    long long period = slot_period_ns(slot);
+    long long phase = atomic_load(&slots[slot].phase_ns);
+    long long n = (t - epoch_ns - phase) / period + 1;
+    t = epoch_ns + phase + n * period;
+  }
+  deadline->tv_sec = t / NS_PER_SEC;
+  deadline->tv_nsec = t % NS_PER_SEC;
+}
+
+long sched_wait_ticks(int slot, struct timespec *deadline, int period_ms,
+                      int ticks) {
+  if (ticks < 1)
+    ticks = 1;
+  if (slot < 0 || slot >= slot_capacity) {
+    sleep_ms(period_ms * ticks);
+    return 0;
+  }
+
+  long long period = slot_period_ns(slot);
+  long long phase = atomic_load(&slots[slot].phase_ns);
+  long long prev = (long long)deadline->tv_sec * NS_PER_SEC + deadline->tv_nsec;
+
+  // Snap to the nearest boundary of the (possibly rebalanced) grid.
+  long long rel = prev + ticks * period - epoch_ns - phase;
+  long long next = epoch_ns + phase + ((rel + period / 2) / period) * period;
+  if (next <= prev)
+    next += period;
+
+  deadline->tv_sec = next / NS_PER_SEC;
+  deadline->tv_nsec = next % NS_PER_SEC;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) ==
+         EINTR)
+    ;
+
+  long long woke = now_ns();
+  long long late = woke - next;
+  record_lateness(late);
+  record_core_wakeup(woke);
+
+  // Overran a whole period: restart from the last boundary instead of
+  // bursting through the missed ones.
+  if (late > period) {
+    atomic_fetch_add(&overruns, 1);
+    long long n = (woke - epoch_ns - phase) / period;
+    next = epoch_ns + phase + n * period;
+    deadline->tv_sec = next / NS_PER_SEC;
+    deadline->tv_nsec = next % NS_PER_SEC;
+  }
+  return (long)late;
+}
+
+void sched_lateness_snapshot(unsigned long long hist[SCHED_LATE_BUCKETS]) {
+  for (int b = 0; b < SCHED_LATE_BUCKETS; b++) {
+    hist[b] = atomic_load(&lateness_hist[b]);
+  }
+}
+
+long sched_lateness_percentile(const unsigned long long hist[SCHED_LATE_BUCKETS],
+                               double pct) {
+  unsigned long long total = 0;
+  for (int b = 0; b < SCHED_LATE_BUCKETS; b++)
+    total += hist[b];
+  if (total == 0)
+    return 0;
+
+  unsigned long long rank = (unsigned long long)(total * pct / 100.0);
+  unsigned long long seen = 0;
+  for (int b = 0; b < SCHED_LATE_BUCKETS; b++) {
+    seen += hist[b];
+    if (seen > rank)
+      return 1L << b;
+  }
+  return 1L << (SCHED_LATE_BUCKETS - 1);
+}
+
+void sched_dump_stats(FILE *f) {
+  fprintf(f, "=== TICK SCHEDULER ===\n");
+
+  pthread_mutex_lock(&sched_mutex);
+  fprintf(f, "Active sessions: %d (rebalances: %llu)\n", active_slots,
+          (unsigned long long)atomic_load(&rebalances));
+  for (int i = 0; i < slot_capacity; i++) {
+    if (slots[i].active) {
+      fprintf(f, "  slot %d: period %d ms, phase %.2f ms\n", i,
+              atomic_load(&slots[i].period_ms),
+              (double)atomic_load(&slots[i].phase_ns) / NS_PER_MS);
+    }
+  }
+  pthread_mutex_unlock(&sched_mutex);
+
+  unsigned long long hist[SCHED_LATE_BUCKETS];
+  sched_lateness_snapshot(hist);
+  fprintf(f, "Tick wakeups: %llu (overruns: %llu)\n",
+          (unsigned long long)atomic_load(&total_wakeups),
+          (unsigned long long)atomic_load(&overruns));
+  fprintf(f, "Tick lateness: p50 < %ld us, p99 < %ld us\n",
+          sched_lateness_percentile(hist, 50.0),
+          sched_lateness_percentile(hist, 99.0));
+
+  // Smoothness = mean / peak wakeups per 1 ms over the last second
+  // (1.0 means perfectly flat load).
+  unsigned long long now_ms = (unsigned long long)(now_ns() / NS_PER_MS);
+  for (int cpu = 0; cpu < SCHED_MAX_CORES; cpu++) {
+    unsigned long long total = 0, peak = 0;
+    for (int b = 0; b < SMOOTH_BUCKETS; b++) {
+      unsigned long long v = atomic_load(&core_buckets[cpu][b]);
+      unsigned long long ms = v >> 16;
+      if (ms + SMOOTH_BUCKETS <= now_ms || ms > now_ms)
+        continue;
+      unsigned long long count = v & 0xFFFF;
+      total += count;
+      if (count > peak)
+        peak = count;
+    }
+    if (total == 0)
+      continue;
+    double mean = (double)total / SMOOTH_BUCKETS;
+    fprintf(f, "  cpu %d: %llu wakeups/s, peak %llu/ms, smoothness %.3f\n",
+            cpu, total, peak, mean / (double)peak);
+  }
+}
@@ -0,0 +1,423 @@
+/**
+ * @file scores.c
+ * @brief Persistent score store: append-only log, mapped index, committer.
+ *
+ * Workers only append a record to an in-memory queue. The committer thread
+ * takes everything queued, writes it to scores.log with one write() and one
+ * fdatasync() (group commit: sessions ending during a sync share the next
+ * one) and then applies the batch to the mapped index under its sequence
+ * lock. A batch that fails to commit is kept and retried with backoff,
+ * while later records queue up behind it.
+ */
+
+#include "../../include/scores.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief First wait before retrying a failed commit, doubled per failure */
+#define SCORES_RETRY_MIN_MS 10
+/** @brief Longest wait between commit retries */
+#define SCORES_RETRY_MAX_MS 5000
+
+static int log_fd = -1;
+static scores_index_t *index_map = NULL;
+static char data_dir[512];
+
+/* Records waiting for the committer */
+static score_record_t *queue = NULL;
+static int queue_len = 0, queue_cap = 0;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+static atomic_ulong batches;
+static atomic_ulong committed;
+static atomic_ulong max_batch;
+static atomic_ullong sync_ns;
+static atomic_ulong commit_errors;
+static atomic_ulong records_lost;    /* Could not be queued */
+static atomic_ulong players_full;    /* Recorded without a per-player entry */
+static unsigned long replayed;
+static unsigned long truncated_bytes;
+static int rebuilt;
+static double recovery_ms;
+
+/**
+ * @brief FNV-1a over a buffer, continuing from hash.
+ */
+static uint64_t fnv1a(const void *buf, size_t size, uint64_t hash) {
+  const unsigned char *p = buf;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Checksum stored in a record (FNV-1a from seq on, 32 bits).
+ */
+static uint32_t record_checksum(const score_record_t *r) {
+  uint64_t h = fnv1a(&r->seq, sizeof(*r) - offsetof(score_record_t, seq),
+                     0xcbf29ce484222325ULL);
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+/**
+ * @brief Checksum of the index tables and counters.
+ */
+static uint64_t index_checksum(const scores_index_t *idx) {
+  uint64_t h = fnv1a(&idx->log_offset,
+                     offsetof(scores_index_t, top) -
+                         offsetof(scores_index_t, log_offset),
+                     0xcbf29ce484222325ULL);
+  h = fnv1a(idx->top, sizeof(idx->top), h);
+  return fnv1a(idx->slots, sizeof(idx->slots), h);
+}
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long scores_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Applies one record to the index (seqlock already held).
+ */
+static void index_apply(scores_index_t *idx, const score_record_t *r) {
+  idx->records++;
+
+  // All-time top: insertion into the sorted array
+  int n = (int)idx->top_count;
+  if (n < SCORES_TOP_K || r->points > idx->top[n - 1].points) {
+    int pos = n < SCORES_TOP_K ? n : SCORES_TOP_K - 1;
+    while (pos > 0 && idx->top[pos - 1].points < r->points) {
+      idx->top[pos] = idx->top[pos - 1];
+      pos--;
+    }
+    idx->top[pos] = *r;
+    if (n < SCORES_TOP_K)
+      idx->top_count++;
+  }
+
+  // Per-player best: linear probing on the name hash
+  uint64_t h = fnv1a(r->player, strnlen(r->player, SCORES_NAME_SIZE),
+                     0xcbf29ce484222325ULL);
+  for (int probe = 0; probe < SCORES_PLAYER_SLOTS; probe++) {
+    score_player_t *slot =
+        &idx->slots[(h + (uint64_t)probe) & (SCORES_PLAYER_SLOTS - 1)];
+    if (slot->player[0] == '\0') {
+      memcpy(slot->player, r->player, SCORES_NAME_SIZE);
+      slot->best = r->points;
+      slot->best_time = r->ended;
+      slot->sessions = 1;
+      idx->players++;
+      return;
+    }
+    if (strncmp(slot->player, r->player, SCORES_NAME_SIZE) == 0) {
+      slot->sessions++;
+      if (r->points > slot->best) {
+        slot->best = r->points;
+        slot->best_time = r->ended;
+      }
+      return;
+    }
+  }
+  // Every slot belongs to another player: only the totals and top count it
+  atomic_fetch_add(&players_full, 1);
+}
+
+/**
+ * @brief Opens the write side of the sequence lock.
+ */
+static void index_begin(void) {
+  __atomic_store_n(&index_map->seqlock, index_map->seqlock + 1,
+                   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Closes the write side of the sequence lock, sealing the checksum.
+ */
+static void index_end(void) {
+  index_map->checksum = index_checksum(index_map);
+  __atomic_store_n(&index_map->seqlock, index_map->seqlock + 1,
+                   __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Replays the log from the index's offset, truncating a torn tail.
+ * @param from_scratch Discard the index and replay the whole log.
+ */
+static void recover(int from_scratch) {
+  if (from_scratch) {
+    uint64_t next_id = index_map->next_client_id;
+    memset(index_map, 0, sizeof(*index_map));
+    index_map->magic = SCORES_INDEX_MAGIC;
+    index_map->version = SCORES_INDEX_VERSION;
+    index_map->next_client_id = next_id > 0 ? next_id : 1;
+    rebuilt = 1;
+  }
+
+  struct stat st;
+  if (fstat(log_fd, &st) != 0)
+    return;
+  uint64_t offset = index_map->log_offset;
+  uint64_t size = (uint64_t)st.st_size;
+  score_record_t batch[256];
+  index_begin();
+  while (offset + sizeof(score_record_t) <= size) {
+    ssize_t n = pread(log_fd, batch, sizeof(batch), (off_t)offset);
+    if (n < (ssize_t)sizeof(score_record_t))
+      break;
+    int count = (int)((size_t)n / sizeof(score_record_t)), i;
+    for (i = 0; i < count; i++) {
+      if (batch[i].magic != SCORES_RECORD_MAGIC ||
+          batch[i].checksum != record_checksum(&batch[i]))
+        break;
+      index_apply(index_map, &batch[i]);
+      if ((uint64_t)batch[i].client_id >= index_map->next_client_id)
+        index_map->next_client_id = (uint64_t)batch[i].client_id + 1;
+      offset += sizeof(score_record_t);
+      replayed++;
+    }
+    if (i < count)
+      break;
+  }
+  index_map->log_offset = offset;
+  index_end();
+
+  // Anything after the last valid record is a write torn by a crash
+  if (offset < size) {
+    truncated_bytes = (unsigned long)(size - offset);
+    if (ftruncate(log_fd, (off_t)offset) != 0)
+      perror("[Scores] ftruncate");
+  }
+}
+
+/**
+ * @brief Committer thread: group-commits queued records.
+ * @param arg Unused.
+ * @return void* Never returns.
+ */
+static void *committer_thread(void *arg) {
+  (void)arg;
+
+  /* Block SIGUSR1 - only the signal thread handles it */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  score_record_t *batch = NULL;
+  int batch_cap = 0, n = 0;
+  int retry_ms = 0; // Wait before retrying the batch, 0 once it is committed
+  while (1) {
+    if (retry_ms > 0) {
+      // Same batch, same offset: a torn first attempt is overwritten
+      struct timespec wait = {.tv_sec = retry_ms / 1000,
+                              .tv_nsec = (long)(retry_ms % 1000) * 1000000L};
+      nanosleep(&wait, NULL);
+    } else {
+      pthread_mutex_lock(&queue_mutex);
+      while (queue_len == 0)
+        pthread_cond_wait(&queue_cond, &queue_mutex);
+      // Swap buffers: workers keep appending while this batch is written
+      score_record_t *taken = queue;
+      int taken_cap = queue_cap;
+      n = queue_len;
+      queue = batch;
+      queue_cap = batch_cap;
+      queue_len = 0;
+      batch = taken;
+      batch_cap = taken_cap;
+      pthread_mutex_unlock(&queue_mutex);
+
+      uint64_t seq = index_map->records;
+      for (int i = 0; i < n; i++) {
+        batch[i].seq = ++seq;
+        batch[i].checksum = record_checksum(&batch[i]);
+      }
+    }
+
+    long long start = scores_now_ns();
+    size_t size = (size_t)n * sizeof(score_record_t);
+    ssize_t written = pwrite(log_fd, batch, size, (off_t)index_map->log_offset);
+    int ok = written == (ssize_t)size && fdatasync(log_fd) == 0;
+    atomic_fetch_add(&sync_ns, (unsigned long long)(scores_now_ns() - start));
+    if (!ok) {
+      atomic_fetch_add(&commit_errors, 1);
+      if (retry_ms == 0)
+        perror("[Scores] Failed to commit scores, retrying");
+      retry_ms = retry_ms == 0 ? SCORES_RETRY_MIN_MS : retry_ms * 2;
+      if (retry_ms > SCORES_RETRY_MAX_MS)
+        retry_ms = SCORES_RETRY_MAX_MS;
+      continue;
+    }
+    retry_ms = 0;
+
+    index_begin();
+    for (int i = 0; i < n; i++)
+      index_apply(index_map, &batch[i]);
+    index_map->log_offset += size;
+    index_end();
+    msync(index_map, sizeof(*index_map), MS_ASYNC);
+
+    atomic_fetch_add(&batches, 1);
+    atomic_fetch_add(&committed, (unsigned long)n);
+    if ((unsigned long)n > atomic_load(&max_batch))
+      atomic_store(&max_batch, (unsigned long)n);
+  }
+  return NULL;
+}
+
+int scores_start(void) {
+  long long start = scores_now_ns();
+  const char *dir = getenv("PACMANIST_DATA_DIR");
+  if (dir == NULL || dir[0] == '\0')
+    dir = "data";
+  strncpy(data_dir, dir, sizeof(data_dir) - 1);
+  if (mkdir(data_dir, 0755) == -1 && errno != EEXIST)
+    return -1;
+
+  char path[600];
+  snprintf(path, sizeof(path), "%s/scores.log", data_dir);
+  log_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (log_fd == -1)
+    return -1;
+
+  snprintf(path, sizeof(path), "%s/scores.idx", data_dir);
+  int idx_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (idx_fd == -1)
+    return -1;
+  struct stat st;
+  int fresh = fstat(idx_fd, &st) != 0 ||
+              (size_t)st.st_size != sizeof(scores_index_t);
+  if (fresh && ftruncate(idx_fd, (off_t)sizeof(scores_index_t)) != 0) {
+    close(idx_fd);
+    return -1;
+  }
+  void *base = mmap(NULL, sizeof(scores_index_t), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, idx_fd, 0);
+  close(idx_fd);
+  if (base == MAP_FAILED)
+    return -1;
+  index_map = (scores_index_t *)base;
+
+  // Trust the index only if it is complete and covers a prefix of the log
+  struct stat log_st;
+  fstat(log_fd, &log_st);
+  int valid = !fresh && index_map->magic == SCORES_INDEX_MAGIC &&
+              index_map->version == SCORES_INDEX_VERSION &&
+              (index_map->seqlock & 1) == 0 &&
+              index_map->checksum == index_checksum(index_map) &&
+              index_map->log_offset <= (uint64_t)log_st.st_size &&
+              index_map->log_offset % sizeof(score_record_t) == 0;
+  recover(!valid);
+  recovery_ms = (double)(scores_now_ns() - start) / 1e6;
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, committer_thread, NULL) != 0)
+    return -1;
+  pthread_detach(tid);
+  return 0;
+}
+
+int scores_next_client_id(void) {
+  return (int)__atomic_fetch_add(&index_map->next_client_id, 1,
+                                 __ATOMIC_RELAXED);
+}
+
+void scores_record(const char *player, int client_id, int points,
+                   int levels) {
+  score_record_t r;
+  memset(&r, 0, sizeof(r));
+  r.magic = SCORES_RECORD_MAGIC;
+  r.ended = (int64_t)time(NULL);
+  r.client_id = client_id;
+  r.points = points;
+  r.levels = levels;
+  strncpy(r.player, player, SCORES_NAME_SIZE - 1);
+
+  pthread_mutex_lock(&queue_mutex);
+  if (queue_len == queue_cap) {
+    int cap = queue_cap ? queue_cap * 2 : 64;
+    score_record_t *grown = realloc(queue, (size_t)cap * sizeof(*queue));
+    if (grown == NULL) {
+      pthread_mutex_unlock(&queue_mutex);
+      atomic_fetch_add(&records_lost, 1);
+      return;
+    }
+    queue = grown;
+    queue_cap = cap;
+  }
+  queue[queue_len++] = r;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+int scores_snapshot(scores_index_t *out) {
+  if (index_map == NULL)
+    return -1;
+  return scores_index_snapshot(index_map, out);
+}
+
+int scores_top(score_record_t *out, int n, uint64_t *records) {
+  if (index_map == NULL)
+    return -1;
+  while (1) {
+    uint64_t before = __atomic_load_n(&index_map->seqlock, __ATOMIC_ACQUIRE);
+    if (before & 1)
+      continue;
+    int count = (int)index_map->top_count;
+    if (count > n)
+      count = n;
+    memcpy(out, index_map->top, (size_t)count * sizeof(*out));
+    *records = index_map->records;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&index_map->seqlock, __ATOMIC_RELAXED) == before)
+      return count;
+  }
+}
+
+void scores_dump_stats(FILE *f) {
+  fprintf(f, "=== SCORE STORE ===\n");
+  if (index_map == NULL) {
+    fprintf(f, "Not open\n");
+    return;
+  }
+  unsigned long n_batches = atomic_load(&batches);
+  unsigned long n_committed = atomic_load(&committed);
+  fprintf(f, "Directory: %s, %llu sessions recorded, %u players\n", data_dir,
+          (unsigned long long)__atomic_load_n(&index_map->records,
+                                              __ATOMIC_RELAXED),
+          __atomic_load_n(&index_map->players, __ATOMIC_RELAXED));
+  fprintf(f,
+          "Recovery: %.2f ms, %lu records replayed%s, %lu torn bytes "
+          "dropped\n",
+          recovery_ms, replayed, rebuilt ? " (index rebuilt)" : "",
+          truncated_bytes);
+  fprintf(f,
+          "Commits: %lu records in %lu batches (max %lu), avg sync %.2f ms, "
+          "failed attempts %lu (retried)\n",
+          n_committed, n_batches, atomic_load(&max_batch),
+          n_batches ? (double)atomic_load(&sync_ns) / (double)n_batches / 1e6
+                    : 0.0,
+          atomic_load(&commit_errors));
+  fprintf(f,
+          "Lost: %lu records that could not be queued, %lu recorded without "
+          "a player entry (player table full)\n",
+          atomic_load(&records_lost), atomic_load(&players_full));
+}
@@ -0,0 +1,355 @@
+/**
+ * @file spectate.c
+ * @brief Spectator connections following many sessions over one pipe.
+ */
+
+#include "../../include/spectate.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Sessions visible to spectators at once */
+#define SPECTATE_REGISTRY 256
+
+/**
+ * @brief One followed session of a spectator connection.
+ */
+typedef struct {
+  int wanted_id;      /**< Client id to follow, 0 for any session */
+  session_t *session; /**< Session followed, NULL while waiting */
+  int32_t client_id;  /**< Its client id */
+  uint64_t digest;    /**< Digest of the last frame sent */
+  int sent;           /**< A frame was sent since it was bound */
+  long long sent_ns;  /**< When it was sent */
+} spectator_slot_t;
+
+/**
+ * @brief A spectator connection.
+ */
+typedef struct {
+  int active;
+  int fd;               /**< Non-blocking notification pipe */
+  int writers;          /**< Publishers writing to fd outside the mutex */
+  int n_slots;          /**< Slots in use (listed ids or the limit) */
+  long long min_gap_ns; /**< Frame period from max_fps, 0 for none */
+  spectator_slot_t slots[SPECTATE_MAX_SESSIONS];
+} spectator_t;
+
+static pthread_mutex_t spectate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static spectator_t spectators[SPECTATORS_MAX];
+static session_t *registry[SPECTATE_REGISTRY];
+
+static unsigned long total_attached;
+static unsigned long total_refused;
+static unsigned long total_closed;
+static unsigned long frames_sent;
+static unsigned long frames_unchanged;
+static unsigned long frames_capped;
+static unsigned long frames_dropped;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long spectate_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief FNV-1a digest of the visible part of a frame.
+ */
+static uint64_t frame_digest(const game_state_msg_t *frame) {
+  uint64_t digest = 0xcbf29ce484222325ULL;
+  int size = frame->width * frame->height;
+  if (size < 0 || size > MAX_BOARD_SIZE)
+    size = MAX_BOARD_SIZE;
+  const unsigned char *header = (const unsigned char *)frame;
+  for (size_t i = 0; i < offsetof(game_state_msg_t, board_data); i++)
+    digest = (digest ^ header[i]) * 0x100000001b3ULL;
+  for (int i = 0; i < size; i++)
+    digest = (digest ^ (unsigned char)frame->board_data[i]) * 0x100000001b3ULL;
+  return digest;
+}
+
+/**
+ * @brief Starts following a session in a free slot (spectate_mutex held).
+ */
+static void bind_slot(spectator_slot_t *slot, session_t *session) {
+  slot->session = session;
+  slot->client_id = session->client_id;
+  slot->sent = 0;
+  atomic_fetch_add(&session->spectators, 1);
+}
+
+/**
+ * @brief Stops following a slot's session (spectate_mutex held).
+ * @param sp Connection of the slot.
+ * @param index Slot index.
+ * @param notify Send OP_SPECTATE_END.
+ */
+static void unbind_slot(spectator_t *sp, int index, int notify) {
+  spectator_slot_t *slot = &sp->slots[index];
+  if (notify) {
+    spectate_end_msg_t end = {.op_code = OP_SPECTATE_END,
+                              .slot = (uint8_t)index,
+                              .client_id = slot->client_id};
+    // A dashboard that is gone is noticed by the next frame
+    ssize_t written = write(sp->fd, &end, sizeof(end));
+    (void)written;
+  }
+  atomic_fetch_sub(&slot->session->spectators, 1);
+  slot->session = NULL;
+}
+
+/**
+ * @brief Whether a connection already follows a session.
+ */
+static int follows(const spectator_t *sp, const session_t *session) {
+  for (int i = 0; i < sp->n_slots; i++)
+    if (sp->slots[i].session == session)
+      return 1;
+  return 0;
+}
+
+/**
+ * @brief Binds waiting slots of a connection to registered sessions
+ * (spectate_mutex held).
+ */
+static void fill_slots(spectator_t *sp) {
+  for (int i = 0; i < sp->n_slots; i++) {
+    spectator_slot_t *slot = &sp->slots[i];
+    if (slot->session != NULL)
+      continue;
+    for (int r = 0; r < SPECTATE_REGISTRY; r++) {
+      session_t *session = registry[r];
+      if (session == NULL || follows(sp, session))
+        continue;
+      if (slot->wanted_id == 0 || slot->wanted_id == session->client_id) {
+        bind_slot(slot, session);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Drops a connection whose dashboard went away (spectate_mutex held).
+ *
+ * The pipe stays open until the last publisher writing to it is done.
+ */
+static void close_spectator(spectator_t *sp) {
+  for (int i = 0; i < sp->n_slots; i++)
+    if (sp->slots[i].session != NULL)
+      unbind_slot(sp, i, 0);
+  if (sp->writers == 0)
+    close(sp->fd);
+  sp->active = 0;
+  total_closed++;
+}
+
+/**
+ * @brief Drops connections whose dashboard left while none of their
+ * sessions had a frame to send (spectate_mutex held).
+ */
+static void reap_spectators(void) {
+  for (int s = 0; s < SPECTATORS_MAX; s++) {
+    if (!spectators[s].active)
+      continue;
+    // The write end of a pipe polls POLLERR once its reader is gone
+    struct pollfd pfd = {.fd = spectators[s].fd, .events = 0};
+    if (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLERR))
+      close_spectator(&spectators[s]);
+  }
+}
+
+int spectate_attach(const spectate_req_t *req) {
+  char path[PIPE_NAME_SIZE + 1];
+  memcpy(path, req->notif_pipe, PIPE_NAME_SIZE);
+  path[PIPE_NAME_SIZE] = '\0';
+  // The dashboard holds its end open before asking
+  int fd = open(path, O_WRONLY | O_NONBLOCK);
+  if (fd == -1) {
+    perror("Failed to open spectator pipe");
+    return -1;
+  }
+
+  pthread_mutex_lock(&spectate_mutex);
+  reap_spectators();
+  spectator_t *sp = NULL;
+  for (int i = 0; i < SPECTATORS_MAX && sp == NULL; i++)
+    if (!spectators[i].active && spectators[i].writers == 0)
+      sp = &spectators[i];
+  spectate_resp_t resp = {.op_code = OP_SPECTATE, .result = -1};
+  if (sp == NULL) {
+    total_refused++;
+    pthread_mutex_unlock(&spectate_mutex);
+    if (write(fd, &resp, sizeof(resp)) < 0)
+      perror("Failed to answer spectator");
+    close(fd);
+    return -1;
+  }
+
+  memset(sp, 0, sizeof(*sp));
+  sp->active = 1;
+  sp->fd = fd;
+  sp->min_gap_ns = req->max_fps > 0 ? 1000000000LL / req->max_fps : 0;
+  if (req->count > 0) {
+    sp->n_slots = req->count < SPECTATE_MAX_SESSIONS ? req->count
+                                                      : SPECTATE_MAX_SESSIONS;
+    for (int i = 0; i < sp->n_slots; i++)
+      sp->slots[i].wanted_id = req->client_ids[i];
+  } else {
+    sp->n_slots = req->limit > 0 && req->limit < SPECTATE_MAX_SESSIONS
+                      ? req->limit
+                      : SPECTATE_MAX_SESSIONS;
+  }
+  fill_slots(sp);
+  for (int i = 0; i < sp->n_slots; i++)
+    if (sp->slots[i].session != NULL)
+      resp.attached++;
+  resp.result = 0;
+  total_attached++;
+  if (write(fd, &resp, sizeof(resp)) < 0)
+    close_spectator(sp);
+  pthread_mutex_unlock(&spectate_mutex);
+  return 0;
+}
+
+void spectate_register(session_t *session) {
+  pthread_mutex_lock(&spectate_mutex);
+  for (int r = 0; r < SPECTATE_REGISTRY; r++) {
+    if (registry[r] == NULL) {
+      registry[r] = session;
+      break;
+    }
+  }
+  for (int s = 0; s < SPECTATORS_MAX; s++)
+    if (spectators[s].active)
+      fill_slots(&spectators[s]);
+  pthread_mutex_unlock(&spectate_mutex);
+}
+
+void spectate_unregister(session_t *session) {
+  pthread_mutex_lock(&spectate_mutex);
+  for (int r = 0; r < SPECTATE_REGISTRY; r++)
+    if (registry[r] == session)
+      registry[r] = NULL;
+  for (int s = 0; s < SPECTATORS_MAX; s++) {
+    spectator_t *sp = &spectators[s];
+    if (!sp->active)
+      continue;
+    for (int i = 0; i < sp->n_slots; i++)
+      if (sp->slots[i].session == session)
+        unbind_slot(sp, i, 1);
+    // A slot following any session moves on to another one
+    fill_slots(sp);
+  }
+  pthread_mutex_unlock(&spectate_mutex);
+}
+
+void spectate_publish(session_t *session, const game_state_msg_t *frame) {
+  uint64_t digest = frame_digest(frame);
+  long long now = spectate_now_ns();
+  // A connection follows a session in one slot at most
+  struct {
+    spectator_t *sp;
+    int slot;
+    ssize_t written;
+    int error;
+  } targets[SPECTATORS_MAX];
+  int n_targets = 0;
+
+  // Pick the slots under the mutex, write without it
+  pthread_mutex_lock(&spectate_mutex);
+  for (int s = 0; s < SPECTATORS_MAX; s++) {
+    spectator_t *sp = &spectators[s];
+    if (!sp->active)
+      continue;
+    for (int i = 0; i < sp->n_slots; i++) {
+      spectator_slot_t *slot = &sp->slots[i];
+      if (slot->session != session)
+        continue;
+      if (slot->sent && slot->digest == digest) {
+        frames_unchanged++;
+      } else if (slot->sent && now - slot->sent_ns < sp->min_gap_ns) {
+        frames_capped++;
+      } else {
+        sp->writers++;
+        targets[n_targets].sp = sp;
+        targets[n_targets].slot = i;
+        n_targets++;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&spectate_mutex);
+  if (n_targets == 0)
+    return;
+
+  spectate_frame_msg_t msg;
+  msg.op_code = OP_SPECTATE_FRAME;
+  memset(msg.reserved, 0, sizeof(msg.reserved));
+  msg.client_id = session->client_id;
+  memcpy(&msg.frame, frame, sizeof(*frame));
+  memset(msg.reserved_end, 0, sizeof(msg.reserved_end));
+  for (int t = 0; t < n_targets; t++) {
+    msg.slot = (uint8_t)targets[t].slot;
+    targets[t].written = write(targets[t].sp->fd, &msg, sizeof(msg));
+    targets[t].error = errno;
+  }
+
+  pthread_mutex_lock(&spectate_mutex);
+  for (int t = 0; t < n_targets; t++) {
+    spectator_t *sp = targets[t].sp;
+    spectator_slot_t *slot = &sp->slots[targets[t].slot];
+    sp->writers--;
+    if (!sp->active) {
+      // Closed while we wrote: the last writer closes the pipe
+      if (sp->writers == 0)
+        close(sp->fd);
+    } else if (targets[t].written == (ssize_t)sizeof(msg)) {
+      if (slot->session == session) {
+        slot->sent = 1;
+        slot->digest = digest;
+        slot->sent_ns = now;
+      }
+      frames_sent++;
+      atomic_fetch_add(&session->cost.bytes_written,
+                       (unsigned long long)targets[t].written);
+    } else if (targets[t].written == -1 && targets[t].error == EAGAIN) {
+      frames_dropped++; // Sent again at the next change
+    } else {
+      close_spectator(sp);
+    }
+  }
+  pthread_mutex_unlock(&spectate_mutex);
+}
+
+void spectate_dump_stats(FILE *f) {
+  pthread_mutex_lock(&spectate_mutex);
+  reap_spectators();
+  int active = 0, followed = 0;
+  for (int s = 0; s < SPECTATORS_MAX; s++) {
+    if (!spectators[s].active)
+      continue;
+    active++;
+    for (int i = 0; i < spectators[s].n_slots; i++)
+      if (spectators[s].slots[i].session != NULL)
+        followed++;
+  }
+  fprintf(f, "=== SPECTATORS ===\n");
+  fprintf(f, "Connections: %d active, %lu attached, %lu refused, %lu closed\n",
+          active, total_attached, total_refused, total_closed);
+  fprintf(f, "Sessions followed: %d\n", followed);
+  fprintf(f,
+          "Frames sent: %lu, unchanged: %lu, over the rate cap: %lu, "
+          "dropped: %lu\n",
+          frames_sent, frames_unchanged, frames_capped, frames_dropped);
+  pthread_mutex_unlock(&spectate_mutex);
+}
@@ -0,0 +1,233 @@
+/**
+ * @file speculate.c
+ * @brief Speculative frames: Pacman's next move prepared between ticks.
+ */
+
+#include "../../include/speculate.h"
+#include "../../include/game.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NS_PER_SEC 1000000000LL
+
+static int enabled = 0;
+
+static atomic_ulong total_prepared;
+static atomic_ulong total_hits;
+static atomic_ulong total_misses;
+static atomic_ullong total_prepare_ns;
+static atomic_ullong total_hit_ns;
+static atomic_ullong total_miss_ns;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long speculate_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void speculate_init(void) {
+  const char *value = getenv("PACMANIST_SPECULATE");
+  enabled = value != NULL && atoi(value) > 0;
+}
+
+int speculate_enabled(void) { return enabled; }
+
+int speculate_alloc(speculation_t *spec, const board_t *board) {
+  memset(spec, 0, sizeof(*spec));
+  if (board->n_pacmans < 1 ||
+      board_clone(&spec->snapshot, board, board->pacmans[0].points) != 0)
+    return -1;
+  // The copy never reports events nor outlives the level
+  spec->snapshot.on_event = NULL;
+  spec->snapshot.event_ctx = NULL;
+  spec->snapshot.on_step = NULL;
+  spec->snapshot.step_ctx = NULL;
+  atomic_store(&spec->frame_tick, 0);
+  return 0;
+}
+
+void speculate_release(speculation_t *spec) {
+  board_t *snapshot = &spec->snapshot;
+  if (snapshot->lock_initialized)
+    pthread_rwlock_destroy(&snapshot->state_lock);
+  free(snapshot->board);
+  free(snapshot->pacmans);
+  free(snapshot->ghosts);
+  free(snapshot->ghost_paths);
+  memset(spec, 0, sizeof(*spec));
+}
+
+int speculate_move_index(char key) {
+  switch (toupper((unsigned char)key)) {
+  case 'W':
+    return 0;
+  case 'A':
+    return 1;
+  case 'S':
+    return 2;
+  case 'D':
+    return 3;
+  case ' ':
+    return SPEC_DEFAULT_MOVE;
+  default:
+    return -1;
+  }
+}
+
+/**
+ * @brief Plays one move on the snapshot, records it and undoes it.
+ * @param spec Speculation state with a fresh snapshot.
+ * @param move Outcome index.
+ */
+static void predict_move(speculation_t *spec, int move) {
+  board_t *snap = &spec->snapshot;
+  pacman_t *pac = &snap->pacmans[0];
+  spec_outcome_t *outcome = &spec->outcomes[move];
+
+  // A move only changes Pacman, the hash and Pacman's cell and a neighbour
+  static const int dx[] = {0, 0, -1, 1};
+  static const int dy[] = {-1, 1, 0, 0};
+  int touched[5];
+  board_pos_t saved_cells[5];
+  int n_touched = 0;
+  touched[n_touched++] = pac->pos_y * snap->width + pac->pos_x;
+  for (int d = 0; d < 4; d++) {
+    int x = pac->pos_x + dx[d];
+    int y = pac->pos_y + dy[d];
+    if (x >= 0 && x < snap->width && y >= 0 && y < snap->height)
+      touched[n_touched++] = y * snap->width + x;
+  }
+  for (int i = 0; i < n_touched; i++)
+    saved_cells[i] = snap->board[touched[i]];
+  pacman_t saved = *pac;
+  uint64_t hash = snap->hash;
+  unsigned int rng_seed = snap->rng_seed;
+  int level_finished = snap->level_finished;
+
+  command_t key = {"WASD "[move], 1, 1};
+  command_t *play = &key;
+  if (move == SPEC_DEFAULT_MOVE && pac->n_moves > 0)
+    play = &pac->moves[pac->current_move % pac->n_moves];
+  move_pacman(snap, 0, play);
+
+  int from = touched[0];
+  int to = pac->pos_y * snap->width + pac->pos_x;
+  outcome->pacman = *pac;
+  outcome->level_finished = snap->level_finished;
+  outcome->n_cells = 0;
+  outcome->cells[outcome->n_cells] = from;
+  outcome->visuals[outcome->n_cells++] = server_cell_visual(&snap->board[from]);
+  if (to != from) {
+    outcome->cells[outcome->n_cells] = to;
+    outcome->visuals[outcome->n_cells++] = server_cell_visual(&snap->board[to]);
+  }
+
+  for (int i = 0; i < n_touched; i++)
+    snap->board[touched[i]] = saved_cells[i];
+  *pac = saved;
+  snap->hash = hash;
+  snap->rng_seed = rng_seed;
+  snap->level_finished = level_finished;
+}
+
+void speculate_prepare(speculation_t *spec, board_t *board) {
+  long long start = speculate_now_ns();
+  board_t *snap = &spec->snapshot;
+  size_t cells = (size_t)board->width * (size_t)board->height;
+
+  board_rdlock(board);
+  memcpy(snap->board, board->board, cells * sizeof(board_pos_t));
+  memcpy(snap->pacmans, board->pacmans,
+         (size_t)board->n_pacmans * sizeof(pacman_t));
+  memcpy(snap->ghosts, board->ghosts,
+         (size_t)board->n_ghosts * sizeof(ghost_t));
+  snap->hash = board->hash;
+  snap->rng_seed = board->rng_seed;
+  snap->level_finished = board->level_finished;
+  pthread_rwlock_unlock(&board->state_lock);
+
+  server_build_update(snap, &spec->frame);
+  for (int g = 0; g < snap->n_ghosts && g < MAX_GHOSTS; g++)
+    spec->ghost_cells[g] =
+        snap->ghosts[g].pos_y * snap->width + snap->ghosts[g].pos_x;
+  for (int move = 0; move < SPEC_MOVES; move++)
+    predict_move(spec, move);
+  spec->ready = 1;
+
+  atomic_fetch_add(&total_prepared, 1);
+  atomic_fetch_add(&total_prepare_ns,
+                   (unsigned long long)(speculate_now_ns() - start));
+}
+
+/**
+ * @brief Whether the board's Pacman ended where an outcome predicted.
+ */
+static int outcome_matches(const spec_outcome_t *outcome,
+                           const board_t *board) {
+  const pacman_t *real = &board->pacmans[0];
+  const pacman_t *predicted = &outcome->pacman;
+  return real->pos_x == predicted->pos_x && real->pos_y == predicted->pos_y &&
+         real->alive == predicted->alive &&
+         real->points == predicted->points &&
+         real->current_move == predicted->current_move &&
+         real->waiting == predicted->waiting &&
+         board->level_finished == outcome->level_finished;
+}
+
+int speculate_commit(speculation_t *spec, const board_t *board, int move,
+                     game_state_msg_t *msg) {
+  long long start = speculate_now_ns();
+  int hit = spec->ready && move >= 0 && move < SPEC_MOVES &&
+            board->n_ghosts == spec->snapshot.n_ghosts &&
+            outcome_matches(&spec->outcomes[move], board);
+  spec->ready = 0;
+
+  if (!hit) {
+    server_build_update(board, msg);
+    atomic_fetch_add(&total_misses, 1);
+    atomic_fetch_add(&total_miss_ns,
+                     (unsigned long long)(speculate_now_ns() - start));
+    return 0;
+  }
+
+  const spec_outcome_t *outcome = &spec->outcomes[move];
+  memcpy(msg, &spec->frame, sizeof(*msg));
+  server_frame_header(board, msg);
+  for (int i = 0; i < outcome->n_cells; i++)
+    if (outcome->cells[i] < MAX_BOARD_SIZE)
+      msg->board_data[outcome->cells[i]] = outcome->visuals[i];
+  // Ghosts kept moving since the snapshot: redraw where they were and are
+  for (int g = 0; g < board->n_ghosts && g < MAX_GHOSTS; g++) {
+    int then = spec->ghost_cells[g];
+    int now = board->ghosts[g].pos_y * board->width + board->ghosts[g].pos_x;
+    if (then < MAX_BOARD_SIZE)
+      msg->board_data[then] = server_cell_visual(&board->board[then]);
+    if (now != then && now < MAX_BOARD_SIZE)
+      msg->board_data[now] = server_cell_visual(&board->board[now]);
+  }
+
+  atomic_fetch_add(&total_hits, 1);
+  atomic_fetch_add(&total_hit_ns,
+                   (unsigned long long)(speculate_now_ns() - start));
+  return 1;
+}
+
+void speculate_dump_stats(FILE *f) {
+  unsigned long prepared = atomic_load(&total_prepared);
+  unsigned long hits = atomic_load(&total_hits);
+  unsigned long misses = atomic_load(&total_misses);
+  fprintf(f, "=== SPECULATION ===\n");
+  fprintf(f, "Speculative frames: %s\n", enabled ? "enabled" : "disabled");
+  fprintf(f, "Steps prepared: %lu, avg %.1f us\n", prepared,
+          prepared ? atomic_load(&total_prepare_ns) / 1e3 / prepared : 0.0);
+  fprintf(f, "Frames from a prediction: %lu (%.1f%%), avg %.1f us\n", hits,
+          hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+          hits ? atomic_load(&total_hit_ns) / 1e3 / hits : 0.0);
+  fprintf(f, "Frames serialized after a miss: %lu, avg %.1f us\n", misses,
+          misses ? atomic_load(&total_miss_ns) / 1e3 / misses : 0.0);
+}
@@ -0,0 +1,474 @@
+/**
+ * @file archive_query.c
+ * @brief archive_query - scans the server's columnar event archive.
+ *
+ * Usage: archive_query [-d dir] [-t type] [-l level] [-s session]
+ *                      [-p min_points] [-H] [-r rows] [-L]
+ *
+ * Every .pca file of the directory is mapped and scanned one row group at a
+ * time. Only the columns used by the filters and the output are decoded;
+ * each filter then runs over a whole column, 16 rows per step with SSE2
+ * (scalar otherwise), narrowing a per-row selection. The default output is
+ * the number of matching events per kind; -H prints a heatmap of their
+ * cells and -r the first matching rows. -L lists the per-level aggregates
+ * the server maintains (with -l, that level's death and dot heatmaps).
+ */
+
+#include "../../include/archive_format.h"
+#include "../../include/events.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** @brief Largest heatmap dimension printed */
+#define QUERY_MAX_DIM 256
+
+/**
+ * @brief Filters and output options.
+ */
+typedef struct {
+  const char *dir;
+  int type;        /**< Event kind, 0 for any */
+  int level;       /**< Level id, -1 for any */
+  int session;     /**< Client id, -1 for any */
+  int min_points;  /**< INT_MIN for no filter */
+  int heatmap;     /**< Print a heatmap of matching cells */
+  long rows;       /**< Matching rows to print */
+} query_t;
+
+/**
+ * @brief Decoded columns and selection of one row group.
+ */
+typedef struct {
+  int32_t *cols[ARCHIVE_COLUMNS];
+  uint8_t *sel; /**< 0xff for rows still matching, 0 otherwise */
+} scan_t;
+
+static unsigned long long scanned = 0;
+static unsigned long long matched = 0;
+static unsigned long long type_counts[EVENT_TYPES];
+static unsigned long long heat[QUERY_MAX_DIM][QUERY_MAX_DIM];
+static int heat_w = 0, heat_h = 0;
+
+/**
+ * @brief Keeps the selected rows whose value equals v (or is >= v).
+ * @param col Column values.
+ * @param rows Number of rows.
+ * @param v Value to compare with.
+ * @param at_least Compare with >= instead of ==.
+ * @param sel Selection, updated in place.
+ */
+static void filter(const int32_t *col, uint32_t rows, int32_t v, int at_least,
+                   uint8_t *sel) {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  if (!at_least || v != INT_MIN) {
+    const __m128i value = _mm_set1_epi32(at_least ? v - 1 : v);
+    for (; i + 16 <= rows; i += 16) {
+      __m128i m[4];
+      for (int k = 0; k < 4; k++) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(col + i + 4 * k));
+        m[k] = at_least ? _mm_cmpgt_epi32(x, value) : _mm_cmpeq_epi32(x, value);
+      }
+      __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]),
+                                      _mm_packs_epi32(m[2], m[3]));
+      __m128i s = _mm_loadu_si128((const __m128i *)(sel + i));
+      _mm_storeu_si128((__m128i *)(sel + i), _mm_and_si128(s, bytes));
+    }
+  }
+#endif
+  for (; i < rows; i++) {
+    int keep = at_least ? col[i] >= v : col[i] == v;
+    sel[i] &= (uint8_t)(keep ? 0xff : 0);
+  }
+}
+
+/**
+ * @brief Counts the selected rows.
+ */
+static unsigned long long count_selected(const uint8_t *sel, uint32_t rows) {
+  unsigned long long n = 0;
+  uint32_t i = 0;
+#ifdef __SSE2__
+  const __m128i one = _mm_set1_epi8(1);
+  for (; i + 16 <= rows; i += 16) {
+    __m128i bits = _mm_and_si128(_mm_loadu_si128((const __m128i *)(sel + i)),
+                                 one);
+    __m128i sums = _mm_sad_epu8(bits, _mm_setzero_si128());
+    n += (unsigned long long)(_mm_cvtsi128_si32(sums) +
+                              _mm_extract_epi16(sums, 4));
+  }
+#endif
+  for (; i < rows; i++)
+    n += sel[i] & 1;
+  return n;
+}
+
+/**
+ * @brief Tells whether a column is needed for this query.
+ */
+static int column_needed(const query_t *q, int c) {
+  switch (c) {
+  case ARCHIVE_COL_TYPE:
+    return 1;
+  case ARCHIVE_COL_LEVEL:
+    return q->level >= 0 || q->rows > 0;
+  case ARCHIVE_COL_SESSION:
+    return q->session >= 0 || q->rows > 0;
+  case ARCHIVE_COL_POINTS:
+    return q->min_points != INT_MIN || q->rows > 0;
+  case ARCHIVE_COL_X:
+  case ARCHIVE_COL_Y:
+    return q->heatmap || q->rows > 0;
+  default:
+    return q->rows > 0;
+  }
+}
+
+/**
+ * @brief Prints one matching row.
+ */
+static void print_row(const scan_t *s, uint32_t i, uint64_t hour_start) {
+  time_t t = (time_t)(hour_start + (uint64_t)s->cols[ARCHIVE_COL_TIME][i] /
+                                       1000);
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char when[32];
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+  printf("%s.%03d client %d level %d %-13s (%d,%d) points %d detail %d\n",
+         when, s->cols[ARCHIVE_COL_TIME][i] % 1000,
+         s->cols[ARCHIVE_COL_SESSION][i], s->cols[ARCHIVE_COL_LEVEL][i],
+         events_type_name(s->cols[ARCHIVE_COL_TYPE][i]),
+         s->cols[ARCHIVE_COL_X][i], s->cols[ARCHIVE_COL_Y][i],
+         s->cols[ARCHIVE_COL_POINTS][i], s->cols[ARCHIVE_COL_DETAIL][i]);
+}
+
+/**
+ * @brief Filters one row group and folds the matches into the results.
+ * @return 0 on success, -1 if the group is malformed.
+ */
+static int scan_group(const query_t *q, const archive_group_header_t *g,
+                      const uint8_t *data, size_t size, uint64_t hour_start,
+                      scan_t *s) {
+  uint32_t rows = g->rows;
+  if (rows == 0 || rows > ARCHIVE_GROUP_ROWS)
+    return -1;
+  size_t offset = 0;
+  for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+    size_t bytes = g->column_bytes[c];
+    if (offset + bytes > size)
+      return -1;
+    if (column_needed(q, c) &&
+        archive_decode_column(data + offset, bytes, s->cols[c], rows) != 0)
+      return -1;
+    offset += bytes;
+  }
+  scanned += rows;
+
+  memset(s->sel, 0xff, rows);
+  if (q->type > 0)
+    filter(s->cols[ARCHIVE_COL_TYPE], rows, q->type, 0, s->sel);
+  if (q->level >= 0)
+    filter(s->cols[ARCHIVE_COL_LEVEL], rows, q->level, 0, s->sel);
+  if (q->session >= 0)
+    filter(s->cols[ARCHIVE_COL_SESSION], rows, q->session, 0, s->sel);
+  if (q->min_points != INT_MIN)
+    filter(s->cols[ARCHIVE_COL_POINTS], rows, q->min_points, 1, s->sel);
+
+  unsigned long long n = count_selected(s->sel, rows);
+  if (n == 0)
+    return 0;
+  matched += n;
+
+  const int32_t *types = s->cols[ARCHIVE_COL_TYPE];
+  for (uint32_t i = 0; i < rows; i++) {
+    if (!s->sel[i])
+      continue;
+    type_counts[types[i] > 0 && types[i] < EVENT_TYPES ? types[i] : 0]++;
+    if (q->heatmap) {
+      int x = s->cols[ARCHIVE_COL_X][i], y = s->cols[ARCHIVE_COL_Y][i];
+      if (x >= 0 && y >= 0 && x < QUERY_MAX_DIM && y < QUERY_MAX_DIM) {
+        heat[y][x]++;
+        if (x >= heat_w)
+          heat_w = x + 1;
+        if (y >= heat_h)
+          heat_h = y + 1;
+      }
+    }
+  }
+  if (q->rows > 0) {
+    static long printed = 0;
+    for (uint32_t i = 0; i < rows && printed < q->rows; i++) {
+      if (s->sel[i]) {
+        print_row(s, i, hour_start);
+        printed++;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Maps a .pca file and scans all of its row groups.
+ */
+static void scan_file(const query_t *q, const char *path, scan_t *s) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      (size_t)st.st_size < sizeof(archive_file_header_t)) {
+    close(fd);
+    return;
+  }
+  size_t size = (size_t)st.st_size;
+  const uint8_t *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return;
+
+  archive_file_header_t fh;
+  memcpy(&fh, base, sizeof(fh));
+  if (fh.magic != ARCHIVE_FILE_MAGIC || fh.columns != ARCHIVE_COLUMNS) {
+    fprintf(stderr, "%s: not an event archive\n", path);
+    munmap((void *)base, size);
+    return;
+  }
+
+  size_t pos = sizeof(fh);
+  while (pos + sizeof(archive_group_header_t) <= size) {
+    archive_group_header_t g;
+    memcpy(&g, base + pos, sizeof(g));
+    if (g.magic != ARCHIVE_GROUP_MAGIC)
+      break;
+    pos += sizeof(g);
+    size_t data = 0;
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+      data += g.column_bytes[c];
+    if (data > size - pos ||
+        scan_group(q, &g, base + pos, data, fh.hour_start, s) != 0) {
+      fprintf(stderr, "%s: truncated or corrupt row group\n", path);
+      break;
+    }
+    pos += data;
+  }
+  munmap((void *)base, size);
+}
+
+/**
+ * @brief qsort comparator for file names.
+ */
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Prints a heatmap, scaled to one character per cell.
+ */
+static void print_heatmap(const char *title, const uint32_t *counts, int w,
+                          int h) {
+  static const char scale[] = " .:-=+*#%@";
+  uint32_t max = 0;
+  for (int i = 0; i < w * h; i++)
+    if (counts[i] > max)
+      max = counts[i];
+  printf("%s (max %u per cell)\n", title, max);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      uint32_t c = counts[y * w + x];
+      putchar(c == 0 ? ' '
+                     : scale[1 + (max > 1 ? (int)((unsigned long long)(c - 1) *
+                                                  8 / (max - 1))
+                                          : 8)]);
+    }
+    putchar('\n');
+  }
+}
+
+/**
+ * @brief Lists the level aggregates of the directory.
+ * @param dir Archive directory.
+ * @param only Level id to show with its heatmaps, or -1 for all.
+ */
+static int list_levels(const char *dir, int only) {
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    perror(dir);
+    return 1;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    int id;
+    char rest;
+    if (sscanf(entry->d_name, "level_%d.ag%c", &id, &rest) != 2 ||
+        rest != 'g' || (only >= 0 && id != only))
+      continue;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+      continue;
+    archive_level_header_t h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != ARCHIVE_LEVEL_MAGIC) {
+      fclose(f);
+      continue;
+    }
+    h.name[sizeof(h.name) - 1] = '\0';
+    printf("Level %d %s (%ux%u): %llu starts, %llu completed", id, h.name,
+           h.width, h.height, (unsigned long long)h.starts,
+           (unsigned long long)h.portals);
+    if (h.portals > 0)
+      printf(" (avg %.1f s)", (double)h.portal_ms / (double)h.portals / 1e3);
+    printf(", quit rate %.1f%%, %llu dots, %llu deaths\n",
+           h.starts ? 100.0 * (double)h.quits / (double)h.starts : 0.0,
+           (unsigned long long)h.dots, (unsigned long long)h.deaths);
+
+    size_t cells = (size_t)h.width * h.height;
+    if (only >= 0 && cells > 0 && cells <= (1 << 20)) {
+      uint32_t *deaths = malloc(cells * sizeof(uint32_t));
+      uint32_t *dots = malloc(cells * sizeof(uint32_t));
+      if (deaths && dots && fread(deaths, sizeof(uint32_t), cells, f) == cells &&
+          fread(dots, sizeof(uint32_t), cells, f) == cells) {
+        print_heatmap("Deaths", deaths, (int)h.width, (int)h.height);
+        print_heatmap("Dots eaten", dots, (int)h.width, (int)h.height);
+      }
+      free(deaths);
+      free(dots);
+    }
+    fclose(f);
+  }
+  closedir(d);
+  return 0;
+}
+
+/**
+ * @brief Maps an event kind name (or number) to its value.
+ */
+static int parse_type(const char *arg) {
+  for (int t = 1; t < EVENT_TYPES; t++)
+    if (strcasecmp(arg, events_type_name(t)) == 0)
+      return t;
+  return atoi(arg);
+}
+
+int main(int argc, char *argv[]) {
+  query_t q = {.dir = "archive",
+               .type = 0,
+               .level = -1,
+               .session = -1,
+               .min_points = INT_MIN};
+  int list = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:t:l:s:p:Hr:Lh")) != -1) {
+    switch (opt) {
+    case 'd':
+      q.dir = optarg;
+      break;
+    case 't':
+      q.type = parse_type(optarg);
+      break;
+    case 'l':
+      q.level = atoi(optarg);
+      break;
+    case 's':
+      q.session = atoi(optarg);
+      break;
+    case 'p':
+      q.min_points = atoi(optarg);
+      break;
+    case 'H':
+      q.heatmap = 1;
+      break;
+    case 'r':
+      q.rows = atol(optarg);
+      break;
+    case 'L':
+      list = 1;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-d dir] [-t type] [-l level] [-s session] "
+              "[-p min_points] [-H] [-r rows] [-L]\n"
+              "Types: SESSION_START SESSION_END LEVEL_START LEVEL_END DOT "
+              "DEATH PORTAL INPUT\n",
+              argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (list)
+    return list_levels(q.dir, q.level);
+
+  DIR *d = opendir(q.dir);
+  if (d == NULL) {
+    perror(q.dir);
+    return 1;
+  }
+  char **files = NULL;
+  int n_files = 0, cap = 0;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len < 4 || strcmp(entry->d_name + len - 4, ".pca") != 0)
+      continue;
+    if (n_files == cap) {
+      cap = cap ? cap * 2 : 64;
+      files = realloc(files, (size_t)cap * sizeof(char *));
+      if (files == NULL)
+        return 1;
+    }
+    files[n_files++] = strdup(entry->d_name);
+  }
+  closedir(d);
+  qsort(files, (size_t)n_files, sizeof(char *), compare_names);
+
+  scan_t s;
+  for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+    s.cols[c] = malloc(ARCHIVE_GROUP_ROWS * sizeof(int32_t));
+  s.sel = malloc(ARCHIVE_GROUP_ROWS);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < n_files; i++) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", q.dir, files[i]);
+    scan_file(&q, path, &s);
+    free(files[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(files);
+
+  if (q.heatmap && heat_w > 0) {
+    uint32_t *counts = calloc((size_t)heat_w * (size_t)heat_h, sizeof(uint32_t));
+    for (int y = 0; y < heat_h; y++)
+      for (int x = 0; x < heat_w; x++)
+        counts[y * heat_w + x] = (uint32_t)heat[y][x];
+    print_heatmap("Matching events", counts, heat_w, heat_h);
+    free(counts);
+  }
+  printf("Matched %llu of %llu events\n", matched, scanned);
+  for (int t = 1; t < EVENT_TYPES; t++)
+    if (type_counts[t] > 0)
+      printf("  %-14s %llu\n", events_type_name(t), type_counts[t]);
+
+  double secs = (double)(end.tv_sec - start.tv_sec) +
+                (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stderr, "Scanned %d files in %.3f s (%.1f M events/s)\n", n_files,
+          secs, secs > 0 ? (double)scanned / secs / 1e6 : 0.0);
+
+  for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+    free(s.cols[c]);
+  free(s.sel);
+  return 0;
+}
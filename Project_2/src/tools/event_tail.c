@@ -0,0 +1,167 @@
+/**
+ * @file event_tail.c
+ * @brief event_tail - follows the server's game event stream.
+ *
+ * Usage: event_tail [-a] [-c] [shm_name]
+ *
+ * Maps the shared memory stream read-only and prints one line per event,
+ * starting with the next one (or the oldest still retained with -a). With
+ * -c it prints per-kind counts on exit instead of every event. The server
+ * never waits for this process; if it falls too far behind, the skipped
+ * events are reported and it resumes at the oldest retained one.
+ */
+
+#include "../../include/events.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Poll interval when no new event is available */
+#define TAIL_POLL_MS 10
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * @brief SIGINT/SIGTERM handler: asks the follow loop to exit.
+ */
+static void handle_stop(int sig) {
+  (void)sig;
+  stop_requested = 1;
+}
+
+/**
+ * @brief Copies event seq out of the stream, checking it was not rewritten.
+ * @param shm Mapped stream.
+ * @param seq Sequence number wanted.
+ * @param out Destination.
+ * @return 1 on success, 0 if the slot holds another (newer) event.
+ */
+static int read_event(const events_shm_t *shm, uint64_t seq,
+                      game_event_t *out) {
+  const game_event_t *slot = &shm->events[(seq - 1) % shm->capacity];
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq)
+    return 0;
+  memcpy(out, slot, sizeof(*out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/**
+ * @brief Prints one event as a text line.
+ */
+static void print_event(const game_event_t *ev) {
+  printf("%llu.%06llu #%llu client %d level %d %-13s",
+         (unsigned long long)(ev->time_ns / 1000000000ULL),
+         (unsigned long long)(ev->time_ns % 1000000000ULL / 1000ULL),
+         (unsigned long long)ev->seq, ev->client_id, ev->level,
+         events_type_name(ev->type));
+  if (ev->x >= 0)
+    printf(" (%d,%d)", ev->x, ev->y);
+  printf(" points %d", ev->points);
+  if (ev->type == EVENT_DEATH)
+    printf(" %s", ev->detail == DEATH_CAUGHT_BY_GHOST ? "caught by ghost"
+                                                      : "walked into ghost");
+  else if (ev->type == EVENT_INPUT)
+    printf(" key %c", ev->detail);
+  else if (ev->type == EVENT_LEVEL_END)
+    printf(" result %d", ev->detail);
+  else if (ev->type == EVENT_SESSION_START)
+    printf(" features 0x%02x", ev->detail);
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  int from_oldest = 0, counts_only = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "ach")) != -1) {
+    if (opt == 'a') {
+      from_oldest = 1;
+    } else if (opt == 'c') {
+      counts_only = 1;
+    } else {
+      fprintf(stderr, "Usage: %s [-a] [-c] [shm_name]\n", argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  const char *name = optind < argc ? argv[optind] : EVENTS_SHM_DEFAULT;
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+    perror("shm_open (is the server running?)");
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(events_shm_t)) {
+    fprintf(stderr, "%s is not an event stream\n", name);
+    close(fd);
+    return 1;
+  }
+  const events_shm_t *shm =
+      mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != EVENTS_SHM_MAGIC ||
+      sizeof(events_shm_t) + shm->capacity * sizeof(game_event_t) >
+          (size_t)st.st_size) {
+    fprintf(stderr, "%s is not an event stream\n", name);
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  uint64_t head = __atomic_load_n(&shm->write_seq, __ATOMIC_ACQUIRE);
+  uint64_t next = head + 1;
+  if (from_oldest)
+    next = head > shm->capacity ? head - shm->capacity + 1 : 1;
+
+  unsigned long counts[EVENT_TYPES] = {0};
+  unsigned long long lost = 0;
+  struct timespec poll_interval = {0, TAIL_POLL_MS * 1000000L};
+  while (!stop_requested) {
+    head = __atomic_load_n(&shm->write_seq, __ATOMIC_ACQUIRE);
+    if (next > head) {
+      fflush(stdout);
+      nanosleep(&poll_interval, NULL);
+      continue;
+    }
+    game_event_t ev;
+    if (!read_event(shm, next, &ev)) {
+      // Overwritten while we lagged: resume at the oldest retained event
+      uint64_t oldest = head > shm->capacity ? head - shm->capacity + 1 : 1;
+      uint64_t resume = oldest + shm->capacity / 8;
+      if (resume > head)
+        resume = head;
+      if (resume <= next)
+        resume = next + 1; // The slot is being rewritten right now
+      lost += resume - next;
+      if (!counts_only)
+        printf("... %llu events lost\n", (unsigned long long)(resume - next));
+      next = resume;
+      continue;
+    }
+    counts[ev.type < EVENT_TYPES ? ev.type : 0]++;
+    if (!counts_only)
+      print_event(&ev);
+    next++;
+  }
+
+  if (counts_only) {
+    for (int t = 1; t < EVENT_TYPES; t++)
+      printf("%-14s %lu\n", events_type_name(t), counts[t]);
+    printf("%-14s %llu\n", "LOST", lost);
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file feature_planes_bench.c
+ * @brief Benchmarks the SIMD feature encoder against the scalar one.
+ *
+ * Usage: feature_planes_bench [level_file] [frames]
+ *
+ * Encodes the same batch of frames with both encoders in every output mode,
+ * checks that the results match and prints the time per frame. Frames are
+ * random 60x40 boards, plus the given level rendered as its first frame.
+ */
+
+#include "../../include/feature_planes.h"
+#include "../../include/protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_WIDTH 60
+#define BENCH_HEIGHT 40
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Fills frames with a plausible mix of walls, dots and entities.
+ */
+static void random_frames(char *frames, int n, int cells) {
+  static const char mix[] = "####.....      @CMM";
+  unsigned int seed = 42;
+  for (long i = 0; i < (long)n * cells; i++)
+    frames[i] = mix[rand_r(&seed) % (sizeof(mix) - 1)];
+}
+
+/**
+ * @brief Encodes all frames with both encoders in one mode and reports.
+ * @return 0 if outputs match, 1 otherwise.
+ */
+static int run_mode(const char *label, const char *frames, int n, int width,
+                    int height, int flags) {
+  size_t size = features_size(width * height, flags);
+  uint8_t *simd = malloc(size * (size_t)n);
+  uint8_t *scalar = malloc(size * (size_t)n);
+  if (simd == NULL || scalar == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+
+  long long t0 = now_ns();
+  for (int f = 0; f < n; f++) {
+    features_encode_scalar(frames + (size_t)f * (size_t)(width * height),
+                           width, height, flags, scalar + (size_t)f * size);
+  }
+  long long t1 = now_ns();
+  features_encode_batch(frames, n, width, height, flags, simd);
+  long long t2 = now_ns();
+
+  int mismatch = memcmp(simd, scalar, size * (size_t)n) != 0;
+  double scalar_ns = (double)(t1 - t0) / n;
+  double simd_ns = (double)(t2 - t1) / n;
+  printf("%-16s %dx%d  scalar %8.1f ns/frame  simd %8.1f ns/frame  "
+         "x%.1f  %s\n",
+         label, width, height, scalar_ns, simd_ns,
+         simd_ns > 0 ? scalar_ns / simd_ns : 0.0,
+         mismatch ? "MISMATCH" : "ok");
+  free(simd);
+  free(scalar);
+  return mismatch;
+}
+
+/**
+ * @brief Runs every output mode over one set of frames.
+ */
+static int run_all(const char *frames, int n, int width, int height) {
+  int failed = 0;
+  failed |= run_mode("bytes", frames, n, width, height, 0);
+  failed |= run_mode("bits", frames, n, width, height, FEATURES_BITS);
+  failed |= run_mode("bytes+distance", frames, n, width, height,
+                     FEATURES_DISTANCE);
+  failed |= run_mode("bits+distance", frames, n, width, height,
+                     FEATURES_BITS | FEATURES_DISTANCE);
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  const char *level = argc >= 2 ? argv[1] : NULL;
+  int n = argc >= 3 ? atoi(argv[2]) : 20000;
+  if (n <= 0)
+    n = 20000;
+
+  int cells = BENCH_WIDTH * BENCH_HEIGHT;
+  char *frames = malloc((size_t)n * (size_t)cells);
+  if (frames == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  random_frames(frames, n, cells);
+  int failed = run_all(frames, n, BENCH_WIDTH, BENCH_HEIGHT);
+  free(frames);
+
+  if (level != NULL) {
+    board_t board = {0};
+    if (load_level(&board, level, 0) != 0) {
+      fprintf(stderr, "Failed to load level %s\n", level);
+      return 1;
+    }
+    int lcells = board.width * board.height;
+    if (lcells <= MAX_BOARD_SIZE) {
+      char *lframes = malloc((size_t)n * (size_t)lcells);
+      features_frame_from_board(&board, lframes);
+      for (int f = 1; f < n; f++)
+        memcpy(lframes + (size_t)f * (size_t)lcells, lframes, (size_t)lcells);
+      failed |= run_all(lframes, n, board.width, board.height);
+      free(lframes);
+    }
+    unload_level(&board);
+  }
+  return failed;
+}
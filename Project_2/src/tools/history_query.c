@@ -0,0 +1,357 @@
+/**
+ * @file history_query.c
+ * @brief history_query - prints and graphs windows of the stats history.
+ *
+ * Usage: history_query [-d data_dir] [-f from] [-t to] [-l length]
+ *                      [-s step] [-g metric] [-w width]
+ *
+ * Maps history.ring read-only and prints the samples between -f and -t,
+ * grouped into rows of -s (by default about 60 rows for the window). Times
+ * are "YYYY-MM-DD HH:MM[:SS]", "HH:MM[:SS]" for today or "@unix_time";
+ * lengths and steps are a number with an s, m, h or d suffix. Without -f the
+ * window ends at -t (or the newest sample) and spans -l (default 10m); with
+ * -f and no -t it spans -l from -f. Rows average the rates and keep the
+ * worst p99 lateness and QoS level; rows without samples are printed as
+ * "down". -g draws one metric (sessions, queue, ticks, fps, bytes, p99,
+ * lock, rss, qos) as bars -w characters wide instead of the table.
+ *
+ * It works while the server is running: samples are copied one by one and
+ * the one being written is skipped, so the server never waits for this
+ * process.
+ */
+
+#include "../../include/history.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Rows printed for a window when -s is not given */
+#define DEFAULT_ROWS 60
+
+/** @brief Metrics -g can draw */
+static const char *metric_names[] = {"sessions", "queue", "ticks",
+                                     "fps",      "bytes", "p99",
+                                     "lock",     "rss",   "qos"};
+#define N_METRICS (int)(sizeof(metric_names) / sizeof(metric_names[0]))
+
+/**
+ * @brief Samples grouped into one printed row.
+ */
+typedef struct {
+  int64_t start; /**< First second of the row */
+  int count;     /**< Samples in the row */
+  double sum[N_METRICS];
+  double max[N_METRICS];
+} row_t;
+
+/**
+ * @brief Formats a Unix time as local date and time.
+ */
+static const char *format_time(int64_t t, char *buf, size_t size) {
+  time_t tt = (time_t)t;
+  struct tm tm;
+  localtime_r(&tt, &tm);
+  strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tm);
+  return buf;
+}
+
+/**
+ * @brief Parses a local time, a time of today or "@unix_time".
+ * @return 0 on success, -1 if the text is not a time.
+ */
+static int parse_time(const char *text, int64_t *out) {
+  if (text[0] == '@') {
+    char *end;
+    long long t = strtoll(text + 1, &end, 10);
+    if (*end != '\0')
+      return -1;
+    *out = t;
+    return 0;
+  }
+  time_t now = time(NULL);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  int y, mo, d, h, mi, s = 0;
+  if (sscanf(text, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &s) >= 5) {
+    tm.tm_year = y - 1900;
+    tm.tm_mon = mo - 1;
+    tm.tm_mday = d;
+  } else if (sscanf(text, "%d:%d:%d", &h, &mi, &s) < 2) {
+    return -1;
+  }
+  tm.tm_hour = h;
+  tm.tm_min = mi;
+  tm.tm_sec = s;
+  tm.tm_isdst = -1;
+  time_t t = mktime(&tm);
+  if (t == (time_t)-1)
+    return -1;
+  *out = (int64_t)t;
+  return 0;
+}
+
+/**
+ * @brief Parses a length such as "90s", "10m", "2h" or "7d".
+ * @return Seconds, or -1 if the text is not a length.
+ */
+static long long parse_length(const char *text) {
+  char *end;
+  long long n = strtoll(text, &end, 10);
+  if (end == text || n <= 0)
+    return -1;
+  switch (*end) {
+  case '\0':
+  case 's':
+    return n;
+  case 'm':
+    return n * 60;
+  case 'h':
+    return n * 3600;
+  case 'd':
+    return n * 86400;
+  default:
+    return -1;
+  }
+}
+
+/**
+ * @brief Metric values of a sample, in the units printed.
+ */
+static void sample_values(const history_sample_t *s, double v[N_METRICS]) {
+  v[0] = s->sessions;
+  v[1] = s->queue_depth;
+  v[2] = s->ticks;
+  v[3] = s->frames;
+  v[4] = (double)s->bytes / 1024.0; /* KiB/s */
+  v[5] = s->p99_late_us / 1000.0;   /* ms */
+  v[6] = s->lock_wait_us / 1000.0;  /* ms/s */
+  v[7] = s->rss_kb / 1024.0;        /* MiB */
+  v[8] = s->qos_level;
+}
+
+/**
+ * @brief Value printed for a row: the worst p99 and QoS level, the mean of
+ * everything else.
+ */
+static double row_value(const row_t *row, int metric) {
+  if (metric == 5 || metric == 8)
+    return row->max[metric];
+  return row->sum[metric] / row->count;
+}
+
+/**
+ * @brief First sample at or after a time (samples are in time order).
+ * @return Its number, or head + 1 if every sample is older.
+ */
+static uint64_t find_first(const history_ring_t *ring, uint64_t first,
+                           uint64_t head, int64_t from) {
+  uint64_t lo = first, hi = head + 1;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    history_sample_t s;
+    // A slot being overwritten holds the oldest sample: treat it as older
+    if (history_read(ring, mid, &s) != 0 || s.time < from)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief Prints the command line to stderr.
+ */
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-d data_dir] [-f from] [-t to] [-l length] [-s step] "
+          "[-g metric] [-w width]\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  const char *dir = getenv("PACMANIST_DATA_DIR");
+  const char *from_text = NULL, *to_text = NULL, *graph = NULL;
+  long long length = 600, step = 0;
+  int width = 50;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:f:t:l:s:g:w:h")) != -1) {
+    if (opt == 'd') {
+      dir = optarg;
+    } else if (opt == 'f') {
+      from_text = optarg;
+    } else if (opt == 't') {
+      to_text = optarg;
+    } else if (opt == 'l') {
+      length = parse_length(optarg);
+    } else if (opt == 's') {
+      step = parse_length(optarg);
+    } else if (opt == 'g') {
+      graph = optarg;
+    } else if (opt == 'w') {
+      width = atoi(optarg);
+    } else {
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (length <= 0 || step < 0 || width <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (dir == NULL || dir[0] == '\0')
+    dir = "data";
+
+  int metric = -1;
+  if (graph != NULL) {
+    for (int m = 0; m < N_METRICS; m++)
+      if (strcmp(graph, metric_names[m]) == 0)
+        metric = m;
+    if (metric == -1) {
+      fprintf(stderr, "Unknown metric %s (one of:", graph);
+      for (int m = 0; m < N_METRICS; m++)
+        fprintf(stderr, " %s", metric_names[m]);
+      fprintf(stderr, ")\n");
+      return 1;
+    }
+  }
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/history.ring", dir);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror(path);
+    return 1;
+  }
+  struct stat st;
+  history_ring_t header;
+  if (fstat(fd, &st) == -1 ||
+      pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+      header.magic != HISTORY_MAGIC || header.version != HISTORY_VERSION ||
+      header.slots == 0 ||
+      (size_t)st.st_size != history_ring_size(header.slots)) {
+    fprintf(stderr, "%s is not a stats history\n", path);
+    close(fd);
+    return 1;
+  }
+  const history_ring_t *ring =
+      mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t first = head > ring->slots ? head - ring->slots + 1 : 1;
+  history_sample_t oldest, newest;
+  // Skip a slot the server is overwriting right now
+  while (first <= head && history_read(ring, first, &oldest) != 0)
+    first++;
+  if (first > head || history_read(ring, head, &newest) != 0) {
+    fprintf(stderr, "%s holds no samples yet\n", path);
+    return 1;
+  }
+  char when[32], until[32];
+  printf("%s: %u slots (%.1f days), %llu samples from %s to %s\n", path,
+         ring->slots, (double)ring->slots * ring->interval_s / 86400.0,
+         (unsigned long long)(head - first + 1),
+         format_time(oldest.time, when, sizeof(when)),
+         format_time(newest.time, until, sizeof(until)));
+
+  int64_t from = 0, to = 0;
+  if ((from_text != NULL && parse_time(from_text, &from) != 0) ||
+      (to_text != NULL && parse_time(to_text, &to) != 0)) {
+    fprintf(stderr, "Times are \"YYYY-MM-DD HH:MM[:SS]\", \"HH:MM[:SS]\" "
+                    "or \"@unix_time\"\n");
+    return 1;
+  }
+  if (from_text == NULL) {
+    if (to_text == NULL)
+      to = newest.time;
+    from = to - length + 1;
+  } else if (to_text == NULL) {
+    to = from + length - 1;
+  }
+  if (to < from) {
+    fprintf(stderr, "The window ends before it starts\n");
+    return 1;
+  }
+  if (step == 0)
+    step = (to - from + DEFAULT_ROWS) / DEFAULT_ROWS;
+  int n_rows = (int)((to - from) / step + 1);
+  row_t *rows = calloc((size_t)n_rows, sizeof(row_t));
+  if (rows == NULL) {
+    perror("calloc");
+    return 1;
+  }
+  for (int r = 0; r < n_rows; r++)
+    rows[r].start = from + (int64_t)r * step;
+
+  for (uint64_t n = find_first(ring, first, head, from); n <= head; n++) {
+    history_sample_t s;
+    if (history_read(ring, n, &s) != 0)
+      continue;
+    if (s.time > to)
+      break;
+    if (s.time < from)
+      continue;
+    row_t *row = &rows[(s.time - from) / step];
+    double v[N_METRICS];
+    sample_values(&s, v);
+    for (int m = 0; m < N_METRICS; m++) {
+      row->sum[m] += v[m];
+      if (row->count == 0 || v[m] > row->max[m])
+        row->max[m] = v[m];
+    }
+    row->count++;
+  }
+
+  printf("%s to %s, %lld s per row\n", format_time(from, when, sizeof(when)),
+         format_time(to, until, sizeof(until)), step);
+  if (metric == -1) {
+    printf("%-19s %8s %6s %8s %7s %9s %8s %9s %8s %3s\n", "time", "sessions",
+           "queue", "ticks/s", "fps", "KiB/s", "p99 ms", "lock ms/s",
+           "RSS MiB", "qos");
+    for (int r = 0; r < n_rows; r++) {
+      format_time(rows[r].start, when, sizeof(when));
+      if (rows[r].count == 0) {
+        printf("%-19s %8s\n", when, "down");
+        continue;
+      }
+      printf("%-19s %8.1f %6.1f %8.0f %7.0f %9.1f %8.3f %9.3f %8.1f %3.0f\n",
+             when, row_value(&rows[r], 0), row_value(&rows[r], 1),
+             row_value(&rows[r], 2), row_value(&rows[r], 3),
+             row_value(&rows[r], 4), row_value(&rows[r], 5),
+             row_value(&rows[r], 6), row_value(&rows[r], 7),
+             row_value(&rows[r], 8));
+    }
+    free(rows);
+    return 0;
+  }
+
+  double peak = 0.0;
+  for (int r = 0; r < n_rows; r++)
+    if (rows[r].count > 0 && row_value(&rows[r], metric) > peak)
+      peak = row_value(&rows[r], metric);
+  printf("%s (peak %.3f)\n", metric_names[metric], peak);
+  for (int r = 0; r < n_rows; r++) {
+    format_time(rows[r].start, when, sizeof(when));
+    if (rows[r].count == 0) {
+      printf("%-19s %10s |\n", when, "down");
+      continue;
+    }
+    double value = row_value(&rows[r], metric);
+    int bar = peak > 0.0 ? (int)(value / peak * width + 0.5) : 0;
+    printf("%-19s %10.3f |", when, value);
+    for (int i = 0; i < bar; i++)
+      putchar('#');
+    putchar('\n');
+  }
+  free(rows);
+  return 0;
+}
@@ -0,0 +1,427 @@
+/**
+ * @file levelgen.c
+ * @brief levelgen - procedural maze and level generator.
+ *
+ * Usage: levelgen [-s seed] [-n count] [-W width] [-H height]
+ *                 [-c corridor] [-d dots] [-g ghosts] [-l length]
+ *                 [-t tempo] [-r] [-o dir]
+ *
+ * Each level is a maze carved by a randomized depth-first search, so every
+ * open cell is reachable from every other; the corridor density then knocks
+ * out extra walls to add loops. Pacman starts in the top-left cell and the
+ * portal goes on the open cell farthest from it (or a random reachable one
+ * with -r), found by breadth-first search. Level i of a run depends only on
+ * (seed, i), so any single level can be regenerated.
+ *
+ * Writes <dir>/gen_<seed>_<i>.lvl with its .p and .m scripts next to it.
+ */
+
+#include "../../include/board.h"
+#include "../../include/protocol.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief Longest row load_level() can read (its line buffer is 1024) */
+#define LEVELGEN_MAX_WIDTH 1000
+#define LEVELGEN_MIN_SIZE 5
+
+/**
+ * @brief Generation parameters.
+ */
+typedef struct {
+  uint64_t seed;
+  long count;
+  int width, height;
+  double corridor;  /**< Fraction of removable walls knocked out */
+  double dots;      /**< Fraction of open cells holding a dot */
+  int ghosts;       /**< Ghosts per level */
+  int script_len;   /**< Moves per .p/.m script */
+  int tempo;        /**< TEMPO of the level */
+  int random_portal;
+  const char *dir;
+} levelgen_opts_t;
+
+/**
+ * @brief Scratch buffers reused for every level.
+ */
+typedef struct {
+  char *grid;     /**< width * height map characters */
+  int *dist;      /**< BFS distance from pacman, -1 if unreachable */
+  int *queue;     /**< BFS queue and DFS stack */
+  char *text;     /**< Level file contents */
+  size_t text_cap;
+} levelgen_buf_t;
+
+/**
+ * @brief splitmix64 step, used to derive one independent seed per level.
+ */
+static uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief xorshift64* generator for everything inside one level.
+ */
+static uint64_t next_rand(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545f4914f6cdd1dULL;
+}
+
+/**
+ * @brief Uniform integer in [0, n).
+ */
+static int rand_below(uint64_t *state, int n) {
+  return (int)((next_rand(state) >> 33) % (uint64_t)n);
+}
+
+/**
+ * @brief Uniform double in [0, 1).
+ */
+static double rand_unit(uint64_t *state) {
+  return (double)(next_rand(state) >> 11) / 9007199254740992.0;
+}
+
+/**
+ * @brief Carves a perfect maze on the odd cells with an explicit DFS stack.
+ */
+static void carve_maze(const levelgen_opts_t *o, levelgen_buf_t *b,
+                       uint64_t *rng) {
+  int w = o->width, h = o->height;
+  memset(b->grid, 'X', (size_t)w * (size_t)h);
+
+  static const int dx[4] = {0, 0, -2, 2};
+  static const int dy[4] = {-2, 2, 0, 0};
+  int top = 0;
+  b->queue[top++] = 1 * w + 1;
+  b->grid[1 * w + 1] = ' ';
+  while (top > 0) {
+    int cell = b->queue[top - 1];
+    int x = cell % w, y = cell / w;
+    int options[4], n = 0;
+    for (int d = 0; d < 4; d++) {
+      int nx = x + dx[d], ny = y + dy[d];
+      if (nx > 0 && nx < w - 1 && ny > 0 && ny < h - 1 &&
+          b->grid[ny * w + nx] == 'X')
+        options[n++] = d;
+    }
+    if (n == 0) {
+      top--;
+      continue;
+    }
+    int d = options[rand_below(rng, n)];
+    int nx = x + dx[d], ny = y + dy[d];
+    b->grid[(y + dy[d] / 2) * w + (x + dx[d] / 2)] = ' ';
+    b->grid[ny * w + nx] = ' ';
+    b->queue[top++] = ny * w + nx;
+  }
+
+  // Knock out walls between two open cells to add loops
+  for (int y = 1; y < h - 1; y++) {
+    for (int x = 1; x < w - 1; x++) {
+      if (b->grid[y * w + x] != 'X')
+        continue;
+      int horizontal = b->grid[y * w + x - 1] == ' ' &&
+                       b->grid[y * w + x + 1] == ' ';
+      int vertical = b->grid[(y - 1) * w + x] == ' ' &&
+                     b->grid[(y + 1) * w + x] == ' ';
+      if ((horizontal || vertical) && rand_unit(rng) < o->corridor)
+        b->grid[y * w + x] = ' ';
+    }
+  }
+}
+
+/**
+ * @brief Breadth-first search from a cell over open cells.
+ * @return The last cell reached (one of the farthest).
+ */
+static int bfs(const levelgen_opts_t *o, levelgen_buf_t *b, int start) {
+  int w = o->width, cells = o->width * o->height;
+  for (int i = 0; i < cells; i++)
+    b->dist[i] = -1;
+  int head = 0, tail = 0, last = start;
+  b->dist[start] = 0;
+  b->queue[tail++] = start;
+  while (head < tail) {
+    int cell = b->queue[head++];
+    last = cell;
+    int next[4] = {cell - w, cell + w, cell - 1, cell + 1};
+    for (int d = 0; d < 4; d++) {
+      if (b->grid[next[d]] != 'X' && b->dist[next[d]] < 0) {
+        b->dist[next[d]] = b->dist[cell] + 1;
+        b->queue[tail++] = next[d];
+      }
+    }
+  }
+  return last;
+}
+
+/**
+ * @brief Picks a random reachable, still empty cell at least min_dist away.
+ * @return Cell index, or -1 if none was found.
+ */
+static int pick_cell(const levelgen_opts_t *o, levelgen_buf_t *b,
+                     uint64_t *rng, int min_dist) {
+  int cells = o->width * o->height;
+  for (int tries = 0; tries < 64; tries++) {
+    int c = rand_below(rng, cells);
+    if (b->grid[c] == ' ' && b->dist[c] >= min_dist)
+      return c;
+  }
+  for (int c = 0; c < cells; c++) {
+    if (b->grid[c] == ' ' && b->dist[c] >= min_dist)
+      return c;
+  }
+  return -1;
+}
+
+/**
+ * @brief Writes a random motion script.
+ * @param path Output path.
+ * @param rng Level generator state.
+ * @param len Number of moves.
+ * @param ghost 1 for a ghost script (may charge), 0 for pacman.
+ * @return 0 on success, -1 on error.
+ */
+static int write_script(const char *path, uint64_t *rng, int len, int ghost) {
+  static const char pacman_moves[] = "WASDWASDT";
+  static const char ghost_moves[] = "WASDWASDRCT";
+  const char *moves = ghost ? ghost_moves : pacman_moves;
+  int n_moves = (int)strlen(moves);
+
+  char text[MAX_MOVES * 8 + 64];
+  int pos = snprintf(text, sizeof(text), "PASSO %d\n",
+                     ghost ? rand_below(rng, 3) : 0);
+  for (int i = 0; i < len; i++) {
+    char m = moves[rand_below(rng, n_moves)];
+    if (m == 'T')
+      pos += snprintf(text + pos, sizeof(text) - (size_t)pos, "T %d\n",
+                      1 + rand_below(rng, 4));
+    else
+      pos += snprintf(text + pos, sizeof(text) - (size_t)pos, "%c\n", m);
+  }
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return -1;
+  fwrite(text, 1, (size_t)pos, f);
+  return fclose(f);
+}
+
+/**
+ * @brief Generates level 'index' of the run and its scripts.
+ * @return 0 on success, -1 on error.
+ */
+static int generate(const levelgen_opts_t *o, levelgen_buf_t *b, long index) {
+  uint64_t mix = o->seed ^ ((uint64_t)index * 0xd1b54a32d192ed03ULL);
+  uint64_t rng = splitmix64(&mix) | 1;
+  int w = o->width, h = o->height;
+
+  carve_maze(o, b, &rng);
+  int pacman = 1 * w + 1;
+  int farthest = bfs(o, b, pacman);
+
+  b->grid[pacman] = 'P';
+
+  // The portal is reachable by construction: it is taken from the BFS
+  int portal = o->random_portal ? pick_cell(o, b, &rng, 1) : farthest;
+  if (portal < 0 || portal == pacman) {
+    fprintf(stderr, "levelgen: level %ld has no room for a portal\n", index);
+    return -1;
+  }
+  b->grid[portal] = '@';
+
+  int placed = 0;
+  for (int g = 0; g < o->ghosts; g++) {
+    int cell = pick_cell(o, b, &rng, 3);
+    if (cell < 0)
+      cell = pick_cell(o, b, &rng, 1);
+    if (cell < 0)
+      break;
+    b->grid[cell] = 'M';
+    placed++;
+  }
+  // Dots go on last so that pacman, the portal and ghosts sit on empty cells
+  for (int c = 0; c < w * h; c++) {
+    if (b->grid[c] == ' ' && rand_unit(&rng) < o->dots)
+      b->grid[c] = '.';
+  }
+
+  char base[MAX_FILENAME];
+  snprintf(base, sizeof(base), "gen_%llu_%ld", (unsigned long long)o->seed,
+           index);
+  char path[MAX_FILENAME * 2];
+
+  snprintf(path, sizeof(path), "%s/%s.p", o->dir, base);
+  if (write_script(path, &rng, o->script_len, 0) != 0)
+    return -1;
+  for (int g = 0; g < placed; g++) {
+    snprintf(path, sizeof(path), "%s/%s_%d.m", o->dir, base, g);
+    if (write_script(path, &rng, o->script_len, 1) != 0)
+      return -1;
+  }
+
+  size_t need = (size_t)(w + 1) * (size_t)h + (size_t)placed * 64 + 512;
+  if (need > b->text_cap) {
+    char *text = realloc(b->text, need);
+    if (text == NULL)
+      return -1;
+    b->text = text;
+    b->text_cap = need;
+  }
+  size_t pos = (size_t)snprintf(
+      b->text, b->text_cap,
+      "# Generated by levelgen: seed %llu, level %ld\nDIM %d %d\nTEMPO %d\n"
+      "PAC %s.p\n",
+      (unsigned long long)o->seed, index, h, w, o->tempo, base);
+  if (placed > 0) {
+    pos += (size_t)snprintf(b->text + pos, b->text_cap - pos, "MON");
+    for (int g = 0; g < placed; g++)
+      pos += (size_t)snprintf(b->text + pos, b->text_cap - pos, " %s_%d.m",
+                              base, g);
+    b->text[pos++] = '\n';
+  }
+  for (int y = 0; y < h; y++) {
+    memcpy(b->text + pos, b->grid + (size_t)y * (size_t)w, (size_t)w);
+    pos += (size_t)w;
+    b->text[pos++] = '\n';
+  }
+
+  snprintf(path, sizeof(path), "%s/%s.lvl", o->dir, base);
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return -1;
+  fwrite(b->text, 1, pos, f);
+  return fclose(f);
+}
+
+/**
+ * @brief Prints usage and the defaults.
+ */
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-s seed] [-n count] [-W width] [-H height]\n"
+          "          [-c corridor] [-d dots] [-g ghosts] [-l length]\n"
+          "          [-t tempo] [-r] [-o dir]\n"
+          "  -s  Seed (default 1)\n"
+          "  -n  Number of levels (default 1)\n"
+          "  -W  Width, %d..%d (default 21)\n"
+          "  -H  Height, at least %d (default 15)\n"
+          "  -c  Fraction of extra walls removed, 0..1 (default 0.1)\n"
+          "  -d  Fraction of open cells with a dot, 0..1 (default 0.8)\n"
+          "  -g  Ghosts per level, 0..%d (default 2)\n"
+          "  -l  Moves per script, 1..%d (default 12)\n"
+          "  -t  Level TEMPO in ms (default 30)\n"
+          "  -r  Random reachable portal instead of the farthest cell\n"
+          "  -o  Output directory (default levels_gen)\n",
+          prog, LEVELGEN_MIN_SIZE, LEVELGEN_MAX_WIDTH, LEVELGEN_MIN_SIZE,
+          MAX_GHOSTS, MAX_MOVES);
+}
+
+int main(int argc, char *argv[]) {
+  levelgen_opts_t o = {.seed = 1,
+                       .count = 1,
+                       .width = 21,
+                       .height = 15,
+                       .corridor = 0.1,
+                       .dots = 0.8,
+                       .ghosts = 2,
+                       .script_len = 12,
+                       .tempo = 30,
+                       .random_portal = 0,
+                       .dir = "levels_gen"};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:W:H:c:d:g:l:t:ro:h")) != -1) {
+    switch (opt) {
+    case 's':
+      o.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'n':
+      o.count = atol(optarg);
+      break;
+    case 'W':
+      o.width = atoi(optarg);
+      break;
+    case 'H':
+      o.height = atoi(optarg);
+      break;
+    case 'c':
+      o.corridor = atof(optarg);
+      break;
+    case 'd':
+      o.dots = atof(optarg);
+      break;
+    case 'g':
+      o.ghosts = atoi(optarg);
+      break;
+    case 'l':
+      o.script_len = atoi(optarg);
+      break;
+    case 't':
+      o.tempo = atoi(optarg);
+      break;
+    case 'r':
+      o.random_portal = 1;
+      break;
+    case 'o':
+      o.dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (o.width < LEVELGEN_MIN_SIZE || o.width > LEVELGEN_MAX_WIDTH ||
+      o.height < LEVELGEN_MIN_SIZE || o.ghosts < 0 || o.ghosts > MAX_GHOSTS ||
+      o.script_len < 1 || o.script_len > MAX_MOVES || o.count < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (o.width * o.height > MAX_BOARD_SIZE) {
+    fprintf(stderr,
+            "levelgen: %dx%d exceeds the protocol limit of %d cells; "
+            "clients will only see part of the board\n",
+            o.width, o.height, MAX_BOARD_SIZE);
+  }
+  if (mkdir(o.dir, 0755) == -1 && errno != EEXIST) {
+    perror("levelgen: mkdir");
+    return 1;
+  }
+
+  size_t cells = (size_t)o.width * (size_t)o.height;
+  levelgen_buf_t b = {.grid = malloc(cells),
+                      .dist = malloc(cells * sizeof(int)),
+                      .queue = malloc(cells * sizeof(int))};
+  if (b.grid == NULL || b.dist == NULL || b.queue == NULL) {
+    fprintf(stderr, "levelgen: out of memory\n");
+    return 1;
+  }
+
+  int status = 0;
+  for (long i = 0; i < o.count; i++) {
+    if (generate(&o, &b, i) != 0) {
+      perror("levelgen");
+      status = 1;
+      break;
+    }
+  }
+
+  free(b.grid);
+  free(b.dist);
+  free(b.queue);
+  free(b.text);
+  return status;
+}
@@ -0,0 +1,372 @@
+/**
+ * @file move_bench.c
+ * @brief move_bench - move throughput and consistency of the board lock
+ * modes.
+ *
+ * Usage: move_bench [-s seconds] [-w width] [-h height] [-r seed] [-c]
+ *                   [ghosts...]
+ *
+ * For each ghost count, builds an open board with pillars, one random
+ * Pacman and that many random ghosts (every fourth one also charges), and
+ * runs one thread per entity calling move_pacman()/move_ghost() as fast as
+ * it can, first in BOARD_LOCK_GLOBAL mode, then in BOARD_LOCK_STRIPED mode.
+ * A checker thread keeps taking the board for reading and verifies that no
+ * entity was lost or duplicated: every ghost stands on its own 'M' cell,
+ * there are exactly as many 'M' cells as ghosts, one 'C' cell for a live
+ * Pacman and none for a dead one, the walls are intact and board->hash
+ * matches board_hash().
+ *
+ * Prints one line per ghost count and mode: moves per second, contended
+ * lock wait per move, checks run and inconsistencies found. With -c, exits
+ * with 1 if any check failed (used by the test suite).
+ */
+
+#include "../../include/board.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Benchmark parameters.
+ */
+typedef struct {
+  double seconds; /**< Run time of each ghost count and mode */
+  int width, height;
+  unsigned int seed; /**< Placement and rng_seed of the boards */
+} bench_opts_t;
+
+/**
+ * @brief One entity thread.
+ */
+typedef struct {
+  board_t *board;
+  int ghost;           /**< Ghost index, -1 for Pacman */
+  unsigned long moves; /**< Moves made */
+} mover_t;
+
+/**
+ * @brief The checker thread.
+ */
+typedef struct {
+  board_t *board;
+  int walls;             /**< Wall cells of the fresh board */
+  unsigned long checks;  /**< Consistency checks run */
+  unsigned long errors;  /**< Checks that failed */
+  char first_error[128]; /**< What the first failed check found */
+} checker_t;
+
+static atomic_int stop;
+
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Picks a random empty cell.
+ */
+static int random_empty_cell(board_t *board, unsigned int *seed) {
+  int cells = board->width * board->height;
+  int cell;
+  do
+    cell = rand_r(seed) % cells;
+  while (board->board[cell].content != ' ');
+  return cell;
+}
+
+/**
+ * @brief Builds a walled board with pillars, Pacman and the ghosts.
+ * @return 0 on success, -1 if out of memory or too small for the ghosts.
+ */
+static int build_board(board_t *board, const bench_opts_t *o, int n_ghosts) {
+  memset(board, 0, sizeof(*board));
+  board->width = o->width;
+  board->height = o->height;
+  board->n_pacmans = 1;
+  board->n_ghosts = n_ghosts;
+  board->board = calloc((size_t)o->width * (size_t)o->height,
+                        sizeof(board_pos_t));
+  board->pacmans = calloc(1, sizeof(pacman_t));
+  board->ghosts = calloc((size_t)n_ghosts + 1, sizeof(ghost_t));
+  if (board->board == NULL || board->pacmans == NULL || board->ghosts == NULL)
+    return -1;
+  snprintf(board->level_name, sizeof(board->level_name), "move_bench");
+
+  int empty = 0;
+  for (int y = 0; y < o->height; y++) {
+    for (int x = 0; x < o->width; x++) {
+      board_pos_t *cell = &board->board[y * o->width + x];
+      int border = x == 0 || y == 0 || x == o->width - 1 || y == o->height - 1;
+      int pillar = x % 4 == 2 && y % 4 == 2;
+      cell->content = border || pillar ? 'X' : ' ';
+      cell->has_dot = cell->content == ' ';
+      empty += cell->content == ' ';
+    }
+  }
+  if (empty < 2 * (n_ghosts + 1))
+    return -1; // Too crowded to move
+
+  unsigned int seed = o->seed;
+  pacman_t *pac = &board->pacmans[0];
+  int cell = random_empty_cell(board, &seed);
+  pac->pos_x = cell % o->width;
+  pac->pos_y = cell / o->width;
+  pac->alive = 1;
+  pac->moves[0] = (command_t){'R', 1, 1};
+  pac->n_moves = 1;
+  board->board[cell].content = 'C';
+  board->board[cell].has_dot = 0;
+
+  for (int g = 0; g < n_ghosts; g++) {
+    ghost_t *ghost = &board->ghosts[g];
+    cell = random_empty_cell(board, &seed);
+    ghost->pos_x = cell % o->width;
+    ghost->pos_y = cell / o->width;
+    // Charged moves cross the board and take every stripe
+    if (g % 4 == 3) {
+      ghost->moves[ghost->n_moves++] = (command_t){'C', 1, 1};
+      ghost->moves[ghost->n_moves++] = (command_t){'R', 1, 1};
+    }
+    ghost->moves[ghost->n_moves++] = (command_t){'R', 1, 1};
+    board->board[cell].content = 'M';
+    board->board[cell].has_dot = 0;
+  }
+
+  board->rng_seed = seed;
+  board->hash = board_hash(board);
+  pthread_rwlock_init(&board->state_lock, NULL);
+  board->lock_initialized = 1;
+  return 0;
+}
+
+/**
+ * @brief Moves one entity until told to stop (or Pacman dies).
+ */
+static void *mover_thread(void *arg) {
+  mover_t *m = (mover_t *)arg;
+  board_t *board = m->board;
+  unsigned long moves = 0;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    if (m->ghost < 0) {
+      pacman_t *pac = &board->pacmans[0];
+      if (move_pacman(board, 0, &pac->moves[pac->current_move % pac->n_moves]) ==
+          DEAD_PACMAN)
+        break;
+    } else {
+      ghost_t *ghost = &board->ghosts[m->ghost];
+      move_ghost(board, m->ghost,
+                 &ghost->moves[ghost->current_move % ghost->n_moves]);
+    }
+    moves++;
+  }
+  m->moves = moves;
+  return NULL;
+}
+
+/**
+ * @brief Checks that no entity was lost or duplicated (board locked).
+ * @return NULL if the board is consistent, else what is wrong.
+ */
+static const char *check_board(const board_t *board, int walls, char *why,
+                               size_t size) {
+  int cells = board->width * board->height;
+  int ghost_cells = 0, pacman_cells = 0, wall_cells = 0;
+  for (int i = 0; i < cells; i++) {
+    char c = board->board[i].content;
+    ghost_cells += c == 'M';
+    pacman_cells += c == 'C';
+    wall_cells += c == 'X';
+  }
+  for (int g = 0; g < board->n_ghosts; g++) {
+    const ghost_t *ghost = &board->ghosts[g];
+    int cell = ghost->pos_y * board->width + ghost->pos_x;
+    if (board->board[cell].content != 'M') {
+      snprintf(why, size, "ghost %d at (%d,%d) is not on its cell", g,
+               ghost->pos_x, ghost->pos_y);
+      return why;
+    }
+    for (int other = 0; other < g; other++) {
+      if (board->ghosts[other].pos_x == ghost->pos_x &&
+          board->ghosts[other].pos_y == ghost->pos_y) {
+        snprintf(why, size, "ghosts %d and %d share (%d,%d)", other, g,
+                 ghost->pos_x, ghost->pos_y);
+        return why;
+      }
+    }
+  }
+  const pacman_t *pac = &board->pacmans[0];
+  int pac_cell = pac->pos_y * board->width + pac->pos_x;
+  if (ghost_cells != board->n_ghosts)
+    snprintf(why, size, "%d ghost cells for %d ghosts", ghost_cells,
+             board->n_ghosts);
+  else if (pacman_cells != (pac->alive ? 1 : 0) ||
+           (pac->alive && board->board[pac_cell].content != 'C'))
+    snprintf(why, size, "%d Pacman cells, Pacman %s", pacman_cells,
+             pac->alive ? "alive" : "dead");
+  else if (wall_cells != walls)
+    snprintf(why, size, "%d wall cells instead of %d", wall_cells, walls);
+  else if (board->hash != board_hash(board))
+    snprintf(why, size, "hash %016llx, board hashes to %016llx",
+             (unsigned long long)board->hash,
+             (unsigned long long)board_hash(board));
+  else
+    return NULL;
+  return why;
+}
+
+/**
+ * @brief Checks the board while the movers run.
+ */
+static void *checker_thread(void *arg) {
+  checker_t *c = (checker_t *)arg;
+  char why[sizeof(c->first_error)];
+  while (!atomic_load(&stop)) {
+    board_rdlock(c->board);
+    const char *error = check_board(c->board, c->walls, why, sizeof(why));
+    pthread_rwlock_unlock(&c->board->state_lock);
+    c->checks++;
+    if (error != NULL && c->errors++ == 0)
+      snprintf(c->first_error, sizeof(c->first_error), "%s", error);
+    sleep_ms(1);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Runs one ghost count in one lock mode and prints its line.
+ * @return Inconsistencies found, -1 if the run could not start.
+ */
+static long run(const bench_opts_t *o, int n_ghosts, int mode) {
+  board_t board;
+  mover_t movers[MAX_GHOSTS + 1];
+  checker_t checker = {.board = &board};
+  pthread_t tids[MAX_GHOSTS + 1], checker_tid;
+  if (build_board(&board, o, n_ghosts) != 0 ||
+      (mode == BOARD_LOCK_STRIPED && board_use_striped_locks(&board) != 0)) {
+    fprintf(stderr, "Failed to build a %dx%d board\n", o->width, o->height);
+    unload_level(&board);
+    return -1;
+  }
+  for (int i = 0; i < o->width * o->height; i++)
+    checker.walls += board.board[i].content == 'X';
+
+  atomic_store(&stop, 0);
+  long long start = now_ns();
+  pthread_create(&checker_tid, NULL, checker_thread, &checker);
+  for (int i = 0; i <= n_ghosts; i++) {
+    movers[i] = (mover_t){.board = &board, .ghost = i - 1};
+    pthread_create(&tids[i], NULL, mover_thread, &movers[i]);
+  }
+  sleep_ms((int)(o->seconds * 1000));
+  atomic_store(&stop, 1);
+  unsigned long moves = 0;
+  for (int i = 0; i <= n_ghosts; i++) {
+    pthread_join(tids[i], NULL);
+    moves += movers[i].moves;
+  }
+  pthread_join(checker_tid, NULL);
+  double elapsed = (double)(now_ns() - start) / 1e9;
+
+  // One last look with every thread gone
+  char why[sizeof(checker.first_error)];
+  const char *error = check_board(&board, checker.walls, why, sizeof(why));
+  checker.checks++;
+  if (error != NULL && checker.errors++ == 0)
+    snprintf(checker.first_error, sizeof(checker.first_error), "%s", error);
+
+  printf("%6d  %-8s %12.0f %10.1f %8lu %6lu%s%s\n", n_ghosts,
+         mode == BOARD_LOCK_STRIPED ? "striped" : "global",
+         (double)moves / elapsed,
+         moves > 0 ? (double)atomic_load(&board.lock_wait_ns) / (double)moves
+                   : 0.0,
+         checker.checks, checker.errors, checker.errors ? "  " : "",
+         checker.first_error);
+  unload_level(&board);
+  return (long)checker.errors;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-s seconds] [-w width] [-h height] [-r seed] [-c]\n"
+          "          [ghosts...]\n"
+          "  -s  Run time of each ghost count and mode (default 1)\n"
+          "  -w  Board width (default 60)\n"
+          "  -h  Board height (default 40)\n"
+          "  -r  Seed of the placement and random moves (default 1)\n"
+          "  -c  Exit with 1 if a check found a lost or duplicated entity\n"
+          "Ghost counts default to 1 2 4 8 16 24. Columns: ghosts, lock mode,\n"
+          "moves per second, contended lock wait in ns per move, checks,\n"
+          "inconsistencies found.\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  bench_opts_t o = {.seconds = 1.0, .width = 60, .height = 40, .seed = 1};
+  int check = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:w:h:r:c")) != -1) {
+    switch (opt) {
+    case 's':
+      o.seconds = atof(optarg);
+      break;
+    case 'w':
+      o.width = atoi(optarg);
+      break;
+    case 'h':
+      o.height = atoi(optarg);
+      break;
+    case 'r':
+      o.seed = (unsigned int)strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      check = 1;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (o.seconds <= 0 || o.width < 5 || o.height < 5 ||
+      o.width * o.height > 100000) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  static const int default_counts[] = {1, 2, 4, 8, 16, 24};
+  int counts[MAX_GHOSTS];
+  int n_counts = 0;
+  for (int i = optind; i < argc && n_counts < MAX_GHOSTS; i++) {
+    int n = atoi(argv[i]);
+    if (n < 1 || n > MAX_GHOSTS) {
+      fprintf(stderr, "Ghost counts go from 1 to %d\n", MAX_GHOSTS);
+      return 1;
+    }
+    counts[n_counts++] = n;
+  }
+  if (n_counts == 0)
+    for (size_t i = 0; i < sizeof(default_counts) / sizeof(int); i++)
+      counts[n_counts++] = default_counts[i];
+
+  printf("%dx%d board, %ld online CPUs\n", o.width, o.height,
+         sysconf(_SC_NPROCESSORS_ONLN));
+  printf("%6s  %-8s %12s %10s %8s %6s\n", "ghosts", "mode", "moves/s",
+         "wait ns", "checks", "errors");
+  long errors = 0;
+  for (int i = 0; i < n_counts; i++) {
+    for (int mode = BOARD_LOCK_GLOBAL; mode <= BOARD_LOCK_STRIPED; mode++) {
+      long found = run(&o, counts[i], mode);
+      if (found < 0)
+        return 1;
+      errors += found;
+    }
+  }
+  return check && errors > 0 ? 1 : 0;
+}
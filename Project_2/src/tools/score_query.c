@@ -0,0 +1,117 @@
+/**
+ * @file score_query.c
+ * @brief score_query - reads the server's persistent score store.
+ *
+ * Usage: score_query [-d data_dir] [-k count] [-p player]
+ *
+ * Maps scores.idx read-only and prints the all-time top scores (10 unless
+ * -k is given) and every player's best, or only the best of one player with
+ * -p. It works while the server is running: the index is copied under its
+ * sequence lock, so the server never waits for this process.
+ */
+
+#include "../../include/scores.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Copy of the index being printed */
+static scores_index_t snapshot;
+
+/**
+ * @brief Formats a Unix time as local date and time.
+ */
+static const char *format_time(int64_t t, char *buf, size_t size) {
+  time_t tt = (time_t)t;
+  struct tm tm;
+  localtime_r(&tt, &tm);
+  strftime(buf, size, "%Y-%m-%d %H:%M", &tm);
+  return buf;
+}
+
+int main(int argc, char *argv[]) {
+  const char *dir = getenv("PACMANIST_DATA_DIR");
+  const char *player = NULL;
+  int top_k = 10;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:k:p:h")) != -1) {
+    if (opt == 'd') {
+      dir = optarg;
+    } else if (opt == 'k') {
+      top_k = atoi(optarg);
+    } else if (opt == 'p') {
+      player = optarg;
+    } else {
+      fprintf(stderr, "Usage: %s [-d data_dir] [-k count] [-p player]\n",
+              argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (dir == NULL || dir[0] == '\0')
+    dir = "data";
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/scores.idx", dir);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror(path);
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size != sizeof(scores_index_t)) {
+    fprintf(stderr, "%s is not a score index\n", path);
+    close(fd);
+    return 1;
+  }
+  const scores_index_t *index =
+      mmap(NULL, sizeof(scores_index_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (index == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  if (scores_index_snapshot(index, &snapshot) != 0 ||
+      snapshot.magic != SCORES_INDEX_MAGIC ||
+      snapshot.version != SCORES_INDEX_VERSION) {
+    fprintf(stderr, "%s is not a score index\n", path);
+    return 1;
+  }
+
+  char when[32];
+  if (player != NULL) {
+    for (int i = 0; i < SCORES_PLAYER_SLOTS; i++) {
+      const score_player_t *p = &snapshot.slots[i];
+      if (strncmp(p->player, player, SCORES_NAME_SIZE) == 0) {
+        printf("%s: best %d points on %s, %u sessions\n", p->player, p->best,
+               format_time(p->best_time, when, sizeof(when)), p->sessions);
+        return 0;
+      }
+    }
+    fprintf(stderr, "No scores for %s\n", player);
+    return 1;
+  }
+
+  printf("%llu sessions, %u players, next client id %llu\n",
+         (unsigned long long)snapshot.records, snapshot.players,
+         (unsigned long long)snapshot.next_client_id);
+  printf("=== TOP %d SCORES ===\n", top_k);
+  for (int i = 0; i < top_k && i < (int)snapshot.top_count; i++) {
+    const score_record_t *r = &snapshot.top[i];
+    printf("%3d. %-23s %6d points  %d levels  client %d  %s\n", i + 1,
+           r->player, r->points, r->levels, r->client_id,
+           format_time(r->ended, when, sizeof(when)));
+  }
+  printf("=== BEST PER PLAYER ===\n");
+  for (int i = 0; i < SCORES_PLAYER_SLOTS; i++) {
+    const score_player_t *p = &snapshot.slots[i];
+    if (p->player[0] != '\0')
+      printf("%-23s %6d points  %u sessions\n", p->player, p->best,
+             p->sessions);
+  }
+  return 0;
+}
@@ -0,0 +1,804 @@
+/**
+ * @file solver.c
+ * @brief solver - parallel optimal-route search over levels.
+ *
+ * Usage: solver [-j threads] [-t ticks] [-m states] [-r seed] [-f] [-o dir]
+ *               <level.lvl | dir>...
+ *
+ * Searches the state space of each level: Pacman's cell, its passo
+ * countdown, the set of eaten dots and the ghost phase. Ghosts follow their
+ * .m scripts whatever Pacman does (a ghost that would reach Pacman ends that
+ * branch), so one ghost-only run of the level gives every tick's ghost cells
+ * and the cells swept by ghost moves, and the ghost phase of a state is the
+ * Zobrist hash of that run at the state's tick. Time runs as in the training
+ * environment: each tick Pacman moves, then every ghost in order.
+ *
+ * The search is a breadth-first search one tick per layer. Worker threads
+ * take chunks of the layer and insert successors into a lock-free
+ * transposition table keyed by a state hash, so a state already reached (at
+ * this or an earlier tick) is not expanded again. The first layer that
+ * reaches the portal gives the par time; the search then goes on until the
+ * state space is exhausted, or the tick or state limit is hit, for the
+ * highest score that still reaches the portal.
+ *
+ * Prints one line per level. With -o, writes <dir>/<level>.par.p (fastest
+ * route) and <dir>/<level>.best.p (highest score), ready to use as the
+ * level's PAC script.
+ */
+
+#include "../../include/board.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Nodes a worker takes from the layer at a time */
+#define SOLVER_CHUNK 64
+
+/**
+ * @brief Search parameters.
+ */
+typedef struct {
+  int threads;
+  int max_ticks;   /**< Deepest layer searched */
+  long max_states; /**< Nodes kept per level */
+  unsigned int seed; /**< rng_seed of the level, for random ghost moves */
+  int fastest_only;  /**< Stop at the par time */
+  const char *dir;   /**< Where to write the scripts, NULL for none */
+} solver_opts_t;
+
+/**
+ * @brief One reached state; the tick is the layer it belongs to.
+ */
+typedef struct {
+  uint64_t dots_key; /**< XOR of the keys of the eaten dots */
+  int32_t parent;    /**< Node it was reached from, -1 for the start */
+  int32_t cell;      /**< Pacman's cell */
+  int32_t points;
+  int16_t waiting; /**< Pacman's passo countdown */
+  char action;     /**< W/A/S/D, 'T' to stay, 0 for a passo wait */
+} solver_node_t;
+
+/**
+ * @brief A route into the portal: its last node and move.
+ */
+typedef struct {
+  int32_t node;
+  char action;
+  int points;
+  int tick; /**< Ticks played when Pacman enters the portal, 0 for none */
+} solver_goal_t;
+
+/**
+ * @brief Ghost-only run of a level.
+ */
+typedef struct {
+  int n_ghosts;
+  int ticks;
+  int *cells;       /**< (ticks + 1) * n_ghosts ghost cells per tick */
+  int *sweep_start; /**< ticks + 1 offsets into sweep */
+  int *sweep;       /**< Cells crossed by ghost moves during each tick */
+  size_t sweep_len, sweep_cap;
+  uint64_t *phase; /**< Ghost phase key at each tick */
+} solver_ghosts_t;
+
+typedef struct solver solver_t;
+
+/**
+ * @brief Per-thread counters and best goals of the current layer.
+ */
+typedef struct {
+  solver_t *solver;
+  pthread_t thread;
+  long moves;  /**< Pacman moves tried */
+  long lethal; /**< Moves that got Pacman killed */
+  solver_goal_t fastest, best;
+} solver_worker_t;
+
+/**
+ * @brief Search state of the level being solved, shared by the workers.
+ */
+struct solver {
+  const solver_opts_t *opts;
+
+  // Level
+  int width, height, passo;
+  const board_pos_t *cells;
+  int *dot_id;       /**< Dot number of each cell, -1 for none */
+  uint64_t *dot_key; /**< Hash key of each dot */
+  int dot_words;     /**< uint64_t words in a node's eaten-dot set */
+  solver_ghosts_t ghosts;
+
+  // Nodes and transposition table, reused by every level
+  solver_node_t *nodes;
+  uint64_t *eaten; /**< dot_words words per node */
+  size_t eaten_cap;
+  _Atomic uint64_t *table;
+  uint64_t table_mask;
+  atomic_long n_nodes;
+  atomic_int overflow;
+
+  // Current layer
+  int tick;
+  long end;
+  atomic_long next;
+  int stop;
+
+  pthread_barrier_t start, done;
+  solver_worker_t *workers;
+};
+
+/**
+ * @brief SplitMix64 finalizer.
+ */
+static inline uint64_t solver_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Hash key of Pacman's cell and passo countdown.
+ */
+static inline uint64_t pacman_key(int cell, int waiting) {
+  return solver_mix(0x5851f42d4c957f2dULL ^ (uint64_t)(uint32_t)cell ^
+                    (uint64_t)(uint32_t)waiting << 32);
+}
+
+/**
+ * @brief Inserts a state key into the transposition table.
+ * @return 1 if the key is new, 0 if it was there already.
+ */
+static int table_insert(solver_t *s, uint64_t key) {
+  if (key == 0)
+    key = 1; // 0 marks an empty slot
+  for (uint64_t i = key & s->table_mask;; i = (i + 1) & s->table_mask) {
+    uint64_t cur = atomic_load_explicit(&s->table[i], memory_order_relaxed);
+    if (cur == key)
+      return 0;
+    if (cur != 0)
+      continue;
+    if (atomic_compare_exchange_strong_explicit(&s->table[i], &cur, key,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+      return 1;
+    if (cur == key)
+      return 0;
+  }
+}
+
+/**
+ * @brief Appends a cell to the sweep list.
+ */
+static int sweep_push(solver_ghosts_t *g, int cell) {
+  if (g->sweep_len == g->sweep_cap) {
+    size_t cap = g->sweep_cap ? g->sweep_cap * 2 : 256;
+    int *sweep = realloc(g->sweep, cap * sizeof(int));
+    if (sweep == NULL)
+      return -1;
+    g->sweep = sweep;
+    g->sweep_cap = cap;
+  }
+  g->sweep[g->sweep_len++] = cell;
+  return 0;
+}
+
+/**
+ * @brief Plays the level's ghosts alone for max_ticks ticks.
+ *
+ * Pacman is taken off the board, so a charged ghost sweeps the whole line it
+ * would have caught Pacman on. Random moves use opts->seed; their phase is
+ * the tick itself, since the ghosts never repeat a state for sure.
+ * @return 0 on success, -1 if out of memory.
+ */
+static int run_ghosts(solver_t *s, const board_t *level) {
+  solver_ghosts_t *g = &s->ghosts;
+  int ticks = s->opts->max_ticks;
+  g->n_ghosts = level->n_ghosts;
+  g->ticks = ticks;
+  g->sweep_len = 0;
+  g->cells = malloc((size_t)(ticks + 1) * (size_t)(g->n_ghosts + 1) *
+                    sizeof(int));
+  g->sweep_start = malloc((size_t)(ticks + 2) * sizeof(int));
+  g->phase = malloc((size_t)(ticks + 1) * sizeof(uint64_t));
+  board_t b;
+  if (g->cells == NULL || g->sweep_start == NULL || g->phase == NULL ||
+      board_clone(&b, level, 0) != 0)
+    return -1;
+
+  pacman_t *pac = &b.pacmans[0];
+  b.board[pac->pos_y * b.width + pac->pos_x].content = ' ';
+  pac->alive = 0;
+  b.rng_seed = s->opts->seed;
+  b.hash = board_hash(&b);
+
+  int random = 0;
+  for (int i = 0; i < b.n_ghosts; i++) {
+    if (b.ghosts[i].n_moves == 0)
+      random = 1;
+    for (int m = 0; m < b.ghosts[i].n_moves; m++)
+      if (b.ghosts[i].moves[m].command == 'R')
+        random = 1;
+  }
+
+  int status = 0;
+  for (int t = 0; t <= ticks && status == 0; t++) {
+    g->phase[t] = random ? solver_mix((uint64_t)t) : b.hash;
+    g->sweep_start[t] = (int)g->sweep_len;
+    for (int i = 0; i < b.n_ghosts; i++) {
+      ghost_t *ghost = &b.ghosts[i];
+      g->cells[(size_t)t * (size_t)g->n_ghosts + (size_t)i] =
+          ghost->pos_y * b.width + ghost->pos_x;
+    }
+    if (t == ticks)
+      break;
+
+    for (int i = 0; i < b.n_ghosts && status == 0; i++) {
+      ghost_t *ghost = &b.ghosts[i];
+      int x = ghost->pos_x, y = ghost->pos_y;
+      if (ghost->n_moves > 0) {
+        move_ghost(&b, i, &ghost->moves[ghost->current_move % ghost->n_moves]);
+      } else {
+        command_t random_move = {'R', 1, 1};
+        move_ghost(&b, i, &random_move);
+      }
+      // Every cell entered, up to and including the new position
+      int dx = (ghost->pos_x > x) - (ghost->pos_x < x);
+      int dy = (ghost->pos_y > y) - (ghost->pos_y < y);
+      while ((x != ghost->pos_x || y != ghost->pos_y) && status == 0) {
+        x += dx;
+        y += dy;
+        status = sweep_push(g, y * b.width + x);
+      }
+    }
+  }
+  g->sweep_start[ticks + 1] = (int)g->sweep_len;
+  unload_level(&b);
+  return status;
+}
+
+/**
+ * @brief Frees the ghost-only run.
+ */
+static void free_ghosts(solver_ghosts_t *g) {
+  free(g->cells);
+  free(g->sweep_start);
+  free(g->sweep);
+  free(g->phase);
+  memset(g, 0, sizeof(*g));
+}
+
+/**
+ * @brief Tells whether a ghost stands on a cell at a tick.
+ */
+static int ghost_at(const solver_t *s, int tick, int cell) {
+  const int *cells = s->ghosts.cells + (size_t)tick * (size_t)s->ghosts.n_ghosts;
+  for (int i = 0; i < s->ghosts.n_ghosts; i++)
+    if (cells[i] == cell)
+      return 1;
+  return 0;
+}
+
+/**
+ * @brief Tells whether a ghost move during a tick crosses a cell.
+ */
+static int swept(const solver_t *s, int tick, int cell) {
+  for (int i = s->ghosts.sweep_start[tick]; i < s->ghosts.sweep_start[tick + 1];
+       i++)
+    if (s->ghosts.sweep[i] == cell)
+      return 1;
+  return 0;
+}
+
+/**
+ * @brief Keeps the better of two goals for the fastest route (then score)
+ * and for the best score (then time).
+ */
+static void goal_offer(solver_worker_t *w, const solver_goal_t *goal) {
+  solver_goal_t *f = &w->fastest, *b = &w->best;
+  if (f->tick == 0 || goal->tick < f->tick ||
+      (goal->tick == f->tick && goal->points > f->points))
+    *f = *goal;
+  if (b->tick == 0 || goal->points > b->points ||
+      (goal->points == b->points && goal->tick < b->tick))
+    *b = *goal;
+}
+
+/**
+ * @brief Lets the ghosts play the tick and keeps the successor if new.
+ * @param s Solver.
+ * @param w Calling worker.
+ * @param parent Node being expanded.
+ * @param cell Pacman's cell after its move.
+ * @param waiting Pacman's passo countdown after its move.
+ * @param action Pacman's move.
+ */
+static void successor(solver_t *s, solver_worker_t *w, int32_t parent,
+                      int cell, int waiting, char action) {
+  const solver_node_t *from = &s->nodes[parent];
+  const uint64_t *from_eaten = s->eaten + (size_t)parent * (size_t)s->dot_words;
+  w->moves++;
+  if (swept(s, s->tick, cell)) {
+    w->lethal++;
+    return;
+  }
+
+  int dot = cell != from->cell ? s->dot_id[cell] : -1;
+  if (dot >= 0 && (from_eaten[dot / 64] >> (dot % 64) & 1))
+    dot = -1;
+  uint64_t dots_key = from->dots_key ^ (dot >= 0 ? s->dot_key[dot] : 0);
+  uint64_t key =
+      s->ghosts.phase[s->tick + 1] ^ pacman_key(cell, waiting) ^ dots_key;
+  if (atomic_load_explicit(&s->overflow, memory_order_relaxed) ||
+      !table_insert(s, key))
+    return;
+
+  long n = atomic_fetch_add_explicit(&s->n_nodes, 1, memory_order_relaxed);
+  if (n >= s->opts->max_states) {
+    atomic_store_explicit(&s->overflow, 1, memory_order_relaxed);
+    return;
+  }
+  solver_node_t *node = &s->nodes[n];
+  node->dots_key = dots_key;
+  node->parent = parent;
+  node->cell = cell;
+  node->points = from->points + (dot >= 0 ? cell : 0);
+  node->waiting = (int16_t)waiting;
+  node->action = action;
+  uint64_t *eaten = s->eaten + (size_t)n * (size_t)s->dot_words;
+  memcpy(eaten, from_eaten, (size_t)s->dot_words * sizeof(uint64_t));
+  if (dot >= 0)
+    eaten[dot / 64] |= 1ULL << (dot % 64);
+}
+
+/**
+ * @brief Expands one node: every move Pacman can make this tick.
+ */
+static void expand(solver_t *s, solver_worker_t *w, int32_t n) {
+  const solver_node_t *node = &s->nodes[n];
+  if (node->waiting > 0) {
+    successor(s, w, n, node->cell, node->waiting - 1, 0);
+    return;
+  }
+
+  static const char dirs[] = {'W', 'A', 'S', 'D'};
+  static const int dx[] = {0, -1, 0, 1}, dy[] = {-1, 0, 1, 0};
+  int x = node->cell % s->width, y = node->cell / s->width;
+  for (int d = 0; d < 4; d++) {
+    int nx = x + dx[d], ny = y + dy[d];
+    if (nx < 0 || nx >= s->width || ny < 0 || ny >= s->height)
+      continue;
+    int cell = ny * s->width + nx;
+    const board_pos_t *pos = &s->cells[cell];
+    if (pos->has_portal) {
+      solver_goal_t goal = {n, dirs[d], node->points, s->tick + 1};
+      w->moves++;
+      goal_offer(w, &goal);
+      continue;
+    }
+    // A wall bump is the same as staying
+    if (pos->content == 'W' || pos->content == 'X')
+      continue;
+    if (ghost_at(s, s->tick, cell)) {
+      w->moves++;
+      w->lethal++;
+      continue;
+    }
+    successor(s, w, n, cell, s->passo, dirs[d]);
+  }
+  successor(s, w, n, node->cell, s->passo, 'T');
+}
+
+/**
+ * @brief Expands the current layer until no chunk is left.
+ */
+static void expand_layer(solver_t *s, solver_worker_t *w) {
+  while (!atomic_load_explicit(&s->overflow, memory_order_relaxed)) {
+    long begin =
+        atomic_fetch_add_explicit(&s->next, SOLVER_CHUNK, memory_order_relaxed);
+    if (begin >= s->end)
+      break;
+    long end = begin + SOLVER_CHUNK < s->end ? begin + SOLVER_CHUNK : s->end;
+    for (long n = begin; n < end; n++)
+      expand(s, w, (int32_t)n);
+  }
+}
+
+/**
+ * @brief Worker thread: expands every layer the coordinator starts.
+ */
+static void *solver_worker(void *arg) {
+  solver_worker_t *w = (solver_worker_t *)arg;
+  solver_t *s = w->solver;
+  while (1) {
+    pthread_barrier_wait(&s->start);
+    if (s->stop)
+      break;
+    expand_layer(s, w);
+    pthread_barrier_wait(&s->done);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Result of one level.
+ */
+typedef struct {
+  solver_goal_t fastest, best;
+  long states;
+  long moves, lethal;
+  int complete; /**< Best score proven optimal */
+  const char *limit; /**< Why the search stopped */
+  long long total_dots; /**< Score with every dot eaten */
+} solver_result_t;
+
+/**
+ * @brief Maps the level's dots and sizes the per-node dot sets.
+ * @return 0 on success, -1 if out of memory.
+ */
+static int map_dots(solver_t *s, const board_t *level, long long *total) {
+  int cells = level->width * level->height;
+  int dots = 0;
+  *total = 0;
+  s->dot_id = malloc((size_t)cells * sizeof(int));
+  if (s->dot_id == NULL)
+    return -1;
+  for (int i = 0; i < cells; i++) {
+    s->dot_id[i] = level->board[i].has_dot ? dots++ : -1;
+    if (level->board[i].has_dot)
+      *total += i;
+  }
+  s->dot_key = malloc(((size_t)dots + 1) * sizeof(uint64_t));
+  if (s->dot_key == NULL)
+    return -1;
+  for (int d = 0; d < dots; d++)
+    s->dot_key[d] = solver_mix(0xd1b54a32d192ed03ULL + (uint64_t)d);
+
+  s->dot_words = dots / 64 + 1;
+  size_t need = (size_t)s->opts->max_states * (size_t)s->dot_words;
+  if (need > s->eaten_cap) {
+    free(s->eaten);
+    s->eaten = malloc(need * sizeof(uint64_t));
+    s->eaten_cap = s->eaten ? need : 0;
+    if (s->eaten == NULL)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Searches one loaded level.
+ * @return 0 on success, -1 if out of memory.
+ */
+static int solve_level(solver_t *s, const board_t *level, solver_result_t *r) {
+  memset(r, 0, sizeof(*r));
+  s->width = level->width;
+  s->height = level->height;
+  s->passo = level->pacmans[0].passo;
+  s->cells = level->board;
+  if (map_dots(s, level, &r->total_dots) != 0 || run_ghosts(s, level) != 0)
+    return -1;
+
+  memset((void *)s->table, 0, (s->table_mask + 1) * sizeof(uint64_t));
+  const pacman_t *pac = &level->pacmans[0];
+  solver_node_t *root = &s->nodes[0];
+  memset(root, 0, sizeof(*root));
+  root->parent = -1;
+  root->cell = pac->pos_y * level->width + pac->pos_x;
+  memset(s->eaten, 0, (size_t)s->dot_words * sizeof(uint64_t));
+  table_insert(s, s->ghosts.phase[0] ^ pacman_key(root->cell, 0));
+  atomic_store(&s->n_nodes, 1);
+  atomic_store(&s->overflow, 0);
+
+  long begin = 0;
+  r->limit = "tick limit";
+  for (s->tick = 0; s->tick < s->opts->max_ticks; s->tick++) {
+    s->end = atomic_load(&s->n_nodes);
+    if (begin == s->end) {
+      r->limit = "exhausted";
+      break;
+    }
+    atomic_store(&s->next, begin);
+    pthread_barrier_wait(&s->start);
+    expand_layer(s, &s->workers[0]);
+    pthread_barrier_wait(&s->done);
+    begin = s->end;
+
+    for (int i = 0; i < s->opts->threads; i++) {
+      solver_worker_t *w = &s->workers[i];
+      if (w->fastest.tick != 0 &&
+          (r->fastest.tick == 0 || w->fastest.tick < r->fastest.tick ||
+           (w->fastest.tick == r->fastest.tick &&
+            w->fastest.points > r->fastest.points)))
+        r->fastest = w->fastest;
+      if (w->best.tick != 0 &&
+          (r->best.tick == 0 || w->best.points > r->best.points ||
+           (w->best.points == r->best.points && w->best.tick < r->best.tick)))
+        r->best = w->best;
+      r->moves += w->moves;
+      r->lethal += w->lethal;
+      memset(&w->fastest, 0, sizeof(w->fastest));
+      memset(&w->best, 0, sizeof(w->best));
+      w->moves = w->lethal = 0;
+    }
+    if (atomic_load(&s->overflow)) {
+      r->limit = "state limit";
+      break;
+    }
+    if (s->opts->fastest_only && r->fastest.tick != 0) {
+      r->limit = "par found";
+      break;
+    }
+  }
+  long n = atomic_load(&s->n_nodes);
+  r->states = n < s->opts->max_states ? n : s->opts->max_states;
+  r->complete = strcmp(r->limit, "exhausted") == 0 ||
+                (r->best.tick != 0 && r->best.points == r->total_dots);
+  return 0;
+}
+
+/**
+ * @brief Writes the route to a goal as a .p script.
+ * @return Number of commands written, -1 on error.
+ */
+static int write_script(const solver_t *s, const board_t *level,
+                        const solver_goal_t *goal, const char *path) {
+  char *moves = malloc((size_t)goal->tick + 1);
+  if (moves == NULL)
+    return -1;
+  int len = 0;
+  moves[len++] = goal->action;
+  for (int32_t n = goal->node; s->nodes[n].parent >= 0; n = s->nodes[n].parent)
+    if (s->nodes[n].action != 0)
+      moves[len++] = s->nodes[n].action;
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    free(moves);
+    return -1;
+  }
+  fprintf(f, "# %s: %d ticks, %d points\n", level->level_name, goal->tick,
+          goal->points);
+  fprintf(f, "PASSO %d\nPOS %d %d\n", s->passo, level->pacmans[0].pos_y,
+          level->pacmans[0].pos_x);
+  int commands = 0;
+  for (int i = len - 1; i >= 0; i--, commands++) {
+    if (moves[i] != 'T') {
+      fprintf(f, "%c\n", moves[i]);
+      continue;
+    }
+    int turns = 1;
+    while (i > 0 && moves[i - 1] == 'T') {
+      turns++;
+      i--;
+    }
+    fprintf(f, "T %d\n", turns);
+  }
+  free(moves);
+  if (fclose(f) != 0)
+    return -1;
+  return commands;
+}
+
+/**
+ * @brief Writes <dir>/<level>.<kind>.p and warns if it is too long to load.
+ */
+static void save_script(const solver_t *s, const board_t *level,
+                        const solver_goal_t *goal, const char *kind) {
+  const char *name = strrchr(level->level_name, '/');
+  name = name ? name + 1 : level->level_name;
+  size_t base = strlen(name);
+  if (base > 4 && strcmp(name + base - 4, ".lvl") == 0)
+    base -= 4;
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%.*s.%s.p", s->opts->dir, (int)base, name,
+           kind);
+  int commands = write_script(s, level, goal, path);
+  if (commands < 0)
+    fprintf(stderr, "solver: %s: %s\n", path, strerror(errno));
+  else if (commands > MAX_MOVES)
+    fprintf(stderr,
+            "solver: %s has %d commands; load_level() keeps the first %d\n",
+            path, commands, MAX_MOVES);
+}
+
+/**
+ * @brief Loads, solves and reports one level file.
+ * @return 0 on success, -1 on error.
+ */
+static int solve_file(solver_t *s, const char *path) {
+  board_t level;
+  memset(&level, 0, sizeof(level));
+  if (load_level(&level, path, 0) != 0 || level.n_pacmans < 1) {
+    fprintf(stderr, "solver: cannot load %s\n", path);
+    return -1;
+  }
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  solver_result_t r;
+  int status = solve_level(s, &level, &r);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 +
+              (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+  if (status != 0) {
+    fprintf(stderr, "solver: %s: out of memory\n", path);
+  } else if (r.fastest.tick == 0) {
+    printf("%-28s %6s %8s %8s %7s %9ld %6.1f%% %-11s %8.1f\n", path, "-", "-",
+           "-", "-", r.states,
+           r.moves ? 100.0 * (double)r.lethal / (double)r.moves : 0.0, r.limit,
+           ms);
+  } else {
+    printf("%-28s %6d %8d %7d%s %7d %9ld %6.1f%% %-11s %8.1f\n", path,
+           r.fastest.tick, r.fastest.tick * level.tempo, r.best.points,
+           r.complete ? " " : "+", r.best.tick, r.states,
+           r.moves ? 100.0 * (double)r.lethal / (double)r.moves : 0.0, r.limit,
+           ms);
+    if (s->opts->dir != NULL) {
+      save_script(s, &level, &r.fastest, "par");
+      save_script(s, &level, &r.best, "best");
+    }
+  }
+  fflush(stdout);
+
+  free_ghosts(&s->ghosts);
+  free(s->dot_id);
+  free(s->dot_key);
+  s->dot_id = NULL;
+  s->dot_key = NULL;
+  unload_level(&level);
+  return status;
+}
+
+/**
+ * @brief Keeps directory entries named *.lvl.
+ */
+static int is_level(const struct dirent *e) {
+  size_t len = strlen(e->d_name);
+  return len > 4 && strcmp(e->d_name + len - 4, ".lvl") == 0;
+}
+
+/**
+ * @brief Solves a level file, or every level of a directory in name order.
+ * @return Number of levels that failed.
+ */
+static int solve_path(solver_t *s, const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+    return solve_file(s, path) != 0;
+
+  struct dirent **list;
+  int n = scandir(path, &list, is_level, alphasort);
+  if (n < 0) {
+    fprintf(stderr, "solver: %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  int failed = 0;
+  for (int i = 0; i < n; i++) {
+    char file[1024];
+    snprintf(file, sizeof(file), "%s/%s", path, list[i]->d_name);
+    failed += solve_file(s, file) != 0;
+    free(list[i]);
+  }
+  free(list);
+  return failed;
+}
+
+/**
+ * @brief Prints usage and the defaults.
+ */
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-j threads] [-t ticks] [-m states] [-r seed] [-f]\n"
+          "          [-o dir] <level.lvl | dir>...\n"
+          "  -j  Search threads (default: online CPUs)\n"
+          "  -t  Deepest tick searched (default 1000)\n"
+          "  -m  States kept per level (default 1048576)\n"
+          "  -r  rng seed for random ghost moves (default 1)\n"
+          "  -f  Stop at the par time, skip the best score search\n"
+          "  -o  Write <level>.par.p and <level>.best.p scripts to dir\n"
+          "Columns: par ticks, par ms (ticks * TEMPO), best score ('+' when\n"
+          "a limit cut the search short), tick it is reached at, states,\n"
+          "share of moves that kill Pacman, why the search stopped, ms.\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  solver_opts_t o = {.threads = cpus > 0 ? (int)cpus : 1,
+                     .max_ticks = 1000,
+                     .max_states = 1L << 20,
+                     .seed = 1,
+                     .fastest_only = 0,
+                     .dir = NULL};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "j:t:m:r:fo:h")) != -1) {
+    switch (opt) {
+    case 'j':
+      o.threads = atoi(optarg);
+      break;
+    case 't':
+      o.max_ticks = atoi(optarg);
+      break;
+    case 'm':
+      o.max_states = atol(optarg);
+      break;
+    case 'r':
+      o.seed = (unsigned int)strtoul(optarg, NULL, 10);
+      break;
+    case 'f':
+      o.fastest_only = 1;
+      break;
+    case 'o':
+      o.dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || o.threads < 1 || o.max_ticks < 1 ||
+      o.max_states < 1 || o.max_states > INT32_MAX) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (o.dir != NULL && mkdir(o.dir, 0755) == -1 && errno != EEXIST) {
+    perror("solver: mkdir");
+    return 1;
+  }
+
+  // The table stays at most half full
+  uint64_t slots = 1;
+  while (slots < (uint64_t)o.max_states * 2 + (uint64_t)o.threads * 8)
+    slots <<= 1;
+  solver_t s;
+  memset(&s, 0, sizeof(s));
+  s.opts = &o;
+  s.nodes = malloc((size_t)o.max_states * sizeof(solver_node_t));
+  s.table = malloc(slots * sizeof(uint64_t));
+  s.table_mask = slots - 1;
+  s.workers = calloc((size_t)o.threads, sizeof(solver_worker_t));
+  if (s.nodes == NULL || s.table == NULL || s.workers == NULL) {
+    fprintf(stderr, "solver: out of memory\n");
+    return 1;
+  }
+
+  pthread_barrier_init(&s.start, NULL, (unsigned int)o.threads);
+  pthread_barrier_init(&s.done, NULL, (unsigned int)o.threads);
+  for (int i = 0; i < o.threads; i++) {
+    s.workers[i].solver = &s;
+    if (i > 0 &&
+        pthread_create(&s.workers[i].thread, NULL, solver_worker,
+                       &s.workers[i]) != 0) {
+      perror("solver: pthread_create");
+      return 1;
+    }
+  }
+
+  printf("%-28s %6s %8s %8s %7s %9s %7s %-11s %8s\n", "level", "par",
+         "par_ms", "best", "best_at", "states", "lethal", "stopped", "ms");
+  int failed = 0;
+  for (int i = optind; i < argc; i++)
+    failed += solve_path(&s, argv[i]);
+
+  s.stop = 1;
+  pthread_barrier_wait(&s.start);
+  for (int i = 1; i < o.threads; i++)
+    pthread_join(s.workers[i].thread, NULL);
+  pthread_barrier_destroy(&s.start);
+  pthread_barrier_destroy(&s.done);
+  free(s.nodes);
+  free(s.eaten);
+  free((void *)s.table);
+  free(s.workers);
+  return failed ? 1 : 0;
+}